@@ -238,12 +238,16 @@ echo "     sudo cp bin/sdr_streamer /usr/local/bin/"
 echo "     sudo cp bin/freq_scanner /usr/local/bin/"
 echo "     sudo cp bin/iq_recorder /usr/local/bin/"
 echo ""
-echo "  2. Test with B210 hardware:"
+echo "  2. Pre-plan FFT sizes (once per machine, as the user running the web app):"
+echo "     cd $REMOTE_DIR/build/bin"
+echo "     ./fftw_wisdom_builder --effort patient"
+echo ""
+echo "  3. Test with B210 hardware:"
 echo "     ssh -p $REMOTE_PORT $REMOTE_USER@$REMOTE_HOST"
 echo "     cd $REMOTE_DIR/build/bin"
 echo "     ./sdr_streamer --freq 915e6 --rate 10e6 --gain 40"
 echo ""
-echo "  3. Configure web application:"
+echo "  4. Configure web application:"
 echo "     Set SDR_MODE=production in .env"
 echo "     Set SDR_STREAMER_PATH=/usr/local/bin/sdr_streamer (if installed system-wide)"
 echo "     Restart web application"
@@ -0,0 +1,421 @@
+/**
+ * async_writer.hpp - Double-buffered asynchronous file writer for the recorders
+ *
+ * Keeps the filesystem off the receive thread. The receive loop asks for
+ * space with acquire(), lets the driver write samples straight into it and
+ * commit()s what it got; once a buffer is full it is queued to a writer
+ * thread, which issues the actual writes. Buffers are large (tens of MB),
+ * page aligned and allocated up front in an SpscRing, so a page-cache
+ * flush or a filesystem stall only fills the queue instead of blocking
+ * recv()/readStream().
+ *
+ * If every buffer is still queued the receive thread must not wait: it
+ * reads into a scratch buffer and reports the loss with mark_dropped(),
+ * the same policy the streamers use for their sample rings.
+ *
+ * Write backends (the writer thread's side only):
+ *
+ *   buffered  pwrite() through the page cache
+ *   direct    O_DIRECT pwrite(), one buffer at a time; no page-cache
+ *             writeback bursts and no eviction of other memory
+ *   uring     O_DIRECT writes through io_uring, `queue_depth` chunks of
+ *             `chunk_bytes` in flight across buffers
+ *
+ * direct/uring fall back to buffered when O_DIRECT or io_uring is not
+ * available; backend() and backend_note() report what was actually used.
+ * When the final size is known (expected_bytes) the file is fallocate()d
+ * up front so the filesystem is not allocating extents mid-capture; the
+ * file is truncated to the bytes actually recorded on close(), which also
+ * drops the page padding of the last O_DIRECT write.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "io_uring_queue.hpp"
+#include "latency_histogram.hpp"
+#include "spsc_ring.hpp"
+
+// Page-aligned heap block. Copies allocate their own storage so SpscRing
+// can clone a prototype into every slot.
+class AlignedBuffer {
+public:
+    static constexpr size_t ALIGNMENT = 4096;
+
+    explicit AlignedBuffer(size_t bytes = 0) { allocate(bytes); }
+    AlignedBuffer(const AlignedBuffer& other) { allocate(other.size_); }
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+    ~AlignedBuffer() { std::free(data_); }
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    void allocate(size_t bytes) {
+        size_ = bytes;
+        if (bytes == 0) return;
+        void* ptr = nullptr;
+        if (::posix_memalign(&ptr, ALIGNMENT, bytes) != 0) throw std::bad_alloc();
+        // Fault the pages in now rather than on the receive thread
+        std::memset(ptr, 0, bytes);
+        data_ = static_cast<uint8_t*>(ptr);
+    }
+
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+struct WriteBlock {
+    AlignedBuffer buffer;
+    size_t used = 0;
+};
+
+enum class WriteBackend { Buffered, Direct, Uring };
+
+inline bool parse_write_backend(const std::string& name, WriteBackend& backend) {
+    if (name == "buffered") { backend = WriteBackend::Buffered; return true; }
+    if (name == "direct") { backend = WriteBackend::Direct; return true; }
+    if (name == "uring") { backend = WriteBackend::Uring; return true; }
+    return false;
+}
+
+inline const char* write_backend_name(WriteBackend backend) {
+    switch (backend) {
+    case WriteBackend::Buffered: return "buffered";
+    case WriteBackend::Direct: return "direct";
+    case WriteBackend::Uring: return "uring";
+    }
+    return "buffered";
+}
+
+struct AsyncWriterOptions {
+    size_t buffer_bytes = size_t(32) << 20;   // Rounded up to the page size
+    size_t num_buffers = 8;                   // Rounded up to a power of two
+    WriteBackend backend = WriteBackend::Buffered;
+    uint64_t expected_bytes = 0;              // fallocate() this much up front (0 = unknown)
+    size_t chunk_bytes = size_t(4) << 20;     // uring: bytes per write
+    unsigned queue_depth = 8;                 // uring: writes in flight
+    bool sync_on_close = false;               // fdatasync() before close()
+};
+
+class AsyncFileWriter {
+public:
+    AsyncFileWriter(const std::string& path, const AsyncWriterOptions& options)
+        : path_(path), options_(options), buffer_bytes_(round_up_page(options.buffer_bytes)),
+          ring_(std::max<size_t>(2, options.num_buffers), WriteBlock{AlignedBuffer(buffer_bytes_), 0}) {
+        options_.chunk_bytes = round_up_page(options_.chunk_bytes);
+        options_.queue_depth = std::max(1u, options_.queue_depth);
+        if (!open_file()) return;
+        writer_ = std::thread(&AsyncFileWriter::writer_loop, this);
+    }
+
+    ~AsyncFileWriter() { close(); }
+
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    bool is_open() const { return fd_ >= 0; }
+    const std::string& path() const { return path_; }
+    WriteBackend backend() const { return backend_; }
+    // Why the requested backend was not used, or why preallocation failed
+    const std::string& backend_note() const { return note_; }
+
+    // Producer: free space in the current buffer (at least one byte), or
+    // nullptr if all buffers are queued for writing
+    void* acquire(size_t& bytes_available) {
+        if (!current_) {
+            current_ = ring_.acquire_write();
+            if (!current_) return nullptr;
+            current_->used = 0;
+        }
+        bytes_available = current_->buffer.size() - current_->used;
+        return current_->buffer.data() + current_->used;
+    }
+
+    // Producer: `bytes` of the space returned by acquire() now hold data
+    void commit(size_t bytes) {
+        current_->used += bytes;
+        if (current_->used == current_->buffer.size()) {
+            ring_.commit_write();
+            current_ = nullptr;
+        }
+    }
+
+    // Producer: data received into a scratch buffer because acquire() failed
+    void mark_dropped(size_t bytes) {
+        dropped_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Producer: queues the partial buffer, waits for the writer to drain and
+    // closes the file. Returns false if any write failed.
+    bool close() {
+        if (fd_ < 0) return !failed_.load();
+        if (current_ && current_->used > 0) {
+            ring_.commit_write();
+        }
+        current_ = nullptr;
+        stopping_.store(true, std::memory_order_release);
+        if (writer_.joinable()) writer_.join();
+        uring_.close();
+
+        // Drop preallocated space and O_DIRECT padding past the real data
+        if ((preallocated_ || backend_ != WriteBackend::Buffered)
+            && ::ftruncate(fd_, static_cast<off_t>(bytes_written())) != 0) {
+            fail(errno);
+        }
+        if (options_.sync_on_close && ::fdatasync(fd_) != 0) fail(errno);
+        if (::close(fd_) != 0) fail(errno);
+        fd_ = -1;
+        return !failed_.load();
+    }
+
+    // Statistics (safe from any thread)
+    size_t buffer_bytes() const { return buffer_bytes_; }
+    size_t buffers() const { return ring_.capacity(); }
+    size_t buffers_queued() const { return ring_.depth(); }
+    size_t buffers_peak() const { return ring_.high_water(); }
+    uint64_t bytes_written() const { return bytes_written_.load(std::memory_order_relaxed); }
+    uint64_t dropped_bytes() const { return dropped_bytes_.load(std::memory_order_relaxed); }
+    bool failed() const { return failed_.load(); }
+    int error() const { return error_.load(); }
+    // Time with a write outstanding; bytes_written / busy = disk bandwidth
+    double busy_seconds() const { return busy_ns_.load(std::memory_order_relaxed) / 1e9; }
+    // Per-write latency in ns (submission to completion); read after close()
+    const LatencyHistogram& write_latency() const { return latency_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // One io_uring write; user_data is its index in requests_
+    struct Request {
+        size_t slot = 0;
+        const uint8_t* data = nullptr;
+        size_t bytes = 0;
+        uint64_t offset = 0;
+        Clock::time_point start;
+    };
+
+    static size_t round_up_page(size_t bytes) {
+        const size_t page = AlignedBuffer::ALIGNMENT;
+        return std::max(page, (bytes + page - 1) / page * page);
+    }
+
+    static int64_t elapsed_ns(Clock::time_point since) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count();
+    }
+
+    bool open_file() {
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        backend_ = options_.backend;
+
+        if (backend_ != WriteBackend::Buffered) {
+            fd_ = ::open(path_.c_str(), flags | O_DIRECT, 0644);
+            if (fd_ < 0) {
+                if (errno != EINVAL) return false;
+                note_ = "O_DIRECT not supported by this filesystem";
+                backend_ = WriteBackend::Buffered;
+            }
+        }
+        if (fd_ < 0) {
+            fd_ = ::open(path_.c_str(), flags, 0644);
+            if (fd_ < 0) return false;
+        }
+
+        if (backend_ == WriteBackend::Uring && !uring_.open(options_.queue_depth)) {
+            note_ = std::string("io_uring unavailable: ") + std::strerror(errno);
+            backend_ = WriteBackend::Buffered;
+            ::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL) & ~O_DIRECT);
+        }
+
+        if (options_.expected_bytes > 0) {
+            preallocated_ = ::fallocate(fd_, 0, 0, static_cast<off_t>(round_up_page(options_.expected_bytes))) == 0;
+            if (!preallocated_) {
+                if (!note_.empty()) note_ += "; ";
+                note_ += std::string("fallocate failed: ") + std::strerror(errno);
+            }
+        }
+        return true;
+    }
+
+    void fail(int err) {
+        if (!failed_.exchange(true)) error_.store(err);
+    }
+
+    // Synchronous write of the whole range; records its latency
+    bool write_at(const uint8_t* data, size_t bytes, uint64_t offset) {
+        const auto start = Clock::now();
+        while (bytes > 0) {
+            const ssize_t n = ::pwrite(fd_, data, bytes, static_cast<off_t>(offset));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                fail(errno);
+                return false;
+            }
+            data += n;
+            bytes -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        const int64_t ns = elapsed_ns(start);
+        latency_.record(static_cast<uint64_t>(ns));
+        busy_ns_.fetch_add(ns, std::memory_order_relaxed);
+        return true;
+    }
+
+    void writer_loop() {
+        if (backend_ == WriteBackend::Uring) {
+            uring_loop();
+            return;
+        }
+
+        const bool direct = backend_ == WriteBackend::Direct;
+        uint64_t offset = 0;
+        while (true) {
+            WriteBlock* block = ring_.acquire_read();
+            if (!block) {
+                if (stopping_.load(std::memory_order_acquire) && ring_.depth() == 0) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+
+            // Only the last block can be partial; O_DIRECT pads it to a page
+            const size_t bytes = direct ? round_up_page(block->used) : block->used;
+            // After a failure keep draining so the receive thread never stalls
+            if (!failed_.load()) write_at(block->buffer.data(), bytes, offset);
+            offset += bytes;
+            bytes_written_.fetch_add(block->used, std::memory_order_relaxed);
+            ring_.release_read();
+        }
+    }
+
+    void uring_loop() {
+        const size_t slots = ring_.capacity();
+        std::vector<unsigned> pending(slots, 0);          // Writes in flight per ring slot
+        std::vector<Request> requests(options_.queue_depth);
+        std::vector<size_t> free_requests;
+        for (size_t i = 0; i < requests.size(); i++) free_requests.push_back(i);
+
+        size_t released = 0;      // Blocks handed back to the producer
+        size_t submitting = 0;    // Block currently being split into writes
+        size_t submit_offset = 0; // Bytes of it already submitted
+        uint64_t file_offset = 0;
+        size_t inflight = 0;
+        Clock::time_point busy_start;
+
+        while (true) {
+            // Keep queue_depth writes in flight, spanning buffers if needed
+            size_t prepared = 0;
+            while (!free_requests.empty()) {
+                WriteBlock* block = ring_.peek_read(submitting - released);
+                if (!block) break;
+                const size_t total = round_up_page(block->used);
+                const size_t bytes = std::min(options_.chunk_bytes, total - submit_offset);
+
+                Request& req = requests[free_requests.back()];
+                req.slot = submitting % slots;
+                req.data = block->buffer.data() + submit_offset;
+                req.bytes = bytes;
+                req.offset = file_offset;
+                req.start = Clock::now();
+                if (!uring_.prepare_write(fd_, req.data, static_cast<uint32_t>(bytes), req.offset,
+                                          free_requests.back())) {
+                    break;
+                }
+                free_requests.pop_back();
+                pending[req.slot]++;
+                if (inflight++ == 0) busy_start = req.start;
+                prepared++;
+
+                file_offset += bytes;
+                submit_offset += bytes;
+                if (submit_offset == total) {
+                    submitting++;
+                    submit_offset = 0;
+                }
+            }
+
+            if (inflight == 0) {
+                if (stopping_.load(std::memory_order_acquire) && ring_.depth() == 0) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+
+            // Submit and wait for at least one completion in one syscall
+            if (!uring_.submit(1)) {
+                fail(errno);
+                // Writes submitted earlier still read their buffers: wait
+                // them out before the drain hands the slots back
+                size_t outstanding = inflight - uring_.unsubmitted();
+                while (outstanding > 0) {
+                    outstanding -= std::min(outstanding, uring_.reap([](uint64_t, int) {}));
+                    if (outstanding > 0 && !uring_.wait(1)) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    }
+                }
+                break;
+            }
+            uring_.reap([&](uint64_t index, int result) {
+                Request& req = requests[index];
+                latency_.record(static_cast<uint64_t>(elapsed_ns(req.start)));
+                // Finish short or rejected writes synchronously
+                const size_t done = result > 0 ? static_cast<size_t>(result) : 0;
+                if (done < req.bytes && !failed_.load()) {
+                    write_at(req.data + done, req.bytes - done, req.offset + done);
+                }
+                pending[req.slot]--;
+                free_requests.push_back(index);
+                if (--inflight == 0) busy_ns_.fetch_add(elapsed_ns(busy_start), std::memory_order_relaxed);
+            });
+
+            // Release fully written buffers in order
+            while (released < submitting && pending[released % slots] == 0) {
+                bytes_written_.fetch_add(ring_.acquire_read()->used, std::memory_order_relaxed);
+                ring_.release_read();
+                released++;
+            }
+        }
+
+        // Only reached early on a submit failure, with nothing left in
+        // flight: drain so close() can finish
+        while (!stopping_.load(std::memory_order_acquire) || ring_.depth() > 0) {
+            if (ring_.acquire_read()) {
+                ring_.release_read();
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    std::string path_;
+    AsyncWriterOptions options_;
+    size_t buffer_bytes_;
+    SpscRing<WriteBlock> ring_;
+    WriteBlock* current_ = nullptr;
+    int fd_ = -1;
+    WriteBackend backend_ = WriteBackend::Buffered;
+    std::string note_;
+    bool preallocated_ = false;
+    IoUringQueue uring_;
+    LatencyHistogram latency_;
+    std::thread writer_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> failed_{false};
+    std::atomic<int> error_{0};
+    std::atomic<uint64_t> bytes_written_{0};
+    std::atomic<uint64_t> dropped_bytes_{0};
+    std::atomic<int64_t> busy_ns_{0};
+};
@@ -0,0 +1,366 @@
+/**
+ * bench_pipeline.cpp - How many Msps the sdr_streamer pipeline sustains
+ *
+ * Runs sdr_streamer's spectrum path (streamer_pipeline.hpp: window, FFT,
+ * power, averaging, peak and JSON or binary serialisation) on synthetic IQ
+ * for every combination of --fft-sizes, --formats and --threads, and
+ * reports per combination:
+ *
+ *   - the Msps each stream processed, i.e. the highest rate it sustains
+ *     (compared against --rate)
+ *   - frames per second
+ *   - ns per sample spent in each stage, plus "other": ring hand-off,
+ *     history copy and waiting for samples
+ *   - operator new calls in the source and DSP threads while measuring,
+ *     total and per frame (the steady state should make none)
+ *
+ *   ./bench_pipeline --fft-sizes 1024,4096,65536 --formats json,binary --threads 1,2,4 --rate 20e6
+ *
+ * --threads N runs N independent streams at once, each a source thread and
+ * a DSP thread joined by the daemon's SpscRing, to see how the pipeline
+ * scales over cores. The source (synthetic_source.hpp, --signal) replays
+ * a precomputed table, so it costs a memcpy per block; the producer waits
+ * for free ring slots instead of dropping, as in a fast replay.
+ *
+ * Frames go to --output, /dev/null by default (FILE.<stream> with several
+ * streams), flushed per frame like the daemon's stdout.
+ *
+ * Output: JSON summary on stdout, progress on stderr; exits 1 if any
+ * combination falls below --rate
+ */
+
+#include <boost/program_options.hpp>
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dsp_kernels.hpp"
+#include "fftw_wisdom.hpp"
+#include "spectrum_frame.hpp"
+#include "spsc_ring.hpp"
+#include "streamer_pipeline.hpp"
+#include "synthetic_source.hpp"
+
+namespace po = boost::program_options;
+
+// operator new calls made by the calling thread; FFTW allocates with
+// malloc and is not counted (it only does so while planning)
+static thread_local uint64_t thread_allocations = 0;
+
+// Out of line, or GCC flags the malloc/free pairs (-Wmismatched-new-delete)
+__attribute__((noinline)) void* operator new(size_t size) {
+    thread_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+// As in sdr_streamer
+struct SampleBlock {
+    std::vector<std::complex<float>> samples;
+    size_t num_samps = 0;
+    double timestamp = 0.0;
+    uint64_t seq = 0;
+};
+
+using SampleRing = SpscRing<SampleBlock>;
+
+struct BenchStream {
+    BenchStream(const StreamerPipelineConfig& config, const SyntheticSource& signal, size_t block_size,
+                size_t ring_blocks)
+        : source(signal), pipeline(config), ring(ring_blocks, make_prototype(block_size)) {}
+
+    static SampleBlock make_prototype(size_t block_size) {
+        SampleBlock prototype;
+        prototype.samples.resize(block_size);
+        return prototype;
+    }
+
+    SyntheticSource source;
+    StreamerPipeline pipeline;
+    SampleRing ring;
+    std::ofstream out;
+    std::unique_ptr<BinaryFrameWriter> writer;
+    StageTimes times;
+    StageTimes* timing = nullptr;   // &times with --stage-times
+    std::atomic<bool> source_done{false};
+    uint64_t source_allocations = 0;
+    uint64_t dsp_allocations = 0;
+    uint64_t samples = 0;
+    uint64_t frames = 0;
+    double dsp_seconds = 0.0;
+};
+
+static bool parse_size_list(const std::string& text, std::vector<size_t>& out) {
+    std::istringstream iss(text);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        if (item.empty()) continue;
+        char* rest = nullptr;
+        const unsigned long value = std::strtoul(item.c_str(), &rest, 10);
+        if (*rest != '\0' || value == 0) return false;
+        out.push_back(value);
+    }
+    return !out.empty();
+}
+
+static bool parse_format_list(const std::string& text, std::vector<OutputFormat>& out) {
+    std::istringstream iss(text);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        if (item.empty()) continue;
+        OutputFormat format;
+        if (!parse_output_format(item, format)) return false;
+        out.push_back(format);
+    }
+    return !out.empty();
+}
+
+// Receive side: fill ring blocks from the source until told to stop
+static void source_loop(BenchStream& stream, size_t block_size, double rate, const std::atomic<bool>& stop) {
+    const uint64_t allocations = thread_allocations;
+    uint64_t seq = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        SampleBlock* block = stream.ring.acquire_write();
+        if (!block) {
+            std::this_thread::yield();
+            continue;
+        }
+        block->timestamp = stream.source.position() / rate;
+        stream.source.read(block->samples.data(), block_size);
+        block->num_samps = block_size;
+        block->seq = seq++;
+        stream.ring.commit_write();
+    }
+    stream.source_allocations = thread_allocations - allocations;
+    stream.source_done.store(true, std::memory_order_release);
+}
+
+// DSP side: the daemon's loop minus control and status records
+static void dsp_loop(BenchStream& stream, OutputFormat format, double rate) {
+    auto emit_frame = [&](const StreamerFrame& frame) {
+        const auto serialize_start = stage_clock(stream.timing);
+        if (format == OutputFormat::Binary) {
+            encode_streamer_binary(*stream.writer, frame, 915e6, rate, 0);
+        } else {
+            write_streamer_json(stream.out, frame, 915e6, rate, 0);
+        }
+        const auto write_start = stage_clock(stream.timing);
+        if (format == OutputFormat::Binary) {
+            stream.writer->write_frame();
+        } else {
+            stream.out.flush();
+        }
+        if (stream.timing) {
+            stream.timing->record(STAGE_SERIALIZE, serialize_start, write_start);
+            stream.timing->record(STAGE_WRITE, write_start, StageTimes::Clock::now());
+        }
+        stream.frames++;
+    };
+
+    const uint64_t allocations = thread_allocations;
+    const auto start = std::chrono::steady_clock::now();
+    while (true) {
+        SampleBlock* block = stream.ring.acquire_read();
+        if (!block) {
+            if (stream.source_done.load(std::memory_order_acquire) && stream.ring.depth() == 0) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+        stream.pipeline.append(block->samples.data(), block->num_samps, block->timestamp);
+        stream.samples += block->num_samps;
+        stream.ring.release_read();
+
+        stream.pipeline.run(emit_frame);
+    }
+    stream.dsp_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stream.dsp_allocations = thread_allocations - allocations;
+}
+
+int main(int argc, char* argv[]) {
+    std::string fft_sizes_arg, formats_arg, threads_arg, signal_spec, output, payload_name;
+    std::string plan_effort_arg, wisdom_file;
+    double rate, seconds, overlap_pct, frame_rate;
+    size_t avg_count, ring_blocks;
+    bool stage_times;
+
+    po::options_description desc("Streamer Pipeline Benchmark Options");
+    desc.add_options()
+        ("help", "Show help message")
+        ("fft-sizes", po::value<std::string>(&fft_sizes_arg)->default_value("256,1024,4096,16384,65536"), "Comma-separated FFT sizes")
+        ("formats", po::value<std::string>(&formats_arg)->default_value("json,binary"), "Comma-separated output formats (json/binary)")
+        ("threads", po::value<std::string>(&threads_arg)->default_value("1,2,4"), "Comma-separated numbers of concurrent streams")
+        ("rate", po::value<double>(&rate)->default_value(10e6), "Sample rate of the synthetic signal; the Msps to sustain")
+        ("signal", po::value<std::string>(&signal_spec)->default_value("tone:1e5:-20+burst:-2e6:-30:5:50+fm:3e6:-25:75e3:1e3+noise:-60"),
+         "Synthetic signal (tone:OFFSET:DBFS, noise:DBFS, burst:OFFSET:DBFS:ON_MS:PERIOD_MS, fm:OFFSET:DBFS:DEV:MOD, joined by +)")
+        ("seconds", po::value<double>(&seconds)->default_value(2.0), "Measured run time per combination")
+        ("overlap", po::value<double>(&overlap_pct)->default_value(0.0), "FFT overlap in percent (0-95)")
+        ("avg", po::value<size_t>(&avg_count)->default_value(1), "Minimum FFTs averaged per output frame")
+        ("frame-rate", po::value<double>(&frame_rate)->default_value(0.0), "Max output frames per second of samples (0 = unlimited)")
+        ("payload", po::value<std::string>(&payload_name)->default_value("float32"), "Binary bin payload (float32/int16)")
+        ("ring-blocks", po::value<size_t>(&ring_blocks)->default_value(512), "Ring capacity in FFT-sized blocks")
+        ("plan-effort", po::value<std::string>(&plan_effort_arg)->default_value("measure"), "FFTW planner effort (estimate/measure/patient/exhaustive)")
+        ("wisdom-file", po::value<std::string>(&wisdom_file), "FFTW wisdom cache (default: per-CPU file under ~/.cache/sdr)")
+        ("stage-times", po::value<bool>(&stage_times)->default_value(true), "Time each stage (one clock read per stage edge)")
+        ("output", po::value<std::string>(&output)->default_value("/dev/null"), "Where frames are written")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    std::vector<size_t> fft_sizes, thread_counts;
+    std::vector<OutputFormat> formats;
+    BinPayload payload;
+    PlanEffort plan_effort;
+    if (!parse_size_list(fft_sizes_arg, fft_sizes) || !parse_format_list(formats_arg, formats)
+        || !parse_size_list(threads_arg, thread_counts) || !parse_bin_payload(payload_name, payload)
+        || !parse_plan_effort(plan_effort_arg, plan_effort)) {
+        std::cerr << "Error: bad --fft-sizes, --formats, --threads, --payload or --plan-effort (see --help)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<SyntheticComponent> components;
+    const std::string signal_error = parse_synthetic_spec(signal_spec, components);
+    if (!signal_error.empty()) {
+        std::cerr << "Error: --signal: " << signal_error << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (rate <= 0.0 || seconds <= 0.0 || overlap_pct < 0.0 || overlap_pct > 95.0) {
+        std::cerr << "Error: --rate and --seconds must be positive, --overlap 0-95" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cerr << "[Pipeline Bench] DSP kernels: " << dsp::kernels().name << ", generating signal..." << std::endl;
+    const SyntheticSource signal(components, rate);
+
+    WisdomStore wisdom(wisdom_file.empty() ? default_wisdom_path() : wisdom_file);
+    wisdom.load();
+
+    std::ostringstream results;
+    bool first = true;
+    bool all_sustained = true;
+
+    for (size_t fft_size : fft_sizes) {
+        for (OutputFormat format : formats) {
+            for (size_t threads : thread_counts) {
+                StreamerPipelineConfig config;
+                config.rate = rate;
+                config.overlap_pct = overlap_pct;
+                config.avg_count = std::max<size_t>(1, avg_count);
+                config.frame_rate = frame_rate;
+                config.max_block = fft_size;
+                config.plan_flags = plan_effort_flags(plan_effort);
+
+                // Set up every stream here: the FFTW planner is single-threaded
+                std::vector<std::unique_ptr<BenchStream>> streams;
+                for (size_t i = 0; i < threads; i++) {
+                    streams.emplace_back(new BenchStream(config, signal, fft_size, ring_blocks));
+                    BenchStream& stream = *streams.back();
+                    stream.pipeline.configure(fft_size);
+                    if (stage_times) stream.timing = &stream.times;
+                    stream.pipeline.set_stage_times(stream.timing);
+                    stream.out.open(threads > 1 && output != "/dev/null" ? output + "." + std::to_string(i) : output,
+                                    std::ios::binary);
+                    if (!stream.out) {
+                        std::cerr << "Error: could not open " << output << std::endl;
+                        return EXIT_FAILURE;
+                    }
+                    stream.writer.reset(new BinaryFrameWriter(stream.out, payload, 0.01f));
+                }
+                wisdom.save();
+
+                std::atomic<bool> stop{false};
+                std::vector<std::thread> workers;
+                for (auto& stream : streams) {
+                    workers.emplace_back(source_loop, std::ref(*stream), fft_size, rate, std::cref(stop));
+                    workers.emplace_back(dsp_loop, std::ref(*stream), format, rate);
+                }
+                std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+                stop.store(true);
+                for (auto& worker : workers) worker.join();
+
+                // Totals over all streams; the slowest stream sets the sustained rate
+                uint64_t samples = 0, frames = 0, allocations = 0;
+                double dsp_seconds = 0.0, min_msps = 0.0;
+                uint64_t stage_ns[STAGE_WORK_END] = {};
+                for (size_t i = 0; i < streams.size(); i++) {
+                    const BenchStream& stream = *streams[i];
+                    samples += stream.samples;
+                    frames += stream.frames;
+                    allocations += stream.source_allocations + stream.dsp_allocations;
+                    dsp_seconds += stream.dsp_seconds;
+                    for (size_t s = 0; s < STAGE_WORK_END; s++) stage_ns[s] += stream.times.total_ns(s);
+                    const double msps = stream.samples / stream.dsp_seconds / 1e6;
+                    min_msps = i == 0 ? msps : std::min(min_msps, msps);
+                }
+                const double wall = dsp_seconds / threads;
+                const double frames_per_sec = frames / wall;
+                const bool sustained = min_msps * 1e6 >= rate;
+                all_sustained = all_sustained && sustained;
+
+                std::ostringstream stages;
+                uint64_t staged_ns = 0;
+                for (size_t s = 0; s < STAGE_WORK_END; s++) {
+                    stages << "\"" << pipeline_stage_name(s) << "\":" << static_cast<double>(stage_ns[s]) / samples << ",";
+                    staged_ns += stage_ns[s];
+                }
+                const double other = stage_times ? (dsp_seconds * 1e9 - staged_ns) / samples : 0.0;
+                stages << "\"other\":" << other;
+
+                const char* format_name = format == OutputFormat::Binary ? "binary" : "json";
+                std::cerr << "[Pipeline Bench] FFT " << fft_size << ", " << format_name << ", " << threads
+                          << (threads == 1 ? " stream: " : " streams: ") << static_cast<long>(min_msps)
+                          << " Msps per stream, " << static_cast<long>(frames_per_sec) << " frames/s, "
+                          << allocations << " allocations" << (sustained ? "" : ", BELOW --rate") << std::endl;
+
+                if (!first) results << ",";
+                first = false;
+                results << "{\"fftSize\":" << fft_size
+                        << ",\"format\":\"" << format_name << "\""
+                        << ",\"threads\":" << threads
+                        << ",\"seconds\":" << wall
+                        << ",\"samples\":" << samples
+                        << ",\"msps\":" << samples / wall / 1e6
+                        << ",\"mspsPerStream\":" << min_msps
+                        << ",\"sustained\":" << (sustained ? "true" : "false")
+                        << ",\"frames\":" << frames
+                        << ",\"framesPerSec\":" << frames_per_sec
+                        << ",\"nsPerSample\":{" << stages.str() << "}"
+                        << ",\"allocations\":" << allocations
+                        << ",\"allocationsPerFrame\":" << (frames ? static_cast<double>(allocations) / frames : 0.0)
+                        << "}";
+            }
+        }
+    }
+
+    std::cout << "{\"rateMsps\":" << rate / 1e6
+              << ",\"signal\":\"" << signal_spec << "\""
+              << ",\"overlap\":" << overlap_pct
+              << ",\"avg\":" << avg_count
+              << ",\"frameRate\":" << frame_rate
+              << ",\"payload\":\"" << payload_name << "\""
+              << ",\"planEffort\":\"" << plan_effort_name(plan_effort) << "\""
+              << ",\"kernels\":\"" << dsp::kernels().name << "\""
+              << ",\"cores\":" << std::thread::hardware_concurrency()
+              << ",\"results\":[" << results.str() << "]}" << std::endl;
+
+    return all_sustained ? EXIT_SUCCESS : EXIT_FAILURE;
+}
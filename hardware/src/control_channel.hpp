@@ -0,0 +1,135 @@
+/**
+ * control_channel.hpp - Line-delimited command channel on stdin
+ *
+ * Lets a running daemon be reconfigured without a restart. The parent
+ * process writes one command per line:
+ *
+ *   freq 915e6
+ *   gain 40
+ *   bw 20e6
+ *   antenna RX2
+ *   fft-size 4096
+ *
+ * A background thread reads stdin and queues parsed commands; the
+ * streaming loop drains the queue between reads with poll(), which
+ * only takes the mutex when the atomic pending count is non-zero.
+ * EOF on stdin (parent went away) simply stops the reader. Lines may end
+ * in CRLF; trailing whitespace is not part of the value.
+ *
+ * Daemons acknowledge every command with a {"type":"config"} record that
+ * carries the new config generation; json_escape() is for echoing
+ * command text and error messages into those records.
+ */
+
+#pragma once
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+struct ControlCommand {
+    std::string key;
+    std::string value;
+};
+
+// Body of a JSON string (no quotes): control characters as \u00XX
+inline std::string json_escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+class ControlChannel {
+public:
+    ControlChannel() = default;
+    ~ControlChannel() { stop(); }
+
+    ControlChannel(const ControlChannel&) = delete;
+    ControlChannel& operator=(const ControlChannel&) = delete;
+
+    void start(int fd = STDIN_FILENO) {
+        fd_ = fd;
+        running_ = true;
+        thread_ = std::thread(&ControlChannel::reader_loop, this);
+    }
+
+    void stop() {
+        running_ = false;
+        if (thread_.joinable()) thread_.join();
+    }
+
+    // Non-blocking: pops the oldest queued command, returns false if none
+    bool poll(ControlCommand& cmd) {
+        if (pending_.load(std::memory_order_acquire) == 0) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty()) return false;
+        cmd = std::move(queue_.front());
+        queue_.pop_front();
+        pending_.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    void reader_loop() {
+        std::string partial;
+        char buf[1024];
+
+        while (running_) {
+            // Wake up periodically so stop() never waits on a quiet stdin
+            struct pollfd pfd = {fd_, POLLIN, 0};
+            int ready = ::poll(&pfd, 1, 100);
+            if (ready <= 0) continue;
+
+            ssize_t n = ::read(fd_, buf, sizeof(buf));
+            if (n <= 0) break;  // EOF or error: no more commands
+
+            partial.append(buf, static_cast<size_t>(n));
+            size_t newline;
+            while ((newline = partial.find('\n')) != std::string::npos) {
+                push_line(partial.substr(0, newline));
+                partial.erase(0, newline + 1);
+            }
+        }
+    }
+
+    void push_line(std::string line) {
+        // CRLF clients: drop the '\r' and any trailing whitespace
+        const size_t end = line.find_last_not_of(" \t\r");
+        line.erase(end == std::string::npos ? 0 : end + 1);
+        std::istringstream iss(line);
+        ControlCommand cmd;
+        if (!(iss >> cmd.key)) return;  // Blank line
+        std::getline(iss >> std::ws, cmd.value);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(cmd));
+        pending_.fetch_add(1, std::memory_order_release);
+    }
+
+    int fd_ = STDIN_FILENO;
+    std::atomic<bool> running_{false};
+    std::atomic<size_t> pending_{0};
+    std::mutex mutex_;
+    std::deque<ControlCommand> queue_;
+    std::thread thread_;
+};
@@ -0,0 +1,314 @@
+/**
+ * ddc.hpp - Digital down-converter for the recorders' --ddc-offset/--ddc-bw
+ *
+ * Moves the channel --ddc-offset Hz away from the tuned frequency to 0 Hz
+ * and decimates it to just over --ddc-bw, so recording one narrowband
+ * signal out of a wide capture costs its own bandwidth in disk and not
+ * the device's:
+ *
+ *   NCO mix -> CIC /R -> half-band /2 (x H) -> FIR /F (CIC droop compensated)
+ *
+ * The total decimation D = R * 2^H * F is the largest such product that
+ * keeps the output rate at or above 1.25x the bandwidth. Each stage's
+ * stopband starts where its own alias would land inside +-bw/2, so the
+ * whole passband is alias-free to ~80 dB; only the margin between bw/2
+ * and the output Nyquist carries filter skirts.
+ *
+ * The CIC is computed in its non-recursive form, the cascade of N boxcars
+ * multiplied out into one FIR. Per input sample that is the same N
+ * multiply-adds as the integrator/comb form, but in float with no integer
+ * wraparound and on the same vectorized dsp::Kernels::fir_decimate as the
+ * later stages. The NCO is a phasor table for one block turned to each
+ * block's starting phase (Kernels::mix), so its phase never drifts.
+ *
+ * Input is the recorders' --format (ci16/ci8 scaled like UHD's fc32
+ * conversion); output is always cf32. Output sample m is centred on input
+ * sample m * D + delay(), which dates it exactly from the input timeline.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "dsp_kernels.hpp"
+#include "sample_format.hpp"
+
+namespace ddc_detail {
+
+constexpr double STOPBAND_DB = 80.0;
+constexpr int CIC_ORDER = 4;
+constexpr unsigned MAX_CIC = 256;   // Beyond this, more half-bands
+constexpr size_t MAX_TAPS = 1023;   // Final FIR
+
+// Modified Bessel function of the first kind, order 0 (power series)
+inline double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64 && term > sum * 1e-17; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+inline double kaiser_beta(double atten_db) {
+    return atten_db > 50.0 ? 0.1102 * (atten_db - 8.7) : 0.5842 * std::pow(atten_db - 21.0, 0.4) + 0.07886 * (atten_db - 21.0);
+}
+
+inline double kaiser(size_t n, size_t length, double beta) {
+    if (length == 1) return 1.0;
+    const double r = 2.0 * n / (length - 1) - 1.0;
+    return bessel_i0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / bessel_i0(beta);
+}
+
+// Kaiser's estimate of the odd length reaching `atten_db` over a transition
+// `width` cycles/sample wide
+inline size_t kaiser_length(double atten_db, double width) {
+    const size_t length = static_cast<size_t>(std::ceil((atten_db - 7.95) / (14.36 * width))) + 1;
+    return length | 1;
+}
+
+// CIC magnitude at `f` cycles/sample of its input rate
+inline double cic_response(double f, unsigned decim) {
+    if (decim <= 1 || f == 0.0) return 1.0;
+    const double h = std::sin(M_PI * f * decim) / (decim * std::sin(M_PI * f));
+    return std::pow(std::fabs(h), CIC_ORDER);
+}
+
+}  // namespace ddc_detail
+
+class Ddc {
+public:
+    Ddc(double input_rate, double offset_hz, double bandwidth_hz, const dsp::Kernels& kernels = dsp::kernels())
+        : kernels_(kernels), input_rate_(input_rate), offset_(offset_hz), bandwidth_(bandwidth_hz) {
+        if (!(bandwidth_hz > 0) || bandwidth_hz * 1.25 > input_rate) {
+            error_ = "--ddc-bw must be above 0 and at most rate / 1.25";
+            return;
+        }
+        if (std::fabs(offset_hz) + bandwidth_hz / 2 > input_rate / 2) {
+            error_ = "--ddc-offset +- bw/2 falls outside the captured band";
+            return;
+        }
+        plan();
+
+        osc_.resize(2 * BLOCK);
+        const double step = -offset_hz / input_rate;
+        for (size_t i = 0; i < BLOCK; i++) {
+            const double phase = 2.0 * M_PI * std::fmod(step * i, 1.0);
+            osc_[2 * i] = static_cast<float>(std::cos(phase));
+            osc_[2 * i + 1] = static_cast<float>(std::sin(phase));
+        }
+        block_.resize(2 * BLOCK);
+    }
+
+    bool valid() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+
+    double input_rate() const { return input_rate_; }
+    double output_rate() const { return input_rate_ / decimation_; }
+    double offset() const { return offset_; }
+    double bandwidth() const { return bandwidth_; }
+    unsigned decimation() const { return decimation_; }
+    // Input samples from the first input to the centre of the first output
+    double delay() const { return delay_; }
+    int64_t delay_ns() const { return static_cast<int64_t>(std::llround(delay_ * 1e9 / input_rate_)); }
+    // Next output sample's index, counting the gaps skip() stood in for
+    uint64_t output_position() const { return output_position_; }
+
+    // "CIC4 /28 (109 taps), HB /2 (11 taps), HB /2 (19 taps), FIR /2 (51 taps) on avx2"
+    std::string describe() const {
+        std::string text;
+        for (const Stage& stage : stages_) {
+            char part[64];
+            std::snprintf(part, sizeof(part), "%s%s /%zu (%zu taps)", text.empty() ? "" : ", ",
+                          stage.name, stage.decim, stage.length);
+            text += part;
+        }
+        return text + " on " + kernels_.name;
+    }
+
+    // Down-converts n samples of `format` and replaces `out` with the
+    // narrowband cf32 result; returns the number of output samples
+    size_t process(const void* in, size_t n, SampleFormat format, std::vector<float>& out) {
+        out.clear();
+        for (size_t done = 0; done < n; done += BLOCK) {
+            const size_t count = std::min(BLOCK, n - done);
+            samples_to_cf32(in, done, count, format, block_.data());
+            const double rot = 2.0 * M_PI * phase_;
+            kernels_.mix(block_.data(), osc_.data(), block_.data(), count,
+                         static_cast<float>(std::cos(rot)), static_cast<float>(std::sin(rot)));
+            phase_ = std::fmod(phase_ - offset_ / input_rate_ * count, 1.0);
+
+            const float* data = block_.data();
+            size_t samples = count;
+            for (Stage& stage : stages_) {
+                samples = stage.run(kernels_, data, samples);
+                data = stage.out.data();
+            }
+            out.insert(out.end(), data, data + 2 * samples);
+        }
+        input_position_ += n;
+        const size_t produced = out.size() / 2;
+        output_position_ += produced;
+        return produced;
+    }
+
+    // `samples` input samples were lost: the filters restart after the gap
+    // with the NCO phase it would have reached. Returns the output samples
+    // the gap stands for, so output indexes keep matching input time to
+    // within half an output sample.
+    uint64_t skip(uint64_t samples) {
+        input_position_ += samples;
+        for (Stage& stage : stages_) stage.history.clear();
+        phase_ = std::fmod(-offset_ / input_rate_ * static_cast<double>(input_position_), 1.0);
+        const uint64_t resume = (input_position_ + decimation_ / 2) / decimation_;
+        const uint64_t skipped = resume > output_position_ ? resume - output_position_ : 0;
+        output_position_ += skipped;
+        return skipped;
+    }
+
+private:
+    static constexpr size_t BLOCK = 4096;
+
+    struct Stage {
+        const char* name = "";
+        size_t decim = 1;
+        size_t length = 0;            // Real taps; ntaps pads with zeros
+        size_t ntaps = 0;
+        std::vector<float> taps2;
+        std::vector<float> history;   // Input not yet consumed, interleaved
+        std::vector<float> out;
+
+        void set_taps(const std::vector<double>& taps) {
+            length = taps.size();
+            ntaps = (length + dsp::FIR_TAP_BLOCK - 1) / dsp::FIR_TAP_BLOCK * dsp::FIR_TAP_BLOCK;
+            taps2.assign(2 * ntaps, 0.0f);
+            for (size_t j = 0; j < length; j++) {
+                taps2[2 * j] = taps2[2 * j + 1] = static_cast<float>(taps[j]);
+            }
+        }
+
+        size_t run(const dsp::Kernels& kernels, const float* in, size_t n) {
+            history.insert(history.end(), in, in + 2 * n);
+            const size_t have = history.size() / 2;
+            const size_t count = have >= ntaps ? (have - ntaps) / decim + 1 : 0;
+            out.resize(2 * count);
+            if (count) kernels.fir_decimate(history.data(), taps2.data(), ntaps, decim, out.data(), count);
+            history.erase(history.begin(), history.begin() + 2 * std::min(have, count * decim));
+            return count;
+        }
+    };
+
+    // Splits the decimation into CIC x half-bands x final FIR and designs
+    // each stage's taps
+    void plan() {
+        using namespace ddc_detail;
+        const unsigned wanted = static_cast<unsigned>(std::max(1.0, std::min(1e9, input_rate_ / (1.25 * bandwidth_))));
+        unsigned final_decim = wanted >= 2 ? 2 : 1;
+        unsigned halfbands = 0;
+        while (halfbands < 2 && (final_decim << (halfbands + 1)) <= wanted) halfbands++;
+        unsigned cic = std::max(1u, wanted / (final_decim << halfbands));
+        while (cic > MAX_CIC) cic = wanted / (final_decim << ++halfbands);
+        decimation_ = cic * (final_decim << halfbands);
+
+        const double out_rate = input_rate_ / decimation_;
+        const double edge = bandwidth_ / 2;
+        double rate = input_rate_;
+
+        if (cic > 1) {
+            // N boxcars of length R convolved: the CIC impulse response
+            std::vector<double> taps(1, 1.0);
+            for (int n = 0; n < CIC_ORDER; n++) {
+                std::vector<double> next(taps.size() + cic - 1, 0.0);
+                for (size_t i = 0; i < taps.size(); i++) {
+                    for (unsigned j = 0; j < cic; j++) next[i + j] += taps[i] / cic;
+                }
+                taps.swap(next);
+            }
+            add_stage("CIC4", cic, taps);
+            rate /= cic;
+        }
+
+        for (unsigned h = 0; h < halfbands; h++) {
+            // Passband +-edge, stopband from the alias of the edge; a
+            // length of 4k+3 with the cutoff at a quarter makes every other
+            // tap zero
+            const double width = 0.5 - 2.0 * edge / rate;
+            size_t length = kaiser_length(STOPBAND_DB, width);
+            length = length / 4 * 4 + 3;
+            const double beta = kaiser_beta(STOPBAND_DB);
+            std::vector<double> taps(length);
+            double sum = 0.0;
+            const double centre = (length - 1) / 2.0;
+            for (size_t n = 0; n < length; n++) {
+                const double t = n - centre;
+                taps[n] = (t == 0 ? 0.5 : std::sin(M_PI * t / 2) / (M_PI * t)) * kaiser(n, length, beta);
+                sum += taps[n];
+            }
+            for (double& tap : taps) tap /= sum;
+            add_stage("HB", 2, taps);
+            rate /= 2;
+        }
+
+        // Final FIR: flat to +-edge after undoing the CIC droop, stopband
+        // from where the decimation folds onto the edge
+        const double stop = std::min(out_rate - edge, rate / 2);
+        const double cutoff = (edge + stop) / 2 / rate;
+        const size_t length = std::min(MAX_TAPS, kaiser_length(STOPBAND_DB, (stop - edge) / rate));
+        const double beta = kaiser_beta(STOPBAND_DB);
+        const double centre = (length - 1) / 2.0;
+        const int points = 2048;
+        std::vector<double> taps(length, 0.0);
+        double sum = 0.0;
+        for (size_t n = 0; n < length; n++) {
+            // Windowed inverse transform of 1/CIC(f) on [0, cutoff]
+            double acc = 0.0;
+            for (int k = 0; k <= points; k++) {
+                const double f = cutoff * k / points;
+                const double weight = (k == 0 || k == points) ? 0.5 : 1.0;
+                const double gain = 1.0 / cic_response(f * rate / input_rate_, cic);
+                acc += weight * gain * std::cos(2.0 * M_PI * f * (n - centre));
+            }
+            taps[n] = 2.0 * acc * cutoff / points * kaiser(n, length, beta);
+            sum += taps[n];
+        }
+        for (double& tap : taps) tap /= sum;
+        add_stage("FIR", final_decim, taps);
+
+        // Centre of output 0 in input samples: each stage adds its own
+        // centre, scaled by the decimation before it
+        delay_ = 0.0;
+        double scale = 1.0;
+        for (const Stage& stage : stages_) {
+            delay_ += scale * (stage.length - 1) / 2.0;
+            scale *= stage.decim;
+        }
+    }
+
+    void add_stage(const char* name, size_t decim, const std::vector<double>& taps) {
+        Stage stage;
+        stage.name = name;
+        stage.decim = decim;
+        stage.set_taps(taps);
+        stages_.push_back(std::move(stage));
+    }
+
+    const dsp::Kernels& kernels_;
+    double input_rate_;
+    double offset_;
+    double bandwidth_;
+    std::string error_;
+    unsigned decimation_ = 1;
+    double delay_ = 0.0;
+    std::vector<Stage> stages_;
+    std::vector<float> osc_;
+    std::vector<float> block_;
+    double phase_ = 0.0;           // NCO phase at the next block, cycles
+    uint64_t input_position_ = 0;
+    uint64_t output_position_ = 0;
+};
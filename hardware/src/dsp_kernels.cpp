@@ -0,0 +1,160 @@
+/**
+ * dsp_kernels.cpp - Scalar reference kernels and runtime ISA selection
+ */
+
+#include "dsp_kernels.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__) && defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_SVE
+#define HWCAP_SVE (1 << 22)
+#endif
+#endif
+
+namespace dsp {
+
+namespace {
+
+void scalar_apply_window(const float* in_iq, const float* window, float* out_iq, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out_iq[2 * i] = in_iq[2 * i] * window[i];
+        out_iq[2 * i + 1] = in_iq[2 * i + 1] * window[i];
+    }
+}
+
+void scalar_power(const float* in_iq, float* power, size_t n, float scale) {
+    for (size_t i = 0; i < n; i++) {
+        const float re = in_iq[2 * i];
+        const float im = in_iq[2 * i + 1];
+        power[i] = (re * re + im * im) * scale;
+    }
+}
+
+void scalar_power_to_db(const float* power, float* db, size_t n, float offset_db) {
+    for (size_t i = 0; i < n; i++) {
+        db[i] = 10.0f * std::log10(power[i] + detail::POWER_FLOOR) + offset_db;
+    }
+}
+
+void scalar_magnitude(const float* power, float* mag, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        mag[i] = std::sqrt(power[i]);
+    }
+}
+
+size_t scalar_argmax(const float* x, size_t n) {
+    size_t best = 0;
+    for (size_t i = 1; i < n; i++) {
+        if (x[i] > x[best]) best = i;
+    }
+    return best;
+}
+
+void scalar_mix(const float* in_iq, const float* osc_iq, float* out_iq, size_t n,
+                float rot_re, float rot_im) {
+    for (size_t i = 0; i < n; i++) {
+        const float osc_re = osc_iq[2 * i] * rot_re - osc_iq[2 * i + 1] * rot_im;
+        const float osc_im = osc_iq[2 * i] * rot_im + osc_iq[2 * i + 1] * rot_re;
+        const float re = in_iq[2 * i];
+        const float im = in_iq[2 * i + 1];
+        out_iq[2 * i] = re * osc_re - im * osc_im;
+        out_iq[2 * i + 1] = re * osc_im + im * osc_re;
+    }
+}
+
+void scalar_fir_decimate(const float* in_iq, const float* taps2, size_t ntaps, size_t decim,
+                         float* out_iq, size_t n_out) {
+    for (size_t k = 0; k < n_out; k++) {
+        const float* x = in_iq + 2 * k * decim;
+        float re = 0.0f;
+        float im = 0.0f;
+        for (size_t j = 0; j < ntaps; j++) {
+            re += taps2[2 * j] * x[2 * j];
+            im += taps2[2 * j + 1] * x[2 * j + 1];
+        }
+        out_iq[2 * k] = re;
+        out_iq[2 * k + 1] = im;
+    }
+}
+
+bool cpu_supports(Isa isa) {
+    switch (isa) {
+    case Isa::Scalar:
+        return true;
+#if defined(SDR_DSP_HAVE_AVX2)
+    case Isa::Avx2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#if defined(SDR_DSP_HAVE_AVX512)
+    case Isa::Avx512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+#if defined(SDR_DSP_HAVE_NEON)
+    case Isa::Neon:
+        return true;  // Mandatory on aarch64
+#endif
+#if defined(SDR_DSP_HAVE_SVE)
+    case Isa::Sve:
+        return (getauxval(AT_HWCAP) & HWCAP_SVE) != 0;
+#endif
+    default:
+        return false;
+    }
+}
+
+const Kernels* select_kernels() {
+    // Widest first
+    static const Isa preference[] = {Isa::Avx512, Isa::Sve, Isa::Avx2, Isa::Neon, Isa::Scalar};
+
+    const char* forced = std::getenv("SDR_DSP_ISA");
+    if (forced && *forced) {
+        for (Isa isa : preference) {
+            const Kernels* k = kernels_for(isa);
+            if (k && std::strcmp(k->name, forced) == 0) return k;
+        }
+    }
+
+    for (Isa isa : preference) {
+        if (const Kernels* k = kernels_for(isa)) return k;
+    }
+    return &scalar_kernels;
+}
+
+}  // namespace
+
+const Kernels scalar_kernels = {
+    Isa::Scalar, "scalar",
+    scalar_apply_window, scalar_power, scalar_power_to_db, scalar_magnitude, scalar_argmax,
+    scalar_mix, scalar_fir_decimate,
+};
+
+const Kernels* kernels_for(Isa isa) {
+    if (!cpu_supports(isa)) return nullptr;
+    switch (isa) {
+    case Isa::Scalar: return &scalar_kernels;
+#if defined(SDR_DSP_HAVE_AVX2)
+    case Isa::Avx2: return &avx2_kernels;
+#endif
+#if defined(SDR_DSP_HAVE_AVX512)
+    case Isa::Avx512: return &avx512_kernels;
+#endif
+#if defined(SDR_DSP_HAVE_NEON)
+    case Isa::Neon: return &neon_kernels;
+#endif
+#if defined(SDR_DSP_HAVE_SVE)
+    case Isa::Sve: return &sve_kernels;
+#endif
+    default: return nullptr;
+    }
+}
+
+const Kernels& kernels() {
+    static const Kernels* selected = select_kernels();
+    return *selected;
+}
+
+}  // namespace dsp
@@ -0,0 +1,117 @@
+/**
+ * dsp_kernels.hpp - Vectorized per-bin kernels shared by the spectrum daemons
+ *
+ * The hot per-frame loops (window, FFT shift + |X|^2, dB conversion, peak
+ * search) and the recorders' down-converter loops (NCO mix, decimating
+ * FIR; see ddc.hpp) are implemented once per instruction set and selected
+ * at runtime:
+ *
+ *   x86_64   scalar, AVX2+FMA, AVX-512F
+ *   aarch64  NEON (baseline), SVE
+ *
+ * dsp::kernels() probes the CPU on first use and returns the widest table
+ * the machine supports; SDR_DSP_ISA=<name> (scalar/avx2/avx512/neon/sve)
+ * forces a specific one for comparisons. The scalar table is the reference:
+ * vector dB conversion uses a polynomial log that agrees with std::log10 to
+ * well under 0.001 dB.
+ *
+ * Complex buffers are interleaved float pairs, i.e. std::complex<float> or
+ * fftwf_complex reinterpreted as float*. This header deliberately includes
+ * nothing heavier than <cstddef> because the ISA translation units are
+ * compiled with wider -m flags than the rest of the program.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace dsp {
+
+enum class Isa { Scalar, Avx2, Avx512, Neon, Sve };
+
+struct Kernels {
+    Isa isa;
+    const char* name;
+
+    // out_iq[i] = in_iq[i] * window[i] for n complex samples (in place is fine)
+    void (*apply_window)(const float* in_iq, const float* window, float* out_iq, size_t n);
+
+    // power[i] = |in_iq[i]|^2 * scale for n complex samples
+    void (*power)(const float* in_iq, float* power, size_t n, float scale);
+
+    // db[i] = 10 * log10(power[i] + 1e-20) + offset_db
+    void (*power_to_db)(const float* power, float* db, size_t n, float offset_db);
+
+    // mag[i] = sqrt(power[i])
+    void (*magnitude)(const float* power, float* mag, size_t n);
+
+    // Index of the first maximum, 0 for an empty range
+    size_t (*argmax)(const float* x, size_t n);
+
+    // out_iq[i] = in_iq[i] * osc_iq[i] * (rot_re + j*rot_im) for n complex
+    // samples (in place is fine): a fixed oscillator table turned to the
+    // block's starting phase
+    void (*mix)(const float* in_iq, const float* osc_iq, float* out_iq, size_t n,
+                float rot_re, float rot_im);
+
+    // Decimating FIR with real taps, out_iq[k] = sum_j h[j] * in_iq[k * decim + j]
+    // for k < n_out. taps2 holds each h[j] twice (once per I/Q) and ntaps
+    // is a multiple of FIR_TAP_BLOCK; in_iq must hold (n_out - 1) * decim
+    // + ntaps samples.
+    void (*fir_decimate)(const float* in_iq, const float* taps2, size_t ntaps, size_t decim,
+                         float* out_iq, size_t n_out);
+};
+
+// fir_decimate tap counts are padded (with zero taps) to a multiple of this:
+// 8 complex taps fill one AVX-512 vector, two AVX2 vectors or four NEON ones
+constexpr size_t FIR_TAP_BLOCK = 8;
+
+// Best table for this CPU (or SDR_DSP_ISA), resolved once
+const Kernels& kernels();
+
+// Table for a specific ISA, nullptr if it was not built or the CPU lacks it
+const Kernels* kernels_for(Isa isa);
+
+// Centered power spectrum straight from FFT output: the FFT shift is done by
+// splitting the pass into two contiguous halves instead of indexing with %.
+inline void shifted_power(const Kernels& k, const float* fft_iq, float* power,
+                          size_t n, float scale) {
+    const size_t half = n / 2;
+    const size_t upper = n - half;
+    k.power(fft_iq + 2 * half, power, upper, scale);
+    k.power(fft_iq, power + upper, half, scale);
+}
+
+namespace detail {
+
+// Cephes logf: frexp to m in [sqrt(1/2), sqrt(2)), then a degree-8
+// polynomial in (m - 1). Shared by every vector path.
+constexpr float LOG_SQRTHF = 0.707106781186547524f;
+constexpr float LOG_P[9] = {
+    7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f,
+    -1.2420140846e-1f, 1.4249322787e-1f, -1.6668057665e-1f,
+    2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f,
+};
+constexpr float LOG_Q1 = -2.12194440e-4f;
+constexpr float LOG_Q2 = 0.693359375f;
+constexpr float DB_PER_LN = 4.342944819032518f;  // 10 / ln(10)
+constexpr float POWER_FLOOR = 1e-20f;             // -200 dB, avoids log(0)
+
+}  // namespace detail
+
+// Per-ISA tables, defined in dsp_kernels_<isa>.cpp when that path is built
+extern const Kernels scalar_kernels;
+#if defined(SDR_DSP_HAVE_AVX2)
+extern const Kernels avx2_kernels;
+#endif
+#if defined(SDR_DSP_HAVE_AVX512)
+extern const Kernels avx512_kernels;
+#endif
+#if defined(SDR_DSP_HAVE_NEON)
+extern const Kernels neon_kernels;
+#endif
+#if defined(SDR_DSP_HAVE_SVE)
+extern const Kernels sve_kernels;
+#endif
+
+}  // namespace dsp
@@ -0,0 +1,223 @@
+/**
+ * dsp_kernels_avx2.cpp - AVX2 + FMA kernels (8 floats per vector)
+ *
+ * Built with -mavx2 -mfma and only reached after the runtime CPU check in
+ * dsp_kernels.cpp. Loop tails go through a zero-padded stack block so the
+ * whole array is processed by the same vector code.
+ */
+
+#include "dsp_kernels.hpp"
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+#include <immintrin.h>
+
+namespace dsp {
+
+namespace {
+
+constexpr size_t W = 8;
+
+void avx2_apply_window(const float* in_iq, const float* window, float* out_iq, size_t n) {
+    const __m256i lo_idx = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256i hi_idx = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        const __m256 w = _mm256_loadu_ps(window + i);
+        const __m256 a = _mm256_loadu_ps(in_iq + 2 * i);
+        const __m256 b = _mm256_loadu_ps(in_iq + 2 * i + W);
+        _mm256_storeu_ps(out_iq + 2 * i, _mm256_mul_ps(a, _mm256_permutevar8x32_ps(w, lo_idx)));
+        _mm256_storeu_ps(out_iq + 2 * i + W, _mm256_mul_ps(b, _mm256_permutevar8x32_ps(w, hi_idx)));
+    }
+    for (; i < n; i++) {
+        out_iq[2 * i] = in_iq[2 * i] * window[i];
+        out_iq[2 * i + 1] = in_iq[2 * i + 1] * window[i];
+    }
+}
+
+inline __m256 power8(const float* iq, __m256 scale) {
+    const __m256 a = _mm256_loadu_ps(iq);
+    const __m256 b = _mm256_loadu_ps(iq + W);
+    // hadd works per 128-bit lane: result is p0 p1 p4 p5 | p2 p3 p6 p7
+    const __m256 sum = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+    const __m256 ordered = _mm256_castpd_ps(
+        _mm256_permute4x64_pd(_mm256_castps_pd(sum), _MM_SHUFFLE(3, 1, 2, 0)));
+    return _mm256_mul_ps(ordered, scale);
+}
+
+void avx2_power(const float* in_iq, float* power, size_t n, float scale) {
+    const __m256 vscale = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        _mm256_storeu_ps(power + i, power8(in_iq + 2 * i, vscale));
+    }
+    if (i < n) {
+        alignas(32) float iq[2 * W] = {};
+        alignas(32) float out[W];
+        for (size_t j = 0; j < 2 * (n - i); j++) iq[j] = in_iq[2 * i + j];
+        _mm256_store_ps(out, power8(iq, vscale));
+        for (size_t j = 0; j < n - i; j++) power[i + j] = out[j];
+    }
+}
+
+// Natural log of x > 0 (cephes logf)
+inline __m256 log8(__m256 x) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    x = _mm256_max_ps(x, _mm256_set1_ps(1.17549435e-38f));  // Smallest normal
+    __m256i bits = _mm256_castps_si256(x);
+    __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0x7f));
+    bits = _mm256_and_si256(bits, _mm256_set1_epi32(~0x7f800000));
+    x = _mm256_or_ps(_mm256_castsi256_ps(bits), half);  // Mantissa in [0.5, 1)
+    __m256 e = _mm256_add_ps(_mm256_cvtepi32_ps(exponent), one);
+
+    // Fold [0.5, sqrt(1/2)) up to [1, sqrt(2))
+    const __m256 mask = _mm256_cmp_ps(x, _mm256_set1_ps(detail::LOG_SQRTHF), _CMP_LT_OQ);
+    const __m256 tmp = _mm256_and_ps(x, mask);
+    x = _mm256_sub_ps(x, one);
+    e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+    x = _mm256_add_ps(x, tmp);
+
+    const __m256 z = _mm256_mul_ps(x, x);
+    __m256 y = _mm256_set1_ps(detail::LOG_P[0]);
+    for (int k = 1; k < 9; k++) {
+        y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(detail::LOG_P[k]));
+    }
+    y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+    y = _mm256_fmadd_ps(e, _mm256_set1_ps(detail::LOG_Q1), y);
+    y = _mm256_fnmadd_ps(z, half, y);
+    x = _mm256_add_ps(x, y);
+    return _mm256_fmadd_ps(e, _mm256_set1_ps(detail::LOG_Q2), x);
+}
+
+inline __m256 db8(__m256 p, __m256 offset) {
+    const __m256 ln = log8(_mm256_add_ps(p, _mm256_set1_ps(detail::POWER_FLOOR)));
+    return _mm256_fmadd_ps(ln, _mm256_set1_ps(detail::DB_PER_LN), offset);
+}
+
+void avx2_power_to_db(const float* power, float* db, size_t n, float offset_db) {
+    const __m256 offset = _mm256_set1_ps(offset_db);
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        _mm256_storeu_ps(db + i, db8(_mm256_loadu_ps(power + i), offset));
+    }
+    if (i < n) {
+        alignas(32) float block[W] = {};
+        for (size_t j = 0; j < n - i; j++) block[j] = power[i + j];
+        _mm256_store_ps(block, db8(_mm256_load_ps(block), offset));
+        for (size_t j = 0; j < n - i; j++) db[i + j] = block[j];
+    }
+}
+
+void avx2_magnitude(const float* power, float* mag, size_t n) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        _mm256_storeu_ps(mag + i, _mm256_sqrt_ps(_mm256_loadu_ps(power + i)));
+    }
+    if (i < n) {
+        alignas(32) float block[W] = {};
+        for (size_t j = 0; j < n - i; j++) block[j] = power[i + j];
+        _mm256_store_ps(block, _mm256_sqrt_ps(_mm256_load_ps(block)));
+        for (size_t j = 0; j < n - i; j++) mag[i + j] = block[j];
+    }
+}
+
+size_t avx2_argmax(const float* x, size_t n) {
+    size_t best = 0;
+    size_t i = 0;
+    if (n >= W) {
+        // Per-lane running max; strict > keeps each lane's first occurrence
+        __m256 vmax = _mm256_loadu_ps(x);
+        __m256i vidx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i cur = vidx;
+        const __m256i step = _mm256_set1_epi32(W);
+        for (i = W; i + W <= n; i += W) {
+            cur = _mm256_add_epi32(cur, step);
+            const __m256 v = _mm256_loadu_ps(x + i);
+            const __m256 gt = _mm256_cmp_ps(v, vmax, _CMP_GT_OQ);
+            vmax = _mm256_blendv_ps(vmax, v, gt);
+            vidx = _mm256_castps_si256(
+                _mm256_blendv_ps(_mm256_castsi256_ps(vidx), _mm256_castsi256_ps(cur), gt));
+        }
+
+        alignas(32) float lane_max[W];
+        alignas(32) int lane_idx[W];
+        _mm256_store_ps(lane_max, vmax);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lane_idx), vidx);
+        best = static_cast<size_t>(lane_idx[0]);
+        float best_val = lane_max[0];
+        for (size_t l = 1; l < W; l++) {
+            const size_t idx = static_cast<size_t>(lane_idx[l]);
+            if (lane_max[l] > best_val || (lane_max[l] == best_val && idx < best)) {
+                best_val = lane_max[l];
+                best = idx;
+            }
+        }
+    } else {
+        i = 1;
+    }
+    for (; i < n; i++) {
+        if (x[i] > x[best]) best = i;
+    }
+    return best;
+}
+
+
+// Four complex products of interleaved pairs: (ar*br - ai*bi, ai*br + ar*bi)
+inline __m256 cmul4(__m256 a, __m256 b) {
+    const __m256 a_swap = _mm256_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm256_fmaddsub_ps(a, _mm256_moveldup_ps(b),
+                              _mm256_mul_ps(a_swap, _mm256_movehdup_ps(b)));
+}
+
+void avx2_mix(const float* in_iq, const float* osc_iq, float* out_iq, size_t n,
+              float rot_re, float rot_im) {
+    const __m256 rot = _mm256_setr_ps(rot_re, rot_im, rot_re, rot_im, rot_re, rot_im, rot_re, rot_im);
+    size_t i = 0;
+    for (; i + W / 2 <= n; i += W / 2) {
+        const __m256 osc = cmul4(_mm256_loadu_ps(osc_iq + 2 * i), rot);
+        _mm256_storeu_ps(out_iq + 2 * i, cmul4(_mm256_loadu_ps(in_iq + 2 * i), osc));
+    }
+    if (i < n) {
+        alignas(32) float in[W] = {};
+        alignas(32) float osc[W] = {};
+        for (size_t j = 0; j < 2 * (n - i); j++) {
+            in[j] = in_iq[2 * i + j];
+            osc[j] = osc_iq[2 * i + j];
+        }
+        _mm256_store_ps(in, cmul4(_mm256_load_ps(in), cmul4(_mm256_load_ps(osc), rot)));
+        for (size_t j = 0; j < 2 * (n - i); j++) out_iq[2 * i + j] = in[j];
+    }
+}
+
+void avx2_fir_decimate(const float* in_iq, const float* taps2, size_t ntaps, size_t decim,
+                       float* out_iq, size_t n_out) {
+    for (size_t k = 0; k < n_out; k++) {
+        const float* x = in_iq + 2 * k * decim;
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for (size_t j = 0; j < 2 * ntaps; j += 2 * W) {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + j), _mm256_loadu_ps(taps2 + j), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + j + W), _mm256_loadu_ps(taps2 + j + W), acc1);
+        }
+        // Even lanes are I, odd lanes Q: fold down to one pair
+        const __m256 acc = _mm256_add_ps(acc0, acc1);
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        _mm_storel_pi(reinterpret_cast<__m64*>(out_iq + 2 * k), sum);
+    }
+}
+
+}  // namespace
+
+const Kernels avx2_kernels = {
+    Isa::Avx2, "avx2",
+    avx2_apply_window, avx2_power, avx2_power_to_db, avx2_magnitude, avx2_argmax,
+    avx2_mix, avx2_fir_decimate,
+};
+
+}  // namespace dsp
+
+#endif  // __AVX2__ && __FMA__
@@ -0,0 +1,196 @@
+/**
+ * dsp_kernels_avx512.cpp - AVX-512F kernels (16 floats per vector)
+ *
+ * Built with -mavx512f and only reached after the runtime CPU check in
+ * dsp_kernels.cpp. Loop tails use masked loads and stores.
+ */
+
+#include "dsp_kernels.hpp"
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+
+namespace dsp {
+
+namespace {
+
+constexpr size_t W = 16;
+
+inline __mmask16 tail_mask(size_t count) {
+    return static_cast<__mmask16>((1u << count) - 1u);
+}
+
+void avx512_apply_window(const float* in_iq, const float* window, float* out_iq, size_t n) {
+    const __m512i lo_idx = _mm512_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7);
+    const __m512i hi_idx = _mm512_setr_epi32(8, 8, 9, 9, 10, 10, 11, 11,
+                                             12, 12, 13, 13, 14, 14, 15, 15);
+    for (size_t i = 0; i < n; i += W) {
+        const size_t count = n - i < W ? n - i : W;
+        const __mmask16 lo_mask = tail_mask(count >= W / 2 ? W : 2 * count);
+        const __mmask16 hi_mask = tail_mask(count > W / 2 ? 2 * count - W : 0);
+
+        const __m512 w = _mm512_maskz_loadu_ps(tail_mask(count), window + i);
+        const __m512 a = _mm512_maskz_loadu_ps(lo_mask, in_iq + 2 * i);
+        const __m512 b = _mm512_maskz_loadu_ps(hi_mask, in_iq + 2 * i + W);
+        _mm512_mask_storeu_ps(out_iq + 2 * i, lo_mask,
+                              _mm512_mul_ps(a, _mm512_permutexvar_ps(lo_idx, w)));
+        _mm512_mask_storeu_ps(out_iq + 2 * i + W, hi_mask,
+                              _mm512_mul_ps(b, _mm512_permutexvar_ps(hi_idx, w)));
+    }
+}
+
+void avx512_power(const float* in_iq, float* power, size_t n, float scale) {
+    // Deinterleave 16 complex samples from two vectors into re and im
+    const __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14,
+                                           16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i odd = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15,
+                                          17, 19, 21, 23, 25, 27, 29, 31);
+    const __m512 vscale = _mm512_set1_ps(scale);
+
+    for (size_t i = 0; i < n; i += W) {
+        const size_t count = n - i < W ? n - i : W;
+        const __mmask16 lo_mask = tail_mask(count >= W / 2 ? W : 2 * count);
+        const __mmask16 hi_mask = tail_mask(count > W / 2 ? 2 * count - W : 0);
+
+        const __m512 a = _mm512_maskz_loadu_ps(lo_mask, in_iq + 2 * i);
+        const __m512 b = _mm512_maskz_loadu_ps(hi_mask, in_iq + 2 * i + W);
+        const __m512 re = _mm512_permutex2var_ps(a, even, b);
+        const __m512 im = _mm512_permutex2var_ps(a, odd, b);
+        const __m512 p = _mm512_fmadd_ps(re, re, _mm512_mul_ps(im, im));
+        _mm512_mask_storeu_ps(power + i, tail_mask(count), _mm512_mul_ps(p, vscale));
+    }
+}
+
+// Natural log of x > 0 (cephes logf)
+inline __m512 log16(__m512 x) {
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 half = _mm512_set1_ps(0.5f);
+
+    x = _mm512_max_ps(x, _mm512_set1_ps(1.17549435e-38f));  // Smallest normal
+    __m512i bits = _mm512_castps_si512(x);
+    __m512i exponent = _mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(0x7f));
+    bits = _mm512_and_si512(bits, _mm512_set1_epi32(~0x7f800000));
+    bits = _mm512_or_si512(bits, _mm512_castps_si512(half));  // Mantissa in [0.5, 1)
+    x = _mm512_castsi512_ps(bits);
+    __m512 e = _mm512_add_ps(_mm512_cvtepi32_ps(exponent), one);
+
+    // Fold [0.5, sqrt(1/2)) up to [1, sqrt(2))
+    const __mmask16 fold = _mm512_cmp_ps_mask(x, _mm512_set1_ps(detail::LOG_SQRTHF), _CMP_LT_OQ);
+    x = _mm512_mask_add_ps(_mm512_sub_ps(x, one), fold, _mm512_sub_ps(x, one), x);
+    e = _mm512_mask_sub_ps(e, fold, e, one);
+
+    const __m512 z = _mm512_mul_ps(x, x);
+    __m512 y = _mm512_set1_ps(detail::LOG_P[0]);
+    for (int k = 1; k < 9; k++) {
+        y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(detail::LOG_P[k]));
+    }
+    y = _mm512_mul_ps(_mm512_mul_ps(y, x), z);
+    y = _mm512_fmadd_ps(e, _mm512_set1_ps(detail::LOG_Q1), y);
+    y = _mm512_fnmadd_ps(z, half, y);
+    x = _mm512_add_ps(x, y);
+    return _mm512_fmadd_ps(e, _mm512_set1_ps(detail::LOG_Q2), x);
+}
+
+void avx512_power_to_db(const float* power, float* db, size_t n, float offset_db) {
+    const __m512 offset = _mm512_set1_ps(offset_db);
+    const __m512 floor = _mm512_set1_ps(detail::POWER_FLOOR);
+    const __m512 scale = _mm512_set1_ps(detail::DB_PER_LN);
+    for (size_t i = 0; i < n; i += W) {
+        const __mmask16 mask = tail_mask(n - i < W ? n - i : W);
+        const __m512 p = _mm512_maskz_loadu_ps(mask, power + i);
+        const __m512 ln = log16(_mm512_add_ps(p, floor));
+        _mm512_mask_storeu_ps(db + i, mask, _mm512_fmadd_ps(ln, scale, offset));
+    }
+}
+
+void avx512_magnitude(const float* power, float* mag, size_t n) {
+    for (size_t i = 0; i < n; i += W) {
+        const __mmask16 mask = tail_mask(n - i < W ? n - i : W);
+        _mm512_mask_storeu_ps(mag + i, mask, _mm512_sqrt_ps(_mm512_maskz_loadu_ps(mask, power + i)));
+    }
+}
+
+size_t avx512_argmax(const float* x, size_t n) {
+    if (n < W) {
+        size_t best = 0;
+        for (size_t i = 1; i < n; i++) {
+            if (x[i] > x[best]) best = i;
+        }
+        return best;
+    }
+
+    // Per-lane running max; strict > keeps each lane's first occurrence
+    __m512 vmax = _mm512_loadu_ps(x);
+    __m512i vidx = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i cur = vidx;
+    const __m512i step = _mm512_set1_epi32(W);
+    size_t i = W;
+    for (; i + W <= n; i += W) {
+        cur = _mm512_add_epi32(cur, step);
+        const __m512 v = _mm512_loadu_ps(x + i);
+        const __mmask16 gt = _mm512_cmp_ps_mask(v, vmax, _CMP_GT_OQ);
+        vmax = _mm512_mask_mov_ps(vmax, gt, v);
+        vidx = _mm512_mask_mov_epi32(vidx, gt, cur);
+    }
+
+    // Lowest index among the lanes holding the overall max
+    const float best_val = _mm512_reduce_max_ps(vmax);
+    const __mmask16 at_max = _mm512_cmp_ps_mask(vmax, _mm512_set1_ps(best_val), _CMP_EQ_OQ);
+    size_t best = static_cast<size_t>(_mm512_mask_reduce_min_epi32(at_max, vidx));
+
+    for (; i < n; i++) {
+        if (x[i] > x[best]) best = i;
+    }
+    return best;
+}
+
+
+// Eight complex products of interleaved pairs: (ar*br - ai*bi, ai*br + ar*bi)
+inline __m512 cmul8(__m512 a, __m512 b) {
+    const __m512 a_swap = _mm512_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm512_fmaddsub_ps(a, _mm512_moveldup_ps(b),
+                              _mm512_mul_ps(a_swap, _mm512_movehdup_ps(b)));
+}
+
+void avx512_mix(const float* in_iq, const float* osc_iq, float* out_iq, size_t n,
+                float rot_re, float rot_im) {
+    const __m512 rot = _mm512_setr_ps(rot_re, rot_im, rot_re, rot_im, rot_re, rot_im, rot_re, rot_im,
+                                      rot_re, rot_im, rot_re, rot_im, rot_re, rot_im, rot_re, rot_im);
+    for (size_t i = 0; i < n; i += W / 2) {
+        const size_t count = n - i < W / 2 ? n - i : W / 2;
+        const __mmask16 mask = tail_mask(2 * count);
+        const __m512 osc = cmul8(_mm512_maskz_loadu_ps(mask, osc_iq + 2 * i), rot);
+        _mm512_mask_storeu_ps(out_iq + 2 * i, mask, cmul8(_mm512_maskz_loadu_ps(mask, in_iq + 2 * i), osc));
+    }
+}
+
+void avx512_fir_decimate(const float* in_iq, const float* taps2, size_t ntaps, size_t decim,
+                         float* out_iq, size_t n_out) {
+    for (size_t k = 0; k < n_out; k++) {
+        const float* x = in_iq + 2 * k * decim;
+        __m512 acc = _mm512_setzero_ps();
+        for (size_t j = 0; j < 2 * ntaps; j += W) {
+            acc = _mm512_fmadd_ps(_mm512_loadu_ps(x + j), _mm512_loadu_ps(taps2 + j), acc);
+        }
+        // Even lanes are I, odd lanes Q: fold down to one pair
+        const __m256 half = _mm256_add_ps(
+            _mm512_castps512_ps256(acc),
+            _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(acc), 1)));
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(half), _mm256_extractf128_ps(half, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        _mm_storel_pi(reinterpret_cast<__m64*>(out_iq + 2 * k), sum);
+    }
+}
+
+}  // namespace
+
+const Kernels avx512_kernels = {
+    Isa::Avx512, "avx512",
+    avx512_apply_window, avx512_power, avx512_power_to_db, avx512_magnitude, avx512_argmax,
+    avx512_mix, avx512_fir_decimate,
+};
+
+}  // namespace dsp
+
+#endif  // __AVX512F__
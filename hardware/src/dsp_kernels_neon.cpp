@@ -0,0 +1,197 @@
+/**
+ * dsp_kernels_neon.cpp - AArch64 Advanced SIMD kernels (4 floats per vector)
+ *
+ * NEON is part of the aarch64 baseline, so this needs no extra flags and
+ * no runtime check. vld2/vst2 do the complex deinterleave for free.
+ */
+
+#include "dsp_kernels.hpp"
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+
+#include <arm_neon.h>
+#include <cstdint>
+
+namespace dsp {
+
+namespace {
+
+constexpr size_t W = 4;
+
+void neon_apply_window(const float* in_iq, const float* window, float* out_iq, size_t n) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        const float32x4_t w = vld1q_f32(window + i);
+        float32x4x2_t iq = vld2q_f32(in_iq + 2 * i);
+        iq.val[0] = vmulq_f32(iq.val[0], w);
+        iq.val[1] = vmulq_f32(iq.val[1], w);
+        vst2q_f32(out_iq + 2 * i, iq);
+    }
+    for (; i < n; i++) {
+        out_iq[2 * i] = in_iq[2 * i] * window[i];
+        out_iq[2 * i + 1] = in_iq[2 * i + 1] * window[i];
+    }
+}
+
+void neon_power(const float* in_iq, float* power, size_t n, float scale) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        const float32x4x2_t iq = vld2q_f32(in_iq + 2 * i);
+        const float32x4_t p = vfmaq_f32(vmulq_f32(iq.val[1], iq.val[1]), iq.val[0], iq.val[0]);
+        vst1q_f32(power + i, vmulq_n_f32(p, scale));
+    }
+    for (; i < n; i++) {
+        const float re = in_iq[2 * i];
+        const float im = in_iq[2 * i + 1];
+        power[i] = (re * re + im * im) * scale;
+    }
+}
+
+// Natural log of x > 0 (cephes logf)
+inline float32x4_t log4(float32x4_t x) {
+    const float32x4_t one = vdupq_n_f32(1.0f);
+
+    x = vmaxq_f32(x, vdupq_n_f32(1.17549435e-38f));  // Smallest normal
+    uint32x4_t bits = vreinterpretq_u32_f32(x);
+    const int32x4_t exponent = vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)),
+                                         vdupq_n_s32(0x7f));
+    bits = vandq_u32(bits, vdupq_n_u32(~0x7f800000u));
+    bits = vorrq_u32(bits, vreinterpretq_u32_f32(vdupq_n_f32(0.5f)));  // Mantissa in [0.5, 1)
+    x = vreinterpretq_f32_u32(bits);
+    float32x4_t e = vaddq_f32(vcvtq_f32_s32(exponent), one);
+
+    // Fold [0.5, sqrt(1/2)) up to [1, sqrt(2))
+    const uint32x4_t fold = vcltq_f32(x, vdupq_n_f32(detail::LOG_SQRTHF));
+    const float32x4_t tmp = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(x), fold));
+    x = vaddq_f32(vsubq_f32(x, one), tmp);
+    e = vsubq_f32(e, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(one), fold)));
+
+    const float32x4_t z = vmulq_f32(x, x);
+    float32x4_t y = vdupq_n_f32(detail::LOG_P[0]);
+    for (int k = 1; k < 9; k++) {
+        y = vfmaq_f32(vdupq_n_f32(detail::LOG_P[k]), y, x);
+    }
+    y = vmulq_f32(vmulq_f32(y, x), z);
+    y = vfmaq_f32(y, e, vdupq_n_f32(detail::LOG_Q1));
+    y = vfmsq_f32(y, z, vdupq_n_f32(0.5f));
+    x = vaddq_f32(x, y);
+    return vfmaq_f32(x, e, vdupq_n_f32(detail::LOG_Q2));
+}
+
+void neon_power_to_db(const float* power, float* db, size_t n, float offset_db) {
+    const float32x4_t floor = vdupq_n_f32(detail::POWER_FLOOR);
+    const float32x4_t offset = vdupq_n_f32(offset_db);
+    const float32x4_t scale = vdupq_n_f32(detail::DB_PER_LN);
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        const float32x4_t ln = log4(vaddq_f32(vld1q_f32(power + i), floor));
+        vst1q_f32(db + i, vfmaq_f32(offset, ln, scale));
+    }
+    if (i < n) {
+        float block[W] = {};
+        for (size_t j = 0; j < n - i; j++) block[j] = power[i + j];
+        const float32x4_t ln = log4(vaddq_f32(vld1q_f32(block), floor));
+        vst1q_f32(block, vfmaq_f32(offset, ln, scale));
+        for (size_t j = 0; j < n - i; j++) db[i + j] = block[j];
+    }
+}
+
+void neon_magnitude(const float* power, float* mag, size_t n) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        vst1q_f32(mag + i, vsqrtq_f32(vld1q_f32(power + i)));
+    }
+    if (i < n) {
+        float block[W] = {};
+        for (size_t j = 0; j < n - i; j++) block[j] = power[i + j];
+        vst1q_f32(block, vsqrtq_f32(vld1q_f32(block)));
+        for (size_t j = 0; j < n - i; j++) mag[i + j] = block[j];
+    }
+}
+
+size_t neon_argmax(const float* x, size_t n) {
+    size_t best = 0;
+    size_t i = 0;
+    if (n >= W) {
+        // Per-lane running max; strict > keeps each lane's first occurrence
+        float32x4_t vmax = vld1q_f32(x);
+        const uint32x4_t lanes = {0, 1, 2, 3};
+        uint32x4_t vidx = lanes;
+        for (i = W; i + W <= n; i += W) {
+            const float32x4_t v = vld1q_f32(x + i);
+            const uint32x4_t gt = vcgtq_f32(v, vmax);
+            vmax = vbslq_f32(gt, v, vmax);
+            vidx = vbslq_u32(gt, vaddq_u32(lanes, vdupq_n_u32(static_cast<uint32_t>(i))), vidx);
+        }
+
+        // Lowest index among the lanes holding the overall max
+        const float best_val = vmaxvq_f32(vmax);
+        const uint32x4_t at_max = vceqq_f32(vmax, vdupq_n_f32(best_val));
+        const uint32x4_t candidates = vbslq_u32(at_max, vidx, vdupq_n_u32(UINT32_MAX));
+        best = vminvq_u32(candidates);
+    } else {
+        i = 1;
+    }
+    for (; i < n; i++) {
+        if (x[i] > x[best]) best = i;
+    }
+    return best;
+}
+
+
+void neon_mix(const float* in_iq, const float* osc_iq, float* out_iq, size_t n,
+              float rot_re, float rot_im) {
+    const float32x4_t rr = vdupq_n_f32(rot_re);
+    const float32x4_t ri = vdupq_n_f32(rot_im);
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        const float32x4x2_t osc = vld2q_f32(osc_iq + 2 * i);
+        const float32x4_t o_re = vfmsq_f32(vmulq_f32(osc.val[0], rr), osc.val[1], ri);
+        const float32x4_t o_im = vfmaq_f32(vmulq_f32(osc.val[0], ri), osc.val[1], rr);
+        float32x4x2_t iq = vld2q_f32(in_iq + 2 * i);
+        const float32x4_t re = vfmsq_f32(vmulq_f32(iq.val[0], o_re), iq.val[1], o_im);
+        iq.val[1] = vfmaq_f32(vmulq_f32(iq.val[0], o_im), iq.val[1], o_re);
+        iq.val[0] = re;
+        vst2q_f32(out_iq + 2 * i, iq);
+    }
+    for (; i < n; i++) {
+        const float o_re = osc_iq[2 * i] * rot_re - osc_iq[2 * i + 1] * rot_im;
+        const float o_im = osc_iq[2 * i] * rot_im + osc_iq[2 * i + 1] * rot_re;
+        const float re = in_iq[2 * i];
+        const float im = in_iq[2 * i + 1];
+        out_iq[2 * i] = re * o_re - im * o_im;
+        out_iq[2 * i + 1] = re * o_im + im * o_re;
+    }
+}
+
+void neon_fir_decimate(const float* in_iq, const float* taps2, size_t ntaps, size_t decim,
+                       float* out_iq, size_t n_out) {
+    for (size_t k = 0; k < n_out; k++) {
+        const float* x = in_iq + 2 * k * decim;
+        float32x4_t acc0 = vdupq_n_f32(0.0f);
+        float32x4_t acc1 = vdupq_n_f32(0.0f);
+        float32x4_t acc2 = vdupq_n_f32(0.0f);
+        float32x4_t acc3 = vdupq_n_f32(0.0f);
+        for (size_t j = 0; j < 2 * ntaps; j += 4 * W) {
+            acc0 = vfmaq_f32(acc0, vld1q_f32(x + j), vld1q_f32(taps2 + j));
+            acc1 = vfmaq_f32(acc1, vld1q_f32(x + j + W), vld1q_f32(taps2 + j + W));
+            acc2 = vfmaq_f32(acc2, vld1q_f32(x + j + 2 * W), vld1q_f32(taps2 + j + 2 * W));
+            acc3 = vfmaq_f32(acc3, vld1q_f32(x + j + 3 * W), vld1q_f32(taps2 + j + 3 * W));
+        }
+        // Lanes are I Q I Q: fold down to one pair
+        const float32x4_t acc = vaddq_f32(vaddq_f32(acc0, acc1), vaddq_f32(acc2, acc3));
+        vst1_f32(out_iq + 2 * k, vadd_f32(vget_low_f32(acc), vget_high_f32(acc)));
+    }
+}
+
+}  // namespace
+
+const Kernels neon_kernels = {
+    Isa::Neon, "neon",
+    neon_apply_window, neon_power, neon_power_to_db, neon_magnitude, neon_argmax,
+    neon_mix, neon_fir_decimate,
+};
+
+}  // namespace dsp
+
+#endif  // __aarch64__ && __ARM_NEON
@@ -0,0 +1,167 @@
+/**
+ * dsp_kernels_sve.cpp - AArch64 SVE kernels (vector-length agnostic)
+ *
+ * Built with +sve and only reached after the HWCAP_SVE check in
+ * dsp_kernels.cpp. Every loop is predicated with svwhilelt, so tails need
+ * no special casing and the same binary uses the full width on 128-bit
+ * (Grace/GX10) and wider implementations.
+ */
+
+#include "dsp_kernels.hpp"
+
+#if defined(__ARM_FEATURE_SVE)
+
+#include <arm_sve.h>
+#include <cstdint>
+
+namespace dsp {
+
+namespace {
+
+void sve_apply_window(const float* in_iq, const float* window, float* out_iq, size_t n) {
+    for (size_t i = 0; i < n; i += svcntw()) {
+        const svbool_t pg = svwhilelt_b32_u64(i, n);
+        const svfloat32_t w = svld1_f32(pg, window + i);
+        const svfloat32x2_t iq = svld2_f32(pg, in_iq + 2 * i);
+        svst2_f32(pg, out_iq + 2 * i,
+                  svcreate2_f32(svmul_f32_x(pg, svget2_f32(iq, 0), w),
+                                svmul_f32_x(pg, svget2_f32(iq, 1), w)));
+    }
+}
+
+void sve_power(const float* in_iq, float* power, size_t n, float scale) {
+    for (size_t i = 0; i < n; i += svcntw()) {
+        const svbool_t pg = svwhilelt_b32_u64(i, n);
+        const svfloat32x2_t iq = svld2_f32(pg, in_iq + 2 * i);
+        const svfloat32_t re = svget2_f32(iq, 0);
+        const svfloat32_t im = svget2_f32(iq, 1);
+        const svfloat32_t p = svmla_f32_x(pg, svmul_f32_x(pg, im, im), re, re);
+        svst1_f32(pg, power + i, svmul_n_f32_x(pg, p, scale));
+    }
+}
+
+// Natural log of x > 0 (cephes logf)
+inline svfloat32_t log_sve(svbool_t pg, svfloat32_t x) {
+    x = svmax_n_f32_x(pg, x, 1.17549435e-38f);  // Smallest normal
+    svuint32_t bits = svreinterpret_u32_f32(x);
+    const svint32_t exponent = svsub_n_s32_x(pg, svreinterpret_s32_u32(svlsr_n_u32_x(pg, bits, 23)), 0x7f);
+    bits = svand_n_u32_x(pg, bits, ~0x7f800000u);
+    bits = svorr_n_u32_x(pg, bits, 0x3f000000u);  // Mantissa in [0.5, 1)
+    x = svreinterpret_f32_u32(bits);
+    svfloat32_t e = svadd_n_f32_x(pg, svcvt_f32_s32_x(pg, exponent), 1.0f);
+
+    // Fold [0.5, sqrt(1/2)) up to [1, sqrt(2))
+    const svbool_t fold = svcmplt_n_f32(pg, x, detail::LOG_SQRTHF);
+    const svfloat32_t xm1 = svsub_n_f32_x(pg, x, 1.0f);
+    x = svadd_f32_m(fold, xm1, x);
+    e = svsub_n_f32_m(fold, e, 1.0f);
+
+    const svfloat32_t z = svmul_f32_x(pg, x, x);
+    svfloat32_t y = svdup_n_f32(detail::LOG_P[0]);
+    for (int k = 1; k < 9; k++) {
+        y = svmad_f32_x(pg, y, x, svdup_n_f32(detail::LOG_P[k]));
+    }
+    y = svmul_f32_x(pg, svmul_f32_x(pg, y, x), z);
+    y = svmla_n_f32_x(pg, y, e, detail::LOG_Q1);
+    y = svmls_n_f32_x(pg, y, z, 0.5f);
+    x = svadd_f32_x(pg, x, y);
+    return svmla_n_f32_x(pg, x, e, detail::LOG_Q2);
+}
+
+void sve_power_to_db(const float* power, float* db, size_t n, float offset_db) {
+    for (size_t i = 0; i < n; i += svcntw()) {
+        const svbool_t pg = svwhilelt_b32_u64(i, n);
+        const svfloat32_t p = svadd_n_f32_x(pg, svld1_f32(pg, power + i), detail::POWER_FLOOR);
+        const svfloat32_t ln = log_sve(pg, p);
+        svst1_f32(pg, db + i, svmla_n_f32_x(pg, svdup_n_f32(offset_db), ln, detail::DB_PER_LN));
+    }
+}
+
+void sve_magnitude(const float* power, float* mag, size_t n) {
+    for (size_t i = 0; i < n; i += svcntw()) {
+        const svbool_t pg = svwhilelt_b32_u64(i, n);
+        svst1_f32(pg, mag + i, svsqrt_f32_x(pg, svld1_f32(pg, power + i)));
+    }
+}
+
+size_t sve_argmax(const float* x, size_t n) {
+    if (n == 0) return 0;
+
+    // Per-lane running max; strict > keeps each lane's first occurrence.
+    // Inactive tail lanes stay at -inf and never win.
+    const svbool_t all = svptrue_b32();
+    svfloat32_t vmax = svdup_n_f32(-__builtin_inff());
+    svuint32_t vidx = svdup_n_u32(0);
+    for (size_t i = 0; i < n; i += svcntw()) {
+        const svbool_t pg = svwhilelt_b32_u64(i, n);
+        const svfloat32_t v = svld1_f32(pg, x + i);
+        const svbool_t gt = svcmpgt_f32(pg, v, vmax);
+        vmax = svsel_f32(gt, v, vmax);
+        vidx = svsel_u32(gt, svindex_u32(static_cast<uint32_t>(i), 1), vidx);
+    }
+
+    // Lowest index among the lanes holding the overall max
+    const float best_val = svmaxv_f32(all, vmax);
+    const svbool_t at_max = svcmpeq_n_f32(all, vmax, best_val);
+    size_t best = svminv_u32(at_max, vidx);
+
+    // All -inf (or NaN) input: fall back to the scalar definition
+    if (!(x[best] == best_val)) {
+        best = 0;
+        for (size_t i = 1; i < n; i++) {
+            if (x[i] > x[best]) best = i;
+        }
+    }
+    return best;
+}
+
+
+void sve_mix(const float* in_iq, const float* osc_iq, float* out_iq, size_t n,
+             float rot_re, float rot_im) {
+    const svfloat32_t rr = svdup_n_f32(rot_re);
+    const svfloat32_t ri = svdup_n_f32(rot_im);
+    for (size_t i = 0; i < n; i += svcntw()) {
+        const svbool_t pg = svwhilelt_b32_u64(i, n);
+        const svfloat32x2_t osc = svld2_f32(pg, osc_iq + 2 * i);
+        const svfloat32_t c = svget2_f32(osc, 0);
+        const svfloat32_t s = svget2_f32(osc, 1);
+        const svfloat32_t o_re = svmls_f32_x(pg, svmul_f32_x(pg, c, rr), s, ri);
+        const svfloat32_t o_im = svmla_f32_x(pg, svmul_f32_x(pg, c, ri), s, rr);
+        const svfloat32x2_t iq = svld2_f32(pg, in_iq + 2 * i);
+        const svfloat32_t re = svget2_f32(iq, 0);
+        const svfloat32_t im = svget2_f32(iq, 1);
+        svst2_f32(pg, out_iq + 2 * i,
+                  svcreate2_f32(svmls_f32_x(pg, svmul_f32_x(pg, re, o_re), im, o_im),
+                                svmla_f32_x(pg, svmul_f32_x(pg, re, o_im), im, o_re)));
+    }
+}
+
+void sve_fir_decimate(const float* in_iq, const float* taps2, size_t ntaps, size_t decim,
+                      float* out_iq, size_t n_out) {
+    // Vectors hold whole I/Q pairs, so lane parity says which is which
+    const svbool_t all = svptrue_b32();
+    const svbool_t even = svcmpeq_n_u32(all, svand_n_u32_x(all, svindex_u32(0, 1), 1), 0);
+    const svbool_t odd = svnot_b_z(all, even);
+    for (size_t k = 0; k < n_out; k++) {
+        const float* x = in_iq + 2 * k * decim;
+        svfloat32_t acc = svdup_n_f32(0.0f);
+        for (size_t j = 0; j < 2 * ntaps; j += svcntw()) {
+            const svbool_t pg = svwhilelt_b32_u64(j, 2 * ntaps);
+            acc = svmla_f32_m(pg, acc, svld1_f32(pg, x + j), svld1_f32(pg, taps2 + j));
+        }
+        out_iq[2 * k] = svaddv_f32(even, acc);
+        out_iq[2 * k + 1] = svaddv_f32(odd, acc);
+    }
+}
+
+}  // namespace
+
+const Kernels sve_kernels = {
+    Isa::Sve, "sve",
+    sve_apply_window, sve_power, sve_power_to_db, sve_magnitude, sve_argmax,
+    sve_mix, sve_fir_decimate,
+};
+
+}  // namespace dsp
+
+#endif  // __ARM_FEATURE_SVE
@@ -0,0 +1,178 @@
+/**
+ * fftw_wisdom.hpp - Persistent FFTW planner wisdom shared by the daemons
+ *
+ * FFTW_MEASURE and stronger planners time candidate algorithms at plan
+ * time, which costs hundreds of ms to seconds per size. Wisdom records the
+ * winners (per transform size, layout and planner flags) so later runs plan
+ * instantly. Wisdom from a more rigorous effort also satisfies a weaker
+ * one, so a cache filled by fftw_wisdom_builder at --plan-effort patient
+ * gives the daemons patient-quality plans at measure cost.
+ *
+ * The cache file is per CPU: its name carries a hash of the /proc/cpuinfo
+ * identity and the FFTW version, because timings measured on one machine
+ * are meaningless on another. Location, in order of preference:
+ *
+ *   $SDR_FFTW_WISDOM                  explicit file
+ *   $XDG_CACHE_HOME/sdr/fftwf-wisdom-<cpu>.dat
+ *   $HOME/.cache/sdr/fftwf-wisdom-<cpu>.dat
+ *
+ * Saving re-imports the file first and replaces it with rename(), so
+ * several daemons sharing one cache never lose each other's plans.
+ */
+
+#pragma once
+
+#include <fftw3.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <utility>
+
+enum class PlanEffort { Estimate, Measure, Patient, Exhaustive };
+
+inline bool parse_plan_effort(const std::string& name, PlanEffort& effort) {
+    if (name == "estimate") { effort = PlanEffort::Estimate; return true; }
+    if (name == "measure") { effort = PlanEffort::Measure; return true; }
+    if (name == "patient") { effort = PlanEffort::Patient; return true; }
+    if (name == "exhaustive") { effort = PlanEffort::Exhaustive; return true; }
+    return false;
+}
+
+inline unsigned plan_effort_flags(PlanEffort effort) {
+    switch (effort) {
+    case PlanEffort::Estimate: return FFTW_ESTIMATE;
+    case PlanEffort::Measure: return FFTW_MEASURE;
+    case PlanEffort::Patient: return FFTW_PATIENT;
+    case PlanEffort::Exhaustive: return FFTW_EXHAUSTIVE;
+    }
+    return FFTW_MEASURE;
+}
+
+inline const char* plan_effort_name(PlanEffort effort) {
+    switch (effort) {
+    case PlanEffort::Estimate: return "estimate";
+    case PlanEffort::Measure: return "measure";
+    case PlanEffort::Patient: return "patient";
+    case PlanEffort::Exhaustive: return "exhaustive";
+    }
+    return "measure";
+}
+
+// Short hex id of this CPU model and the FFTW build
+inline std::string cpu_signature() {
+    static const char* const keys[] = {
+        "vendor_id", "cpu family", "model", "model name", "stepping", "flags",          // x86
+        "CPU implementer", "CPU architecture", "CPU variant", "CPU part", "Features",   // arm
+    };
+
+    uint64_t hash = 1469598103934665603ull;  // FNV-1a
+    auto mix = [&hash](const std::string& text) {
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+    };
+
+    // The first processor block is enough; all cores share the model
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line) && !line.empty()) {
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string key = line.substr(0, colon);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        for (const char* wanted : keys) {
+            if (key == wanted) {
+                mix(line);
+                break;
+            }
+        }
+    }
+    mix(fftwf_version);
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return hex;
+}
+
+inline std::string default_wisdom_path() {
+    if (const char* explicit_path = std::getenv("SDR_FFTW_WISDOM")) {
+        if (*explicit_path) return explicit_path;
+    }
+
+    std::string dir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        if (*xdg) dir = xdg;
+    }
+    if (dir.empty()) {
+        const char* home = std::getenv("HOME");
+        dir = std::string(home && *home ? home : "/tmp") + "/.cache";
+    }
+    return dir + "/sdr/fftwf-wisdom-" + cpu_signature() + ".dat";
+}
+
+class WisdomStore {
+public:
+    explicit WisdomStore(std::string path = default_wisdom_path())
+        : path_(std::move(path)) {}
+
+    // Imports system wisdom (/etc/fftw/wisdomf) and then the cache file.
+    // Returns false if the cache file is missing or unreadable.
+    bool load() {
+        fftwf_import_system_wisdom();
+        const bool loaded = fftwf_import_wisdom_from_filename(path_.c_str()) != 0;
+        saved_ = snapshot();
+        return loaded;
+    }
+
+    // Writes the cache back if planning added wisdom since load()/save()
+    bool save() {
+        const std::string current = snapshot();
+        if (current == saved_) return true;
+
+        const size_t slash = path_.find_last_of('/');
+        if (slash != std::string::npos && !make_dirs(path_.substr(0, slash))) return false;
+
+        // Merge with whatever other processes saved meanwhile, then swap atomically
+        fftwf_import_wisdom_from_filename(path_.c_str());
+        const std::string tmp = path_ + ".tmp." + std::to_string(::getpid());
+        if (!fftwf_export_wisdom_to_filename(tmp.c_str())) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        if (std::rename(tmp.c_str(), path_.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        saved_ = snapshot();
+        return true;
+    }
+
+    const std::string& path() const { return path_; }
+
+private:
+    static std::string snapshot() {
+        char* text = fftwf_export_wisdom_to_string();
+        std::string out = text ? text : "";
+        std::free(text);
+        return out;
+    }
+
+    static bool make_dirs(const std::string& dir) {
+        for (size_t pos = 1; pos <= dir.size(); pos++) {
+            if (pos != dir.size() && dir[pos] != '/') continue;
+            const std::string prefix = dir.substr(0, pos);
+            if (::mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        }
+        return true;
+    }
+
+    std::string path_;
+    std::string saved_;
+};
@@ -0,0 +1,126 @@
+/**
+ * fftw_wisdom_builder.cpp - Pre-plans the deployed FFT sizes into the wisdom cache
+ *
+ * Runs the FFTW planner at a high effort for every size (and batch count)
+ * the daemons use and merges the result into the per-CPU wisdom file from
+ * fftw_wisdom.hpp. Run it once per machine, e.g. at install time:
+ *
+ *   ./fftw_wisdom_builder --effort patient --sizes 1024,2048,4096,8192 --batch 1,10
+ *
+ * Afterwards the daemons plan those sizes instantly at any effort up to the
+ * one used here. Plans match the daemons' layout: single precision, complex
+ * forward, out of place, FFTW-aligned buffers; --batch N adds the contiguous
+ * howmany=N layout used by batched measurements (spectral_engine.hpp).
+ *
+ * Output: JSON summary on stdout, progress on stderr
+ */
+
+#include <fftw3.h>
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "fftw_wisdom.hpp"
+
+namespace po = boost::program_options;
+
+static bool parse_size_list(const std::string& text, std::vector<size_t>& out) {
+    std::istringstream iss(text);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        if (item.empty()) continue;
+        try {
+            size_t value = std::stoul(item);
+            if (value == 0) return false;
+            out.push_back(value);
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return !out.empty();
+}
+
+int main(int argc, char* argv[]) {
+    std::string sizes_arg, batch_arg, effort_name, wisdom_file;
+
+    po::options_description desc("FFTW Wisdom Builder Options");
+    desc.add_options()
+        ("help", "Show help message")
+        ("sizes", po::value<std::string>(&sizes_arg)->default_value("512,1024,2048,4096,8192,16384"), "Comma-separated FFT sizes")
+        ("batch", po::value<std::string>(&batch_arg)->default_value("1,10"), "Comma-separated batch counts (howmany); 10 = freq_scanner default averages")
+        ("effort", po::value<std::string>(&effort_name)->default_value("patient"), "Planner effort (estimate/measure/patient/exhaustive)")
+        ("wisdom-file", po::value<std::string>(&wisdom_file)->default_value(""), "Wisdom cache to update (default: per-CPU file under ~/.cache/sdr)")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    PlanEffort effort;
+    if (!parse_plan_effort(effort_name, effort)) {
+        std::cerr << "Error: Unknown effort '" << effort_name << "' (estimate/measure/patient/exhaustive)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<size_t> sizes, batches;
+    if (!parse_size_list(sizes_arg, sizes) || !parse_size_list(batch_arg, batches)) {
+        std::cerr << "Error: --sizes and --batch take comma-separated positive integers" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    WisdomStore wisdom(wisdom_file.empty() ? default_wisdom_path() : wisdom_file);
+    const bool existing = wisdom.load();
+    std::cerr << "[Wisdom Builder] " << (existing ? "Updating " : "Creating ") << wisdom.path()
+              << " at effort " << effort_name << std::endl;
+
+    std::ostringstream plans;
+    bool first = true;
+    for (size_t size : sizes) {
+        for (size_t batch : batches) {
+            fftwf_complex* in = fftwf_alloc_complex(size * batch);
+            fftwf_complex* out = fftwf_alloc_complex(size * batch);
+            const int n = static_cast<int>(size);
+
+            auto start = std::chrono::steady_clock::now();
+            fftwf_plan plan = fftwf_plan_many_dft(1, &n, static_cast<int>(batch),
+                                                  in, nullptr, 1, n,
+                                                  out, nullptr, 1, n,
+                                                  FFTW_FORWARD, plan_effort_flags(effort));
+            double plan_ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+
+            const bool ok = plan != nullptr;
+            if (ok) fftwf_destroy_plan(plan);
+            fftwf_free(in);
+            fftwf_free(out);
+
+            std::cerr << "[Wisdom Builder] size " << size << " x" << batch << ": "
+                      << (ok ? "planned in " : "FAILED after ") << static_cast<long>(plan_ms) << " ms" << std::endl;
+
+            // Save after every plan so an interrupted exhaustive run keeps its progress
+            if (ok && !wisdom.save()) {
+                std::cerr << "Error: Could not write " << wisdom.path() << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            if (!first) plans << ",";
+            first = false;
+            plans << "{\"size\":" << size << ",\"batch\":" << batch
+                  << ",\"ok\":" << (ok ? "true" : "false")
+                  << ",\"planMs\":" << plan_ms << "}";
+        }
+    }
+
+    std::cout << "{\"wisdomFile\":\"" << wisdom.path() << "\""
+              << ",\"effort\":\"" << effort_name << "\""
+              << ",\"plans\":[" << plans.str() << "]}" << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -7,7 +7,36 @@
  * Usage:
  *   ./freq_scanner --start 900e6 --stop 930e6 --step 1e6 --rate 10e6 --gain 50
  * 
- * Output: JSON array of {frequency, peak_power} objects
+ * Each step averages --averages FFTs through one batched plan (see
+ * spectral_engine.hpp); peak, average and noise floor come from the
+ * linear-domain average, not from averaging per-FFT dB peaks.
+ *
+ * --sweep keeps one continuous stream running for the whole range instead
+ * of starting and stopping it around a fixed 50 ms sleep per step. Retunes
+ * are timed commands (set_command_time) laid out back to back: step k
+ * tunes at T_k, its capture window starts exactly --settle-ms later by
+ * rx_metadata_t timestamps, and step k+1 tunes the instant that window
+ * ends. A receive thread slices windows out of the stream into an SPSC
+ * ring while the main thread issues the next timed tunes and runs the
+ * FFTs of the previous step, so hardware settling overlaps processing.
+ *
+ * --panorama stitches the steps into one spectrum on a fixed bin grid
+ * (panorama.hpp) instead of reporting one row per step: --step is replaced
+ * by a plan with --overlap between steps, --edge-trim of each span and
+ * --dc-blank bins around DC are discarded. With --output-format binary the
+ * result is a single float32 spectrum frame (spectrum_frame.hpp) flagged
+ * SPECTRUM_FLAG_PANORAMA, and log lines move to stderr.
+ *
+ * --args replay:path=<file>[,mode=fast] scans a recording instead of a
+ * USRP (rx_frontend.hpp, replay_source.hpp). Every step sees the same
+ * samples, so this measures the scanner, not the band. With --sweep and
+ * mode=fast the receiver waits for each step rather than dropping it, but
+ * retune times still race the replay clock; use mode=paced to reproduce
+ * hardware timing.
+ *
+ * Output: JSON array of {frequency, peak_power_dbm, peak_frequency,
+ * avg_power_dbm, noise_floor_dbm} objects, or one panorama
+ * (JSON {type: "panorama", ...} object or binary frame)
  */
 
 #include <uhd/usrp/multi_usrp.hpp>
@@ -21,48 +50,144 @@
 #include <complex>
 #include <vector>
 #include <cmath>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+
+#include "fftw_wisdom.hpp"
+#include "panorama.hpp"
+#include "rx_frontend.hpp"
+#include "spectral_engine.hpp"
+#include "spectrum_frame.hpp"
+#include "spsc_ring.hpp"
 
 namespace po = boost::program_options;
 
-static bool stop_signal_called = false;
+static std::atomic<bool> stop_signal_called{false};
 void sig_int_handler(int) {
     stop_signal_called = true;
 }
 
-// Compute peak power in dBm from FFT
-double compute_peak_power(const std::vector<std::complex<float>>& samples, size_t fft_size) {
-    // Allocate FFTW buffers
-    fftwf_complex* in = fftwf_alloc_complex(fft_size);
-    fftwf_complex* out = fftwf_alloc_complex(fft_size);
-    fftwf_plan plan = fftwf_plan_dft_1d(fft_size, in, out, FFTW_FORWARD, FFTW_ESTIMATE);
-
-    // Copy samples to input buffer
-    for (size_t i = 0; i < fft_size && i < samples.size(); ++i) {
-        in[i][0] = samples[i].real();
-        in[i][1] = samples[i].imag();
-    }
+// Timed tunes closer than this to the device clock are pushed back
+constexpr double SWEEP_MIN_LEAD_SECS = 0.002;
+
+// One step's capture window, sliced out of the stream by the receive thread
+struct SweepCapture {
+    size_t step = 0;
+    std::vector<std::complex<float>> samples;   // num_averages * fft_size
+    std::vector<size_t> block_fill;             // Samples received per FFT block
+};
+
+using SweepRing = SpscRing<SweepCapture>;
+
+// Tune timeline shared by the worker (writer) and receive thread (reader).
+// Entries for step k are written before `published` is raised past k.
+struct SweepSchedule {
+    std::vector<double> freqs;
+    std::vector<double> actual_freqs;
+    std::vector<double> tune_times;
+    std::vector<long long> window_start;    // Device tick of the first kept sample
+    std::atomic<size_t> published{0};
+};
+
+struct SweepReceiveContext {
+    RxFrontend::sptr frontend;
+    bool lossless;          // Wait for steps and ring slots instead of dropping (unpaced replay)
+    SweepRing* ring;
+    SweepSchedule* schedule;
+    size_t fft_size;
+    size_t num_averages;
+    double rate;
+    std::atomic<size_t> current_step{0};
+    std::atomic<bool> done{false};
+    std::atomic<size_t> overflows{0};
+};
+
+// Keeps the stream drained and copies each step's capture window (by
+// device timestamp) into a ring slot. Samples before a window (settling)
+// or after the last one are dropped on the floor.
+void sweep_receive_loop(SweepReceiveContext& ctx) {
+    uhd::set_thread_priority_safe();
+
+    const size_t num_steps = ctx.schedule->freqs.size();
+    const long long window_len = static_cast<long long>(ctx.fft_size * ctx.num_averages);
+    std::vector<std::complex<float>> buffer(ctx.frontend->get_max_num_samps());
+    uhd::rx_metadata_t md;
+    SweepCapture* slot = nullptr;
+    size_t step = 0;
 
-    // Execute FFT
-    fftwf_execute(plan);
-
-    // Find peak power
-    double peak_power = -200.0; // Start very low
-    for (size_t i = 0; i < fft_size; ++i) {
-        double real = out[i][0];
-        double imag = out[i][1];
-        double magnitude = std::sqrt(real * real + imag * imag) / fft_size;
-        double power_dbm = 20.0 * std::log10(magnitude + 1e-20) - 30.0; // Convert to dBm
-        if (power_dbm > peak_power) {
-            peak_power = power_dbm;
+    while (step < num_steps && !stop_signal_called) {
+        size_t num_rx_samps = ctx.frontend->recv(buffer.data(), buffer.size(), md, 1.0);
+
+        if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
+            if (ctx.frontend->finished()) break;  // Replay reached the end of its file
+            continue;
         }
-    }
+        if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW) {
+            // Lost samples leave holes; the affected FFT blocks stay unfilled
+            ctx.overflows.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE || !md.has_time_spec) {
+            continue;
+        }
+
+        const long long t0 = md.time_spec.to_ticks(ctx.rate);
+        const long long t1 = t0 + static_cast<long long>(num_rx_samps);
+
+        // A packet may finish one window and start the next
+        while (step < num_steps) {
+            while (ctx.lossless && ctx.schedule->published.load(std::memory_order_acquire) <= step
+                   && !stop_signal_called) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            if (ctx.schedule->published.load(std::memory_order_acquire) <= step) break;
+            const long long start = ctx.schedule->window_start[step];
+            const long long end = start + window_len;
+            if (t1 <= start) break;  // Still settling
+
+            if (!slot) {
+                slot = ctx.ring->acquire_write();
+                while (!slot && ctx.lossless && !stop_signal_called) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    slot = ctx.ring->acquire_write();
+                }
+                if (slot) {
+                    slot->step = step;
+                    std::fill(slot->block_fill.begin(), slot->block_fill.end(), 0);
+                }
+            }
+
+            const long long from = std::max(t0, start);
+            const long long to = std::min(t1, end);
+            if (slot && to > from) {
+                std::memcpy(slot->samples.data() + (from - start), buffer.data() + (from - t0),
+                            static_cast<size_t>(to - from) * sizeof(std::complex<float>));
+                const size_t a = static_cast<size_t>(from - start);
+                const size_t b = static_cast<size_t>(to - start);
+                for (size_t j = a / ctx.fft_size; j * ctx.fft_size < b; j++) {
+                    const size_t lo = std::max(a, j * ctx.fft_size);
+                    const size_t hi = std::min(b, (j + 1) * ctx.fft_size);
+                    slot->block_fill[j] += hi - lo;
+                }
+            }
 
-    // Cleanup
-    fftwf_destroy_plan(plan);
-    fftwf_free(in);
-    fftwf_free(out);
+            if (t1 < end) break;  // Window continues in the next packet
 
-    return peak_power;
+            if (slot) {
+                ctx.ring->commit_write();
+            } else {
+                ctx.ring->mark_dropped();
+            }
+            slot = nullptr;
+            step++;
+            ctx.current_step.store(step, std::memory_order_release);
+        }
+    }
+
+    ctx.done.store(true, std::memory_order_release);
 }
 
 int UHD_SAFE_MAIN(int argc, char *argv[]) {
@@ -70,9 +195,10 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     uhd::set_thread_priority_safe();
 
     // Command line options
-    std::string device_args;
-    double start_freq, stop_freq, step_freq, rate, gain;
-    size_t fft_size, num_averages;
+    std::string device_args, plan_effort_name, wisdom_file, output_format_name;
+    double start_freq, stop_freq, step_freq, rate, gain, settle_ms, overlap, edge_trim;
+    size_t fft_size, num_averages, lookahead, dc_blank;
+    bool sweep = false, panorama = false;
 
     po::options_description desc("Frequency Scanner Options");
     desc.add_options()
@@ -85,6 +211,16 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
         ("gain", po::value<double>(&gain)->default_value(50), "RX gain (dB)")
         ("fft-size", po::value<size_t>(&fft_size)->default_value(2048), "FFT size")
         ("averages", po::value<size_t>(&num_averages)->default_value(10), "Number of averages per frequency")
+        ("plan-effort", po::value<std::string>(&plan_effort_name)->default_value("measure"), "FFTW planner effort (estimate/measure/patient/exhaustive)")
+        ("wisdom-file", po::value<std::string>(&wisdom_file)->default_value(""), "FFTW wisdom cache (default: per-CPU file under ~/.cache/sdr)")
+        ("sweep", po::bool_switch(&sweep), "Continuous-stream sweep with timed retunes")
+        ("settle-ms", po::value<double>(&settle_ms)->default_value(2), "Sweep: samples discarded after each retune (ms)")
+        ("lookahead", po::value<size_t>(&lookahead)->default_value(2), "Sweep: timed retunes queued ahead of the receiver")
+        ("panorama", po::bool_switch(&panorama), "Stitch all steps into one spectrum (ignores --step)")
+        ("overlap", po::value<double>(&overlap)->default_value(0.25), "Panorama: fraction of usable span shared by neighbouring steps")
+        ("edge-trim", po::value<double>(&edge_trim)->default_value(0.1), "Panorama: fraction of the span dropped at each edge")
+        ("dc-blank", po::value<size_t>(&dc_blank)->default_value(2), "Panorama: bins with |k - DC| below this are dropped")
+        ("output-format", po::value<std::string>(&output_format_name)->default_value("json"), "Panorama output: json or binary (float32 spectrum frame)")
     ;
 
     po::variables_map vm;
@@ -96,103 +232,302 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
         return EXIT_SUCCESS;
     }
 
-    std::cout << "[Freq Scanner] Starting..." << std::endl;
-    std::cout << "  Frequency range: " << start_freq / 1e6 << " - " << stop_freq / 1e6 << " MHz" << std::endl;
-    std::cout << "  Step size: " << step_freq / 1e6 << " MHz" << std::endl;
-    std::cout << "  Sample rate: " << rate / 1e6 << " MSPS" << std::endl;
-    std::cout << "  RX gain: " << gain << " dB" << std::endl;
-    std::cout << "  FFT size: " << fft_size << std::endl;
-    std::cout << "  Averages: " << num_averages << std::endl;
+    PlanEffort plan_effort;
+    if (!parse_plan_effort(plan_effort_name, plan_effort)) {
+        std::cerr << "Error: Unknown plan effort '" << plan_effort_name
+                  << "' (estimate/measure/patient/exhaustive)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    OutputFormat output_format;
+    if (!parse_output_format(output_format_name, output_format)) {
+        std::cerr << "Error: Unknown output format '" << output_format_name << "' (json/binary)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (output_format == OutputFormat::Binary && !panorama) {
+        std::cerr << "Error: --output-format binary requires --panorama" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (num_averages < 1) num_averages = 1;
+    if (lookahead < 1) lookahead = 1;
+
+    // Binary output owns stdout
+    std::ostream& console = output_format == OutputFormat::Binary ? std::cerr : std::cout;
+
+    console << "[Freq Scanner] Starting..." << std::endl;
+    console << "  Frequency range: " << start_freq / 1e6 << " - " << stop_freq / 1e6 << " MHz" << std::endl;
+    if (panorama) {
+        console << "  Panorama: " << overlap * 100 << "% overlap, " << edge_trim * 100 << "% edge trim, "
+            << dc_blank << " DC bins blanked" << std::endl;
+    } else {
+        console << "  Step size: " << step_freq / 1e6 << " MHz" << std::endl;
+    }
+    console << "  Sample rate: " << rate / 1e6 << " MSPS" << std::endl;
+    console << "  RX gain: " << gain << " dB" << std::endl;
+    console << "  FFT size: " << fft_size << std::endl;
+    console << "  Averages: " << num_averages << std::endl;
 
     // Create USRP device
-    std::cout << "[Freq Scanner] Creating USRP device..." << std::endl;
-    uhd::usrp::multi_usrp::sptr usrp = uhd::usrp::multi_usrp::make(device_args);
+    console << "[Freq Scanner] Creating USRP device..." << std::endl;
+    RxFrontend::sptr frontend = RxFrontend::make(device_args);
+    if (const ReplaySource* replay = frontend->replay()) {
+        console << "[Freq Scanner] Replaying " << replay->path() << " ("
+                << (replay->paced() ? "paced" : "fast") << ")" << std::endl;
+    }
 
     // Set sample rate
-    usrp->set_rx_rate(rate);
-    double actual_rate = usrp->get_rx_rate();
-    std::cout << "[Freq Scanner] Actual sample rate: " << actual_rate / 1e6 << " MSPS" << std::endl;
+    frontend->set_rx_rate(rate);
+    double actual_rate = frontend->get_rx_rate();
+    console << "[Freq Scanner] Actual sample rate: " << actual_rate / 1e6 << " MSPS" << std::endl;
 
     // Set RX gain
-    usrp->set_rx_gain(gain);
-    double actual_gain = usrp->get_rx_gain();
-    std::cout << "[Freq Scanner] Actual RX gain: " << actual_gain << " dB" << std::endl;
+    frontend->set_rx_gain(gain);
+    double actual_gain = frontend->get_rx_gain();
+    console << "[Freq Scanner] Actual RX gain: " << actual_gain << " dB" << std::endl;
 
     // Set antenna
-    usrp->set_rx_antenna("TX/RX");
+    frontend->set_rx_antenna("TX/RX");
 
     // Create RX streamer
     uhd::stream_args_t stream_args("fc32", "sc16");
-    uhd::rx_streamer::sptr rx_stream = usrp->get_rx_stream(stream_args);
+    frontend->setup_stream(stream_args);
 
-    // Allocate buffer
-    std::vector<std::complex<float>> buffer(fft_size);
+    // One plan and one set of aligned buffers for the whole sweep
+    WisdomStore wisdom(wisdom_file.empty() ? default_wisdom_path() : wisdom_file);
+    wisdom.load();
+    SpectralEngine engine(fft_size, num_averages, plan_effort_flags(plan_effort));
+    wisdom.save();
     uhd::rx_metadata_t md;
 
     // Register signal handler
     std::signal(SIGINT, &sig_int_handler);
 
-    // Calculate number of steps
-    size_t num_steps = static_cast<size_t>((stop_freq - start_freq) / step_freq) + 1;
-    std::cout << "[Freq Scanner] Scanning " << num_steps << " frequencies..." << std::endl;
+    // Calculate the step list; the panorama grid is laid out at the actual rate
+    PanoramaConfig pano_config;
+    pano_config.start_freq = start_freq;
+    pano_config.stop_freq = stop_freq;
+    pano_config.sample_rate = actual_rate;
+    pano_config.fft_size = fft_size;
+    pano_config.overlap = overlap;
+    pano_config.edge_trim = edge_trim;
+    pano_config.dc_blank_bins = dc_blank;
+    PanoramaStitcher stitcher(pano_config);
+
+    std::vector<double> freqs;
+    if (panorama) {
+        freqs = stitcher.plan_steps();
+    } else {
+        for (double freq = start_freq; freq <= stop_freq; freq += step_freq) {
+            freqs.push_back(freq);
+        }
+    }
+    const size_t num_steps = freqs.size();
+    console << "[Freq Scanner] Scanning " << num_steps << " frequencies..." << std::endl;
 
     // Output JSON array start
-    std::cout << "[" << std::endl;
+    if (!panorama) {
+        std::cout << "[" << std::endl;
+    }
 
-    // Scan loop
     size_t step_count = 0;
-    for (double freq = start_freq; freq <= stop_freq && !stop_signal_called; freq += step_freq) {
-        // Tune to frequency
-        uhd::tune_request_t tune_request(freq);
-        usrp->set_rx_freq(tune_request);
-        double actual_freq = usrp->get_rx_freq();
+    auto emit_step = [&](double actual_freq, const SpectralMeasurement& m) {
+        if (panorama) {
+            stitcher.add(actual_freq, engine.averaged_power().data(), m.blocks);
+            step_count++;
+            std::cerr << boost::format("\r[Freq Scanner] Progress: %.1f%% (%zu / %zu)")
+                         % (100.0 * step_count / num_steps) % step_count % num_steps << std::flush;
+            return;
+        }
 
-        // Allow time for frequency to settle
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        double peak_freq = actual_freq + (static_cast<double>(m.peak_bin) - fft_size / 2.0) * actual_rate / fft_size;
 
-        // Start streaming
+        // Output JSON object
+        if (step_count > 0) {
+            std::cout << "," << std::endl;
+        }
+        std::cout << "  {";
+        std::cout << "\"frequency\": " << actual_freq << ", ";
+        std::cout << "\"peak_power_dbm\": " << m.peak_power_db << ", ";
+        std::cout << "\"peak_frequency\": " << peak_freq << ", ";
+        std::cout << "\"avg_power_dbm\": " << m.avg_power_db << ", ";
+        std::cout << "\"noise_floor_dbm\": " << m.noise_floor_db << ", ";
+        std::cout << "\"averages\": " << m.blocks;
+        std::cout << "}";
+
+        step_count++;
+        double progress = 100.0 * step_count / num_steps;
+        std::cerr << boost::format("\r[Freq Scanner] Progress: %.1f%% (%zu / %zu)")
+                     % progress % step_count % num_steps << std::flush;
+    };
+
+    auto scan_start = std::chrono::steady_clock::now();
+
+    if (sweep) {
+        // Timeline: tune k at T_k, keep [T_k + settle, T_k + settle + capture)
+        const double settle_secs = settle_ms / 1000.0;
+        const double capture_secs = static_cast<double>(fft_size * num_averages) / actual_rate;
+        const double period = settle_secs + capture_secs;
+
+        SweepSchedule schedule;
+        schedule.freqs = freqs;
+        schedule.actual_freqs.resize(num_steps);
+        schedule.tune_times.resize(num_steps);
+        schedule.window_start.resize(num_steps);
+
+        SweepCapture prototype;
+        prototype.samples.resize(fft_size * num_averages);
+        prototype.block_fill.resize(num_averages);
+        SweepRing ring(8, prototype);
+
+        SweepReceiveContext rx_ctx;
+        rx_ctx.frontend = frontend;
+        rx_ctx.lossless = frontend->replay() && !frontend->replay()->paced();
+        rx_ctx.ring = &ring;
+        rx_ctx.schedule = &schedule;
+        rx_ctx.fft_size = fft_size;
+        rx_ctx.num_averages = num_averages;
+        rx_ctx.rate = actual_rate;
+
+        size_t late_tunes = 0;
+        auto issue_tune = [&](size_t k) {
+            double t = k == 0 ? frontend->get_time_now().get_real_secs() + 0.05
+                              : schedule.tune_times[k - 1] + period;
+            const double earliest = frontend->get_time_now().get_real_secs() + SWEEP_MIN_LEAD_SECS;
+            if (t < earliest) {
+                // Fell behind: slide the rest of the timeline rather than tune late
+                t = earliest;
+                late_tunes++;
+            }
+            frontend->set_command_time(uhd::time_spec_t(t));
+            frontend->set_rx_freq(uhd::tune_request_t(schedule.freqs[k]));
+            frontend->clear_command_time();
+
+            schedule.actual_freqs[k] = frontend->get_rx_freq();
+            schedule.tune_times[k] = t;
+            schedule.window_start[k] = uhd::time_spec_t(t + settle_secs).to_ticks(actual_rate);
+            schedule.published.store(k + 1, std::memory_order_release);
+        };
+
+        // Stream once for the whole sweep
         uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
         stream_cmd.stream_now = true;
-        rx_stream->issue_stream_cmd(stream_cmd);
+        frontend->issue_stream_cmd(stream_cmd);
+        std::thread rx_thread(sweep_receive_loop, std::ref(rx_ctx));
+
+        size_t next_tune = 0;
+        while (!stop_signal_called) {
+            // Keep `lookahead` timed tunes queued beyond the step being captured
+            const size_t rx_step = rx_ctx.current_step.load(std::memory_order_acquire);
+            while (next_tune < num_steps && next_tune <= rx_step + lookahead - 1) {
+                issue_tune(next_tune++);
+            }
 
-        // Collect averages
-        double avg_peak_power = 0.0;
-        for (size_t avg = 0; avg < num_averages; ++avg) {
-            size_t num_rx_samps = rx_stream->recv(&buffer.front(), buffer.size(), md, 1.0);
+            SweepCapture* capture = ring.acquire_read();
+            if (!capture) {
+                if (rx_ctx.done.load(std::memory_order_acquire) && ring.depth() == 0) break;
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
 
-            if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_NONE && num_rx_samps == fft_size) {
-                double peak_power = compute_peak_power(buffer, fft_size);
-                avg_peak_power += peak_power;
+            // Only complete FFT blocks are averaged
+            size_t valid_blocks = 0;
+            for (size_t b = 0; b < num_averages; b++) {
+                if (capture->block_fill[b] != fft_size) continue;
+                std::copy(capture->samples.begin() + b * fft_size,
+                          capture->samples.begin() + (b + 1) * fft_size,
+                          engine.block(valid_blocks++));
             }
+            const size_t step = capture->step;
+            ring.release_read();
+
+            // -30 dB maps full scale to the dBm-like scale used by the UI
+            emit_step(schedule.actual_freqs[step], engine.measure(valid_blocks, -30.0));
         }
-        avg_peak_power /= num_averages;
 
-        // Stop streaming
+        rx_thread.join();
         stream_cmd.stream_mode = uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS;
-        rx_stream->issue_stream_cmd(stream_cmd);
+        frontend->issue_stream_cmd(stream_cmd);
+
+        std::cerr << std::endl << "[Freq Scanner] Sweep: " << late_tunes << " late retunes, "
+                  << rx_ctx.overflows.load() << " overflows, "
+                  << ring.dropped() << " steps dropped" << std::endl;
+    } else {
+        for (size_t k = 0; k < num_steps && !stop_signal_called && !frontend->finished(); k++) {
+            // Tune to frequency
+            uhd::tune_request_t tune_request(freqs[k]);
+            frontend->set_rx_freq(tune_request);
+            double actual_freq = frontend->get_rx_freq();
+
+            // Allow time for frequency to settle
+            if (frontend->usrp()) std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+            // Start streaming
+            uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+            stream_cmd.stream_now = true;
+            frontend->issue_stream_cmd(stream_cmd);
+
+            // Collect averages straight into the engine's batch; failed reads are skipped
+            size_t valid_blocks = 0;
+            for (size_t avg = 0; avg < num_averages; ++avg) {
+                size_t num_rx_samps = frontend->recv(engine.block(valid_blocks), fft_size, md, 1.0);
+
+                if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_NONE && num_rx_samps == fft_size) {
+                    valid_blocks++;
+                }
+            }
 
-        // Output JSON object
-        std::cout << "  {";
-        std::cout << "\"frequency\": " << actual_freq << ", ";
-        std::cout << "\"peak_power_dbm\": " << avg_peak_power;
-        std::cout << "}";
-        if (freq + step_freq <= stop_freq) {
-            std::cout << ",";
-        }
-        std::cout << std::endl;
+            // Stop streaming
+            stream_cmd.stream_mode = uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS;
+            frontend->issue_stream_cmd(stream_cmd);
 
-        step_count++;
-        double progress = 100.0 * step_count / num_steps;
-        std::cerr << boost::format("\r[Freq Scanner] Progress: %.1f%% (%zu / %zu)") 
-                     % progress % step_count % num_steps << std::flush;
+            // -30 dB maps full scale to the dBm-like scale used by the UI
+            emit_step(actual_freq, engine.measure(valid_blocks, -30.0));
+        }
     }
 
     std::cerr << std::endl;
 
-    // Output JSON array end
-    std::cout << "]" << std::endl;
+    if (panorama) {
+        // -30 dB maps full scale to the dBm-like scale used by the UI
+        std::vector<float> pano_db;
+        const size_t filled = stitcher.finish(pano_db, -30.0);
+        const size_t peak_bin = std::max_element(pano_db.begin(), pano_db.end()) - pano_db.begin();
+
+        if (output_format == OutputFormat::Binary) {
+            SpectrumFrameInfo info;
+            info.timestamp = std::chrono::duration<double>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            info.center_freq = stitcher.center_freq();
+            info.sample_rate = stitcher.span();
+            info.peak_bin = static_cast<uint32_t>(peak_bin);
+            info.peak_power = pano_db[peak_bin];
+            info.flags = SPECTRUM_FLAG_PANORAMA;
+            info.fft_count = static_cast<uint32_t>(stitcher.fft_count());
+            BinaryFrameWriter writer(std::cout, BinPayload::Float32, 0.01f);
+            writer.write_spectrum(info, pano_db.data(), pano_db.size());
+        } else {
+            std::cout << "{\"type\": \"panorama\", ";
+            std::cout << "\"start_freq\": " << stitcher.start_freq() << ", ";
+            std::cout << "\"bin_hz\": " << stitcher.bin_hz() << ", ";
+            std::cout << "\"peak_frequency\": " << stitcher.start_freq() + peak_bin * stitcher.bin_hz() << ", ";
+            std::cout << "\"peak_power_dbm\": " << pano_db[peak_bin] << ", ";
+            std::cout << "\"steps\": " << step_count << ", ";
+            std::cout << "\"bins\": [";
+            for (size_t i = 0; i < pano_db.size(); i++) {
+                if (i > 0) std::cout << ",";
+                std::cout << pano_db[i];
+            }
+            std::cout << "]}" << std::endl;
+        }
+        std::cerr << "[Freq Scanner] Panorama: " << pano_db.size() << " bins at "
+                  << stitcher.bin_hz() << " Hz, " << filled << " interpolated" << std::endl;
+    } else {
+        // Output JSON array end
+        std::cout << std::endl << "]" << std::endl;
+    }
 
-    std::cerr << "[Freq Scanner] Scan complete!" << std::endl;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - scan_start).count();
+    std::cerr << boost::format("[Freq Scanner] Scan complete! %zu steps in %.3f s (%.1f steps/s)")
+                 % step_count % elapsed % (elapsed > 0 ? step_count / elapsed : 0.0) << std::endl;
 
     return EXIT_SUCCESS;
 }
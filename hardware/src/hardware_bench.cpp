@@ -0,0 +1,297 @@
+/**
+ * hardware_bench.cpp - Micro-benchmarks of the daemons' per-spectrum kernels
+ *
+ * Times each hot-path kernel at every --fft-sizes size and, for the
+ * sdr_dsp kernels, on every instruction set this CPU runs (or --isa):
+ *
+ *   window           Hann window apply (every daemon, before each FFT)
+ *   power_db         FFT shift + |X|^2, then log10 (sdr_streamer)
+ *   magnitude        FFT shift + |X|^2, then sqrt (soapy_streamer)
+ *   argmax           Peak bin (sdr_streamer, soapy_streamer binary frames)
+ *   find_peaks       Peak list with 3 dB bandwidths (soapy_scanner, scanner_peaks.hpp)
+ *   measure          SpectralEngine::measure over --averages blocks, the
+ *                    freq_scanner step (window, batched FFT, power, average,
+ *                    peak, median floor); includes copying the samples into
+ *                    the engine, as the scanner does per step
+ *   fft              fftwf_execute alone, for scale
+ *
+ *   ./hardware_bench --fft-sizes 256,4096,65536 --isa avx2,avx512 > bench.json
+ *
+ * Inputs are real spectra of a synthetic signal (synthetic_source.hpp,
+ * --signal), so data-dependent kernels (find_peaks) see realistic peak
+ * counts. Each case is calibrated to run for at least --min-ms, then
+ * timed --repeats times; the median and minimum are reported. Results
+ * carry cpu_signature() so runs from different machines are not compared
+ * by mistake.
+ *
+ * Output: JSON summary on stdout, progress on stderr
+ */
+
+#include <boost/program_options.hpp>
+#include <fftw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dsp_kernels.hpp"
+#include "fftw_wisdom.hpp"
+#include "scanner_peaks.hpp"
+#include "spectral_engine.hpp"
+#include "synthetic_source.hpp"
+
+namespace po = boost::program_options;
+
+static const char* const all_kernels[] = {"window", "power_db", "magnitude", "argmax", "find_peaks", "measure", "fft"};
+
+struct Timing {
+    uint64_t iterations = 0;    // Calls per timed run
+    double median_ns = 0.0;     // Per call
+    double min_ns = 0.0;
+};
+
+// Keeps results observable so the calls are not optimised away
+static volatile size_t sink;
+
+// Doubles the call count until one run lasts min_ms, then times `repeats` runs
+template <typename Fn>
+static Timing time_calls(Fn&& fn, double min_ms, int repeats) {
+    auto run = [&](uint64_t calls) {
+        const auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < calls; i++) fn();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    Timing timing;
+    timing.iterations = 1;
+    while (run(timing.iterations) < min_ms * 1e6 && timing.iterations < (uint64_t(1) << 40)) {
+        timing.iterations *= 2;
+    }
+
+    std::vector<double> per_call;
+    for (int r = 0; r < std::max(1, repeats); r++) {
+        per_call.push_back(run(timing.iterations) / timing.iterations);
+    }
+    std::sort(per_call.begin(), per_call.end());
+    timing.median_ns = per_call[per_call.size() / 2];
+    timing.min_ns = per_call.front();
+    return timing;
+}
+
+static bool parse_list(const std::string& text, std::vector<std::string>& out) {
+    std::istringstream iss(text);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return !out.empty();
+}
+
+static bool wanted(const std::vector<std::string>& list, const std::string& name) {
+    return std::find(list.begin(), list.end(), name) != list.end();
+}
+
+int main(int argc, char* argv[]) {
+    std::string fft_sizes_arg, kernels_arg, isa_arg, signal_spec, plan_effort_arg, wisdom_file;
+    double min_ms, rate;
+    int repeats;
+    size_t averages;
+
+    po::options_description desc("Hardware DSP Benchmark Options");
+    desc.add_options()
+        ("help", "Show help message")
+        ("fft-sizes", po::value<std::string>(&fft_sizes_arg)->default_value("256,512,1024,2048,4096,8192,16384,32768,65536"), "Comma-separated FFT sizes")
+        ("kernels", po::value<std::string>(&kernels_arg)->default_value("window,power_db,magnitude,argmax,find_peaks,measure,fft"), "Comma-separated kernels to time")
+        ("isa", po::value<std::string>(&isa_arg)->default_value("all"), "Instruction sets for the sdr_dsp kernels: all, default (the runtime pick) or a list (scalar,avx2,avx512,neon,sve)")
+        ("min-ms", po::value<double>(&min_ms)->default_value(20.0), "Minimum duration of one timed run")
+        ("repeats", po::value<int>(&repeats)->default_value(5), "Timed runs per case")
+        ("averages", po::value<size_t>(&averages)->default_value(10), "Blocks per measure() call, as freq_scanner --averages")
+        ("rate", po::value<double>(&rate)->default_value(10e6), "Sample rate of the synthetic signal")
+        ("signal", po::value<std::string>(&signal_spec)->default_value("tone:1e5:-20+burst:-2e6:-30:5:50+fm:3e6:-25:75e3:1e3+noise:-60"),
+         "Synthetic signal (see synthetic_source.hpp)")
+        ("plan-effort", po::value<std::string>(&plan_effort_arg)->default_value("measure"), "FFTW planner effort (estimate/measure/patient/exhaustive)")
+        ("wisdom-file", po::value<std::string>(&wisdom_file), "FFTW wisdom cache (default: per-CPU file under ~/.cache/sdr)")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    std::vector<std::string> size_items, kernel_names, isa_names;
+    std::vector<size_t> fft_sizes;
+    PlanEffort plan_effort;
+    if (!parse_list(fft_sizes_arg, size_items) || !parse_list(kernels_arg, kernel_names)
+        || !parse_list(isa_arg, isa_names) || !parse_plan_effort(plan_effort_arg, plan_effort)) {
+        std::cerr << "Error: bad --fft-sizes, --kernels, --isa or --plan-effort (see --help)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    for (const std::string& item : size_items) {
+        char* rest = nullptr;
+        const unsigned long size = std::strtoul(item.c_str(), &rest, 10);
+        if (*rest != '\0' || size < 16) {
+            std::cerr << "Error: bad FFT size '" << item << "' (at least 16)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        fft_sizes.push_back(size);
+    }
+    for (const std::string& name : kernel_names) {
+        if (std::find_if(std::begin(all_kernels), std::end(all_kernels),
+                         [&](const char* k) { return name == k; }) == std::end(all_kernels)) {
+            std::cerr << "Error: unknown kernel '" << name << "'" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Instruction sets to run the sdr_dsp kernels on
+    std::vector<const dsp::Kernels*> tables;
+    const dsp::Isa isas[] = {dsp::Isa::Scalar, dsp::Isa::Avx2, dsp::Isa::Avx512, dsp::Isa::Neon, dsp::Isa::Sve};
+    for (dsp::Isa isa : isas) {
+        const dsp::Kernels* table = dsp::kernels_for(isa);
+        if (!table) continue;
+        if (wanted(isa_names, "all") || wanted(isa_names, table->name)
+            || (wanted(isa_names, "default") && table == &dsp::kernels())) {
+            tables.push_back(table);
+        }
+    }
+    if (tables.empty()) {
+        std::cerr << "Error: none of --isa " << isa_arg << " is available on this CPU" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<SyntheticComponent> components;
+    const std::string signal_error = parse_synthetic_spec(signal_spec, components);
+    if (!signal_error.empty()) {
+        std::cerr << "Error: --signal: " << signal_error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    WisdomStore wisdom(wisdom_file.empty() ? default_wisdom_path() : wisdom_file);
+    wisdom.load();
+    const dsp::Kernels& best = dsp::kernels();
+    std::cerr << "[Hardware Bench] CPU " << cpu_signature() << ", runtime ISA " << best.name << std::endl;
+
+    std::ostringstream results;
+    bool first = true;
+    auto report = [&](const char* kernel, const char* isa, size_t fft_size, size_t samples, const Timing& t) {
+        const double ns_per_sample = t.median_ns / samples;
+        std::cerr << "[Hardware Bench] " << kernel << " " << isa << " " << fft_size << ": "
+                  << t.median_ns << " ns/call, " << ns_per_sample << " ns/sample" << std::endl;
+        if (!first) results << ",";
+        first = false;
+        results << "{\"kernel\":\"" << kernel << "\""
+                << ",\"isa\":\"" << isa << "\""
+                << ",\"fftSize\":" << fft_size
+                << ",\"samples\":" << samples
+                << ",\"iterations\":" << t.iterations
+                << ",\"nsPerCall\":" << t.median_ns
+                << ",\"nsPerCallMin\":" << t.min_ns
+                << ",\"nsPerSample\":" << ns_per_sample
+                << ",\"msps\":" << 1e3 / ns_per_sample << "}";
+    };
+
+    for (size_t n : fft_sizes) {
+        // Input: --averages blocks of the signal, and the spectrum of the
+        // first one the way the daemons produce it
+        SyntheticSource source(components, rate);
+        std::vector<std::complex<float>> iq(n * std::max<size_t>(1, averages));
+        source.read(iq.data(), iq.size());
+
+        std::vector<float> window(n);
+        for (size_t i = 0; i < n; i++) {
+            window[i] = 0.5 * (1.0 - std::cos(2.0 * M_PI * i / (n - 1)));
+        }
+        fftwf_complex* fft_in = fftwf_alloc_complex(n);
+        fftwf_complex* fft_out = fftwf_alloc_complex(n);
+        fftwf_plan plan = fftwf_plan_dft_1d(static_cast<int>(n), fft_in, fft_out, FFTW_FORWARD,
+                                            plan_effort_flags(plan_effort));
+        best.apply_window(reinterpret_cast<const float*>(iq.data()), window.data(),
+                          reinterpret_cast<float*>(fft_in), n);
+        fftwf_execute(plan);
+
+        const float power_scale = 1.0f / (static_cast<float>(n) * n);
+        std::vector<float> power(n), db(n), magnitude(n);
+        std::vector<float> windowed(2 * n);
+        dsp::shifted_power(best, reinterpret_cast<const float*>(fft_out), power.data(), n, power_scale);
+        best.power_to_db(power.data(), db.data(), n, 0.0f);
+        best.magnitude(power.data(), magnitude.data(), n);
+
+        for (const dsp::Kernels* k : tables) {
+            const float* in_iq = reinterpret_cast<const float*>(iq.data());
+            const float* spectrum = reinterpret_cast<const float*>(fft_out);
+            if (wanted(kernel_names, "window")) {
+                report("window", k->name, n, n, time_calls([&] {
+                    k->apply_window(in_iq, window.data(), windowed.data(), n);
+                }, min_ms, repeats));
+            }
+            if (wanted(kernel_names, "power_db")) {
+                std::vector<float> p(n), d(n);
+                report("power_db", k->name, n, n, time_calls([&] {
+                    dsp::shifted_power(*k, spectrum, p.data(), n, power_scale);
+                    k->power_to_db(p.data(), d.data(), n, 0.0f);
+                }, min_ms, repeats));
+            }
+            if (wanted(kernel_names, "magnitude")) {
+                std::vector<float> p(n), m(n);
+                report("magnitude", k->name, n, n, time_calls([&] {
+                    dsp::shifted_power(*k, spectrum, p.data(), n, power_scale);
+                    k->magnitude(p.data(), m.data(), n);
+                }, min_ms, repeats));
+            }
+            if (wanted(kernel_names, "argmax")) {
+                report("argmax", k->name, n, n, time_calls([&] {
+                    sink = k->argmax(db.data(), n);
+                }, min_ms, repeats));
+            }
+        }
+
+        // Plain C++ (built for the baseline ISA) and FFTW
+        if (wanted(kernel_names, "find_peaks")) {
+            report("find_peaks", "generic", n, n, time_calls([&] {
+                sink = find_peaks(magnitude, db, 915e6, rate).size();
+            }, min_ms, repeats));
+        }
+        if (wanted(kernel_names, "measure")) {
+            SpectralEngine engine(n, averages, plan_effort_flags(plan_effort));
+            const size_t blocks = engine.batch();
+            report("measure", best.name, n, n * blocks, time_calls([&] {
+                for (size_t b = 0; b < blocks; b++) {
+                    std::memcpy(engine.block(b), iq.data() + b * n, n * sizeof(std::complex<float>));
+                }
+                sink = engine.measure(blocks, -30.0).peak_bin;
+            }, min_ms, repeats));
+        }
+        if (wanted(kernel_names, "fft")) {
+            report("fft", "fftw", n, n, time_calls([&] {
+                fftwf_execute(plan);
+            }, min_ms, repeats));
+        }
+
+        fftwf_destroy_plan(plan);
+        fftwf_free(fft_in);
+        fftwf_free(fft_out);
+    }
+    wisdom.save();
+
+    std::cout << "{\"cpu\":\"" << cpu_signature() << "\""
+              << ",\"fftw\":\"" << fftwf_version << "\""
+              << ",\"runtimeIsa\":\"" << best.name << "\""
+              << ",\"cores\":" << std::thread::hardware_concurrency()
+              << ",\"minMs\":" << min_ms
+              << ",\"repeats\":" << repeats
+              << ",\"averages\":" << averages
+              << ",\"planEffort\":\"" << plan_effort_name(plan_effort) << "\""
+              << ",\"results\":[" << results.str() << "]}" << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+/**
+ * io_uring_queue.hpp - Minimal io_uring submission/completion queue for file writes
+ *
+ * Just enough of io_uring to keep several O_DIRECT writes in flight from
+ * one thread: queue writes, submit them with one syscall, reap
+ * completions. Talks to the kernel through the raw syscalls and
+ * <linux/io_uring.h>, so there is no liburing dependency; where the
+ * headers or the syscall are missing (old kernels, seccomp-filtered
+ * containers) open() fails and callers fall back to pwrite.
+ *
+ * IORING_OP_WRITE needs Linux 5.6+. Writes rejected by an older kernel
+ * complete with -EINVAL like any other failed write.
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define SDR_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef SDR_HAVE_IO_URING
+
+class IoUringQueue {
+public:
+    IoUringQueue() = default;
+    ~IoUringQueue() { close(); }
+
+    IoUringQueue(const IoUringQueue&) = delete;
+    IoUringQueue& operator=(const IoUringQueue&) = delete;
+
+    // Returns false (with errno set) if io_uring is unavailable
+    bool open(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) return false;
+
+        sq_map_bytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_map_bytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqes_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+
+        sq_map_ = ::mmap(nullptr, sq_map_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd_, IORING_OFF_SQ_RING);
+        cq_map_ = ::mmap(nullptr, cq_map_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd_, IORING_OFF_CQ_RING);
+        sqes_ = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+        if (sq_map_ == MAP_FAILED || cq_map_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+            const int err = errno;
+            close();
+            errno = err;
+            return false;
+        }
+
+        uint8_t* sq = static_cast<uint8_t*>(sq_map_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sq_entries_ = params.sq_entries;
+
+        uint8_t* cq = static_cast<uint8_t*>(cq_map_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void close() {
+        if (sqes_ && sqes_ != MAP_FAILED) ::munmap(sqes_, sqes_bytes_);
+        if (cq_map_ && cq_map_ != MAP_FAILED) ::munmap(cq_map_, cq_map_bytes_);
+        if (sq_map_ && sq_map_ != MAP_FAILED) ::munmap(sq_map_, sq_map_bytes_);
+        sqes_ = nullptr;
+        cq_map_ = sq_map_ = nullptr;
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    bool is_open() const { return fd_ >= 0; }
+
+    // Queues a write; false if the submission queue is full
+    bool prepare_write(int fd, const void* data, uint32_t bytes, uint64_t offset, uint64_t user_data) {
+        const unsigned tail = *sq_tail_;
+        if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) return false;
+
+        const unsigned index = tail & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = bytes;
+        sqe->off = offset;
+        sqe->user_data = user_data;
+        sq_array_[index] = index;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        pending_++;
+        return true;
+    }
+
+    // Submits everything prepared and optionally waits for `wait_for`
+    // completions; returns false on a syscall error other than EINTR
+    bool submit(unsigned wait_for = 0) {
+        const unsigned flags = wait_for ? IORING_ENTER_GETEVENTS : 0;
+        while (true) {
+            const long ret = ::syscall(__NR_io_uring_enter, fd_, pending_, wait_for, flags, nullptr, 0);
+            if (ret >= 0) {
+                pending_ -= static_cast<unsigned>(ret);
+                return true;
+            }
+            if (errno != EINTR) return false;
+        }
+    }
+
+    // Waits for `wait_for` completions without submitting anything
+    bool wait(unsigned wait_for) {
+        while (true) {
+            const long ret = ::syscall(__NR_io_uring_enter, fd_, 0, wait_for, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret >= 0) return true;
+            if (errno != EINTR) return false;
+        }
+    }
+
+    // Prepared writes not yet handed to the kernel
+    unsigned unsubmitted() const { return pending_; }
+
+    // Calls fn(user_data, result) for every available completion
+    template <typename Fn>
+    size_t reap(Fn&& fn) {
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        size_t reaped = 0;
+        for (; head != tail; head++, reaped++) {
+            const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            fn(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return reaped;
+    }
+
+private:
+    int fd_ = -1;
+    void* sq_map_ = nullptr;
+    void* cq_map_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sq_map_bytes_ = 0;
+    size_t cq_map_bytes_ = 0;
+    size_t sqes_bytes_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned pending_ = 0;
+
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+#else
+
+// Stand-in for platforms without io_uring: never opens
+class IoUringQueue {
+public:
+    bool open(unsigned) { errno = ENOSYS; return false; }
+    void close() {}
+    bool is_open() const { return false; }
+    bool prepare_write(int, const void*, uint32_t, uint64_t, uint64_t) { return false; }
+    bool submit(unsigned = 0) { return false; }
+    bool wait(unsigned) { return false; }
+    unsigned unsubmitted() const { return 0; }
+    template <typename Fn>
+    size_t reap(Fn&&) { return 0; }
+};
+
+#endif
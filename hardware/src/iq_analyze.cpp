@@ -0,0 +1,537 @@
+/**
+ * iq_analyze.cpp - Offline spectral analysis of recorded IQ files
+ *
+ * Re-analyses a recording from iq_recorder/soapy_recorder at any FFT size
+ * and overlap, as fast as the machine allows rather than at the capture
+ * rate:
+ *
+ *   ./iq_analyze recording.sigmf-data --fft 4096 --overlap 75 --row-ffts 32
+ *   ./iq_analyze capture.dat --rate 10e6 --format ci16 --channel 1.5e6:200e3 --peaks 10
+ *   ./iq_analyze recording.sigmf-data --output-format binary --output rec.spfr
+ *
+ * The file is mmapped and cut into spectrogram rows of --row-ffts FFTs
+ * (hop = fft * (1 - overlap / 100), as in sdr_streamer), which a pool of
+ * --threads workers claims in order. Each worker owns a SpectralEngine with
+ * sdr_streamer's Hann window and power scaling (spectrum_window.hpp), so
+ * rows read the same dB as the live stream of the same signal, and
+ * converts samples straight from the mapping into its FFT input. Rows are written
+ * in order as they complete; workers never run more than a few rows ahead
+ * of the writer, so memory use does not grow with the file.
+ *
+ * Format, rate and centre frequency come from the .sigmf-meta next to a
+ * .sigmf-data, else from --format/--rate/--freq (which also override it).
+ *
+ * Output, line-delimited JSON on stdout (or --output):
+ *   {"type":"info", ...}                  analysis parameters
+ *   {"type":"fft", ...,"data":[dB...]}    one per spectrogram row, as sdr_streamer
+ *   {"type":"spectrum","average":[...],"maxHold":[...]}  whole range, dBFS
+ *   {"type":"peaks","noiseFloor":..,"peaks":[{frequency,bin,power,snr,bandwidth}]}
+ *   {"type":"channels","channels":[{offset,bandwidth,power}]}
+ *   {"type":"summary", ...}               samples, seconds, throughput
+ *
+ * --output-format binary writes the spectrum frame protocol
+ * (spectrum_frame.hpp) instead: rows as spectrum frames timestamped in
+ * seconds from the first analysed sample, the average and max-hold spectra
+ * flagged SPECTRUM_FLAG_AVERAGE (| SPECTRUM_FLAG_MAX_HOLD), and the other
+ * records as JSON record frames.
+ */
+
+#include <boost/program_options.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "control_channel.hpp"
+#include "dsp_kernels.hpp"
+#include "fftw_wisdom.hpp"
+#include "sample_format.hpp"
+#include "sigmf.hpp"
+#include "spectral_engine.hpp"
+#include "spectrum_frame.hpp"
+
+namespace po = boost::program_options;
+
+namespace {
+
+struct Channel {
+    double offset = 0.0;      // Hz from the centre frequency
+    double bandwidth = 0.0;
+    size_t first_bin = 0;     // Shifted bins [first_bin, last_bin]
+    size_t last_bin = 0;
+};
+
+struct Peak {
+    size_t bin = 0;
+    float power_db = 0.0f;
+    float bandwidth_hz = 0.0f;  // -3 dB width
+};
+
+// One spectrogram row, filled by a worker and emitted in order
+struct RowSlot {
+    uint64_t row = UINT64_MAX;   // Row held, UINT64_MAX while free
+    bool ready = false;
+    size_t ffts = 0;
+    size_t peak_bin = 0;
+    std::vector<float> db;
+    std::vector<float> channel_db;
+};
+
+// Per-worker totals over every FFT, merged at the end
+struct Totals {
+    std::vector<double> sum;
+    std::vector<float> max;
+    uint64_t ffts = 0;
+};
+
+bool parse_channel(const std::string& text, Channel& channel) {
+    const size_t colon = text.find(':');
+    if (colon == std::string::npos) return false;
+    try {
+        channel.offset = std::stod(text.substr(0, colon));
+        channel.bandwidth = std::stod(text.substr(colon + 1));
+    } catch (const std::exception&) {
+        return false;
+    }
+    return channel.bandwidth > 0;
+}
+
+// Summed bin powers over the channel, corrected for the window's noise
+// bandwidth and scaling (SpectralEngine::band_divisor()), in dBFS
+float channel_power_db(const float* power, const Channel& channel, double band_divisor) {
+    double sum = 0.0;
+    for (size_t k = channel.first_bin; k <= channel.last_bin; k++) sum += power[k];
+    return static_cast<float>(10.0 * std::log10(sum / band_divisor + 1e-20));
+}
+
+// Local maxima at least `threshold_db` above `floor_db`, strongest first
+std::vector<Peak> find_peaks(const std::vector<float>& db, float floor_db, float threshold_db, size_t max_peaks,
+                             double bin_hz) {
+    std::vector<Peak> peaks;
+    const size_t n = db.size();
+    for (size_t k = 1; k + 1 < n; k++) {
+        if (db[k] < floor_db + threshold_db || db[k] <= db[k - 1] || db[k] < db[k + 1]) continue;
+        size_t lo = k, hi = k;
+        while (lo > 0 && db[lo - 1] > db[k] - 3.0f) lo--;
+        while (hi + 1 < n && db[hi + 1] > db[k] - 3.0f) hi++;
+        peaks.push_back({k, db[k], static_cast<float>((hi - lo + 1) * bin_hz)});
+    }
+    std::sort(peaks.begin(), peaks.end(), [](const Peak& a, const Peak& b) { return a.power_db > b.power_db; });
+    if (peaks.size() > max_peaks) peaks.resize(max_peaks);
+    return peaks;
+}
+
+void append_array(std::ostream& out, const float* values, size_t n) {
+    out << "[";
+    for (size_t i = 0; i < n; i++) {
+        if (i) out << ",";
+        out << values[i];
+    }
+    out << "]";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string input, output, format_name, output_format_name, payload_name;
+    double rate, freq, overlap, start_sample, count, peak_threshold;
+    size_t fft_size, row_ffts, max_peaks;
+    unsigned threads;
+    std::vector<std::string> channel_specs;
+
+    po::options_description desc("IQ Analyze Options");
+    desc.add_options()
+        ("help", "Show help message")
+        ("input", po::value<std::string>(&input), "Recording (.sigmf-data or raw interleaved IQ)")
+        ("format", po::value<std::string>(&format_name), "Sample format: cf32, ci16 or ci8 (default: from .sigmf-meta, else cf32)")
+        ("rate", po::value<double>(&rate)->default_value(0), "Sample rate (Hz; default: from .sigmf-meta)")
+        ("freq", po::value<double>(&freq)->default_value(0), "Centre frequency (Hz; default: from .sigmf-meta)")
+        ("fft", po::value<size_t>(&fft_size)->default_value(1024), "FFT size")
+        ("overlap", po::value<double>(&overlap)->default_value(50), "FFT overlap (%, 0-95)")
+        ("row-ffts", po::value<size_t>(&row_ffts)->default_value(64), "FFTs averaged per spectrogram row (0 = no spectrogram)")
+        ("start-sample", po::value<double>(&start_sample)->default_value(0), "First sample to analyse")
+        ("count", po::value<double>(&count)->default_value(0), "Samples to analyse (0 = to the end)")
+        ("peaks", po::value<size_t>(&max_peaks)->default_value(20), "Peaks to report from the average spectrum")
+        ("peak-threshold", po::value<double>(&peak_threshold)->default_value(10), "Peaks must be this far above the median floor (dB)")
+        ("channel", po::value<std::vector<std::string>>(&channel_specs)->composing(), "Channel power over OFFSET:BW (Hz, offset from centre); repeatable")
+        ("threads", po::value<unsigned>(&threads)->default_value(0), "Worker threads (0 = one per core)")
+        ("output-format", po::value<std::string>(&output_format_name)->default_value("json"), "Output format: json or binary")
+        ("bin-format", po::value<std::string>(&payload_name)->default_value("float32"), "Binary bin payload: float32 or int16 (centi-dB)")
+        ("output", po::value<std::string>(&output), "Write results here instead of stdout")
+    ;
+    po::positional_options_description positional;
+    positional.add("input", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help") || input.empty()) {
+        std::cout << "Usage: iq_analyze <recording> [options]" << std::endl << desc << std::endl;
+        return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // The .sigmf-meta describes the data; the command line overrides it
+    std::string datatype;
+    double meta_rate = 0.0, meta_freq = 0.0;
+    const bool have_meta = read_sigmf_core(sigmf_meta_path(input), datatype, meta_rate, meta_freq);
+    SampleFormat format = SampleFormat::Cf32;
+    if (!format_name.empty()) {
+        if (!parse_sample_format(format_name, format)) {
+            std::cerr << "[IQ Analyze] ERROR: Unknown sample format '" << format_name << "' (cf32/ci16/ci8)" << std::endl;
+            return EXIT_FAILURE;
+        }
+    } else if (have_meta && !datatype.empty() && !parse_sigmf_datatype(datatype, format)) {
+        std::cerr << "[IQ Analyze] ERROR: Unsupported SigMF datatype '" << datatype << "'" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (rate <= 0) rate = meta_rate;
+    if (!vm.count("freq") || vm["freq"].defaulted()) freq = meta_freq;
+    if (rate <= 0) {
+        std::cerr << "[IQ Analyze] ERROR: No sample rate: pass --rate or keep the .sigmf-meta next to the data" << std::endl;
+        return EXIT_FAILURE;
+    }
+    OutputFormat output_format;
+    BinPayload payload;
+    if (!parse_output_format(output_format_name, output_format) || !parse_bin_payload(payload_name, payload)) {
+        std::cerr << "[IQ Analyze] ERROR: Unknown output format '" << output_format_name << "' / '"
+                  << payload_name << "'" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (fft_size < 16 || overlap < 0.0 || overlap > 95.0) {
+        std::cerr << "[IQ Analyze] ERROR: --fft must be at least 16 and --overlap within 0-95%" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Channel> channels;
+    for (const std::string& spec : channel_specs) {
+        Channel channel;
+        if (!parse_channel(spec, channel)) {
+            std::cerr << "[IQ Analyze] ERROR: --channel wants OFFSET:BW in Hz, got '" << spec << "'" << std::endl;
+            return EXIT_FAILURE;
+        }
+        // Bins whose centres fall inside the channel, at least the nearest one
+        const double bins_per_hz = fft_size / rate;
+        const double centre = fft_size / 2.0;
+        const double lo = std::ceil((channel.offset - channel.bandwidth / 2) * bins_per_hz + centre);
+        const double hi = std::floor((channel.offset + channel.bandwidth / 2) * bins_per_hz + centre);
+        const double nearest = std::round(channel.offset * bins_per_hz + centre);
+        const double last = fft_size - 1.0;
+        channel.first_bin = static_cast<size_t>(std::min(last, std::max(0.0, hi < lo ? nearest : lo)));
+        channel.last_bin = static_cast<size_t>(std::min(last, std::max(0.0, hi < lo ? nearest : hi)));
+        channels.push_back(channel);
+    }
+
+    // Map the recording; workers read it in rising order
+    const int fd = ::open(input.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "[IQ Analyze] ERROR: Could not open " << input << ": " << std::strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        std::cerr << "[IQ Analyze] ERROR: Could not stat " << input << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return EXIT_FAILURE;
+    }
+    const size_t sample_bytes = sample_format_bytes(format);
+    const uint64_t file_samples = static_cast<uint64_t>(st.st_size) / sample_bytes;
+    const uint64_t first = static_cast<uint64_t>(start_sample);
+    uint64_t samples = first < file_samples ? file_samples - first : 0;
+    if (count > 0) samples = std::min(samples, static_cast<uint64_t>(count));
+    if (samples < fft_size) {
+        std::cerr << "[IQ Analyze] ERROR: " << samples << " samples to analyse, fewer than one FFT" << std::endl;
+        ::close(fd);
+        return EXIT_FAILURE;
+    }
+    void* map = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "[IQ Analyze] ERROR: Could not map " << input << ": " << std::strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+    ::madvise(map, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    const uint8_t* data = static_cast<const uint8_t*>(map) + first * sample_bytes;
+
+    const size_t hop = std::max<size_t>(1, static_cast<size_t>(std::llround(fft_size * (1.0 - overlap / 100.0))));
+    const uint64_t total_ffts = (samples - fft_size) / hop + 1;
+    const bool spectrogram = row_ffts > 0;
+    // Without a spectrogram the work is still cut into rows, just not emitted
+    const size_t unit_ffts = spectrogram ? row_ffts : 256;
+    const uint64_t units = (total_ffts + unit_ffts - 1) / unit_ffts;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<uint64_t>(threads, units));
+
+    // Plans are made here, one engine per worker: FFTW's planner is not
+    // thread-safe, fftwf_execute on separate plans is
+    WisdomStore wisdom;
+    wisdom.load();
+    std::vector<std::unique_ptr<SpectralEngine>> engines;
+    for (unsigned t = 0; t < threads; t++) {
+        engines.push_back(std::make_unique<SpectralEngine>(fft_size, unit_ffts, FFTW_MEASURE,
+                                                            SpectrumWindow::Streamer));
+    }
+    wisdom.save();
+    const double band_divisor = engines[0]->band_divisor();
+
+    std::ofstream file_out;
+    if (!output.empty()) {
+        file_out.open(output, std::ios::binary);
+        if (!file_out.is_open()) {
+            std::cerr << "[IQ Analyze] ERROR: Could not open " << output << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream& out = output.empty() ? std::cout : file_out;
+    BinaryFrameWriter frame_writer(out, payload, 0.01f);
+    auto emit_record = [&](const std::string& record) {
+        if (output_format == OutputFormat::Binary) {
+            frame_writer.write_record(record);
+        } else {
+            out << record << "\n";
+        }
+    };
+
+    {
+        std::ostringstream info;
+        info << "{\"type\":\"info\",\"file\":\"" << json_escape(input) << "\""
+             << ",\"format\":\"" << sample_format_name(format) << "\""
+             << ",\"sampleRate\":" << rate
+             << ",\"centerFreq\":" << freq
+             << ",\"fftSize\":" << fft_size
+             << ",\"hop\":" << hop
+             << ",\"rowFfts\":" << row_ffts
+             << ",\"startSample\":" << first
+             << ",\"samples\":" << samples
+             << ",\"ffts\":" << total_ffts
+             << ",\"rows\":" << (spectrogram ? units : 0)
+             << ",\"threads\":" << threads
+             << ",\"isa\":\"" << dsp::kernels().name << "\"}";
+        emit_record(info.str());
+    }
+
+    // Workers claim rows in order but stay within `window` rows of the
+    // writer, each into slot row % window
+    const size_t window = 4 * threads;
+    std::vector<RowSlot> slots(window);
+    for (RowSlot& slot : slots) {
+        slot.db.resize(fft_size);
+        slot.channel_db.resize(channels.size());
+    }
+    std::vector<Totals> totals(threads);
+    std::mutex mutex;
+    std::condition_variable slot_free, slot_ready;
+    uint64_t next_unit = 0;
+    uint64_t emitted = 0;
+
+    auto worker = [&](unsigned t) {
+        SpectralEngine& engine = *engines[t];
+        const dsp::Kernels& kernels = dsp::kernels();
+        Totals& total = totals[t];
+        total.sum.assign(fft_size, 0.0);
+        total.max.assign(fft_size, 0.0f);
+        while (true) {
+            uint64_t unit;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                slot_free.wait(lock, [&] { return next_unit >= units || next_unit < emitted + window; });
+                if (next_unit >= units) return;
+                unit = next_unit++;
+            }
+
+            const uint64_t first_fft = unit * unit_ffts;
+            const size_t ffts = static_cast<size_t>(std::min<uint64_t>(unit_ffts, total_ffts - first_fft));
+            for (size_t b = 0; b < ffts; b++) {
+                samples_to_cf32(data, static_cast<size_t>((first_fft + b) * hop), fft_size, format,
+                                reinterpret_cast<float*>(engine.block(b)));
+            }
+            const SpectralMeasurement m = engine.measure(ffts);
+            const std::vector<float>& mean = engine.averaged_power();
+            const std::vector<float>& held = engine.max_power();
+            for (size_t k = 0; k < fft_size; k++) {
+                total.sum[k] += static_cast<double>(mean[k]) * ffts;
+                total.max[k] = std::max(total.max[k], held[k]);
+            }
+            total.ffts += ffts;
+
+            RowSlot& slot = slots[unit % window];
+            if (spectrogram) {
+                kernels.power_to_db(mean.data(), slot.db.data(), fft_size, 0.0f);
+                for (size_t c = 0; c < channels.size(); c++) {
+                    slot.channel_db[c] = channel_power_db(mean.data(), channels[c], band_divisor);
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slot.row = unit;
+                slot.ffts = ffts;
+                slot.peak_bin = m.peak_bin;
+                slot.ready = true;
+            }
+            slot_ready.notify_all();
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) pool.emplace_back(worker, t);
+
+    // Emit rows in order as they complete
+    std::ostringstream record;
+    for (uint64_t row = 0; row < units; row++) {
+        RowSlot& slot = slots[row % window];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slot_ready.wait(lock, [&] { return slot.ready && slot.row == row; });
+        }
+        if (spectrogram) {
+            const double time = static_cast<double>(row * unit_ffts * hop) / rate;
+            if (output_format == OutputFormat::Binary) {
+                SpectrumFrameInfo info;
+                info.timestamp = time;
+                info.center_freq = freq;
+                info.sample_rate = rate;
+                info.peak_bin = static_cast<uint32_t>(slot.peak_bin);
+                info.peak_power = slot.db[slot.peak_bin];
+                info.fft_count = static_cast<uint32_t>(slot.ffts);
+                frame_writer.write_spectrum(info, slot.db.data(), fft_size);
+                if (!channels.empty()) {
+                    record.str("");
+                    record << "{\"type\":\"channelPower\",\"timestamp\":" << time << ",\"power\":";
+                    append_array(record, slot.channel_db.data(), channels.size());
+                    record << "}";
+                    frame_writer.write_record(record.str());
+                }
+            } else {
+                out << "{\"type\":\"fft\",\"timestamp\":" << time
+                    << ",\"centerFreq\":" << freq
+                    << ",\"sampleRate\":" << rate
+                    << ",\"fftSize\":" << fft_size
+                    << ",\"peakPower\":" << slot.db[slot.peak_bin]
+                    << ",\"peakBin\":" << slot.peak_bin
+                    << ",\"fftCount\":" << slot.ffts;
+                if (!channels.empty()) {
+                    out << ",\"channelPower\":";
+                    append_array(out, slot.channel_db.data(), channels.size());
+                }
+                out << ",\"data\":";
+                append_array(out, slot.db.data(), fft_size);
+                out << "}\n";
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.ready = false;
+            emitted = row + 1;
+        }
+        slot_free.notify_all();
+    }
+    for (std::thread& thread : pool) thread.join();
+    ::munmap(map, static_cast<size_t>(st.st_size));
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Whole-range average and max hold from the workers' totals
+    std::vector<float> average(fft_size, 0.0f), max_hold(fft_size, 0.0f);
+    uint64_t ffts_done = 0;
+    for (const Totals& total : totals) ffts_done += total.ffts;
+    for (const Totals& total : totals) {
+        for (size_t k = 0; k < fft_size; k++) {
+            average[k] += static_cast<float>(total.sum[k] / ffts_done);
+            max_hold[k] = std::max(max_hold[k], total.max[k]);
+        }
+    }
+    const dsp::Kernels& kernels = dsp::kernels();
+    std::vector<float> average_db(fft_size), max_db(fft_size);
+    kernels.power_to_db(average.data(), average_db.data(), fft_size, 0.0f);
+    kernels.power_to_db(max_hold.data(), max_db.data(), fft_size, 0.0f);
+
+    std::vector<float> sorted = average_db;
+    std::nth_element(sorted.begin(), sorted.begin() + fft_size / 2, sorted.end());
+    const float floor_db = sorted[fft_size / 2];
+    const double bin_hz = rate / fft_size;
+    const std::vector<Peak> peaks = find_peaks(average_db, floor_db, static_cast<float>(peak_threshold), max_peaks, bin_hz);
+    const size_t peak_bin = kernels.argmax(average_db.data(), fft_size);
+
+    if (output_format == OutputFormat::Binary) {
+        SpectrumFrameInfo info;
+        info.timestamp = 0.0;
+        info.center_freq = freq;
+        info.sample_rate = rate;
+        info.fft_count = static_cast<uint32_t>(std::min<uint64_t>(ffts_done, UINT32_MAX));
+        info.flags = SPECTRUM_FLAG_AVERAGE;
+        info.peak_bin = static_cast<uint32_t>(peak_bin);
+        info.peak_power = average_db[peak_bin];
+        frame_writer.write_spectrum(info, average_db.data(), fft_size);
+        info.flags = SPECTRUM_FLAG_AVERAGE | SPECTRUM_FLAG_MAX_HOLD;
+        info.peak_bin = static_cast<uint32_t>(kernels.argmax(max_db.data(), fft_size));
+        info.peak_power = max_db[info.peak_bin];
+        frame_writer.write_spectrum(info, max_db.data(), fft_size);
+    } else {
+        out << "{\"type\":\"spectrum\",\"centerFreq\":" << freq
+            << ",\"sampleRate\":" << rate
+            << ",\"fftSize\":" << fft_size
+            << ",\"fftCount\":" << ffts_done
+            << ",\"peakPower\":" << average_db[peak_bin]
+            << ",\"peakBin\":" << peak_bin
+            << ",\"average\":";
+        append_array(out, average_db.data(), fft_size);
+        out << ",\"maxHold\":";
+        append_array(out, max_db.data(), fft_size);
+        out << "}\n";
+    }
+
+    record.str("");
+    record << "{\"type\":\"peaks\",\"noiseFloor\":" << floor_db << ",\"peaks\":[";
+    for (size_t i = 0; i < peaks.size(); i++) {
+        const Peak& p = peaks[i];
+        record << (i ? "," : "") << "{\"frequency\":" << freq + (static_cast<double>(p.bin) - fft_size / 2.0) * bin_hz
+               << ",\"bin\":" << p.bin
+               << ",\"power\":" << p.power_db
+               << ",\"snr\":" << p.power_db - floor_db
+               << ",\"bandwidth\":" << p.bandwidth_hz << "}";
+    }
+    record << "]}";
+    emit_record(record.str());
+
+    if (!channels.empty()) {
+        record.str("");
+        record << "{\"type\":\"channels\",\"channels\":[";
+        for (size_t c = 0; c < channels.size(); c++) {
+            record << (c ? "," : "") << "{\"offset\":" << channels[c].offset
+                   << ",\"bandwidth\":" << channels[c].bandwidth
+                   << ",\"bins\":" << channels[c].last_bin - channels[c].first_bin + 1
+                   << ",\"power\":" << channel_power_db(average.data(), channels[c], band_divisor) << "}";
+        }
+        record << "]}";
+        emit_record(record.str());
+    }
+
+    record.str("");
+    record << "{\"type\":\"summary\",\"samples\":" << samples
+           << ",\"ffts\":" << ffts_done
+           << ",\"seconds\":" << seconds
+           << ",\"msps\":" << (seconds > 0 ? samples / 1e6 / seconds : 0.0)
+           << ",\"mbps\":" << (seconds > 0 ? samples * sample_bytes / 1e6 / seconds : 0.0) << "}";
+    emit_record(record.str());
+    out.flush();
+
+    std::cerr << "[IQ Analyze] " << samples << " samples, " << ffts_done << " FFTs in " << seconds << " s ("
+              << (seconds > 0 ? samples * sample_bytes / 1e6 / seconds : 0.0) << " MB/s, " << threads
+              << " threads)" << std::endl;
+    return out.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
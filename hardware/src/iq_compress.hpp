@@ -0,0 +1,778 @@
+/**
+ * iq_compress.hpp - Multi-threaded lossless block compression for recordings
+ *
+ * --compress splits the recorded stream into independent blocks
+ * (--compress-block-kb of raw samples). A worker pool transforms and
+ * compresses them in parallel and one thread appends them, in order, to
+ * the segment's AsyncFileWriter, so the disk backends and segmentation
+ * work unchanged underneath.
+ *
+ * Transforms (lossless, per block, chosen to suit the codec):
+ *
+ *   shuffle  byte planes: all low bytes, then all high bytes, ... of each
+ *            I/Q value. The high bytes of a 12-bit converter's ci16
+ *            samples (or the exponent bytes of cf32) are nearly constant
+ *            and compress well once grouped.
+ *   delta    per-channel difference to the previous I (or Q) value, then
+ *            shuffle; helps oversampled, narrowband captures. cf32 uses
+ *            XOR of the bit patterns so it stays exact.
+ *   none     codec only
+ *
+ * Codecs: zstd (levels 1..19) and lz4 (level = acceleration), when built
+ * with them (SDR_HAVE_ZSTD / SDR_HAVE_LZ4 from CMake), plus "none". A block
+ * that does not shrink is stored raw, so the output is never much bigger
+ * than the input.
+ *
+ * File layout (.iqz, little-endian):
+ *
+ *   IqzHeader                      magic, format, codec/transform, block size
+ *   { IqzBlockHeader, payload }*   one per block, self-describing
+ *   IqzIndexEntry[blocks]          file/raw offset and sizes of every block
+ *   IqzTrailer                     index offset and totals
+ *
+ * The index makes the file seekable: IqzReader decodes only the blocks a
+ * sample range touches. A file whose recording was cut short has no
+ * trailer; the reader then rebuilds the index by walking block headers.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef SDR_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef SDR_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#include "async_writer.hpp"
+#include "sample_format.hpp"
+
+enum class IqCodec : uint8_t { None = 0, Lz4 = 1, Zstd = 2 };
+enum class IqTransform : uint8_t { None = 0, Shuffle = 1, Delta = 2 };
+
+inline const char* iq_codec_name(IqCodec codec) {
+    switch (codec) {
+    case IqCodec::None: return "none";
+    case IqCodec::Lz4: return "lz4";
+    case IqCodec::Zstd: return "zstd";
+    }
+    return "none";
+}
+
+inline bool iq_codec_available(IqCodec codec) {
+    switch (codec) {
+    case IqCodec::None: return true;
+#ifdef SDR_HAVE_LZ4
+    case IqCodec::Lz4: return true;
+#endif
+#ifdef SDR_HAVE_ZSTD
+    case IqCodec::Zstd: return true;
+#endif
+    default: return false;
+    }
+}
+
+// "zstd", "zstd:5", "lz4", "lz4:8" (acceleration) or "none"
+inline bool parse_iq_codec(const std::string& text, IqCodec& codec, int& level) {
+    const size_t colon = text.find(':');
+    const std::string name = text.substr(0, colon);
+    if (name == "zstd") { codec = IqCodec::Zstd; level = 1; }
+    else if (name == "lz4") { codec = IqCodec::Lz4; level = 1; }
+    else if (name == "none") { codec = IqCodec::None; level = 0; }
+    else return false;
+    if (colon != std::string::npos) {
+        char* end = nullptr;
+        level = static_cast<int>(std::strtol(text.c_str() + colon + 1, &end, 10));
+        if (!end || *end != '\0') return false;
+    }
+    return true;
+}
+
+inline const char* iq_transform_name(IqTransform transform) {
+    switch (transform) {
+    case IqTransform::None: return "none";
+    case IqTransform::Shuffle: return "shuffle";
+    case IqTransform::Delta: return "delta";
+    }
+    return "none";
+}
+
+inline bool parse_iq_transform(const std::string& name, IqTransform& transform) {
+    if (name == "none") { transform = IqTransform::None; return true; }
+    if (name == "shuffle") { transform = IqTransform::Shuffle; return true; }
+    if (name == "delta") { transform = IqTransform::Delta; return true; }
+    return false;
+}
+
+// Bytes per I or Q value: what shuffle splits into planes
+inline size_t iq_element_bytes(SampleFormat format) {
+    return sample_format_bytes(format) / 2;
+}
+
+inline uint8_t iq_format_code(SampleFormat format) {
+    return static_cast<uint8_t>(format);
+}
+
+inline SampleFormat iq_format_from_code(uint8_t code) {
+    return code == 1 ? SampleFormat::Ci16 : code == 2 ? SampleFormat::Ci8 : SampleFormat::Cf32;
+}
+
+// ---------------------------------------------------------------------------
+// File format
+
+constexpr char IQZ_MAGIC[8] = {'S', 'D', 'R', 'I', 'Q', 'Z', '1', '\0'};
+constexpr char IQZ_TRAILER_MAGIC[8] = {'I', 'Q', 'Z', 'I', 'N', 'D', 'X', '\0'};
+constexpr uint32_t IQZ_BLOCK_MAGIC = 0x314B4C42;  // "BLK1"
+
+struct IqzHeader {
+    char magic[8];
+    double sample_rate;
+    uint32_t version;
+    uint8_t format;         // SampleFormat
+    uint8_t codec;          // IqCodec requested
+    uint8_t transform;      // IqTransform requested
+    int8_t level;
+    uint32_t block_bytes;   // Raw bytes per block (the last may be shorter)
+    uint8_t reserved[36];
+};
+static_assert(sizeof(IqzHeader) == 64, "IqzHeader must be 64 bytes");
+
+struct IqzBlockHeader {
+    uint32_t magic;
+    uint32_t stored_bytes;  // Payload size
+    uint32_t raw_bytes;
+    uint8_t codec;          // As stored: None if compression did not help
+    uint8_t transform;
+    uint16_t reserved;
+};
+static_assert(sizeof(IqzBlockHeader) == 16, "IqzBlockHeader must be 16 bytes");
+
+struct IqzIndexEntry {
+    uint64_t file_offset;   // Of the block header
+    uint64_t raw_offset;    // Of the block's first byte in the raw stream
+    uint32_t stored_bytes;
+    uint32_t raw_bytes;
+};
+static_assert(sizeof(IqzIndexEntry) == 24, "IqzIndexEntry must be 24 bytes");
+
+struct IqzTrailer {
+    uint64_t index_offset;
+    uint64_t blocks;
+    uint64_t raw_bytes;
+    char magic[8];
+};
+static_assert(sizeof(IqzTrailer) == 32, "IqzTrailer must be 32 bytes");
+
+// recording.sigmf-data -> recording.iqz (the .sigmf-meta keeps the
+// original name and describes the decompressed data)
+inline std::string iqz_path(const std::string& data_path) {
+    static const std::string data_ext = ".sigmf-data";
+    if (data_path.size() > data_ext.size()
+        && data_path.compare(data_path.size() - data_ext.size(), data_ext.size(), data_ext) == 0) {
+        return data_path.substr(0, data_path.size() - data_ext.size()) + ".iqz";
+    }
+    return data_path + ".iqz";
+}
+
+// recording.iqz -> recording.sigmf-data, where iq_decompress restores it
+inline std::string iqz_data_path(const std::string& iqz) {
+    static const std::string ext = ".iqz";
+    if (iqz.size() > ext.size() && iqz.compare(iqz.size() - ext.size(), ext.size(), ext) == 0) {
+        return iqz.substr(0, iqz.size() - ext.size()) + ".sigmf-data";
+    }
+    return iqz + ".sigmf-data";
+}
+
+// ---------------------------------------------------------------------------
+// Transforms
+
+namespace iqz_detail {
+
+template <typename T>
+inline void delta_encode(T* values, size_t count) {
+    for (size_t i = count; i-- > 2;) values[i] = static_cast<T>(values[i] - values[i - 2]);
+}
+
+template <typename T>
+inline void delta_decode(T* values, size_t count) {
+    for (size_t i = 2; i < count; i++) values[i] = static_cast<T>(values[i] + values[i - 2]);
+}
+
+inline void xor_encode(uint32_t* values, size_t count) {
+    for (size_t i = count; i-- > 2;) values[i] ^= values[i - 2];
+}
+
+inline void xor_decode(uint32_t* values, size_t count) {
+    for (size_t i = 2; i < count; i++) values[i] ^= values[i - 2];
+}
+
+template <size_t E>
+inline void shuffle(const uint8_t* in, uint8_t* out, size_t count) {
+    for (size_t b = 0; b < E; b++) {
+        uint8_t* plane = out + b * count;
+        for (size_t i = 0; i < count; i++) plane[i] = in[i * E + b];
+    }
+}
+
+template <size_t E>
+inline void unshuffle(const uint8_t* in, uint8_t* out, size_t count) {
+    for (size_t b = 0; b < E; b++) {
+        const uint8_t* plane = in + b * count;
+        for (size_t i = 0; i < count; i++) out[i * E + b] = plane[i];
+    }
+}
+
+}  // namespace iqz_detail
+
+// in -> out (same size). `in` is used as scratch for delta.
+inline void iq_forward_transform(uint8_t* in, uint8_t* out, size_t bytes, size_t element_bytes,
+                                 IqTransform transform) {
+    using namespace iqz_detail;
+    const size_t count = bytes / element_bytes;
+    if (transform == IqTransform::Delta) {
+        switch (element_bytes) {
+        case 1: delta_encode(reinterpret_cast<uint8_t*>(in), count); break;
+        case 2: delta_encode(reinterpret_cast<uint16_t*>(in), count); break;
+        case 4: xor_encode(reinterpret_cast<uint32_t*>(in), count); break;
+        }
+    }
+    if (transform == IqTransform::None || element_bytes == 1) {
+        std::memcpy(out, in, bytes);
+        return;
+    }
+    switch (element_bytes) {
+    case 2: shuffle<2>(in, out, count); break;
+    case 4: shuffle<4>(in, out, count); break;
+    }
+    std::memcpy(out + count * element_bytes, in + count * element_bytes, bytes - count * element_bytes);
+}
+
+inline void iq_inverse_transform(const uint8_t* in, uint8_t* out, size_t bytes, size_t element_bytes,
+                                 IqTransform transform) {
+    using namespace iqz_detail;
+    const size_t count = bytes / element_bytes;
+    if (transform == IqTransform::None || element_bytes == 1) {
+        std::memcpy(out, in, bytes);
+    } else {
+        switch (element_bytes) {
+        case 2: unshuffle<2>(in, out, count); break;
+        case 4: unshuffle<4>(in, out, count); break;
+        }
+        std::memcpy(out + count * element_bytes, in + count * element_bytes, bytes - count * element_bytes);
+    }
+    if (transform == IqTransform::Delta) {
+        switch (element_bytes) {
+        case 1: delta_decode(reinterpret_cast<uint8_t*>(out), count); break;
+        case 2: delta_decode(reinterpret_cast<uint16_t*>(out), count); break;
+        case 4: xor_decode(reinterpret_cast<uint32_t*>(out), count); break;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Codecs
+
+inline size_t iq_codec_bound(IqCodec codec, size_t bytes) {
+    switch (codec) {
+#ifdef SDR_HAVE_ZSTD
+    case IqCodec::Zstd: return ZSTD_compressBound(bytes);
+#endif
+#ifdef SDR_HAVE_LZ4
+    case IqCodec::Lz4: return static_cast<size_t>(LZ4_compressBound(static_cast<int>(bytes)));
+#endif
+    default: return bytes;
+    }
+}
+
+// Per-thread codec state (zstd contexts are reused across blocks)
+class IqCodecContext {
+public:
+    IqCodecContext() = default;
+    ~IqCodecContext() {
+#ifdef SDR_HAVE_ZSTD
+        if (cctx_) ZSTD_freeCCtx(cctx_);
+        if (dctx_) ZSTD_freeDCtx(dctx_);
+#endif
+    }
+    IqCodecContext(const IqCodecContext&) = delete;
+    IqCodecContext& operator=(const IqCodecContext&) = delete;
+
+    // Compressed size, or 0 if the codec failed or the data did not fit
+    size_t compress(IqCodec codec, int level, const uint8_t* src, size_t bytes, uint8_t* dst, size_t capacity) {
+        switch (codec) {
+#ifdef SDR_HAVE_ZSTD
+        case IqCodec::Zstd: {
+            if (!cctx_) cctx_ = ZSTD_createCCtx();
+            const size_t n = ZSTD_compressCCtx(cctx_, dst, capacity, src, bytes, level);
+            return ZSTD_isError(n) ? 0 : n;
+        }
+#endif
+#ifdef SDR_HAVE_LZ4
+        case IqCodec::Lz4: {
+            const int n = LZ4_compress_fast(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+                                            static_cast<int>(bytes), static_cast<int>(capacity), std::max(1, level));
+            return n > 0 ? static_cast<size_t>(n) : 0;
+        }
+#endif
+        default:
+            (void)level;
+            if (bytes > capacity) return 0;
+            std::memcpy(dst, src, bytes);
+            return bytes;
+        }
+    }
+
+    bool decompress(IqCodec codec, const uint8_t* src, size_t bytes, uint8_t* dst, size_t raw_bytes) {
+        switch (codec) {
+        case IqCodec::None:
+            if (bytes != raw_bytes) return false;
+            std::memcpy(dst, src, bytes);
+            return true;
+#ifdef SDR_HAVE_ZSTD
+        case IqCodec::Zstd: {
+            if (!dctx_) dctx_ = ZSTD_createDCtx();
+            const size_t n = ZSTD_decompressDCtx(dctx_, dst, raw_bytes, src, bytes);
+            return !ZSTD_isError(n) && n == raw_bytes;
+        }
+#endif
+#ifdef SDR_HAVE_LZ4
+        case IqCodec::Lz4:
+            return LZ4_decompress_safe(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+                                       static_cast<int>(bytes), static_cast<int>(raw_bytes))
+                   == static_cast<int>(raw_bytes);
+#endif
+        default:
+            return false;
+        }
+    }
+
+private:
+#ifdef SDR_HAVE_ZSTD
+    ZSTD_CCtx* cctx_ = nullptr;
+    ZSTD_DCtx* dctx_ = nullptr;
+#endif
+};
+
+// ---------------------------------------------------------------------------
+// Writer
+
+struct IqCompressOptions {
+    IqCodec codec = IqCodec::Zstd;
+    int level = 1;
+    IqTransform transform = IqTransform::Shuffle;
+    size_t block_bytes = size_t(1) << 20;   // Rounded down to whole samples
+    unsigned threads = 0;                   // 0 = one per core, less one for recv
+    size_t slots = 0;                       // Raw blocks in flight, 0 = 4 per thread
+};
+
+inline unsigned default_compress_threads() {
+    const unsigned cores = std::thread::hardware_concurrency();
+    return cores > 2 ? cores - 1 : 1;
+}
+
+// Sits in front of an AsyncFileWriter with the same producer interface:
+// the receive thread fills raw blocks, workers compress them, and one
+// emitter thread appends them in order to `sink` and records the index.
+// As with the writer, the producer never waits: with every block still
+// in flight acquire() returns nullptr and the caller drops.
+class IqCompressor {
+public:
+    IqCompressor(AsyncFileWriter& sink, SampleFormat format, double sample_rate, const IqCompressOptions& options)
+        : sink_(sink), format_(format), options_(options) {
+        const size_t sample_bytes = sample_format_bytes(format_);
+        block_bytes_ = std::max(sample_bytes, options_.block_bytes / sample_bytes * sample_bytes);
+        const unsigned threads = options_.threads ? options_.threads : default_compress_threads();
+        const size_t slots = options_.slots ? options_.slots : 4 * static_cast<size_t>(threads);
+
+        slots_.resize(std::max<size_t>(2, slots));
+        const size_t stored_capacity = std::max(iq_codec_bound(options_.codec, block_bytes_), block_bytes_);
+        for (Slot& slot : slots_) {
+            // Touch everything now rather than on the receive thread
+            slot.raw.assign(block_bytes_, 0);
+            slot.stored.assign(sizeof(IqzBlockHeader) + stored_capacity, 0);
+        }
+
+        IqzHeader header = {};
+        std::memcpy(header.magic, IQZ_MAGIC, sizeof(header.magic));
+        header.version = 1;
+        header.format = iq_format_code(format_);
+        header.codec = static_cast<uint8_t>(options_.codec);
+        header.transform = static_cast<uint8_t>(options_.transform);
+        header.level = static_cast<int8_t>(std::max(-128, std::min(127, options_.level)));
+        header.block_bytes = static_cast<uint32_t>(block_bytes_);
+        header.sample_rate = sample_rate;
+        append(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+
+        for (unsigned i = 0; i < threads; i++) workers_.emplace_back(&IqCompressor::worker_loop, this);
+        emitter_ = std::thread(&IqCompressor::emit_loop, this);
+    }
+
+    ~IqCompressor() { finish(); }
+
+    IqCompressor(const IqCompressor&) = delete;
+    IqCompressor& operator=(const IqCompressor&) = delete;
+
+    unsigned threads() const { return static_cast<unsigned>(workers_.size()); }
+    size_t block_bytes() const { return block_bytes_; }
+
+    // Producer: free space in the current raw block, nullptr if all are busy
+    void* acquire(size_t& bytes_available) {
+        if (!filling_) {
+            Slot& slot = slots_[fill_seq_ % slots_.size()];
+            if (slot.state.load(std::memory_order_acquire) != SlotState::Free) return nullptr;
+            slot.used = 0;
+            filling_ = &slot;
+        }
+        bytes_available = block_bytes_ - filling_->used;
+        return filling_->raw.data() + filling_->used;
+    }
+
+    void commit(size_t bytes) {
+        filling_->used += bytes;
+        raw_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        if (filling_->used == block_bytes_) queue_filled();
+    }
+
+    // Producer: compresses the partial block, drains the pool and appends
+    // the index and trailer. The sink is left open for its owner to close.
+    bool finish() {
+        if (finished_) return !failed_.load();
+        finished_ = true;
+        if (filling_ && filling_->used > 0) queue_filled();
+        filling_ = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_cv_.notify_all();
+        emit_cv_.notify_all();
+        for (std::thread& worker : workers_) worker.join();
+        if (emitter_.joinable()) emitter_.join();
+
+        IqzTrailer trailer = {};
+        trailer.index_offset = file_offset_;
+        trailer.blocks = index_.size();
+        trailer.raw_bytes = index_raw_bytes_;
+        std::memcpy(trailer.magic, IQZ_TRAILER_MAGIC, sizeof(trailer.magic));
+        append(reinterpret_cast<const uint8_t*>(index_.data()), index_.size() * sizeof(IqzIndexEntry));
+        append(reinterpret_cast<const uint8_t*>(&trailer), sizeof(trailer));
+        return !failed_.load();
+    }
+
+    // Statistics (safe from any thread)
+    uint64_t raw_bytes() const { return raw_bytes_.load(std::memory_order_relaxed); }
+    uint64_t stored_bytes() const { return stored_bytes_.load(std::memory_order_relaxed); }
+    uint64_t blocks() const { return blocks_.load(std::memory_order_relaxed); }
+    // Summed worker time spent transforming and compressing
+    double compress_seconds() const { return compress_ns_.load(std::memory_order_relaxed) / 1e9; }
+    size_t slots_busy_peak() const { return busy_peak_.load(std::memory_order_relaxed); }
+    size_t slots() const { return slots_.size(); }
+
+private:
+    enum class SlotState { Free, Queued, Compressed };
+
+    struct Slot {
+        std::vector<uint8_t> raw;
+        std::vector<uint8_t> stored;    // IqzBlockHeader + payload
+        size_t used = 0;
+        size_t stored_bytes = 0;
+        std::atomic<SlotState> state{SlotState::Free};
+
+        Slot() = default;
+        Slot(const Slot&) : Slot() {}  // For vector::resize only; slots start empty
+    };
+
+    void queue_filled() {
+        filling_->state.store(SlotState::Queued, std::memory_order_release);
+        filling_ = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            work_.push_back(fill_seq_++);
+            busy_peak_.store(std::max(busy_peak_.load(std::memory_order_relaxed),
+                                      static_cast<size_t>(fill_seq_ - emit_seq_.load())),
+                             std::memory_order_relaxed);
+        }
+        work_cv_.notify_one();
+    }
+
+    void worker_loop() {
+        IqCodecContext codec;
+        std::vector<uint8_t> scratch(block_bytes_);
+        const size_t element_bytes = iq_element_bytes(format_);
+        while (true) {
+            uint64_t seq;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_cv_.wait(lock, [this] { return !work_.empty() || stopping_; });
+                if (work_.empty()) return;
+                seq = work_.front();
+                work_.pop_front();
+            }
+
+            Slot& slot = slots_[seq % slots_.size()];
+            const auto start = std::chrono::steady_clock::now();
+            iq_forward_transform(slot.raw.data(), scratch.data(), slot.used, element_bytes, options_.transform);
+            IqzBlockHeader header = {};
+            header.magic = IQZ_BLOCK_MAGIC;
+            header.raw_bytes = static_cast<uint32_t>(slot.used);
+            uint8_t* payload = slot.stored.data() + sizeof(IqzBlockHeader);
+            const size_t capacity = slot.stored.size() - sizeof(IqzBlockHeader);
+            size_t n = codec.compress(options_.codec, options_.level, scratch.data(), slot.used, payload, capacity);
+            if (n > 0 && n < slot.used) {
+                header.codec = static_cast<uint8_t>(options_.codec);
+                header.transform = static_cast<uint8_t>(options_.transform);
+            } else {
+                // Incompressible (or codec error): keep the block as received.
+                // Delta mutated raw in place, so store the transform as well.
+                const bool mutated = options_.transform == IqTransform::Delta;
+                header.codec = static_cast<uint8_t>(IqCodec::None);
+                header.transform = static_cast<uint8_t>(mutated ? options_.transform : IqTransform::None);
+                std::memcpy(payload, mutated ? scratch.data() : slot.raw.data(), slot.used);
+                n = slot.used;
+            }
+            header.stored_bytes = static_cast<uint32_t>(n);
+            std::memcpy(slot.stored.data(), &header, sizeof(header));
+            slot.stored_bytes = sizeof(header) + n;
+            compress_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+
+            slot.state.store(SlotState::Compressed, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(mutex_);
+            emit_cv_.notify_one();
+        }
+    }
+
+    void emit_loop() {
+        while (true) {
+            const uint64_t seq = emit_seq_.load(std::memory_order_relaxed);
+            Slot& slot = slots_[seq % slots_.size()];
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                emit_cv_.wait(lock, [&] {
+                    return slot.state.load(std::memory_order_acquire) == SlotState::Compressed
+                        || (stopping_ && seq == fill_seq_);
+                });
+                if (slot.state.load(std::memory_order_acquire) != SlotState::Compressed) return;
+            }
+
+            IqzIndexEntry entry;
+            entry.file_offset = file_offset_;
+            entry.raw_offset = index_raw_bytes_;
+            entry.stored_bytes = static_cast<uint32_t>(slot.stored_bytes - sizeof(IqzBlockHeader));
+            entry.raw_bytes = static_cast<uint32_t>(slot.used);
+            append(slot.stored.data(), slot.stored_bytes);
+            index_.push_back(entry);
+            index_raw_bytes_ += slot.used;
+            stored_bytes_.fetch_add(slot.stored_bytes, std::memory_order_relaxed);
+            blocks_.fetch_add(1, std::memory_order_relaxed);
+
+            slot.state.store(SlotState::Free, std::memory_order_release);
+            emit_seq_.store(seq + 1, std::memory_order_release);
+        }
+    }
+
+    // Copies into the sink's buffers, waiting while they are all queued
+    // (only the emitter and finish() call this, never the receive thread)
+    void append(const uint8_t* data, size_t bytes) {
+        while (bytes > 0) {
+            size_t available = 0;
+            void* space = sink_.acquire(available);
+            if (!space) {
+                if (sink_.failed()) {
+                    failed_.store(true);
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            const size_t n = std::min(available, bytes);
+            std::memcpy(space, data, n);
+            sink_.commit(n);
+            data += n;
+            bytes -= n;
+            file_offset_ += n;
+        }
+    }
+
+    AsyncFileWriter& sink_;
+    SampleFormat format_;
+    IqCompressOptions options_;
+    size_t block_bytes_ = 0;
+    std::vector<Slot> slots_;
+
+    // Producer (fill_seq_ is only written under mutex_)
+    Slot* filling_ = nullptr;
+    uint64_t fill_seq_ = 0;
+    bool finished_ = false;
+
+    // Shared
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable emit_cv_;
+    std::deque<uint64_t> work_;
+    bool stopping_ = false;
+    std::atomic<uint64_t> emit_seq_{0};
+    std::vector<std::thread> workers_;
+    std::thread emitter_;
+
+    // Emitter (then finish())
+    uint64_t file_offset_ = 0;
+    uint64_t index_raw_bytes_ = 0;
+    std::vector<IqzIndexEntry> index_;
+
+    std::atomic<uint64_t> raw_bytes_{0};
+    std::atomic<uint64_t> stored_bytes_{0};
+    std::atomic<uint64_t> blocks_{0};
+    std::atomic<int64_t> compress_ns_{0};
+    std::atomic<size_t> busy_peak_{0};
+    std::atomic<bool> failed_{false};
+};
+
+// ---------------------------------------------------------------------------
+// Reader
+
+class IqzReader {
+public:
+    bool open(const std::string& path) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) return fail("cannot open " + path + ": " + std::strerror(errno));
+        if (!read_at(&header_, sizeof(header_), 0) || std::memcmp(header_.magic, IQZ_MAGIC, sizeof(IQZ_MAGIC)) != 0) {
+            return fail(path + " is not an .iqz file");
+        }
+        const off_t size = ::lseek(fd_, 0, SEEK_END);
+        IqzTrailer trailer = {};
+        if (size >= static_cast<off_t>(sizeof(header_) + sizeof(trailer))
+            && read_at(&trailer, sizeof(trailer), static_cast<uint64_t>(size) - sizeof(trailer))
+            && std::memcmp(trailer.magic, IQZ_TRAILER_MAGIC, sizeof(IQZ_TRAILER_MAGIC)) == 0) {
+            index_.resize(trailer.blocks);
+            if (!read_at(index_.data(), index_.size() * sizeof(IqzIndexEntry), trailer.index_offset)) {
+                return fail("truncated block index");
+            }
+            raw_bytes_ = trailer.raw_bytes;
+        } else {
+            rebuilt_ = true;
+            rebuild_index(static_cast<uint64_t>(size));
+        }
+        return true;
+    }
+
+    ~IqzReader() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    const std::string& error() const { return error_; }
+    SampleFormat format() const { return iq_format_from_code(header_.format); }
+    size_t sample_bytes() const { return sample_format_bytes(format()); }
+    double sample_rate() const { return header_.sample_rate; }
+    IqCodec codec() const { return static_cast<IqCodec>(header_.codec); }
+    IqTransform transform() const { return static_cast<IqTransform>(header_.transform); }
+    int level() const { return header_.level; }
+    uint64_t samples() const { return raw_bytes_ / sample_bytes(); }
+    const std::vector<IqzIndexEntry>& index() const { return index_; }
+    // True if the trailer was missing and the index came from a scan
+    bool index_rebuilt() const { return rebuilt_; }
+
+    // Decodes `count` samples from `start` into `out`; returns samples read
+    // (fewer at the end of the file), or 0 with error() set on corruption
+    uint64_t read(uint64_t start, uint64_t count, uint8_t* out) {
+        const size_t sb = sample_bytes();
+        uint64_t pos = start * sb;
+        const uint64_t end = std::min(raw_bytes_, (start + count) * sb);
+        if (pos >= end) return 0;
+
+        // First block whose range reaches past `pos`
+        auto it = std::upper_bound(index_.begin(), index_.end(), pos,
+                                   [](uint64_t value, const IqzIndexEntry& e) { return value < e.raw_offset + e.raw_bytes; });
+        uint8_t* dst = out;
+        for (; it != index_.end() && pos < end; ++it) {
+            if (!decode_block(*it)) return 0;
+            const uint64_t from = pos - it->raw_offset;
+            const uint64_t n = std::min<uint64_t>(it->raw_bytes - from, end - pos);
+            std::memcpy(dst, block_.data() + from, n);
+            dst += n;
+            pos += n;
+        }
+        return static_cast<uint64_t>(dst - out) / sb;
+    }
+
+private:
+    bool fail(const std::string& message) {
+        error_ = message;
+        return false;
+    }
+
+    bool read_at(void* data, size_t bytes, uint64_t offset) {
+        uint8_t* p = static_cast<uint8_t*>(data);
+        while (bytes > 0) {
+            const ssize_t n = ::pread(fd_, p, bytes, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            bytes -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    // Walks block headers up to the first one that is torn or missing
+    void rebuild_index(uint64_t file_size) {
+        uint64_t offset = sizeof(IqzHeader);
+        raw_bytes_ = 0;
+        IqzBlockHeader header;
+        while (offset + sizeof(header) <= file_size && read_at(&header, sizeof(header), offset)
+               && header.magic == IQZ_BLOCK_MAGIC && offset + sizeof(header) + header.stored_bytes <= file_size) {
+            index_.push_back(IqzIndexEntry{offset, raw_bytes_, header.stored_bytes, header.raw_bytes});
+            raw_bytes_ += header.raw_bytes;
+            offset += sizeof(header) + header.stored_bytes;
+        }
+    }
+
+    bool decode_block(const IqzIndexEntry& entry) {
+        if (decoded_offset_ == entry.file_offset && !block_.empty()) return true;
+        IqzBlockHeader header;
+        stored_.resize(entry.stored_bytes);
+        if (!read_at(&header, sizeof(header), entry.file_offset) || header.magic != IQZ_BLOCK_MAGIC
+            || !read_at(stored_.data(), entry.stored_bytes, entry.file_offset + sizeof(header))) {
+            return fail("cannot read block at offset " + std::to_string(entry.file_offset));
+        }
+        scratch_.resize(entry.raw_bytes);
+        block_.resize(entry.raw_bytes);
+        if (!codec_.decompress(static_cast<IqCodec>(header.codec), stored_.data(), entry.stored_bytes,
+                               scratch_.data(), entry.raw_bytes)) {
+            return fail(std::string("cannot decode ") + iq_codec_name(static_cast<IqCodec>(header.codec))
+                        + " block at offset " + std::to_string(entry.file_offset)
+                        + (iq_codec_available(static_cast<IqCodec>(header.codec)) ? "" : " (codec not built in)"));
+        }
+        iq_inverse_transform(scratch_.data(), block_.data(), entry.raw_bytes, iq_element_bytes(format()),
+                             static_cast<IqTransform>(header.transform));
+        decoded_offset_ = entry.file_offset;
+        return true;
+    }
+
+    int fd_ = -1;
+    std::string error_;
+    IqzHeader header_ = {};
+    std::vector<IqzIndexEntry> index_;
+    uint64_t raw_bytes_ = 0;
+    bool rebuilt_ = false;
+    IqCodecContext codec_;
+    std::vector<uint8_t> stored_, scratch_, block_;
+    uint64_t decoded_offset_ = ~uint64_t(0);
+};
@@ -0,0 +1,242 @@
+/**
+ * iq_compress_bench.cpp - Checks that --compress keeps up with a device
+ *
+ * Feeds synthetic IQ through IqCompressor exactly as the recorders do
+ * (acquire/commit of recv-sized pieces from one producer thread, worker
+ * pool and ordered writer behind it) once per --threads count, and reports
+ * the sustained rate in Msps and the compression ratio.
+ *
+ *   ./iq_compress_bench --format ci16 --compress zstd:1 --threads 1,2,4,8 --rate-msps 56
+ *
+ * The signal is a few tones in Gaussian noise quantised to --adc-bits,
+ * which is about what a wideband capture of a quiet band looks like; real
+ * recordings compress anywhere from slightly better (narrowband, low gain)
+ * to not at all (full-scale noise). Use --input to bench on a recording
+ * (.sigmf-data in --format) instead.
+ *
+ * The compressed output goes to --file, /dev/null by default, so only the
+ * compression is measured; point it at the recording disk to include it.
+ *
+ * Output: JSON summary on stdout, progress on stderr
+ */
+
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_writer.hpp"
+#include "iq_compress.hpp"
+
+namespace po = boost::program_options;
+
+static bool parse_thread_list(const std::string& text, std::vector<unsigned>& out) {
+    std::istringstream iss(text);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        if (item.empty()) continue;
+        const unsigned threads = static_cast<unsigned>(std::stoul(item));
+        out.push_back(threads ? threads : default_compress_threads());
+    }
+    return !out.empty();
+}
+
+// Tones plus noise, full scale = 1, quantised to `adc_bits` and stored in `format`
+static std::vector<uint8_t> synthesize(SampleFormat format, size_t samples, int adc_bits) {
+    std::mt19937 rng(12345);
+    std::normal_distribution<float> noise(0.0f, 0.01f);
+    const float levels = static_cast<float>(1 << (adc_bits - 1));
+    const double tones[] = {0.013, -0.071, 0.2};
+    const float amplitudes[] = {0.3f, 0.05f, 0.02f};
+
+    std::vector<uint8_t> data(samples * sample_format_bytes(format));
+    for (size_t n = 0; n < samples; n++) {
+        std::complex<float> value(noise(rng), noise(rng));
+        for (size_t t = 0; t < 3; t++) {
+            value += std::polar(amplitudes[t], static_cast<float>(2 * M_PI * std::fmod(tones[t] * n, 1.0)));
+        }
+        const float i = std::round(value.real() * levels) / levels;
+        const float q = std::round(value.imag() * levels) / levels;
+        switch (format) {
+        case SampleFormat::Cf32: {
+            float* out = reinterpret_cast<float*>(data.data()) + 2 * n;
+            out[0] = i;
+            out[1] = q;
+            break;
+        }
+        case SampleFormat::Ci16: {
+            int16_t* out = reinterpret_cast<int16_t*>(data.data()) + 2 * n;
+            out[0] = static_cast<int16_t>(std::lrint(i * 32767.0f));
+            out[1] = static_cast<int16_t>(std::lrint(q * 32767.0f));
+            break;
+        }
+        case SampleFormat::Ci8: {
+            int8_t* out = reinterpret_cast<int8_t*>(data.data()) + 2 * n;
+            out[0] = static_cast<int8_t>(std::lrint(i * 127.0f));
+            out[1] = static_cast<int8_t>(std::lrint(q * 127.0f));
+            break;
+        }
+        }
+    }
+    return data;
+}
+
+int main(int argc, char* argv[]) {
+    std::string file, input, format_name, codec_name, transform_name, threads_arg;
+    size_t size_mb, block_kb, chunk_samples;
+    double rate_msps;
+    int adc_bits;
+
+    po::options_description desc("IQ Compression Benchmark Options");
+    desc.add_options()
+        ("help", "Show help message")
+        ("format", po::value<std::string>(&format_name)->default_value("ci16"), "Sample format: cf32, ci16 or ci8")
+        ("compress", po::value<std::string>(&codec_name)->default_value("zstd:1"), "Codec: zstd[:level], lz4[:acceleration] or none")
+        ("transform", po::value<std::string>(&transform_name)->default_value("shuffle"), "Transform: shuffle, delta or none")
+        ("threads", po::value<std::string>(&threads_arg)->default_value("1,2,4,0"), "Comma-separated worker counts to compare (0 = default)")
+        ("block-kb", po::value<size_t>(&block_kb)->default_value(1024), "Compression block size (KB)")
+        ("size-mb", po::value<size_t>(&size_mb)->default_value(2048), "Raw data compressed per run (MB)")
+        ("rate-msps", po::value<double>(&rate_msps)->default_value(0), "Device rate to check against; paces the producer and counts drops (0 = flat out)")
+        ("adc-bits", po::value<int>(&adc_bits)->default_value(12), "Synthetic signal: converter resolution")
+        ("input", po::value<std::string>(&input), "Bench on this raw recording instead of synthetic IQ")
+        ("file", po::value<std::string>(&file)->default_value("/dev/null"), "Where the compressed stream goes")
+        ("recv-samples", po::value<size_t>(&chunk_samples)->default_value(8192), "Samples per producer commit, like a recv() call")
+    ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    SampleFormat format;
+    IqCompressOptions base;
+    std::vector<unsigned> thread_counts;
+    if (!parse_sample_format(format_name, format)
+        || !parse_iq_codec(codec_name, base.codec, base.level)
+        || !parse_iq_transform(transform_name, base.transform)
+        || !parse_thread_list(threads_arg, thread_counts)) {
+        std::cerr << "Error: bad --format, --compress, --transform or --threads (see --help)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!iq_codec_available(base.codec)) {
+        std::cerr << "Error: built without " << iq_codec_name(base.codec) << std::endl;
+        return EXIT_FAILURE;
+    }
+    base.block_bytes = std::max<size_t>(1, block_kb) << 10;
+    const size_t sample_bytes = sample_format_bytes(format);
+
+    // Source cycled through for the whole run; 64 MB keeps it out of the
+    // codec's reach as a repeat
+    std::vector<uint8_t> source;
+    if (!input.empty()) {
+        std::ifstream in(input, std::ios::binary);
+        source.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        source.resize(std::min<size_t>(source.size(), size_t(256) << 20) / sample_bytes * sample_bytes);
+        if (source.empty()) {
+            std::cerr << "Error: could not read " << input << std::endl;
+            return EXIT_FAILURE;
+        }
+    } else {
+        std::cerr << "[Compress Bench] Generating signal..." << std::endl;
+        source = synthesize(format, (size_t(64) << 20) / sample_bytes, std::max(2, std::min(16, adc_bits)));
+    }
+
+    const uint64_t total_bytes = (static_cast<uint64_t>(size_mb) << 20) / sample_bytes * sample_bytes;
+    const size_t commit_bytes = std::max<size_t>(1, chunk_samples) * sample_bytes;
+    std::ostringstream results;
+    bool first = true;
+    bool all_sustained = true;
+
+    for (unsigned threads : thread_counts) {
+        IqCompressOptions options = base;
+        options.threads = threads;
+
+        AsyncWriterOptions writer_options;
+        writer_options.buffer_bytes = size_t(8) << 20;
+        AsyncFileWriter writer(file, writer_options);
+        if (!writer.is_open()) {
+            std::perror(("Error: Could not open " + file).c_str());
+            return EXIT_FAILURE;
+        }
+
+        uint64_t produced = 0;
+        uint64_t dropped = 0;
+        size_t offset = 0;
+        IqCompressor compressor(writer, format, rate_msps * 1e6, options);
+        const auto start = std::chrono::steady_clock::now();
+        while (produced < total_bytes) {
+            if (rate_msps > 0) {
+                const auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(produced / sample_bytes / (rate_msps * 1e6)));
+                std::this_thread::sleep_until(due);
+            }
+            size_t want = static_cast<size_t>(std::min<uint64_t>(commit_bytes, total_bytes - produced));
+            want = std::min(want, source.size() - offset);
+            size_t available = 0;
+            void* space = compressor.acquire(available);
+            if (space) {
+                want = std::min(want, available);
+                std::memcpy(space, source.data() + offset, want);
+                compressor.commit(want);
+            } else if (rate_msps > 0) {
+                dropped += want;  // Live capture: the samples are gone
+            } else {
+                continue;         // Flat out: wait for a block to free up
+            }
+            produced += want;
+            offset = (offset + want) % source.size();
+        }
+        const bool ok = compressor.finish() && writer.close();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const double msps = produced / sample_bytes / 1e6 / seconds;
+        const double ratio = compressor.raw_bytes() ? static_cast<double>(compressor.stored_bytes()) / compressor.raw_bytes() : 1.0;
+        const double per_thread = compressor.compress_seconds() > 0
+            ? compressor.raw_bytes() / sample_bytes / 1e6 / compressor.compress_seconds() : 0.0;
+        const bool sustained = rate_msps > 0 ? dropped == 0 : true;
+        all_sustained = all_sustained && sustained && ok;
+        std::cerr << "[Compress Bench] " << compressor.threads() << " threads: " << static_cast<long>(msps)
+                  << " Msps, " << static_cast<long>(per_thread) << " Msps per thread, ratio "
+                  << static_cast<int>(ratio * 1000) / 10.0 << "%, peak blocks in flight "
+                  << compressor.slots_busy_peak() << "/" << compressor.slots()
+                  << (dropped ? ", DROPPED " + std::to_string(dropped / sample_bytes) + " samples" : "")
+                  << (ok ? "" : ", WRITE FAILED") << std::endl;
+
+        if (!first) results << ",";
+        first = false;
+        results << "{\"threads\":" << compressor.threads()
+                << ",\"ok\":" << (ok ? "true" : "false")
+                << ",\"seconds\":" << seconds
+                << ",\"msps\":" << msps
+                << ",\"mspsPerThread\":" << per_thread
+                << ",\"ratio\":" << ratio
+                << ",\"rawBytes\":" << compressor.raw_bytes()
+                << ",\"storedBytes\":" << compressor.stored_bytes()
+                << ",\"blocks\":" << compressor.blocks()
+                << ",\"peakBlocks\":" << compressor.slots_busy_peak()
+                << ",\"droppedSamples\":" << dropped / sample_bytes
+                << ",\"sustained\":" << (sustained ? "true" : "false") << "}";
+    }
+
+    std::cout << "{\"format\":\"" << sample_format_name(format) << "\""
+              << ",\"codec\":\"" << iq_codec_name(base.codec) << "\""
+              << ",\"level\":" << base.level
+              << ",\"transform\":\"" << iq_transform_name(base.transform) << "\""
+              << ",\"blockKb\":" << (base.block_bytes >> 10)
+              << ",\"rateMsps\":" << rate_msps
+              << ",\"cores\":" << std::thread::hardware_concurrency()
+              << ",\"results\":[" << results.str() << "]}" << std::endl;
+
+    return rate_msps > 0 && !all_sustained ? EXIT_FAILURE : EXIT_SUCCESS;
+}
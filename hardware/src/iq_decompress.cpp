@@ -0,0 +1,143 @@
+/**
+ * iq_decompress.cpp - Restores .sigmf-data from the recorders' .iqz files
+ *
+ * Reads a --compress recording (iq_compress.hpp) and writes the original
+ * interleaved samples, byte for byte. The block index makes any sample
+ * range cheap to pull out of a long capture without decoding the rest:
+ *
+ *   ./iq_decompress recording.iqz                       # -> recording.sigmf-data
+ *   ./iq_decompress recording.iqz --start-sample 5e8 --count 1e6 --output cut.sigmf-data
+ *   ./iq_decompress recording.iqz --info
+ *
+ * The recording's .sigmf-meta already describes the decompressed data, so
+ * a full restore next to it is a complete SigMF recording again. A range
+ * starts at --start-sample of that recording.
+ *
+ * Output: JSON summary on stdout, errors on stderr
+ */
+
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "async_writer.hpp"
+#include "control_channel.hpp"
+#include "iq_compress.hpp"
+
+namespace po = boost::program_options;
+
+int main(int argc, char* argv[]) {
+    std::string input, output;
+    double start_sample, count;
+    bool info = false;
+
+    po::options_description desc("IQ Decompress Options");
+    desc.add_options()
+        ("help", "Show help message")
+        ("input", po::value<std::string>(&input), "Compressed recording (.iqz)")
+        ("output", po::value<std::string>(&output), "Output file (default: <input>.sigmf-data)")
+        ("start-sample", po::value<double>(&start_sample)->default_value(0), "First sample to restore")
+        ("count", po::value<double>(&count)->default_value(0), "Samples to restore (0 = to the end)")
+        ("info", po::bool_switch(&info), "Print the header and block index summary only")
+    ;
+    po::positional_options_description positional;
+    positional.add("input", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help") || input.empty()) {
+        std::cout << "Usage: iq_decompress <file.iqz> [options]" << std::endl << desc << std::endl;
+        return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    IqzReader reader;
+    if (!reader.open(input)) {
+        std::cerr << "[IQ Decompress] ERROR: " << reader.error() << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (reader.index_rebuilt()) {
+        std::cerr << "[IQ Decompress] WARNING: " << input << " has no index (recording cut short?); "
+                  << "recovered " << reader.index().size() << " complete blocks" << std::endl;
+    }
+
+    uint64_t stored = 0;
+    for (const IqzIndexEntry& entry : reader.index()) stored += entry.stored_bytes;
+    if (info) {
+        std::cout << "{\"file\":\"" << json_escape(input) << "\""
+                  << ",\"format\":\"" << sample_format_name(reader.format()) << "\""
+                  << ",\"sampleRate\":" << reader.sample_rate()
+                  << ",\"codec\":\"" << iq_codec_name(reader.codec()) << "\""
+                  << ",\"level\":" << reader.level()
+                  << ",\"transform\":\"" << iq_transform_name(reader.transform()) << "\""
+                  << ",\"samples\":" << reader.samples()
+                  << ",\"blocks\":" << reader.index().size()
+                  << ",\"indexRebuilt\":" << (reader.index_rebuilt() ? "true" : "false")
+                  << ",\"rawBytes\":" << reader.samples() * reader.sample_bytes()
+                  << ",\"storedBytes\":" << stored << "}" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    const uint64_t first = static_cast<uint64_t>(start_sample);
+    if (first > reader.samples()) {
+        std::cerr << "[IQ Decompress] ERROR: --start-sample past the end (" << reader.samples() << " samples)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    uint64_t remaining = reader.samples() - first;
+    if (count > 0) remaining = std::min(remaining, static_cast<uint64_t>(count));
+    if (output.empty()) output = iqz_data_path(input);
+
+    // Decode straight into the writer's buffers, so decoding and disk
+    // writes overlap
+    const size_t sample_bytes = reader.sample_bytes();
+    AsyncWriterOptions options;
+    options.expected_bytes = remaining * sample_bytes;
+    AsyncFileWriter writer(output, options);
+    if (!writer.is_open()) {
+        std::cerr << "[IQ Decompress] ERROR: Could not open " << output << ": " << std::strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t position = first;
+    uint64_t written = 0;
+    bool ok = true;
+    while (remaining > 0) {
+        size_t available = 0;
+        void* space = writer.acquire(available);
+        if (!space) {
+            if (writer.failed()) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        const uint64_t want = std::min<uint64_t>(remaining, available / sample_bytes);
+        const uint64_t got = reader.read(position, want, static_cast<uint8_t*>(space));
+        if (got == 0) {
+            ok = false;
+            break;
+        }
+        writer.commit(got * sample_bytes);
+        position += got;
+        written += got;
+        remaining -= got;
+    }
+    ok = writer.close() && ok;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!ok) {
+        std::cerr << "[IQ Decompress] ERROR: "
+                  << (reader.error().empty() ? "writing " + output + " failed" : reader.error()) << std::endl;
+    }
+    std::cout << "{\"success\":" << (ok ? "true" : "false")
+              << ",\"input\":\"" << json_escape(input) << "\""
+              << ",\"output\":\"" << json_escape(output) << "\""
+              << ",\"format\":\"" << sample_format_name(reader.format()) << "\""
+              << ",\"startSample\":" << first
+              << ",\"samples\":" << written
+              << ",\"seconds\":" << seconds
+              << ",\"msps\":" << (seconds > 0 ? written / 1e6 / seconds : 0.0) << "}" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
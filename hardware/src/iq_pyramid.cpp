@@ -0,0 +1,185 @@
+/**
+ * iq_pyramid.cpp - Builds the spectrogram pyramid of an existing recording
+ *
+ * The recorders write <base>.pyramid while recording with --pyramid; this
+ * builds the same overview (spectrogram_pyramid.hpp) for recordings made
+ * without it, or at another resolution:
+ *
+ *   ./iq_pyramid recording.sigmf-data --format ci16 --rate 56e6 --freq 2.4e9
+ *   ./iq_pyramid recording.iqz --fft 4096 --row-ms 10 --ffts 0
+ *   ./iq_pyramid recording.pyramid --info
+ *
+ * .iqz files carry their own format and rate. Rows follow the samples in
+ * the file: gaps the .sigmf-meta records between captures are not put
+ * back in. Unlike the recorders, --ffts defaults to 0 (every sample
+ * transformed), since nothing has to keep up with a device here.
+ *
+ * Output: JSON summary on stdout, progress and errors on stderr
+ */
+
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "control_channel.hpp"
+#include "iq_compress.hpp"
+#include "spectrogram_pyramid.hpp"
+
+namespace po = boost::program_options;
+
+static bool ends_with(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static int print_info(const std::string& path) {
+    PyramidReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "[IQ Pyramid] ERROR: " << reader.error() << std::endl;
+        return EXIT_FAILURE;
+    }
+    const PyramidHeader& h = reader.header();
+    std::cout << "{\"file\":\"" << json_escape(path) << "\""
+              << ",\"sampleRate\":" << h.sample_rate
+              << ",\"frequency\":" << h.center_freq
+              << ",\"fftSize\":" << h.fft_size
+              << ",\"fftsPerRow\":" << h.ffts_per_row
+              << ",\"rowSamples\":" << h.row_samples
+              << ",\"rowSeconds\":" << h.row_samples / h.sample_rate
+              << ",\"levels\":" << h.levels
+              << ",\"rows\":[";
+    for (unsigned l = 0; l < reader.levels(); l++) {
+        std::cout << (l ? "," : "") << reader.rows(l);
+    }
+    std::cout << "]}" << std::endl;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    std::string input, output, format_name;
+    double rate, freq, row_ms;
+    size_t fft_size, ffts;
+    unsigned levels;
+    bool info = false;
+
+    po::options_description desc("IQ Pyramid Options");
+    desc.add_options()
+        ("help", "Show help message")
+        ("input", po::value<std::string>(&input), "Recording (.sigmf-data or raw IQ, or .iqz); a .pyramid with --info")
+        ("output", po::value<std::string>(&output), "Pyramid file (default: <base>.pyramid)")
+        ("format", po::value<std::string>(&format_name)->default_value("cf32"), "Raw input sample format: cf32, ci16 or ci8")
+        ("rate", po::value<double>(&rate)->default_value(0), "Raw input sample rate (Hz)")
+        ("freq", po::value<double>(&freq)->default_value(0), "Centre frequency to record in the header (Hz)")
+        ("fft", po::value<size_t>(&fft_size)->default_value(1024), "FFT size (frequency bins)")
+        ("row-ms", po::value<double>(&row_ms)->default_value(50), "Time per finest row (ms)")
+        ("ffts", po::value<size_t>(&ffts)->default_value(0), "FFTs averaged per row (0 = every sample)")
+        ("levels", po::value<unsigned>(&levels)->default_value(4), "Levels including the finest (4 = 1x, 2x, 4x, 8x)")
+        ("info", po::bool_switch(&info), "Describe an existing .pyramid")
+    ;
+    po::positional_options_description positional;
+    positional.add("input", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help") || input.empty()) {
+        std::cout << "Usage: iq_pyramid <recording> [options]" << std::endl << desc << std::endl;
+        return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (info) return print_info(input);
+
+    // Either a compressed recording or raw samples described on the command line
+    const bool compressed = ends_with(input, ".iqz");
+    IqzReader iqz;
+    std::FILE* raw = nullptr;
+    SampleFormat format;
+    uint64_t samples = 0;
+    if (compressed) {
+        if (!iqz.open(input)) {
+            std::cerr << "[IQ Pyramid] ERROR: " << iqz.error() << std::endl;
+            return EXIT_FAILURE;
+        }
+        format = iqz.format();
+        rate = iqz.sample_rate();
+        samples = iqz.samples();
+        if (output.empty()) output = pyramid_path(iqz_data_path(input));
+    } else {
+        if (!parse_sample_format(format_name, format)) {
+            std::cerr << "[IQ Pyramid] ERROR: Unknown sample format '" << format_name << "' (cf32/ci16/ci8)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (rate <= 0) {
+            std::cerr << "[IQ Pyramid] ERROR: --rate is required for raw input" << std::endl;
+            return EXIT_FAILURE;
+        }
+        raw = std::fopen(input.c_str(), "rb");
+        if (!raw) {
+            std::cerr << "[IQ Pyramid] ERROR: Could not open " << input << ": " << std::strerror(errno) << std::endl;
+            return EXIT_FAILURE;
+        }
+        struct stat st;
+        if (::fstat(fileno(raw), &st) == 0) samples = st.st_size / sample_format_bytes(format);
+        if (output.empty()) output = pyramid_path(input);
+    }
+
+    PyramidOptions options;
+    options.fft_size = fft_size;
+    options.row_secs = row_ms / 1e3;
+    options.ffts_per_row = ffts;
+    options.levels = levels;
+    options.wait_for_worker = true;
+    PyramidWriter pyramid(output, rate, freq, options);
+    if (!pyramid.is_open()) {
+        std::cerr << "[IQ Pyramid] ERROR: Could not open " << output << ": " << std::strerror(pyramid.error()) << std::endl;
+        if (raw) std::fclose(raw);
+        return EXIT_FAILURE;
+    }
+
+    const size_t sample_bytes = sample_format_bytes(format);
+    const size_t chunk = (4 << 20) / sample_bytes;
+    std::vector<uint8_t> buffer(chunk * sample_bytes);
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t position = 0;
+    uint64_t next_progress = 0;
+    bool ok = true;
+    while (true) {
+        size_t got = 0;
+        if (compressed) {
+            got = static_cast<size_t>(iqz.read(position, std::min<uint64_t>(chunk, samples - position), buffer.data()));
+            if (got == 0 && position < samples) ok = false;
+        } else {
+            got = std::fread(buffer.data(), sample_bytes, chunk, raw);
+            if (got == 0 && std::ferror(raw)) ok = false;
+        }
+        if (got == 0) break;
+        pyramid.feed(buffer.data(), got, format);
+        position += got;
+        if (position >= next_progress && samples > 0) {
+            next_progress = position + samples / 20;
+            std::cerr << "\r[IQ Pyramid] " << 100 * position / samples << "%" << std::flush;
+        }
+    }
+    if (raw) std::fclose(raw);
+    ok = pyramid.close() && ok;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << std::endl;
+
+    if (!ok) {
+        std::cerr << "[IQ Pyramid] ERROR: "
+                  << (compressed && !iqz.error().empty() ? iqz.error()
+                      : pyramid.error() ? "writing " + output + " failed" : "reading " + input + " failed")
+                  << std::endl;
+    }
+    std::cout << "{\"success\":" << (ok ? "true" : "false")
+              << ",\"input\":\"" << json_escape(input) << "\""
+              << ",\"output\":\"" << json_escape(output) << "\""
+              << ",\"samples\":" << position
+              << ",\"rows\":" << pyramid.rows()
+              << ",\"fftsPerRow\":" << pyramid.ffts_per_row()
+              << ",\"seconds\":" << seconds
+              << ",\"msps\":" << (seconds > 0 ? position / 1e6 / seconds : 0.0) << "}" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
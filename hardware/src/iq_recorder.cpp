@@ -7,7 +7,47 @@
  * Usage:
  *   ./iq_recorder --freq 915e6 --rate 10e6 --gain 50 --duration 10 --output recording.dat
  * 
- * Output format: Complex float32 (I/Q interleaved)
+ * Output format: I/Q interleaved in the --format chosen (cf32 default, or
+ * the native ci16/ci8 wire samples with no float conversion; see
+ * sample_format.hpp), plus a SigMF .sigmf-meta describing it
+ *
+ * Samples are received straight into large page-aligned buffers that a
+ * writer thread flushes to disk (async_writer.hpp), so filesystem stalls
+ * never block recv(). Size the pool with --write-buffer-mb/--write-buffers
+ * to ride out the longest stall expected at the target rate.
+ * --io-backend direct|uring writes with O_DIRECT (uring: several writes in
+ * flight through io_uring) into a file preallocated for the full
+ * --duration, keeping long captures out of the page cache.
+ * --segment-secs/--segment-mb rotate the output into numbered SigMF
+ * segments without a gap (segmented_writer.hpp), --retain-mb bounds the
+ * disk they use, and --duration 0 records until Ctrl-C.
+ * The device clock is set to UTC (--time-source) and the .sigmf-meta carries
+ * the hardware time of the first sample. An overflow starts a new SigMF
+ * capture at the sample after it, stamped with that sample's hardware
+ * time and annotated with the number of samples lost, so every capture
+ * is contiguous (see sample_timeline.hpp).
+ * --compress zstd[:level]|lz4[:accel] writes losslessly compressed,
+ * seekable .iqz data instead (iq_compress.hpp), compressed block-parallel
+ * on --compress-threads workers; iq_decompress restores .sigmf-data.
+ * --ddc-offset HZ --ddc-bw HZ records one narrowband channel instead of
+ * the full band: the down-converter (ddc.hpp) mixes it to 0 Hz and
+ * decimates in the receive loop, and the file is cf32 at the reduced rate
+ * with the channel's own frequency in the .sigmf-meta.
+ *
+ * --pyramid also writes <base>.pyramid, a multi-resolution spectrogram of
+ * the recording for quick browsing (spectrogram_pyramid.hpp), computed on
+ * its own thread from the samples as they are written.
+ *
+ * --pretrigger SECS turns the recorder into a daemon that keeps the last
+ * SECS of samples in memory (pretrigger.hpp) and records only on demand.
+ * Each `trigger [post_secs]` line on stdin writes the buffered history
+ * plus --post-trigger seconds to <output>_NNN.sigmf-data; progress is
+ * reported as {"type":"trigger"} JSON lines. `stop` (or Ctrl-C) exits.
+ *
+ * --burst-threshold DB records only energy bursts (burst_capture.hpp):
+ * windows more than DB above the adaptive noise floor are written, padded
+ * by --burst-pre-ms/--burst-post-ms, to one file for --duration, each as
+ * its own SigMF capture and "burst" annotation.
  */
 
 #include <uhd/usrp/multi_usrp.hpp>
@@ -16,10 +56,22 @@
 #include <boost/program_options.hpp>
 #include <boost/format.hpp>
 #include <iostream>
-#include <fstream>
+#include <cstring>
 #include <csignal>
 #include <complex>
+#include <memory>
 #include <vector>
+#include <algorithm>
+
+#include "async_writer.hpp"
+#include "burst_capture.hpp"
+#include "ddc.hpp"
+#include "pretrigger.hpp"
+#include "spectrogram_pyramid.hpp"
+#include "sample_format.hpp"
+#include "sample_timeline.hpp"
+#include "segmented_writer.hpp"
+#include "sigmf.hpp"
 
 namespace po = boost::program_options;
 
@@ -28,14 +80,310 @@ void sig_int_handler(int) {
     stop_signal_called = true;
 }
 
+static int64_t time_spec_ns(const uhd::time_spec_t& time) {
+    return time.get_full_secs() * 1000000000LL + std::llround(time.get_frac_secs() * 1e9);
+}
+
+// Sets the device clock to UTC so rx metadata time_specs date samples:
+// from the host clock, or at a PPS edge from an external/GPSDO reference
+// (the host clock then only has to be right to the second)
+static void set_device_time(uhd::usrp::multi_usrp::sptr usrp, const std::string& time_source) {
+    if (time_source == "host") {
+        usrp->set_time_now(uhd::time_spec_t(host_time_ns() / 1e9));
+        return;
+    }
+    usrp->set_time_source(time_source);
+    const double last_pps = usrp->get_time_last_pps().get_real_secs();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(1500);
+    while (usrp->get_time_last_pps().get_real_secs() == last_pps) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            std::cerr << "[IQ Recorder] WARNING: No PPS edge on " << time_source << ", using the host clock" << std::endl;
+            usrp->set_time_now(uhd::time_spec_t(host_time_ns() / 1e9));
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // Just past an edge, so the next one is the following whole second
+    usrp->set_time_next_pps(uhd::time_spec_t(std::llround(host_time_ns() / 1e9) + 1.0));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+}
+
+// {"type":"segment"} record for each finished segment; a single output
+// file is covered by the summary instead
+static void report_segments(SegmentedWriter& outfile) {
+    SegmentEvent event;
+    while (outfile.poll(event)) {
+        if (outfile.segmented()) {
+            std::cout << std::endl << segment_event_json(event) << std::endl;
+        } else if (!event.ok) {
+            std::cerr << "[IQ Recorder] WARNING: " << event.error << std::endl;
+        }
+    }
+}
+
+// Streams into the pre-trigger history until stopped, dumping on triggers
+static int run_pretrigger_daemon(uhd::usrp::multi_usrp::sptr usrp, uhd::rx_streamer::sptr rx_stream,
+                                 const std::string& output_file, SampleFormat format,
+                                 double pretrigger, double post_trigger, size_t buffer_size) {
+    const size_t sample_bytes = sample_format_bytes(format);
+    const double actual_rate = usrp->get_rx_rate();
+
+    // The whole history is mapped and faulted in before streaming starts
+    const size_t history_bytes = static_cast<size_t>(pretrigger * actual_rate) * sample_bytes;
+    SampleHistory history(history_bytes, buffer_size * sample_bytes);
+    std::cout << boost::format("[IQ Recorder] Pre-trigger history: %.1f s, %zu MB (%s)")
+                 % pretrigger % (history.capacity() >> 20) % history.page_kind() << std::endl;
+
+    SigmfMeta meta;
+    meta.datatype = sigmf_datatype(format);
+    meta.sample_rate = actual_rate;
+    meta.description = "Triggered IQ recording from UHD device";
+    meta.recorder = "iq_recorder";
+    meta.hw = usrp->get_mboard_name();
+    SigmfCapture capture;
+    capture.frequency = usrp->get_rx_freq();
+    meta.captures.push_back(capture);
+    PretriggerDumper dumper(history, sample_bytes, actual_rate, meta);
+
+    ControlChannel control;
+    control.start();
+
+    uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+    stream_cmd.stream_now = true;
+    rx_stream->issue_stream_cmd(stream_cmd);
+
+    std::signal(SIGINT, &sig_int_handler);
+    std::cout << "[IQ Recorder] Waiting for triggers (trigger [post_secs] / stop on stdin)" << std::endl;
+
+    uhd::rx_metadata_t md;
+    ControlCommand cmd;
+    TriggerEvent event;
+    unsigned triggers = 0;
+    size_t overflows = 0;
+    bool running = true;
+    // Dates the dumps and logs overflow gaps in the history
+    SampleTimeline timeline(actual_rate);
+    bool overflowed = false;
+
+    while (running && !stop_signal_called) {
+        size_t bytes_available = 0;
+        uint8_t* dest = history.acquire(bytes_available);
+        size_t num_rx_samps = rx_stream->recv(dest, bytes_available / sample_bytes, md, 3.0);
+
+        if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
+            std::cerr << "[IQ Recorder] WARNING: Timeout waiting for samples" << std::endl;
+        } else if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW) {
+            std::cerr << "[IQ Recorder] WARNING: Overflow detected" << std::endl;
+            overflows++;
+            overflowed = true;
+        } else if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
+            std::cerr << "[IQ Recorder] ERROR: " << md.strerror() << std::endl;
+            break;
+        } else if (num_rx_samps > 0) {
+            const bool first = !timeline.started();
+            const uint64_t lost = timeline.observe(md.has_time_spec, time_spec_ns(md.time_spec), num_rx_samps, overflowed);
+            overflowed = false;
+            if (first) dumper.set_stream_start(time_point_from_ns(timeline.first_ns()));
+            history.mark_gap(lost, !md.has_time_spec);
+            history.commit(num_rx_samps * sample_bytes);
+        }
+
+        while (control.poll(cmd)) {
+            if (cmd.key == "stop") {
+                running = false;
+            } else if (cmd.key == "trigger") {
+                double post = post_trigger;
+                if (!cmd.value.empty()) {
+                    try {
+                        post = std::stod(cmd.value);
+                    } catch (const std::exception&) {
+                        event = TriggerEvent();
+                        event.status = "error";
+                        event.error = "invalid post-trigger duration '" + cmd.value + "'";
+                        std::cout << trigger_event_json(event) << std::endl;
+                        continue;
+                    }
+                }
+                dumper.trigger(trigger_file_path(output_file, triggers + 1), pretrigger, post);
+                triggers++;
+            } else {
+                event = TriggerEvent();
+                event.status = "error";
+                event.error = "unknown command '" + cmd.key + "'";
+                std::cout << trigger_event_json(event) << std::endl;
+            }
+        }
+        while (dumper.poll(event)) {
+            std::cout << trigger_event_json(event) << std::endl;
+        }
+    }
+
+    stream_cmd.stream_mode = uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS;
+    rx_stream->issue_stream_cmd(stream_cmd);
+    control.stop();
+
+    // Let a capture in progress finish with what has been received
+    dumper.finish();
+    while (dumper.poll(event)) {
+        std::cout << trigger_event_json(event) << std::endl;
+    }
+
+    std::cout << "[IQ Recorder] Daemon stopped" << std::endl;
+    if (overflows > 0) {
+        std::cout << "  Device overflows: " << overflows << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Records only the bursts the energy detector finds, for `duration` seconds
+static int run_burst_capture(uhd::usrp::multi_usrp::sptr usrp, uhd::rx_streamer::sptr rx_stream,
+                             const std::string& output_file, SampleFormat format, double duration,
+                             const BurstDetectorConfig& detector_config, double pre_secs,
+                             size_t history_bytes, size_t buffer_size) {
+    const size_t sample_bytes = sample_format_bytes(format);
+    const double actual_rate = usrp->get_rx_rate();
+    const uint64_t total_samples = duration > 0 ? static_cast<uint64_t>(duration * actual_rate) : 0;
+    const uint64_t pre_samples = static_cast<uint64_t>(pre_secs * actual_rate);
+    const uint64_t post_samples = static_cast<uint64_t>(detector_config.post_secs * actual_rate);
+
+    // The history covers the pre-burst padding plus however far the
+    // writer may fall behind (the write pool's size in normal mode)
+    SampleHistory history(history_bytes + pre_samples * sample_bytes, buffer_size * sample_bytes);
+    EnergyDetector detector(detector_config, format, actual_rate);
+    std::cout << boost::format("[IQ Recorder] Burst capture: threshold %.1f dB, window %zu samples, history %zu MB (%s)")
+                 % detector_config.threshold_db % detector_config.window
+                 % (history.capacity() >> 20) % history.page_kind() << std::endl;
+
+    SigmfMeta meta;
+    meta.datatype = sigmf_datatype(format);
+    meta.sample_rate = actual_rate;
+    meta.description = "Energy-triggered burst recording from UHD device";
+    meta.recorder = "iq_recorder";
+    meta.hw = usrp->get_mboard_name();
+    SigmfCapture capture;
+    capture.frequency = usrp->get_rx_freq();
+    meta.captures.push_back(capture);
+
+    uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+    stream_cmd.stream_now = true;
+    rx_stream->issue_stream_cmd(stream_cmd);
+    BurstWriter writer(history, output_file, sample_bytes, actual_rate, meta);
+    if (!writer.is_open()) {
+        std::cerr << "[IQ Recorder] ERROR: Failed to open output file: " << output_file << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto on_burst = [&](const EnergyDetector::Event& event) {
+        if (event.start) {
+            writer.begin(event.sample, pre_samples);
+        } else {
+            writer.end(event.sample, post_samples, event.peak_dbfs, event.floor_dbfs);
+        }
+    };
+
+    std::signal(SIGINT, &sig_int_handler);
+    std::cout << "[IQ Recorder] Recording bursts..." << std::endl;
+
+    uhd::rx_metadata_t md;
+    uint64_t samples_received = 0;
+    size_t overflows = 0;
+    uint64_t next_progress = static_cast<uint64_t>(actual_rate);
+    auto start_time = std::chrono::steady_clock::now();
+    // Dates the bursts and logs overflow gaps in the history
+    SampleTimeline timeline(actual_rate);
+    bool overflowed = false;
+
+    while (!stop_signal_called && (total_samples == 0 || samples_received < total_samples)) {
+        size_t bytes_available = 0;
+        uint8_t* dest = history.acquire(bytes_available);
+        size_t request = bytes_available / sample_bytes;
+        if (total_samples > 0) {
+            request = static_cast<size_t>(std::min<uint64_t>(request, total_samples - samples_received));
+        }
+        size_t num_rx_samps = rx_stream->recv(dest, request, md, 3.0);
+
+        if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
+            std::cerr << "[IQ Recorder] WARNING: Timeout waiting for samples" << std::endl;
+            continue;
+        }
+        if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW) {
+            std::cerr << "[IQ Recorder] WARNING: Overflow detected" << std::endl;
+            overflows++;
+            overflowed = true;
+            continue;
+        }
+        if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
+            std::cerr << "[IQ Recorder] ERROR: " << md.strerror() << std::endl;
+            break;
+        }
+        if (num_rx_samps == 0) continue;
+
+        const bool first = !timeline.started();
+        const uint64_t lost = timeline.observe(md.has_time_spec, time_spec_ns(md.time_spec), num_rx_samps, overflowed);
+        overflowed = false;
+        if (first) writer.set_stream_start(time_point_from_ns(timeline.first_ns()));
+        if (lost > 0) {
+            std::cerr << "[IQ Recorder] WARNING: " << lost << " samples lost"
+                      << (md.has_time_spec ? "" : " (host clock estimate)") << std::endl;
+        }
+        history.mark_gap(lost, !md.has_time_spec);
+        history.commit(num_rx_samps * sample_bytes);
+        detector.process(dest, num_rx_samps, on_burst);
+        samples_received += num_rx_samps;
+
+        if (samples_received >= next_progress) {
+            next_progress += static_cast<uint64_t>(actual_rate);
+            std::cout << boost::format("\r[IQ Recorder] Progress: %.1f%%, %zu bursts, %.2f%% of samples kept, floor %.1f dBFS")
+                         % (total_samples ? 100.0 * samples_received / total_samples : 0.0) % writer.bursts()
+                         % (100.0 * writer.samples_written() / samples_received)
+                         % detector.floor_dbfs() << std::flush;
+        }
+    }
+    std::cout << std::endl;
+
+    stream_cmd.stream_mode = uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS;
+    rx_stream->issue_stream_cmd(stream_cmd);
+    detector.flush(on_burst);
+    const bool write_ok = writer.finish();
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::cout << "[IQ Recorder] Burst capture complete!" << std::endl;
+    std::cout << "  Duration: " << elapsed << " seconds" << std::endl;
+    std::cout << "  Bursts: " << writer.bursts() << std::endl;
+    std::cout << boost::format("  Samples kept: %llu of %llu (%.3f%%)")
+                 % writer.samples_written() % samples_received
+                 % (samples_received ? 100.0 * writer.samples_written() / samples_received : 0.0) << std::endl;
+    std::cout << "  Output: " << output_file << std::endl;
+    if (overflows > 0) {
+        std::cout << "  Device overflows: " << overflows << std::endl;
+    }
+    if (writer.lost_samples() > 0) {
+        std::cerr << "[IQ Recorder] WARNING: Disk fell behind, lost " << writer.lost_samples()
+                  << " burst samples" << std::endl;
+    }
+    if (!write_ok) {
+        std::cerr << "[IQ Recorder] ERROR: Writing " << output_file << " failed: "
+                  << std::strerror(writer.error()) << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
 int UHD_SAFE_MAIN(int argc, char *argv[]) {
     // Set thread priority
     uhd::set_thread_priority_safe();
 
     // Command line options
-    std::string device_args, output_file;
-    double freq, rate, gain, duration;
-    size_t buffer_size;
+    std::string device_args, output_file, io_backend_name, format_name;
+    std::string compress_name, compress_transform, time_source;
+    double freq, rate, gain, duration, pretrigger, post_trigger;
+    double burst_threshold, burst_pre_ms, burst_post_ms, burst_floor_secs;
+    double segment_secs, segment_mb, retain_mb, ddc_offset, ddc_bw, pyramid_row_ms;
+    size_t burst_window, pyramid_fft, pyramid_ffts;
+    bool pyramid = false;
+    size_t buffer_size, write_buffer_mb, write_buffers;
+    size_t compress_block_kb;
+    unsigned compress_threads;
 
     po::options_description desc("IQ Recorder Options");
     desc.add_options()
@@ -44,9 +392,34 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
         ("freq", po::value<double>(&freq)->default_value(915e6), "Center frequency (Hz)")
         ("rate", po::value<double>(&rate)->default_value(10e6), "Sample rate (Hz)")
         ("gain", po::value<double>(&gain)->default_value(50), "RX gain (dB)")
-        ("duration", po::value<double>(&duration)->default_value(10.0), "Recording duration (seconds)")
+        ("time-source", po::value<std::string>(&time_source)->default_value("host"), "Device time for sample timestamps: host (NTP), external or gpsdo (PPS-aligned UTC)")
+        ("duration", po::value<double>(&duration)->default_value(10.0), "Recording duration (seconds, 0 = until Ctrl-C)")
         ("output", po::value<std::string>(&output_file)->default_value("recording.dat"), "Output file path")
+        ("format", po::value<std::string>(&format_name)->default_value("cf32"), "Sample format on disk: cf32, ci16 (native sc16) or ci8 (sc8 wire format)")
         ("buffer", po::value<size_t>(&buffer_size)->default_value(8192), "Buffer size (samples)")
+        ("write-buffer-mb", po::value<size_t>(&write_buffer_mb)->default_value(32), "Size of each disk write buffer (MB)")
+        ("write-buffers", po::value<size_t>(&write_buffers)->default_value(8), "Number of disk write buffers")
+        ("io-backend", po::value<std::string>(&io_backend_name)->default_value("buffered"), "Disk writes: buffered, direct (O_DIRECT) or uring (O_DIRECT + io_uring)")
+        ("segment-secs", po::value<double>(&segment_secs)->default_value(0), "Rotate to a new numbered SigMF segment every N seconds (0 = one file)")
+        ("segment-mb", po::value<double>(&segment_mb)->default_value(0), "Rotate to a new segment every N MB (0 = one file)")
+        ("retain-mb", po::value<double>(&retain_mb)->default_value(0), "Delete the oldest segments beyond this many MB (0 = keep all)")
+        ("compress", po::value<std::string>(&compress_name)->default_value("none"), "Lossless compression to .iqz: zstd[:level], lz4[:acceleration] or none")
+        ("compress-transform", po::value<std::string>(&compress_transform)->default_value("shuffle"), "Before compressing: shuffle (byte planes), delta (+ shuffle) or none")
+        ("compress-threads", po::value<unsigned>(&compress_threads)->default_value(0), "Compression worker threads (0 = one per core, less one)")
+        ("compress-block-kb", po::value<size_t>(&compress_block_kb)->default_value(1024), "Compression block size (KB); each block is independently decodable")
+        ("ddc-offset", po::value<double>(&ddc_offset)->default_value(0), "Down-convert: channel centre relative to --freq (Hz)")
+        ("ddc-bw", po::value<double>(&ddc_bw)->default_value(0), "Down-convert: record only this bandwidth around --ddc-offset, decimated (Hz, 0 = full band)")
+        ("pyramid", po::bool_switch(&pyramid), "Also write <base>.pyramid, a multi-resolution spectrogram overview")
+        ("pyramid-fft", po::value<size_t>(&pyramid_fft)->default_value(1024), "Pyramid: FFT size (frequency bins)")
+        ("pyramid-row-ms", po::value<double>(&pyramid_row_ms)->default_value(50), "Pyramid: time per finest row (ms)")
+        ("pyramid-ffts", po::value<size_t>(&pyramid_ffts)->default_value(32), "Pyramid: FFTs averaged per row (0 = every sample)")
+        ("pretrigger", po::value<double>(&pretrigger)->default_value(0), "Daemon mode: keep this many seconds in memory and record on 'trigger' commands")
+        ("post-trigger", po::value<double>(&post_trigger)->default_value(5.0), "Daemon mode: seconds recorded after each trigger")
+        ("burst-threshold", po::value<double>(&burst_threshold)->default_value(0), "Record only bursts this many dB above the noise floor (0 = record everything)")
+        ("burst-pre-ms", po::value<double>(&burst_pre_ms)->default_value(1.0), "Burst mode: padding kept before each burst (ms)")
+        ("burst-post-ms", po::value<double>(&burst_post_ms)->default_value(1.0), "Burst mode: padding after each burst; quieter gaps close it (ms)")
+        ("burst-window", po::value<size_t>(&burst_window)->default_value(1024), "Burst mode: samples per power measurement")
+        ("burst-floor-secs", po::value<double>(&burst_floor_secs)->default_value(10.0), "Burst mode: time for the noise floor to rise by one threshold")
     ;
 
     po::variables_map vm;
@@ -58,12 +431,57 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
         return EXIT_SUCCESS;
     }
 
+    SampleFormat format;
+    if (!parse_sample_format(format_name, format)) {
+        std::cerr << "[IQ Recorder] ERROR: Unknown sample format '" << format_name
+                  << "' (cf32/ci16/ci8)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const size_t sample_bytes = sample_format_bytes(format);
+
+    AsyncWriterOptions write_options;
+    if (!parse_write_backend(io_backend_name, write_options.backend)) {
+        std::cerr << "[IQ Recorder] ERROR: Unknown I/O backend '" << io_backend_name
+                  << "' (buffered/direct/uring)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    write_options.buffer_bytes = write_buffer_mb << 20;
+    write_options.num_buffers = write_buffers;
+
+    IqCompressOptions compress_options;
+    if (!parse_iq_codec(compress_name, compress_options.codec, compress_options.level)
+        || !parse_iq_transform(compress_transform, compress_options.transform)) {
+        std::cerr << "[IQ Recorder] ERROR: Unknown compression '" << compress_name << "' / '" << compress_transform
+                  << "' (zstd[:level]/lz4[:accel]/none, shuffle/delta/none)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!iq_codec_available(compress_options.codec)) {
+        std::cerr << "[IQ Recorder] ERROR: Built without " << iq_codec_name(compress_options.codec) << std::endl;
+        return EXIT_FAILURE;
+    }
+    compress_options.threads = compress_threads;
+    compress_options.block_bytes = std::max<size_t>(1, compress_block_kb) << 10;
+    const bool compress = compress_options.codec != IqCodec::None;
+    if (compress && (pretrigger > 0 || burst_threshold > 0)) {
+        std::cerr << "[IQ Recorder] WARNING: --compress applies to continuous recordings only; ignored" << std::endl;
+    }
+    if (ddc_bw > 0 && (pretrigger > 0 || burst_threshold > 0)) {
+        std::cerr << "[IQ Recorder] WARNING: --ddc-bw applies to continuous recordings only; ignored" << std::endl;
+    }
+    if (pyramid && (pretrigger > 0 || burst_threshold > 0)) {
+        std::cerr << "[IQ Recorder] WARNING: --pyramid applies to continuous recordings only; ignored" << std::endl;
+    }
+
     std::cout << "[IQ Recorder] Starting..." << std::endl;
     std::cout << "  Frequency: " << freq / 1e6 << " MHz" << std::endl;
     std::cout << "  Sample Rate: " << rate / 1e6 << " MSPS" << std::endl;
     std::cout << "  RX Gain: " << gain << " dB" << std::endl;
-    std::cout << "  Duration: " << duration << " seconds" << std::endl;
-    std::cout << "  Output: " << output_file << std::endl;
+    if (pretrigger > 0) {
+        std::cout << "  Pre-trigger: " << pretrigger << " s, post-trigger: " << post_trigger << " s" << std::endl;
+    } else {
+        std::cout << "  Duration: " << duration << " seconds" << std::endl;
+    }
+    std::cout << "  Output: " << output_file << " (" << sample_format_name(format) << ")" << std::endl;
 
     // Create USRP device
     std::cout << "[IQ Recorder] Creating USRP device..." << std::endl;
@@ -88,32 +506,128 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     // Set antenna
     usrp->set_rx_antenna("TX/RX");
 
+    set_device_time(usrp, time_source);
+    std::cout << "[IQ Recorder] Device time: " << iso8601_utc(time_point_from_ns(time_spec_ns(usrp->get_time_now())))
+              << " (" << time_source << ")" << std::endl;
+
     // Allow time for device to settle
     std::this_thread::sleep_for(std::chrono::seconds(1));
 
-    // Create RX streamer
-    uhd::stream_args_t stream_args("fc32", "sc16");
+    // Create RX streamer; ci16/ci8 keep the device's integer samples as-is
+    uhd::stream_args_t stream_args(uhd_cpu_format(format), uhd_wire_format(format));
     uhd::rx_streamer::sptr rx_stream = usrp->get_rx_stream(stream_args);
 
-    // Open output file
-    std::ofstream outfile(output_file, std::ios::binary);
+    if (pretrigger > 0) {
+        return run_pretrigger_daemon(usrp, rx_stream, output_file, format, pretrigger, post_trigger, buffer_size);
+    }
+    if (burst_threshold > 0) {
+        BurstDetectorConfig detector_config;
+        detector_config.window = std::max<size_t>(1, burst_window);
+        detector_config.threshold_db = burst_threshold;
+        detector_config.floor_secs = burst_floor_secs;
+        detector_config.post_secs = burst_post_ms / 1e3;
+        return run_burst_capture(usrp, rx_stream, output_file, format, duration, detector_config,
+                                 burst_pre_ms / 1e3, write_options.buffer_bytes * write_options.num_buffers,
+                                 buffer_size);
+    }
+
+    // Calculate total samples to record (0 = until stopped)
+    const uint64_t total_samples = duration > 0 ? static_cast<uint64_t>(duration * actual_rate) : 0;
+    uint64_t samples_recorded = 0;
+
+    // With --ddc-bw the file holds the down-converter's cf32 output, so
+    // everything on the writer side is at the output rate
+    std::unique_ptr<Ddc> ddc;
+    std::vector<float> narrowband;
+    if (ddc_bw > 0) {
+        ddc = std::make_unique<Ddc>(actual_rate, ddc_offset, ddc_bw);
+        if (!ddc->valid()) {
+            std::cerr << "[IQ Recorder] ERROR: " << ddc->error() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << boost::format("[IQ Recorder] DDC: %.6f MHz, %.1f kHz wide -> %.1f kS/s (/%u: %s)")
+                     % ((actual_freq + ddc->offset()) / 1e6) % (ddc_bw / 1e3) % (ddc->output_rate() / 1e3)
+                     % ddc->decimation() % ddc->describe() << std::endl;
+    }
+    const SampleFormat file_format = ddc ? SampleFormat::Cf32 : format;
+    const size_t file_sample_bytes = sample_format_bytes(file_format);
+    const double file_rate = ddc ? ddc->output_rate() : actual_rate;
+
+    SegmentOptions segment_options;
+    segment_options.sample_bytes = file_sample_bytes;
+    segment_options.sample_rate = file_rate;
+    segment_options.total_samples = ddc ? total_samples / ddc->decimation() : total_samples;
+    if (segment_secs > 0) {
+        segment_options.segment_samples = static_cast<uint64_t>(segment_secs * file_rate);
+    } else if (segment_mb > 0) {
+        segment_options.segment_samples = static_cast<uint64_t>(segment_mb * (1 << 20)) / file_sample_bytes;
+    }
+    segment_options.retain_bytes = static_cast<uint64_t>(retain_mb * (1 << 20));
+    segment_options.compress = compress;
+    segment_options.compression = compress_options;
+    segment_options.format = file_format;
+
+    SigmfMeta meta;
+    meta.datatype = sigmf_datatype(file_format);
+    meta.sample_rate = file_rate;
+    meta.description = ddc ? "Down-converted IQ recording from UHD device" : "IQ recording from UHD device";
+    meta.recorder = "iq_recorder";
+    meta.hw = usrp->get_mboard_name();
+    SigmfCapture capture;
+    capture.frequency = ddc ? actual_freq + ddc->offset() : actual_freq;
+    meta.captures.push_back(capture);
+
+    // Open output file (or first segment, with the next one pre-opened),
+    // preallocated; buffers are allocated and faulted in before streaming
+    SegmentedWriter outfile(output_file, write_options, segment_options, meta);
     if (!outfile.is_open()) {
         std::cerr << "[IQ Recorder] ERROR: Failed to open output file: " << output_file << std::endl;
         return EXIT_FAILURE;
     }
+    std::cout << "[IQ Recorder] Disk writes: " << write_backend_name(outfile.current().backend()) << std::endl;
+    if (!outfile.current().backend_note().empty()) {
+        std::cerr << "[IQ Recorder] WARNING: " << outfile.current().backend_note() << std::endl;
+    }
+    if (outfile.segmented()) {
+        std::cout << boost::format("[IQ Recorder] Segments of %llu samples, first: %s")
+                     % segment_options.segment_samples % outfile.current_path() << std::endl;
+    }
+    if (outfile.compressed()) {
+        std::cout << boost::format("[IQ Recorder] Compression: %s level %d, %s, %u threads, %zu KB blocks -> %s")
+                     % iq_codec_name(compress_options.codec) % compress_options.level
+                     % iq_transform_name(compress_options.transform) % outfile.compress_threads()
+                     % (compress_options.block_bytes >> 10) % outfile.current_path() << std::endl;
+    }
+
+    // The pyramid indexes what goes into the file, by its global index
+    std::unique_ptr<PyramidWriter> overview;
+    if (pyramid) {
+        PyramidOptions pyramid_options;
+        pyramid_options.fft_size = pyramid_fft;
+        pyramid_options.row_secs = pyramid_row_ms / 1e3;
+        pyramid_options.ffts_per_row = pyramid_ffts;
+        overview = std::make_unique<PyramidWriter>(pyramid_path(output_file), file_rate, capture.frequency, pyramid_options);
+        if (!overview->is_open()) {
+            std::cerr << "[IQ Recorder] ERROR: Failed to open " << overview->path() << ": "
+                      << std::strerror(overview->error()) << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << boost::format("[IQ Recorder] Pyramid: %zu bins, %.1f ms rows of %zu FFTs -> %s")
+                     % pyramid_fft % (overview->row_samples() * 1e3 / file_rate) % overview->ffts_per_row()
+                     % overview->path() << std::endl;
+    }
 
     // Setup streaming
     uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
     stream_cmd.stream_now = true;
     rx_stream->issue_stream_cmd(stream_cmd);
 
-    // Allocate buffer
-    std::vector<std::complex<float>> buffer(buffer_size);
+    // Scratch buffer, only used while every write buffer is queued
+    std::vector<uint8_t> buffer(buffer_size * sample_bytes);
     uhd::rx_metadata_t md;
-
-    // Calculate total samples to record
-    size_t total_samples = static_cast<size_t>(duration * actual_rate);
-    size_t samples_recorded = 0;
+    size_t overflows = 0;
+    bool overflowed = false;
+    SampleTimeline timeline(actual_rate);
 
     // Register signal handler
     std::signal(SIGINT, &sig_int_handler);
@@ -123,8 +637,20 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     auto start_time = std::chrono::steady_clock::now();
 
     // Recording loop
-    while (!stop_signal_called && samples_recorded < total_samples) {
-        size_t num_rx_samps = rx_stream->recv(&buffer.front(), buffer.size(), md, 3.0);
+    while (!stop_signal_called && (total_samples == 0 || samples_recorded < total_samples)) {
+        // The DDC reads from the scratch buffer and writes its much smaller
+        // output through SegmentedWriter::write()
+        size_t bytes_available = 0;
+        void* dest = ddc ? nullptr : outfile.acquire(bytes_available);
+        size_t request = total_samples == 0 ? buffer_size
+                                            : static_cast<size_t>(std::min<uint64_t>(buffer_size, total_samples - samples_recorded));
+        void* rx_buffer = buffer.data();
+        if (dest) {
+            request = std::min(request, bytes_available / sample_bytes);
+            rx_buffer = dest;
+        }
+
+        size_t num_rx_samps = rx_stream->recv(rx_buffer, request, md, 3.0);
 
         if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
             std::cerr << "[IQ Recorder] WARNING: Timeout waiting for samples" << std::endl;
@@ -132,6 +658,8 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
         }
         if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW) {
             std::cerr << "[IQ Recorder] WARNING: Overflow detected" << std::endl;
+            overflows++;
+            overflowed = true;
             continue;
         }
         if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
@@ -139,19 +667,53 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
             break;
         }
 
-        // Write samples to file
-        outfile.write(reinterpret_cast<const char*>(&buffer.front()), 
-                      num_rx_samps * sizeof(std::complex<float>));
+        if (num_rx_samps == 0) continue;
+
+        // The first sample's hardware time dates the recording; after an
+        // overflow it says how many samples the device skipped
+        const bool first = !timeline.started();
+        const uint64_t lost = timeline.observe(md.has_time_spec, time_spec_ns(md.time_spec), num_rx_samps, overflowed);
+        overflowed = false;
+        if (first) {
+            // The DDC's first output is centred delay() input samples in
+            const int64_t offset_ns = ddc ? ddc->delay_ns() : 0;
+            outfile.set_stream_start(time_point_from_ns(timeline.first_ns() + offset_ns));
+        }
+        if (lost > 0) {
+            std::cerr << "[IQ Recorder] WARNING: " << lost << " samples lost, starting a new SigMF capture" << std::endl;
+            const uint64_t file_lost = ddc ? ddc->skip(lost) : lost;
+            outfile.mark_overflow(file_lost, !md.has_time_spec);
+            if (overview) overview->skip(file_lost);
+        }
+
+        // Hand samples to the writer thread (the pyramid copies what it
+        // needs first: committed buffers belong to the writer)
+        if (ddc) {
+            const size_t produced = ddc->process(rx_buffer, num_rx_samps, format, narrowband);
+            if (overview) overview->feed(narrowband.data(), produced, file_format);
+            outfile.write(narrowband.data(), produced * file_sample_bytes);
+        } else {
+            if (overview) overview->feed(rx_buffer, num_rx_samps, format);
+            if (dest) {
+                outfile.commit(num_rx_samps * sample_bytes);
+            } else {
+                outfile.mark_dropped(num_rx_samps * sample_bytes);
+            }
+        }
 
         samples_recorded += num_rx_samps;
 
+        report_segments(outfile);
+
         // Progress update every second
         auto now = std::chrono::steady_clock::now();
         auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
-        if (elapsed > 0 && samples_recorded % static_cast<size_t>(actual_rate) < buffer_size) {
-            double progress = 100.0 * samples_recorded / total_samples;
-            std::cout << boost::format("\r[IQ Recorder] Progress: %.1f%% (%zu / %zu samples)") 
-                         % progress % samples_recorded % total_samples << std::flush;
+        if (elapsed > 0 && samples_recorded % static_cast<size_t>(actual_rate) < num_rx_samps) {
+            const double progress = total_samples ? 100.0 * samples_recorded / total_samples : 0.0;
+            std::cout << boost::format("\r[IQ Recorder] Progress: %.1f%% (%llu samples), segment %u, write queue %zu/%zu, %.0f MB/s")
+                         % progress % samples_recorded % outfile.segments()
+                         % outfile.current().buffers_queued() % outfile.current().buffers()
+                         % (outfile.bytes_written() / 1e6 / elapsed) << std::flush;
         }
     }
 
@@ -161,8 +723,13 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     stream_cmd.stream_mode = uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS;
     rx_stream->issue_stream_cmd(stream_cmd);
 
-    // Close output file
-    outfile.close();
+    // Drain the write queue and close the output file, then describe it
+    // (per segment) for SigMF readers
+    const size_t buffers = outfile.current().buffers();
+    const size_t buffer_mb = outfile.current().buffer_bytes() >> 20;
+    const bool write_ok = outfile.close();
+    report_segments(outfile);
+    const bool pyramid_ok = !overview || overview->close();
 
     auto end_time = std::chrono::steady_clock::now();
     auto recording_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() / 1000.0;
@@ -170,8 +737,50 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     std::cout << "[IQ Recorder] Recording complete!" << std::endl;
     std::cout << "  Samples recorded: " << samples_recorded << std::endl;
     std::cout << "  Duration: " << recording_duration << " seconds" << std::endl;
-    std::cout << "  File size: " << (samples_recorded * sizeof(std::complex<float>) / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << "  File size: " << (outfile.bytes_written() / 1024.0 / 1024.0) << " MB" << std::endl;
     std::cout << "  Output: " << output_file << std::endl;
+    if (outfile.segmented()) {
+        std::cout << "  Segments: " << outfile.segments() << std::endl;
+    }
+    if (outfile.compressed() && outfile.raw_bytes() > 0) {
+        std::cout << boost::format("  Compression: %.1f MB -> %.1f MB (%.1f%%), %.0f MB/s per thread")
+                     % (outfile.raw_bytes() / 1e6) % (outfile.bytes_written() / 1e6)
+                     % (100.0 * outfile.bytes_written() / outfile.raw_bytes())
+                     % (outfile.compress_seconds() > 0 ? outfile.raw_bytes() / 1e6 / outfile.compress_seconds() : 0.0)
+                  << std::endl;
+    }
+    std::cout << boost::format("  Disk: %.1f MB/s sustained, %.1f MB/s while writing, peak queue %zu/%zu x %zu MB")
+                 % (outfile.bytes_written() / 1e6 / recording_duration)
+                 % (outfile.busy_seconds() > 0 ? outfile.bytes_written() / 1e6 / outfile.busy_seconds() : 0.0)
+                 % outfile.buffers_peak() % buffers % buffer_mb << std::endl;
+    std::cout << boost::format("  Write latency: p50 %.2f ms, p99 %.2f ms, max %.2f ms")
+                 % (outfile.write_latency().percentile(50) / 1e6)
+                 % (outfile.write_latency().percentile(99) / 1e6)
+                 % (outfile.write_latency().max() / 1e6) << std::endl;
+    if (overflows > 0 || outfile.gaps() > 0) {
+        std::cout << "  Device overflows: " << overflows << ", " << outfile.gaps() << " SigMF captures started after "
+                  << outfile.lost_samples() << " lost samples" << std::endl;
+    }
+    if (overview) {
+        std::cout << "  Pyramid: " << overview->rows() << " rows -> " << overview->path() << std::endl;
+        if (overview->rows_skipped() > 0) {
+            std::cerr << "[IQ Recorder] WARNING: Pyramid fell behind, " << overview->rows_skipped()
+                      << " rows left empty" << std::endl;
+        }
+        if (!pyramid_ok) {
+            std::cerr << "[IQ Recorder] WARNING: Writing " << overview->path() << " failed: "
+                      << std::strerror(overview->error()) << std::endl;
+        }
+    }
+    if (outfile.dropped_bytes() > 0) {
+        std::cerr << "[IQ Recorder] WARNING: Write queue full, dropped "
+                  << outfile.dropped_bytes() / file_sample_bytes << " samples" << std::endl;
+    }
+    if (!write_ok) {
+        std::cerr << "[IQ Recorder] ERROR: Writing " << output_file << " failed: "
+                  << std::strerror(outfile.error()) << std::endl;
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,89 @@
+/**
+ * latency_histogram.hpp - Fixed-size log-linear latency histogram
+ *
+ * HDR-style bucketing: values below 64 get exact buckets, larger values
+ * get 32 linear sub-buckets per power of two, so every recorded value is
+ * kept to within ~3% across the full uint64 range in a constant 15 KB.
+ * Recording is a few shifts and an increment, cheap enough for per-block
+ * use on hot threads; tails (p99, p99.9, max) come out without storing
+ * samples.
+ *
+ * Not thread-safe: each thread records into its own histogram and readers
+ * merge() or copy them once the owner is done (or hands over a snapshot).
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+class LatencyHistogram {
+public:
+    void record(uint64_t value) {
+        counts_[bucket_of(value)]++;
+        count_++;
+        sum_ += static_cast<double>(value);
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BUCKETS; i++) counts_[i] += other.counts_[i];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    void reset() { *this = LatencyHistogram(); }
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? sum_ / count_ : 0.0; }
+
+    // Smallest recorded-equivalent value with at least p% of samples at or
+    // below it (p in [0, 100]); reported as the bucket's upper bound
+    uint64_t percentile(double p) const {
+        if (count_ == 0) return 0;
+        const double wanted = std::max(1.0, std::min(p, 100.0) / 100.0 * static_cast<double>(count_));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += counts_[i];
+            if (static_cast<double>(seen) >= wanted) return std::min(upper_bound_of(i), max_);
+        }
+        return max_;
+    }
+
+private:
+    static constexpr unsigned SUB_BITS = 5;                     // 32 sub-buckets per octave
+    static constexpr uint64_t EXACT = 2ull << SUB_BITS;         // Values below this are exact
+    static constexpr size_t BUCKETS = EXACT + (63 - SUB_BITS) * (1ull << SUB_BITS);
+
+    static size_t bucket_of(uint64_t value) {
+        if (value < EXACT) return static_cast<size_t>(value);
+        const unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+        const unsigned shift = msb - SUB_BITS;
+        const uint64_t sub = (value >> shift) - (1ull << SUB_BITS);
+        return static_cast<size_t>(EXACT + (shift - 1) * (1ull << SUB_BITS) + sub);
+    }
+
+    static uint64_t upper_bound_of(size_t bucket) {
+        if (bucket < EXACT) return bucket;
+        const size_t rel = bucket - EXACT;
+        const unsigned shift = static_cast<unsigned>(rel >> SUB_BITS) + 1;
+        const uint64_t sub = (rel & ((1ull << SUB_BITS) - 1)) + (1ull << SUB_BITS);
+        if (shift + SUB_BITS + 1 >= 64 && sub + 1 == (2ull << SUB_BITS)) {
+            return std::numeric_limits<uint64_t>::max();
+        }
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::array<uint64_t, BUCKETS> counts_{};
+    uint64_t count_ = 0;
+    double sum_ = 0.0;
+    uint64_t min_ = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ = 0;
+};
@@ -0,0 +1,134 @@
+/**
+ * panorama.hpp - Stitches per-step scanner spectra into one wideband spectrum
+ *
+ * The output grid is fixed before the sweep starts: bin i sits at
+ * start + i * bin_hz, with bin_hz = sample_rate / fft_size, so every
+ * step's bins land on the same grid and a band renders as one array. Steps
+ * are planned so their usable parts overlap by `overlap`:
+ *
+ *   - `edge_trim` (fraction of the span, per side) is dropped where the
+ *     analog anti-alias filter rolls off
+ *   - bins within `dc_blank_bins` of DC are dropped (LO leakage / DC offset)
+ *   - grid bins covered by several steps average them in linear power
+ *   - grid bins nobody covered (blanked DC with too little overlap) are
+ *     interpolated in dB from their neighbours
+ *
+ * The stitched result fits a spectrum frame directly: center_freq() and
+ * span() describe the grid the same way center frequency and sample rate
+ * describe a single shifted FFT.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+struct PanoramaConfig {
+    double start_freq = 0.0;
+    double stop_freq = 0.0;
+    double sample_rate = 0.0;
+    size_t fft_size = 0;
+    double overlap = 0.25;       // Fraction of the usable span shared by neighbours
+    double edge_trim = 0.1;      // Fraction of the span dropped at each edge
+    size_t dc_blank_bins = 2;    // Bins with |k - DC| < this are dropped
+};
+
+class PanoramaStitcher {
+public:
+    explicit PanoramaStitcher(const PanoramaConfig& config)
+        : config_(config), bin_hz_(config.sample_rate / config.fft_size) {
+        const double span = std::max(0.0, config_.stop_freq - config_.start_freq);
+        num_bins_ = static_cast<size_t>(std::floor(span / bin_hz_)) + 1;
+        sum_.assign(num_bins_, 0.0);
+        count_.assign(num_bins_, 0);
+
+        const size_t n = config_.fft_size;
+        trim_bins_ = std::min(static_cast<size_t>(std::lround(config_.edge_trim * n)), n / 2 - 1);
+        const size_t usable = n - 2 * trim_bins_;
+        const double overlap = std::min(std::max(config_.overlap, 0.0), 0.95);
+        step_bins_ = std::max<size_t>(1, static_cast<size_t>(usable * (1.0 - overlap)));
+    }
+
+    // Tuning plan: centres on the grid, first usable bin at start_freq,
+    // last step's usable part reaching stop_freq
+    std::vector<double> plan_steps() const {
+        const size_t n = config_.fft_size;
+        const double low_edge = (static_cast<double>(n / 2) - trim_bins_) * bin_hz_;
+        const double high_edge = (static_cast<double>(n - trim_bins_ - 1) - n / 2) * bin_hz_;
+
+        std::vector<double> centers;
+        for (double center = config_.start_freq + low_edge;; center += step_bins_ * bin_hz_) {
+            centers.push_back(center);
+            if (center + high_edge >= config_.stop_freq) break;
+        }
+        return centers;
+    }
+
+    // Adds one step's shifted linear power spectrum (fft_size bins) tuned to
+    // `center_freq`; `blocks` is the number of FFTs averaged into it
+    void add(double center_freq, const float* power, size_t blocks = 1) {
+        if (blocks == 0) return;
+        const size_t n = config_.fft_size;
+        const double first = (center_freq - config_.start_freq) / bin_hz_ - static_cast<double>(n / 2);
+
+        for (size_t k = trim_bins_; k < n - trim_bins_; k++) {
+            const size_t from_dc = k > n / 2 ? k - n / 2 : n / 2 - k;
+            if (from_dc < config_.dc_blank_bins) continue;
+
+            const long long g = std::llround(first + static_cast<double>(k));
+            if (g < 0 || g >= static_cast<long long>(num_bins_)) continue;
+            sum_[g] += power[k];
+            count_[g]++;
+        }
+        fft_count_ += blocks;
+    }
+
+    // Stitched spectrum in dB (+ offset_db); returns the number of grid bins
+    // that had to be interpolated because no step covered them
+    size_t finish(std::vector<float>& db, double offset_db = 0.0) const {
+        db.assign(num_bins_, 0.0f);
+        std::vector<size_t> covered;
+        for (size_t i = 0; i < num_bins_; i++) {
+            if (count_[i] == 0) continue;
+            db[i] = static_cast<float>(10.0 * std::log10(sum_[i] / count_[i] + 1e-20) + offset_db);
+            covered.push_back(i);
+        }
+        if (covered.empty()) {
+            std::fill(db.begin(), db.end(), static_cast<float>(-200.0 + offset_db));
+            return num_bins_;
+        }
+
+        // Fill holes linearly between covered neighbours, flat past the ends
+        std::fill(db.begin(), db.begin() + covered.front(), db[covered.front()]);
+        std::fill(db.begin() + covered.back() + 1, db.end(), db[covered.back()]);
+        for (size_t c = 1; c < covered.size(); c++) {
+            const size_t lo = covered[c - 1];
+            const size_t hi = covered[c];
+            for (size_t i = lo + 1; i < hi; i++) {
+                const float t = static_cast<float>(i - lo) / static_cast<float>(hi - lo);
+                db[i] = db[lo] + t * (db[hi] - db[lo]);
+            }
+        }
+        return num_bins_ - covered.size();
+    }
+
+    size_t num_bins() const { return num_bins_; }
+    double bin_hz() const { return bin_hz_; }
+    double start_freq() const { return config_.start_freq; }
+    // Frame description: bin i = center_freq() + (i - num_bins / 2) * span() / num_bins
+    double center_freq() const { return config_.start_freq + static_cast<double>(num_bins_ / 2) * bin_hz_; }
+    double span() const { return num_bins_ * bin_hz_; }
+    size_t fft_count() const { return fft_count_; }
+
+private:
+    PanoramaConfig config_;
+    double bin_hz_;
+    size_t num_bins_ = 0;
+    size_t trim_bins_ = 0;
+    size_t step_bins_ = 1;
+    size_t fft_count_ = 0;
+    std::vector<double> sum_;
+    std::vector<size_t> count_;
+};
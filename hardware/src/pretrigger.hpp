@@ -0,0 +1,535 @@
+/**
+ * pretrigger.hpp - Pre-trigger history and triggered dumps for the recorders
+ *
+ * In pre-trigger mode a recorder streams continuously into SampleHistory,
+ * a circular buffer holding the last N seconds of samples. A trigger
+ * (control command) starts a capture that begins up to N seconds in the
+ * past and runs for a post-trigger duration; PretriggerDumper writes it
+ * from the history to a SigMF recording on its own thread while the
+ * receive loop carries on filling the ring, so pre- and post-trigger
+ * samples come out as one gap-free run. A trigger that arrives while a
+ * capture is still running extends it instead of starting a second file.
+ *
+ * The ring is allocated and faulted in once at startup, from explicit
+ * hugepages (MAP_HUGETLB) when the pool has room and transparent
+ * hugepages otherwise, which keeps TLB misses down when the dumper
+ * sweeps gigabytes of history.
+ *
+ * Device overflows are logged in the history as gaps (mark_gap()), with
+ * the samples the receive loop's SampleTimeline says were skipped. A dump
+ * starts a new SigMF capture at every gap it spans, with its own
+ * core:global_index and datetime and an "overflow" annotation, as
+ * SegmentedWriter does; datetimes are set_stream_start() + the stream
+ * position (gaps included) / rate.
+ *
+ * The dumper must stay within the ring: if the disk falls so far behind
+ * that the receive loop laps unwritten history, the overwritten span is
+ * skipped and reported as lost instead of writing torn data, and the dump
+ * continues in a new capture.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "control_channel.hpp"
+#include "sigmf.hpp"
+
+inline bool write_all(int fd, const uint8_t* data, size_t bytes) {
+    while (bytes > 0) {
+        const ssize_t n = ::write(fd, data, bytes);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        bytes -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Anonymous mapping backed by hugepages where possible, populated up front
+class HugePageBuffer {
+public:
+    static constexpr size_t HUGE_PAGE = size_t(2) << 20;
+
+    explicit HugePageBuffer(size_t bytes) : size_((bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE) {
+        void* ptr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        if (ptr != MAP_FAILED) {
+            explicit_huge_ = true;
+        } else {
+            ptr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED) throw std::bad_alloc();
+            transparent_huge_ = ::madvise(ptr, size_, MADV_HUGEPAGE) == 0;
+            // Fault every page in now, not on the receive thread
+            std::memset(ptr, 0, size_);
+        }
+        data_ = static_cast<uint8_t*>(ptr);
+    }
+
+    ~HugePageBuffer() { ::munmap(data_, size_); }
+
+    HugePageBuffer(const HugePageBuffer&) = delete;
+    HugePageBuffer& operator=(const HugePageBuffer&) = delete;
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    const char* page_kind() const {
+        return explicit_huge_ ? "hugetlb" : transparent_huge_ ? "transparent hugepages" : "4 KB pages";
+    }
+
+private:
+    size_t size_;
+    uint8_t* data_ = nullptr;
+    bool explicit_huge_ = false;
+    bool transparent_huge_ = false;
+};
+
+// Single-producer circular byte history addressed by absolute stream
+// position (bytes since start). Readers on other threads check validity
+// after copying, since the producer never waits for them.
+class SampleHistory {
+public:
+    // Device overflow just before history position `pos`
+    struct Gap {
+        uint64_t pos;
+        uint64_t samples;       // Skipped by the device
+        uint64_t lost_total;    // Skipped up to and including this gap
+        bool estimated;         // Counted with the host clock
+    };
+
+    // `history_bytes` is the guaranteed look-back; `max_chunk` bounds a
+    // single acquire() and is kept as a guard band so data being received
+    // never overlaps data a reader considers valid
+    SampleHistory(size_t history_bytes, size_t max_chunk)
+        : guard_(max_chunk), buffer_(history_bytes + 2 * max_chunk) {}
+
+    size_t capacity() const { return buffer_.size(); }
+    const char* page_kind() const { return buffer_.page_kind(); }
+
+    // Producer: contiguous free space at the write position
+    uint8_t* acquire(size_t& bytes_available) {
+        const size_t offset = static_cast<size_t>(write_pos_.load(std::memory_order_relaxed) % buffer_.size());
+        bytes_available = std::min(guard_, buffer_.size() - offset);
+        return buffer_.data() + offset;
+    }
+
+    void commit(size_t bytes) {
+        write_pos_.store(write_pos_.load(std::memory_order_relaxed) + bytes, std::memory_order_release);
+    }
+
+    // Producer: the device skipped `samples` before the next commit();
+    // `estimated` if the count came from the host clock
+    void mark_gap(uint64_t samples, bool estimated) {
+        if (samples == 0) return;
+        const uint64_t pos = write_position();
+        std::lock_guard<std::mutex> lock(gap_mutex_);
+        // Keep a ring's worth of slack for readers still describing older data
+        const uint64_t keep_from = oldest_position() > buffer_.size() ? oldest_position() - buffer_.size() : 0;
+        while (!gaps_.empty() && gaps_.front().pos < keep_from) {
+            lost_base_ = gaps_.front().lost_total;
+            gaps_.pop_front();
+        }
+        const uint64_t before = gaps_.empty() ? lost_base_ : gaps_.back().lost_total;
+        gaps_.push_back(Gap{pos, samples, before + samples, estimated});
+    }
+
+    // Samples the device skipped before history position `pos`; the
+    // stream position of `pos` is pos / sample_bytes + this
+    uint64_t lost_before(uint64_t pos) const {
+        std::lock_guard<std::mutex> lock(gap_mutex_);
+        uint64_t lost = lost_base_;
+        for (const Gap& gap : gaps_) {
+            if (gap.pos > pos) break;
+            lost = gap.lost_total;
+        }
+        return lost;
+    }
+
+    // Gaps at positions in (after, upto]
+    std::vector<Gap> gaps(uint64_t after, uint64_t upto) const {
+        std::lock_guard<std::mutex> lock(gap_mutex_);
+        std::vector<Gap> found;
+        for (const Gap& gap : gaps_) {
+            if (gap.pos > upto) break;
+            if (gap.pos > after) found.push_back(gap);
+        }
+        return found;
+    }
+
+    // Bytes ever committed
+    uint64_t write_position() const { return write_pos_.load(std::memory_order_acquire); }
+
+    // Oldest position that is guaranteed not to be overwritten yet
+    uint64_t oldest_position() const {
+        const uint64_t end = write_position() + guard_;
+        return end > buffer_.size() ? end - buffer_.size() : 0;
+    }
+
+    // Contiguous committed bytes starting at `pos`, at most `max_bytes`
+    const uint8_t* span(uint64_t pos, size_t max_bytes, size_t& bytes) const {
+        const size_t offset = static_cast<size_t>(pos % buffer_.size());
+        const uint64_t committed = write_position() - pos;
+        bytes = static_cast<size_t>(std::min<uint64_t>({max_bytes, buffer_.size() - offset, committed}));
+        return buffer_.data() + offset;
+    }
+
+    // Writes up to `max_bytes` of history from `pos` (stopping at `end`
+    // and at the write position) to `fd` and advances `pos`. Bytes the
+    // producer lapped before or during the write are counted in `lost`
+    // instead; `written` gets the bytes that went to `fd` (lapped ones
+    // included if they were overwritten mid-write). Returns false with
+    // errno set if the write fails.
+    bool write_span(int fd, uint64_t& pos, uint64_t end, size_t max_bytes, uint64_t& lost,
+                    uint64_t& written) const {
+        written = 0;
+        const uint64_t oldest = oldest_position();
+        if (pos < oldest) {
+            lost += std::min(oldest, end) - pos;
+            pos = std::min(oldest, end);
+        }
+        if (pos >= end) return true;
+        size_t bytes = 0;
+        const uint8_t* data = span(pos, static_cast<size_t>(std::min<uint64_t>(max_bytes, end - pos)), bytes);
+        if (bytes == 0) return true;
+        if (!write_all(fd, data, bytes)) return false;
+        written = bytes;
+        const uint64_t oldest_after = oldest_position();
+        if (oldest_after > pos) lost += std::min<uint64_t>(oldest_after - pos, bytes);
+        pos += bytes;
+        return true;
+    }
+
+private:
+    size_t guard_;
+    HugePageBuffer buffer_;
+    std::atomic<uint64_t> write_pos_{0};
+
+    mutable std::mutex gap_mutex_;
+    std::deque<Gap> gaps_;
+    uint64_t lost_base_ = 0;    // lost_total of the gaps already pruned
+};
+
+struct TriggerEvent {
+    std::string status;        // "started", "extended", "complete" or "error"
+    std::string file;
+    uint64_t pre_samples = 0;  // History samples before the trigger
+    uint64_t samples = 0;      // Samples written (complete)
+    uint64_t lost_samples = 0; // Lapped by the receive loop before they were written
+    std::string error;
+};
+
+// {"type":"trigger"} record for the parent process
+inline std::string trigger_event_json(const TriggerEvent& event) {
+    std::ostringstream record;
+    record << "{\"type\":\"trigger\""
+           << ",\"status\":\"" << event.status << "\""
+           << ",\"file\":\"" << json_escape(event.file) << "\"";
+    if (event.status == "started") {
+        record << ",\"preSamples\":" << event.pre_samples;
+    }
+    if (event.status == "complete") {
+        record << ",\"metaFile\":\"" << json_escape(sigmf_meta_path(event.file)) << "\""
+               << ",\"samples\":" << event.samples
+               << ",\"lostSamples\":" << event.lost_samples;
+    }
+    if (!event.error.empty()) {
+        record << ",\"error\":\"" << json_escape(event.error) << "\"";
+    }
+    record << "}";
+    return record.str();
+}
+
+// recording.sigmf-data -> recording_003.sigmf-data
+inline std::string trigger_file_path(const std::string& output, unsigned index) {
+    return sigmf_numbered_path(output, index, 3);
+}
+
+class PretriggerDumper {
+public:
+    // `meta` is the SigMF template (datatype, rate, hw, frequency in the
+    // first capture); each dump fills in its own datetime
+    PretriggerDumper(SampleHistory& history, size_t sample_bytes, double sample_rate, SigmfMeta meta)
+        : history_(history), sample_bytes_(sample_bytes), sample_rate_(sample_rate), meta_(std::move(meta)) {
+        thread_ = std::thread(&PretriggerDumper::dump_loop, this);
+    }
+
+    ~PretriggerDumper() { finish(); }
+
+    // After streaming stops: ends a capture still waiting for post-trigger
+    // samples with what has been received, then joins the dump thread.
+    // Its final events stay queued for poll().
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    PretriggerDumper(const PretriggerDumper&) = delete;
+    PretriggerDumper& operator=(const PretriggerDumper&) = delete;
+
+    // Receive thread: wall time of history position 0 (the SampleTimeline's
+    // first_ns()); dumps are dated from it
+    void set_stream_start(std::chrono::system_clock::time_point start) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stream_start_ = start;
+    }
+
+    // Receive thread: captures `pre_secs` of history and `post_secs` from
+    // now into `data_path`, or extends the running capture
+    void trigger(const std::string& data_path, double pre_secs, double post_secs) {
+        const uint64_t now_pos = history_.write_position();
+        const uint64_t post_end = now_pos + to_bytes(post_secs);
+        TriggerEvent event;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (active_) {
+                end_pos_ = std::max(end_pos_, post_end);
+                event.status = "extended";
+                event.file = path_;
+            } else {
+                const uint64_t wanted = now_pos > to_bytes(pre_secs) ? now_pos - to_bytes(pre_secs) : 0;
+                start_pos_ = std::max(wanted, history_.oldest_position());
+                next_pos_ = start_pos_;
+                end_pos_ = post_end;
+                lost_bytes_ = 0;
+                path_ = data_path;
+                active_ = true;
+                event.status = "started";
+                event.file = path_;
+                event.pre_samples = (now_pos - start_pos_) / sample_bytes_;
+            }
+        }
+        push_event(event);
+        cv_.notify_all();
+    }
+
+    bool busy() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return active_;
+    }
+
+    // Main loop: pops the oldest event, false if none
+    bool poll(TriggerEvent& event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (events_.empty()) return false;
+        event = std::move(events_.front());
+        events_.pop_front();
+        return true;
+    }
+
+private:
+    static constexpr size_t WRITE_CHUNK = size_t(8) << 20;
+
+    // Start of a contiguous run of samples in the dump
+    struct Break {
+        uint64_t sample_start;      // In the file
+        uint64_t global_index;      // In the stream, gaps included
+        uint64_t overflow;          // Samples the device skipped just before it
+        uint64_t lapped;            // History samples overwritten before the dump got to them
+        bool estimated;
+    };
+
+    uint64_t to_bytes(double secs) const {
+        return static_cast<uint64_t>(std::max(0.0, secs) * sample_rate_) * sample_bytes_;
+    }
+
+    void push_event(TriggerEvent event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.push_back(std::move(event));
+    }
+
+    void dump_loop() {
+        while (true) {
+            std::string path;
+            uint64_t start_pos;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return active_ || stopping_; });
+                if (!active_) return;
+                path = path_;
+                start_pos = start_pos_;
+            }
+
+            TriggerEvent done = dump_one(path, start_pos);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                active_ = false;
+                done.samples = (next_pos_ - start_pos - lost_bytes_) / sample_bytes_;
+                done.lost_samples = lost_bytes_ / sample_bytes_;
+            }
+            push_event(done);
+        }
+    }
+
+    uint64_t global_index(uint64_t pos) const {
+        return pos / sample_bytes_ + history_.lost_before(pos);
+    }
+
+    // Starts a capture at file sample `sample_start`, or adds to the losses
+    // before the one already starting there
+    static void add_break(std::vector<Break>& breaks, const Break& b) {
+        if (!breaks.empty() && breaks.back().sample_start == b.sample_start) {
+            Break& last = breaks.back();
+            last.global_index = b.global_index;
+            last.overflow += b.overflow;
+            last.lapped += b.lapped;
+            last.estimated = last.estimated || b.estimated;
+        } else {
+            breaks.push_back(b);
+        }
+    }
+
+    TriggerEvent dump_one(const std::string& path, uint64_t start_pos) {
+        TriggerEvent event;
+        event.file = path;
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            event.status = "error";
+            event.error = std::string("open failed: ") + std::strerror(errno);
+            return event;
+        }
+
+        std::vector<Break> breaks{Break{0, global_index(start_pos), 0, 0, false}};
+        uint64_t file_bytes = 0;
+        while (true) {
+            uint64_t pos, end;
+            bool stopping;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pos = next_pos_;
+                end = end_pos_;
+                stopping = stopping_;
+            }
+            if (pos >= end) break;
+
+            uint64_t lost = 0;
+            uint64_t written = 0;
+            const uint64_t before = pos;
+            const bool ok = history_.write_span(fd, pos, end, WRITE_CHUNK, lost, written);
+            const int write_errno = errno;
+
+            // Lapped history was skipped, so the file continues further on
+            const uint64_t resumed = pos - written;
+            if (resumed > before) {
+                uint64_t overflow = 0;
+                bool estimated = false;
+                for (const SampleHistory::Gap& gap : history_.gaps(before, resumed)) {
+                    overflow += gap.samples;
+                    estimated = estimated || gap.estimated;
+                }
+                add_break(breaks, Break{file_bytes / sample_bytes_, global_index(resumed), overflow,
+                                        (resumed - before) / sample_bytes_, estimated});
+            }
+            for (const SampleHistory::Gap& gap : history_.gaps(resumed, pos)) {
+                add_break(breaks, Break{(file_bytes + gap.pos - resumed) / sample_bytes_, global_index(gap.pos),
+                                        gap.samples, 0, gap.estimated});
+            }
+            file_bytes += written;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                next_pos_ = pos;
+                lost_bytes_ += lost;
+            }
+            if (!ok) {
+                event.status = "error";
+                event.error = std::string("write failed: ") + std::strerror(write_errno);
+                break;
+            }
+            if (pos == before) {
+                if (stopping) break;  // Daemon exiting: keep what we have
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+
+        if (::close(fd) != 0 && event.status.empty()) {
+            event.status = "error";
+            event.error = std::string("close failed: ") + std::strerror(errno);
+        }
+        if (!event.status.empty()) return event;
+
+        // A loss after the last sample written starts nothing
+        if (breaks.size() > 1 && breaks.back().sample_start >= file_bytes / sample_bytes_) breaks.pop_back();
+        std::chrono::system_clock::time_point stream_start;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stream_start = stream_start_;
+        }
+
+        SigmfMeta meta = meta_;
+        const double frequency = meta.captures.empty() ? 0.0 : meta.captures[0].frequency;
+        meta.captures.clear();
+        for (const Break& b : breaks) {
+            SigmfCapture capture;
+            capture.sample_start = b.sample_start;
+            capture.frequency = frequency;
+            capture.datetime = iso8601_utc(stream_start
+                + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::nanoseconds(std::llround(b.global_index * 1e9 / sample_rate_))));
+            if (breaks.size() > 1) capture.global_index = static_cast<int64_t>(b.global_index);
+            meta.captures.push_back(capture);
+            if (b.overflow + b.lapped == 0) continue;
+
+            std::ostringstream comment;
+            if (b.overflow > 0) {
+                comment << b.overflow << " samples lost to a device overflow"
+                        << (b.estimated ? " (estimated from the host clock)" : "");
+            }
+            if (b.lapped > 0) {
+                comment << (b.overflow ? "; " : "") << b.lapped << " samples overwritten before they were written";
+            }
+            meta.annotations.push_back(SigmfAnnotation{b.sample_start, 0, b.overflow ? "overflow" : "dropped",
+                                                       comment.str()});
+        }
+        if (!write_sigmf_meta(sigmf_meta_path(path), meta)) {
+            event.status = "error";
+            event.error = "failed to write " + sigmf_meta_path(path);
+            return event;
+        }
+        event.status = "complete";
+        return event;
+    }
+
+    SampleHistory& history_;
+    size_t sample_bytes_;
+    double sample_rate_;
+    SigmfMeta meta_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<TriggerEvent> events_;
+    bool stopping_ = false;
+    bool active_ = false;
+    std::string path_;
+    uint64_t start_pos_ = 0;
+    uint64_t next_pos_ = 0;
+    uint64_t end_pos_ = 0;
+    uint64_t lost_bytes_ = 0;
+    std::chrono::system_clock::time_point stream_start_ = std::chrono::system_clock::now();
+    std::thread thread_;
+};
@@ -0,0 +1,322 @@
+/**
+ * replay_source.hpp - Recorded IQ played back in place of a radio
+ *
+ * Lets the daemons run without hardware (build servers, profiling,
+ * regression runs) by taking device args of the form
+ *
+ *   replay:path=capture.sigmf-data[,mode=paced|fast][,loop=1]
+ *          [,format=cf32|ci16|ci8][,rate=10e6][,backlog=0.5]
+ *
+ * instead of a UHD or Soapy device string. rx_frontend.hpp wraps it for
+ * the UHD daemons (--args) and soapy_replay.hpp for the Soapy ones
+ * (--device).
+ *
+ * The file is mmapped. Format and rate come from the .sigmf-meta next to
+ * a .sigmf-data; raw files are cf32 unless format= says otherwise, and
+ * run at whatever rate the daemon asks for unless rate= fixes one.
+ * Samples are converted to the format the daemon streams
+ * (convert_samples() in sample_format.hpp).
+ *
+ *   mode=paced  (default) samples are released at the sample rate from
+ *               the moment the stream starts, like a radio. With
+ *               backlog=<secs> a reader further behind than that loses
+ *               the backlog and sees an overflow, so a daemon that cannot
+ *               keep up shows it the way it would on air; by default a
+ *               late reader just catches up.
+ *   mode=fast   every read is served at once: the daemon runs as fast as
+ *               it can process, for throughput benchmarks.
+ *
+ * Device time is the stream position (samples delivered / rate), or in
+ * paced mode the samples released so far, so timed logic sees a
+ * consistent clock in either mode. Tuning, gain and antenna are accepted
+ * and reported back but do not change the samples: the recording is
+ * what the air sounds like. At the end of the file the stream ends
+ * (ReplayStatus::End), or with loop=1 starts over with the clock still
+ * running.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "sample_format.hpp"
+#include "sigmf.hpp"
+
+struct ReplayOptions {
+    std::string path;
+    std::string format;        // Empty: from .sigmf-meta, else cf32
+    double sample_rate = 0.0;  // 0: from .sigmf-meta, else as the daemon sets it
+    bool paced = true;
+    bool loop = false;
+    double backlog_secs = 0.0; // 0: never overflow
+};
+
+inline bool is_replay_args(const std::string& args) {
+    return args.compare(0, 7, "replay:") == 0;
+}
+
+// "replay:key=value,..." -> options. Returns an error, empty on success.
+inline std::string parse_replay_args(const std::string& args, ReplayOptions& options) {
+    if (!is_replay_args(args)) return "replay args must start with 'replay:'";
+    size_t pos = 7;
+    while (pos <= args.size()) {
+        size_t end = args.find(',', pos);
+        if (end == std::string::npos) end = args.size();
+        const std::string item = args.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.empty()) continue;
+
+        const size_t eq = item.find('=');
+        const std::string key = eq == std::string::npos ? "path" : item.substr(0, eq);
+        const std::string value = eq == std::string::npos ? item : item.substr(eq + 1);
+        char* rest = nullptr;
+        if (key == "path") {
+            options.path = value;
+        } else if (key == "mode") {
+            if (value != "paced" && value != "fast") return "replay mode must be paced or fast";
+            options.paced = value == "paced";
+        } else if (key == "loop") {
+            options.loop = value == "1" || value == "true" || value == "yes";
+        } else if (key == "format") {
+            SampleFormat format;
+            if (!parse_sample_format(value, format)) return "unknown replay format '" + value + "' (cf32/ci16/ci8)";
+            options.format = value;
+        } else if (key == "rate") {
+            options.sample_rate = std::strtod(value.c_str(), &rest);
+            if (rest == value.c_str() || options.sample_rate <= 0.0) return "bad replay rate '" + value + "'";
+        } else if (key == "backlog") {
+            options.backlog_secs = std::strtod(value.c_str(), &rest);
+            if (rest == value.c_str() || options.backlog_secs < 0.0) return "bad replay backlog '" + value + "'";
+        } else {
+            return "unknown replay option '" + key + "'";
+        }
+    }
+    if (options.path.empty()) return "replay needs path=<file>";
+    return "";
+}
+
+enum class ReplayStatus { Ok, Timeout, Overflow, End };
+
+struct ReplayRead {
+    size_t samples = 0;
+    uint64_t first = 0;     // Stream position of the first sample (device time * rate)
+    ReplayStatus status = ReplayStatus::Ok;
+};
+
+class ReplaySource {
+public:
+    ReplaySource() = default;
+    ReplaySource(const ReplaySource&) = delete;
+    ReplaySource& operator=(const ReplaySource&) = delete;
+    ~ReplaySource() {
+        if (map_) ::munmap(map_, map_bytes_);
+    }
+
+    bool open(const ReplayOptions& options) {
+        options_ = options;
+        std::string datatype;
+        double meta_rate = 0.0;
+        double meta_freq = 0.0;
+        read_sigmf_core(sigmf_meta_path(options.path), datatype, meta_rate, meta_freq);
+
+        format_ = SampleFormat::Cf32;
+        if (!options.format.empty()) {
+            parse_sample_format(options.format, format_);
+        } else if (!datatype.empty() && !parse_sigmf_datatype(datatype, format_)) {
+            error_ = "unsupported SigMF datatype '" + datatype + "'";
+            return false;
+        }
+        rate_ = options.sample_rate > 0.0 ? options.sample_rate : meta_rate;
+        rate_fixed_ = rate_ > 0.0;
+        recorded_freq_ = meta_freq;
+
+        const int fd = ::open(options.path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error_ = options.path + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sample_format_bytes(format_))) {
+            error_ = options.path + ": empty or unreadable";
+            ::close(fd);
+            return false;
+        }
+        map_bytes_ = static_cast<size_t>(st.st_size);
+        void* map = ::mmap(nullptr, map_bytes_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            error_ = options.path + ": mmap: " + std::strerror(errno);
+            return false;
+        }
+        ::madvise(map, map_bytes_, MADV_SEQUENTIAL);
+        map_ = map;
+        samples_ = map_bytes_ / sample_format_bytes(format_);
+        return true;
+    }
+
+    const std::string& error() const { return error_; }
+    const std::string& path() const { return options_.path; }
+    SampleFormat format() const { return format_; }
+    uint64_t samples() const { return samples_; }
+    bool paced() const { return options_.paced; }
+    bool loop() const { return options_.loop; }
+    double recorded_freq() const { return recorded_freq_; }
+    double sample_rate() const {
+        std::lock_guard<std::mutex> lock(clock_mutex_);
+        return rate_;
+    }
+
+    // A raw file without rate= plays at the rate the daemon configures
+    void set_sample_rate(double rate) {
+        if (!rate_fixed_ && rate > 0.0) {
+            std::lock_guard<std::mutex> lock(clock_mutex_);
+            rate_ = rate;
+        }
+    }
+
+    // Stream on/off. The paced clock resumes from the current position.
+    void start() {
+        std::lock_guard<std::mutex> lock(clock_mutex_);
+        anchor_pos_ = position_.load(std::memory_order_relaxed);
+        anchor_time_ = std::chrono::steady_clock::now();
+        streaming_ = true;
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(clock_mutex_);
+        streaming_ = false;
+    }
+
+    bool streaming() const {
+        std::lock_guard<std::mutex> lock(clock_mutex_);
+        return streaming_;
+    }
+
+    // Up to `max_samples` in `out_format`. Paced reads wait (up to the
+    // timeout) for the whole request to be released, then return what is.
+    // One reader at a time; the clock may be read from any thread.
+    ReplayRead read(void* out, SampleFormat out_format, size_t max_samples, double timeout_secs) {
+        ReplayRead result;
+        uint64_t position = position_.load(std::memory_order_relaxed);
+        result.first = position;
+        if (finished()) {
+            result.status = ReplayStatus::End;
+            return result;
+        }
+
+        bool streaming;
+        double rate;
+        uint64_t anchor_pos;
+        std::chrono::steady_clock::time_point anchor_time;
+        {
+            std::lock_guard<std::mutex> lock(clock_mutex_);
+            streaming = streaming_;
+            rate = rate_;
+            anchor_pos = anchor_pos_;
+            anchor_time = anchor_time_;
+        }
+        if (!streaming) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(std::min(timeout_secs, 0.1)));
+            result.status = ReplayStatus::Timeout;
+            return result;
+        }
+
+        size_t count = max_samples;
+        if (options_.paced && rate > 0.0) {
+            using Duration = std::chrono::steady_clock::duration;
+            const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+                + std::chrono::duration_cast<Duration>(std::chrono::duration<double>(timeout_secs));
+            const std::chrono::steady_clock::time_point ready = anchor_time
+                + std::chrono::duration_cast<Duration>(std::chrono::duration<double>((position + max_samples - anchor_pos) / rate));
+            std::this_thread::sleep_until(std::min(ready, deadline));
+
+            const uint64_t released = released_at(std::chrono::steady_clock::now(), rate, anchor_pos, anchor_time);
+            if (options_.backlog_secs > 0.0 && released > position + options_.backlog_secs * rate) {
+                // Too far behind: the backlog is gone, as a device FIFO would drop it
+                position = released;
+                position_.store(position, std::memory_order_relaxed);
+                result.first = position;
+                result.status = ReplayStatus::Overflow;
+                return result;
+            }
+            count = static_cast<size_t>(std::min<uint64_t>(count, released - position));
+            if (count == 0) {
+                result.status = ReplayStatus::Timeout;
+                return result;
+            }
+        }
+        if (!options_.loop) {
+            count = static_cast<size_t>(std::min<uint64_t>(count, samples_ - position));
+        }
+
+        // Copy out, wrapping at the end of the file when looping
+        const size_t out_bytes = sample_format_bytes(out_format);
+        size_t done = 0;
+        while (done < count) {
+            const uint64_t offset = (position + done) % samples_;
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(count - done, samples_ - offset));
+            convert_samples(map_, static_cast<size_t>(offset), n, format_,
+                            static_cast<uint8_t*>(out) + done * out_bytes, out_format);
+            done += n;
+        }
+        position_.store(position + count, std::memory_order_relaxed);
+        result.samples = count;
+        return result;
+    }
+
+    // Played to the end of the file (never with loop=1)
+    bool finished() const {
+        return !options_.loop && position_.load(std::memory_order_relaxed) >= samples_;
+    }
+
+    // Samples delivered, or dropped as overflows
+    uint64_t position() const { return position_.load(std::memory_order_relaxed); }
+
+    // Device time in seconds
+    double time_now() const {
+        std::lock_guard<std::mutex> lock(clock_mutex_);
+        if (rate_ <= 0.0) return 0.0;
+        uint64_t now = position_.load(std::memory_order_relaxed);
+        if (options_.paced && streaming_) {
+            now = std::max(now, released_at(std::chrono::steady_clock::now(), rate_, anchor_pos_, anchor_time_));
+        }
+        return now / rate_;
+    }
+
+private:
+    static uint64_t released_at(std::chrono::steady_clock::time_point when, double rate, uint64_t anchor_pos,
+                                std::chrono::steady_clock::time_point anchor_time) {
+        const double secs = std::chrono::duration<double>(when - anchor_time).count();
+        return anchor_pos + static_cast<uint64_t>(std::max(0.0, secs) * rate);
+    }
+
+    ReplayOptions options_;
+    std::string error_;
+    void* map_ = nullptr;
+    size_t map_bytes_ = 0;
+    uint64_t samples_ = 0;
+    SampleFormat format_ = SampleFormat::Cf32;
+    double recorded_freq_ = 0.0;
+    bool rate_fixed_ = false;
+
+    mutable std::mutex clock_mutex_;
+    double rate_ = 0.0;
+    bool streaming_ = false;
+    uint64_t anchor_pos_ = 0;
+    std::chrono::steady_clock::time_point anchor_time_;
+    std::atomic<uint64_t> position_{0};
+};
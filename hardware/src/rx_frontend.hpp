@@ -0,0 +1,191 @@
+/**
+ * rx_frontend.hpp - UHD receive front end: a USRP or a file replay
+ *
+ * The UHD daemons talk to the radio through RxFrontend rather than
+ * multi_usrp and rx_streamer directly, so that --args replay:path=...
+ * (replay_source.hpp) runs them from a recording with no hardware
+ * attached. Members mirror the multi_usrp/rx_streamer calls they replace;
+ * on a USRP they forward, on a replay they keep the settings and serve
+ * samples from the file. Anything that only exists on real hardware
+ * (clock/time sources, sensors, subdev specs) goes through usrp(), which
+ * is null for a replay.
+ *
+ * As with multi_usrp, settings calls may come from another thread than
+ * the one in recv().
+ */
+
+#pragma once
+
+#include <uhd/usrp/multi_usrp.hpp>
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "replay_source.hpp"
+
+class RxFrontend {
+public:
+    typedef std::shared_ptr<RxFrontend> sptr;
+
+    // A USRP for ordinary device args, a replay for "replay:..."
+    static sptr make(const std::string& args) {
+        sptr frontend(new RxFrontend);
+        if (!is_replay_args(args)) {
+            frontend->usrp_ = uhd::usrp::multi_usrp::make(args);
+            return frontend;
+        }
+        ReplayOptions options;
+        const std::string error = parse_replay_args(args, options);
+        if (!error.empty()) throw std::invalid_argument(error);
+        frontend->replay_.reset(new ReplaySource);
+        if (!frontend->replay_->open(options)) throw std::runtime_error(frontend->replay_->error());
+        return frontend;
+    }
+
+    uhd::usrp::multi_usrp::sptr usrp() const { return usrp_; }
+    ReplaySource* replay() const { return replay_.get(); }
+
+    void set_rx_rate(double rate) {
+        if (usrp_) return usrp_->set_rx_rate(rate);
+        replay_->set_sample_rate(rate);
+    }
+    double get_rx_rate() {
+        return usrp_ ? usrp_->get_rx_rate() : replay_->sample_rate();
+    }
+
+    uhd::tune_result_t set_rx_freq(const uhd::tune_request_t& request) {
+        if (usrp_) return usrp_->set_rx_freq(request);
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        freq_ = request.target_freq;
+        uhd::tune_result_t result;
+        result.target_rf_freq = freq_;
+        result.actual_rf_freq = freq_;
+        return result;
+    }
+    double get_rx_freq() {
+        if (usrp_) return usrp_->get_rx_freq();
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        return freq_;
+    }
+
+    void set_rx_gain(double gain) {
+        if (usrp_) return usrp_->set_rx_gain(gain);
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        gain_ = gain;
+    }
+    double get_rx_gain() {
+        if (usrp_) return usrp_->get_rx_gain();
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        return gain_;
+    }
+
+    void set_rx_bandwidth(double bw) {
+        if (usrp_) return usrp_->set_rx_bandwidth(bw);
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        bandwidth_ = bw;
+    }
+    double get_rx_bandwidth() {
+        if (usrp_) return usrp_->get_rx_bandwidth();
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        return bandwidth_ > 0.0 ? bandwidth_ : replay_->sample_rate();
+    }
+
+    void set_rx_antenna(const std::string& antenna) {
+        if (usrp_) return usrp_->set_rx_antenna(antenna);
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        antenna_ = antenna;
+    }
+    std::string get_rx_antenna() {
+        if (usrp_) return usrp_->get_rx_antenna();
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        return antenna_;
+    }
+
+    // A replay's clock is its stream position; timed commands take effect
+    // at once, since retuning does not change the samples anyway
+    uhd::time_spec_t get_time_now() {
+        return usrp_ ? usrp_->get_time_now() : uhd::time_spec_t(replay_->time_now());
+    }
+    void set_command_time(const uhd::time_spec_t& time) {
+        if (usrp_) usrp_->set_command_time(time);
+    }
+    void clear_command_time() {
+        if (usrp_) usrp_->clear_command_time();
+    }
+
+    // Replaces get_rx_stream(): the front end is also the stream
+    void setup_stream(const uhd::stream_args_t& args) {
+        if (usrp_) {
+            rx_stream_ = usrp_->get_rx_stream(args);
+            return;
+        }
+        if (args.cpu_format == "sc16") {
+            cpu_format_ = SampleFormat::Ci16;
+        } else if (args.cpu_format == "sc8") {
+            cpu_format_ = SampleFormat::Ci8;
+        } else {
+            cpu_format_ = SampleFormat::Cf32;
+        }
+    }
+
+    // Replays read B2xx USB-sized packets so per-packet costs match hardware
+    size_t get_max_num_samps() const {
+        return rx_stream_ ? rx_stream_->get_max_num_samps() : 2040;
+    }
+
+    // Replays only know start and stop; other stream modes start it
+    void issue_stream_cmd(const uhd::stream_cmd_t& cmd) {
+        if (rx_stream_) return rx_stream_->issue_stream_cmd(cmd);
+        if (cmd.stream_mode == uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS) {
+            replay_->stop();
+        } else {
+            replay_->start();
+        }
+    }
+
+    size_t recv(void* buffer, size_t num_samps, uhd::rx_metadata_t& md, double timeout = 0.1) {
+        if (rx_stream_) return rx_stream_->recv(buffer, num_samps, md, timeout);
+
+        const ReplayRead read = replay_->read(buffer, cpu_format_, num_samps, timeout);
+        md = uhd::rx_metadata_t();
+        md.has_time_spec = true;
+        md.time_spec = uhd::time_spec_t::from_ticks(static_cast<long long>(read.first), replay_->sample_rate());
+        switch (read.status) {
+        case ReplayStatus::Ok:
+            md.error_code = uhd::rx_metadata_t::ERROR_CODE_NONE;
+            break;
+        case ReplayStatus::Overflow:
+            md.error_code = uhd::rx_metadata_t::ERROR_CODE_OVERFLOW;
+            break;
+        case ReplayStatus::End:
+            md.end_of_burst = true;
+            md.error_code = uhd::rx_metadata_t::ERROR_CODE_TIMEOUT;
+            break;
+        case ReplayStatus::Timeout:
+            md.error_code = uhd::rx_metadata_t::ERROR_CODE_TIMEOUT;
+            break;
+        }
+        return read.samples;
+    }
+
+    // A replay without loop=1 has played its whole file
+    bool finished() const {
+        return replay_ && replay_->finished();
+    }
+
+private:
+    RxFrontend() = default;
+
+    uhd::usrp::multi_usrp::sptr usrp_;
+    uhd::rx_streamer::sptr rx_stream_;
+    std::unique_ptr<ReplaySource> replay_;
+    SampleFormat cpu_format_ = SampleFormat::Cf32;
+
+    std::mutex settings_mutex_;
+    double freq_ = 0.0;
+    double gain_ = 0.0;
+    double bandwidth_ = 0.0;
+    std::string antenna_;
+};
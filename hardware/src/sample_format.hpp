@@ -0,0 +1,147 @@
+/**
+ * sample_format.hpp - On-disk IQ sample formats shared by the recorders
+ *
+ * Each format names what lands in the file and how to ask the driver for
+ * exactly that, so samples go from the driver's buffer to disk without a
+ * float conversion:
+ *
+ *   format  bytes  SigMF     UHD cpu/otw   Soapy
+ *   cf32    8      cf32_le   fc32/sc16     CF32
+ *   ci16    4      ci16_le   sc16/sc16     CS16
+ *   ci8     2      ci8       sc8/sc8       CS8
+ *
+ * ci16 keeps every bit of 12-bit converters (B2xx, LimeSDR) at half the
+ * size of cf32; ci8 matches 8-bit converters (RTL-SDR, HackRF) and UHD's
+ * sc8 wire format at a quarter.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class SampleFormat { Cf32, Ci16, Ci8 };
+
+inline bool parse_sample_format(const std::string& name, SampleFormat& format) {
+    if (name == "cf32") { format = SampleFormat::Cf32; return true; }
+    if (name == "ci16") { format = SampleFormat::Ci16; return true; }
+    if (name == "ci8") { format = SampleFormat::Ci8; return true; }
+    return false;
+}
+
+inline const char* sample_format_name(SampleFormat format) {
+    switch (format) {
+    case SampleFormat::Cf32: return "cf32";
+    case SampleFormat::Ci16: return "ci16";
+    case SampleFormat::Ci8: return "ci8";
+    }
+    return "cf32";
+}
+
+// Bytes per complex sample
+inline size_t sample_format_bytes(SampleFormat format) {
+    switch (format) {
+    case SampleFormat::Cf32: return 8;
+    case SampleFormat::Ci16: return 4;
+    case SampleFormat::Ci8: return 2;
+    }
+    return 8;
+}
+
+inline const char* sigmf_datatype(SampleFormat format) {
+    switch (format) {
+    case SampleFormat::Cf32: return "cf32_le";
+    case SampleFormat::Ci16: return "ci16_le";
+    case SampleFormat::Ci8: return "ci8";
+    }
+    return "cf32_le";
+}
+
+inline bool parse_sigmf_datatype(const std::string& datatype, SampleFormat& format) {
+    if (datatype == "cf32_le" || datatype == "cf32") { format = SampleFormat::Cf32; return true; }
+    if (datatype == "ci16_le" || datatype == "ci16") { format = SampleFormat::Ci16; return true; }
+    if (datatype == "ci8" || datatype == "ci8_le") { format = SampleFormat::Ci8; return true; }
+    return false;
+}
+
+// UHD host-side (cpu) format
+inline const char* uhd_cpu_format(SampleFormat format) {
+    switch (format) {
+    case SampleFormat::Cf32: return "fc32";
+    case SampleFormat::Ci16: return "sc16";
+    case SampleFormat::Ci8: return "sc8";
+    }
+    return "fc32";
+}
+
+// UHD over-the-wire format; sc8 halves USB/Ethernet load as well
+inline const char* uhd_wire_format(SampleFormat format) {
+    return format == SampleFormat::Ci8 ? "sc8" : "sc16";
+}
+
+// SoapySDR stream format string (SOAPY_SDR_CF32/CS16/CS8)
+inline const char* soapy_stream_format(SampleFormat format) {
+    switch (format) {
+    case SampleFormat::Cf32: return "CF32";
+    case SampleFormat::Ci16: return "CS16";
+    case SampleFormat::Ci8: return "CS8";
+    }
+    return "CF32";
+}
+
+// Samples [offset, offset + count) of `in` as interleaved floats, full
+// scale = 1.0 (ci16 / 32767, ci8 / 127), for the code that analyses them
+inline void samples_to_cf32(const void* in, size_t offset, size_t count, SampleFormat format, float* out) {
+    switch (format) {
+    case SampleFormat::Cf32: {
+        const float* src = static_cast<const float*>(in) + 2 * offset;
+        std::copy(src, src + 2 * count, out);
+        break;
+    }
+    case SampleFormat::Ci16: {
+        const int16_t* src = static_cast<const int16_t*>(in) + 2 * offset;
+        for (size_t i = 0; i < 2 * count; i++) out[i] = src[i] * (1.0f / 32767.0f);
+        break;
+    }
+    case SampleFormat::Ci8: {
+        const int8_t* src = static_cast<const int8_t*>(in) + 2 * offset;
+        for (size_t i = 0; i < 2 * count; i++) out[i] = src[i] * (1.0f / 127.0f);
+        break;
+    }
+    }
+}
+
+// Samples [offset, offset + count) of `in` converted to `out_format`, on
+// the same full scale as samples_to_cf32; narrowing saturates
+inline void convert_samples(const void* in, size_t offset, size_t count, SampleFormat in_format,
+                            void* out, SampleFormat out_format) {
+    if (in_format == out_format) {
+        const size_t bytes = sample_format_bytes(in_format);
+        const uint8_t* src = static_cast<const uint8_t*>(in) + offset * bytes;
+        std::copy(src, src + count * bytes, static_cast<uint8_t*>(out));
+        return;
+    }
+    if (out_format == SampleFormat::Cf32) {
+        samples_to_cf32(in, offset, count, in_format, static_cast<float*>(out));
+        return;
+    }
+    // Integer output: through float, a chunk at a time
+    const float scale = out_format == SampleFormat::Ci16 ? 32767.0f : 127.0f;
+    float chunk[2 * 256];
+    for (size_t done = 0; done < count; ) {
+        const size_t n = std::min<size_t>(256, count - done);
+        samples_to_cf32(in, offset + done, n, in_format, chunk);
+        for (size_t i = 0; i < 2 * n; i++) {
+            const float v = std::max(-scale, std::min(scale, chunk[i] * scale));
+            if (out_format == SampleFormat::Ci16) {
+                static_cast<int16_t*>(out)[2 * done + i] = static_cast<int16_t>(std::lrint(v));
+            } else {
+                static_cast<int8_t*>(out)[2 * done + i] = static_cast<int8_t>(std::lrint(v));
+            }
+        }
+        done += n;
+    }
+}
@@ -0,0 +1,88 @@
+/**
+ * sample_timeline.hpp - Hardware-time bookkeeping for the recorders
+ *
+ * Every recv()/readStream() result carries the device time of its first
+ * sample (UHD time_spec, Soapy timeNs). The timeline keeps the stream
+ * position that time corresponds to, counting from the first sample, so
+ * an overflow shows up as the number of samples the device skipped. The
+ * recorders pass that to SegmentedWriter::mark_overflow() (samples lost
+ * on the device; mark_dropped() for samples lost in the write queue),
+ * which starts a new SigMF capture there; the datetime of any capture is
+ * then simply first_ns() + global_index / rate.
+ *
+ * Drivers without timestamps (has_time = false) are timed with the host
+ * clock when the call returns instead. That jitters by up to a buffer and
+ * drifts against the sample clock, so it is only consulted right after an
+ * overflow the driver reported, and host_timed() flags the result as an
+ * estimate.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+// Host wall clock in ns since the epoch, the recorders' fallback time base
+inline int64_t host_time_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+inline std::chrono::system_clock::time_point time_point_from_ns(int64_t ns) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(ns)));
+}
+
+class SampleTimeline {
+public:
+    explicit SampleTimeline(double sample_rate) : rate_(sample_rate) {}
+
+    bool started() const { return started_; }
+    // Time of the first sample (ns since the epoch)
+    int64_t first_ns() const { return first_ns_; }
+    // True once any time came from the host clock
+    bool host_timed() const { return host_timed_; }
+    // Stream position of the next sample, gaps included
+    uint64_t position() const { return position_; }
+
+    // A receive call returned `samples` whose first was taken at `time_ns`
+    // (ignored when !has_time); `overflowed` if the driver reported an
+    // overflow since the previous call. Returns the samples missing before
+    // them, 0 if the stream is contiguous; position() includes both.
+    uint64_t observe(bool has_time, int64_t time_ns, uint64_t samples, bool overflowed) {
+        if (!has_time) {
+            if (started_ && !overflowed) {
+                position_ += samples;
+                return 0;
+            }
+            // The call returned after its last sample arrived
+            time_ns = host_time_ns() - static_cast<int64_t>(samples * 1e9 / rate_);
+            host_timed_ = true;
+        }
+        uint64_t lost = 0;
+        if (!started_) {
+            started_ = true;
+            first_ns_ = time_ns;
+        } else {
+            const double behind = (time_ns - expected_ns()) * rate_ / 1e9;
+            if (behind > 0.5) lost = static_cast<uint64_t>(std::llround(behind));
+        }
+        position_ += lost + samples;
+        return lost;
+    }
+
+    // Time of stream position `index` (ns since the epoch)
+    int64_t time_of(uint64_t index) const {
+        return first_ns_ + static_cast<int64_t>(std::llround(index * 1e9 / rate_));
+    }
+
+private:
+    int64_t expected_ns() const { return time_of(position_); }
+
+    double rate_;
+    bool started_ = false;
+    bool host_timed_ = false;
+    int64_t first_ns_ = 0;
+    uint64_t position_ = 0;
+};
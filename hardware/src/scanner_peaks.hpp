@@ -0,0 +1,59 @@
+/**
+ * scanner_peaks.hpp - soapy_scanner's per-step peak list
+ *
+ * Local maxima (over +-2 bins) above a dB threshold, each with a 3 dB
+ * bandwidth estimate from the linear magnitude spectrum. In a header so
+ * hardware_bench times the code the scanner runs.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+struct Peak {
+    double frequency;
+    float power_db;
+    float bandwidth;
+};
+
+// fft_data is linear magnitude, power_db the same bins in dB
+inline std::vector<Peak> find_peaks(const std::vector<float>& fft_data, const std::vector<float>& power_db_bins,
+                                     double center_freq, double sample_rate, float threshold_db = -80.0) {
+    std::vector<Peak> peaks;
+    const size_t fft_size = fft_data.size();
+    const double freq_resolution = sample_rate / fft_size;
+
+    for (size_t i = 5; i < fft_size - 5; ++i) {
+        float power_db = power_db_bins[i];
+        
+        if (power_db < threshold_db) continue;
+
+        // Check if local maximum
+        bool is_peak = true;
+        for (int j = -2; j <= 2; ++j) {
+            if (j == 0) continue;
+            if (fft_data[i] < fft_data[i + j]) {
+                is_peak = false;
+                break;
+            }
+        }
+
+        if (is_peak) {
+            double freq = center_freq - sample_rate / 2.0 + i * freq_resolution;
+            
+            // Estimate bandwidth (3dB down)
+            float threshold_3db = fft_data[i] * 0.707f;
+            size_t bw_left = i, bw_right = i;
+            
+            while (bw_left > 0 && fft_data[bw_left] > threshold_3db) bw_left--;
+            while (bw_right < fft_size - 1 && fft_data[bw_right] > threshold_3db) bw_right++;
+            
+            float bandwidth = (bw_right - bw_left) * freq_resolution;
+
+            peaks.push_back({freq, power_db, bandwidth});
+        }
+    }
+
+    return peaks;
+}
@@ -6,7 +6,36 @@
  * RX: 50-6000 MHz, 0-76 dB gain, 200 kHz - 56 MHz BW
  * TX: 50-6000 MHz, 0-89.8 dB gain
  * 
- * Outputs JSON FFT data to stdout for Node.js consumption
+ * Outputs JSON FFT data to stdout for Node.js consumption, or binary
+ * length-prefixed frames with --output-format binary (see spectrum_frame.hpp)
+ *
+ * Threading: a dedicated receive thread only calls recv() into a lock-free
+ * ring of preallocated sample blocks; the main thread does windowing, FFT
+ * and JSON output. A slow stdout consumer drops display frames instead of
+ * overflowing the USB transport.
+ *
+ * Spectra: FFTs are computed over every received sample with an optional
+ * overlap (--overlap) and averaged in linear power (--avg) before a single
+ * log10 pass per output frame; --frame-rate caps the emitted frame rate
+ * independently of the FFT rate. The path lives in streamer_pipeline.hpp,
+ * shared with bench_pipeline.
+ *
+ * Control: while running, line-delimited commands on stdin (freq, gain, bw,
+ * antenna, fft-size; see control_channel.hpp) are applied without stopping
+ * the stream. Each command bumps a config generation that is acknowledged
+ * with a {"type":"config"} record and stamped on every following frame.
+ *
+ * Planning: FFT plans use --plan-effort and the per-CPU wisdom cache in
+ * fftw_wisdom.hpp, so restarts and live fft-size changes reuse earlier
+ * measurements instead of re-timing the planner.
+ *
+ * Perf: every --perf-interval seconds a {"type":"perf"} record gives
+ * per-stage latency histograms (queue, window, FFT, power, reduce,
+ * serialize, write) and recv-to-written frame latency (stage_latency.hpp).
+ *
+ * Replay: --args replay:path=<file>[,mode=fast] streams a recording
+ * instead of a USRP (rx_frontend.hpp, replay_source.hpp); the daemon exits
+ * once the file has been played, unless it loops.
  */
 
 #include <uhd/usrp/multi_usrp.hpp>
@@ -23,11 +52,25 @@
 #include <cmath>
 #include <chrono>
 #include <iomanip>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <mutex>
+#include <deque>
+
+#include "spsc_ring.hpp"
+#include "spectrum_frame.hpp"
+#include "control_channel.hpp"
+#include "dsp_kernels.hpp"
+#include "fftw_wisdom.hpp"
+#include "rx_frontend.hpp"
+#include "streamer_pipeline.hpp"
 
 namespace po = boost::program_options;
 
-// Global flag for clean shutdown
-static bool stop_signal_called = false;
+// Global flag for clean shutdown (shared by receive and DSP threads)
+static std::atomic<bool> stop_signal_called{false};
 
 void sig_int_handler(int) {
     stop_signal_called = true;
@@ -43,6 +86,186 @@ constexpr double B210_MAX_TX_GAIN = 89.8;   // 89.8 dB
 constexpr double B210_MIN_BW = 200e3;       // 200 kHz
 constexpr double B210_MAX_BW = 56e6;        // 56 MHz
 
+// Settings that can change while streaming. Every control command bumps
+// `generation`; blocks and frames carry it so consumers can drop stale data.
+struct LiveSettings {
+    uint32_t generation = 0;
+    double center_freq = 0.0;
+    size_t fft_size = 0;
+};
+
+// One recv() worth of samples, handed from the receive thread to the DSP thread
+struct SampleBlock {
+    std::vector<std::complex<float>> samples;
+    size_t num_samps = 0;
+    double timestamp = 0.0;     // Hardware time_spec of the first sample
+    uint64_t seq = 0;           // Receive counter, gaps mean dropped blocks
+    LiveSettings settings;      // Configuration the samples were taken with
+    std::chrono::steady_clock::time_point received;  // When recv() returned it
+};
+
+using SampleRing = SpscRing<SampleBlock>;
+
+// JSON records produced on the receive thread (control acks). The DSP
+// thread is the only stdout writer, so they are queued and written there.
+class RecordQueue {
+public:
+    void push(std::string record) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(record));
+        pending_.fetch_add(1, std::memory_order_release);
+    }
+
+    bool pop(std::string& record) {
+        if (pending_.load(std::memory_order_acquire) == 0) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        record = std::move(queue_.front());
+        queue_.pop_front();
+        pending_.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::atomic<size_t> pending_{0};
+    std::mutex mutex_;
+    std::deque<std::string> queue_;
+};
+
+// Applies one control command to the device. Runs on the receive thread,
+// which owns the device while streaming. Returns an error, empty on success.
+std::string apply_control_command(RxFrontend::sptr frontend, const ControlCommand& cmd,
+                                  LiveSettings& settings) {
+    try {
+        if (cmd.key == "freq") {
+            double freq = std::stod(cmd.value);
+            if (freq < B210_MIN_FREQ || freq > B210_MAX_FREQ) return "frequency out of range";
+            frontend->set_rx_freq(uhd::tune_request_t(freq));
+            settings.center_freq = frontend->get_rx_freq();
+        } else if (cmd.key == "gain") {
+            double gain = std::stod(cmd.value);
+            if (gain < B210_MIN_RX_GAIN || gain > B210_MAX_RX_GAIN) return "gain out of range";
+            frontend->set_rx_gain(gain);
+        } else if (cmd.key == "bw") {
+            double bw = std::stod(cmd.value);
+            if (bw < B210_MIN_BW || bw > B210_MAX_BW) return "bandwidth out of range";
+            frontend->set_rx_bandwidth(bw);
+        } else if (cmd.key == "antenna") {
+            frontend->set_rx_antenna(cmd.value);
+        } else if (cmd.key == "fft-size") {
+            size_t fft_size = std::stoul(cmd.value);
+            if (fft_size < 16 || fft_size > 65536) return "fft-size out of range [16-65536]";
+            settings.fft_size = fft_size;
+        } else {
+            return "unknown command '" + cmd.key + "'";
+        }
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+    return "";
+}
+
+struct ReceiveContext {
+    RxFrontend::sptr frontend;
+    SampleRing* ring;
+    ControlChannel* control;
+    RecordQueue* records;
+    size_t block_size;
+    double settle_secs;         // Samples blanked after a front-end change
+    bool lossless;              // Wait for a free block instead of dropping (unpaced replay)
+    LiveSettings settings;
+    std::atomic<uint64_t> overflow_count{0};
+    std::atomic<bool> done{false};
+};
+
+// Receive loop: never touches FFTW or stdout, only recv() into the ring.
+// If the ring is full the block is still received (into scratch) so the
+// device FIFO keeps draining, and the loss is counted as a dropped block.
+// Control commands are applied here, between two recv() calls.
+void receive_loop(ReceiveContext& ctx) {
+    uhd::set_thread_priority_safe();
+
+    SampleBlock scratch;
+    scratch.samples.resize(ctx.block_size);
+    uhd::rx_metadata_t md;
+    uint64_t seq = 0;
+    double blank_until = 0.0;
+    ControlCommand cmd;
+
+    while (!stop_signal_called) {
+        while (ctx.control->poll(cmd)) {
+            std::string error = apply_control_command(ctx.frontend, cmd, ctx.settings);
+            ctx.settings.generation++;
+            if (error.empty() && cmd.key != "fft-size") {
+                blank_until = ctx.frontend->get_time_now().get_real_secs() + ctx.settle_secs;
+            }
+
+            std::ostringstream record;
+            record << "{\"type\":\"config\""
+                   << ",\"generation\":" << ctx.settings.generation
+                   << ",\"command\":\"" << json_escape(cmd.key) << "\""
+                   << ",\"ok\":" << (error.empty() ? "true" : "false")
+                   << ",\"centerFreq\":" << ctx.settings.center_freq
+                   << ",\"gain\":" << ctx.frontend->get_rx_gain()
+                   << ",\"bw\":" << ctx.frontend->get_rx_bandwidth()
+                   << ",\"antenna\":\"" << json_escape(ctx.frontend->get_rx_antenna()) << "\""
+                   << ",\"fftSize\":" << ctx.settings.fft_size;
+            if (!error.empty()) {
+                record << ",\"error\":\"" << json_escape(error) << "\"";
+            }
+            record << "}";
+            ctx.records->push(record.str());
+        }
+
+        SampleBlock* block = ctx.ring->acquire_write();
+        while (!block && ctx.lossless && !stop_signal_called) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            block = ctx.ring->acquire_write();
+        }
+        SampleBlock* target = block ? block : &scratch;
+
+        size_t num_rx_samps = ctx.frontend->recv(target->samples.data(), ctx.block_size, md, 3.0);
+        const auto received = std::chrono::steady_clock::now();
+
+        // Handle errors
+        if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
+            if (ctx.frontend->finished()) break;  // Replay reached the end of its file
+            std::cerr << "Timeout while streaming" << std::endl;
+            continue;
+        }
+        if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW) {
+            // Samples were lost: skip a sequence number so the DSP thread
+            // restarts its overlap window, as for a ring drop
+            ctx.overflow_count.fetch_add(1, std::memory_order_relaxed);
+            seq++;
+            continue;
+        }
+        if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
+            std::cerr << "Receiver error: " << md.strerror() << std::endl;
+            continue;
+        }
+
+        // Still settling after a retune: the slot is simply reused
+        const double timestamp = md.time_spec.get_real_secs();
+        if (timestamp < blank_until) {
+            continue;
+        }
+
+        if (!block) {
+            ctx.ring->mark_dropped();
+            seq++;
+            continue;
+        }
+
+        block->num_samps = num_rx_samps;
+        block->timestamp = timestamp;
+        block->seq = seq++;
+        block->settings = ctx.settings;
+        block->received = received;
+        ctx.ring->commit_write();
+    }
+    ctx.done.store(true, std::memory_order_release);
+}
+
 struct GPSDOStatus {
     bool locked;
     std::string time;
@@ -67,13 +290,11 @@ GPSDOStatus get_gpsdo_status(uhd::usrp::multi_usrp::sptr usrp) {
 }
 
 int UHD_SAFE_MAIN(int argc, char *argv[]) {
-    // Set thread priority
-    uhd::set_thread_priority_safe();
-
     // Command line options
-    std::string device_args, subdev, ant, ref, clock_source;
-    double freq, rate, gain, bw;
-    size_t fft_size;
+    std::string device_args, subdev, ant, ref, clock_source, output_format_name, payload_name;
+    std::string plan_effort_name, wisdom_file;
+    double freq, rate, gain, bw, overlap_pct, frame_rate, settle_ms, perf_interval;
+    size_t fft_size, ring_blocks, avg_count;
     bool use_gpsdo;
 
     po::options_description desc("Allowed options");
@@ -89,7 +310,17 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
         ("ref", po::value<std::string>(&ref)->default_value("internal"), "Reference source (internal/external/gpsdo)")
         ("clock", po::value<std::string>(&clock_source)->default_value("internal"), "Clock source")
         ("fft-size", po::value<size_t>(&fft_size)->default_value(2048), "FFT size")
+        ("overlap", po::value<double>(&overlap_pct)->default_value(0), "FFT overlap in percent (0-95)")
+        ("avg", po::value<size_t>(&avg_count)->default_value(1), "Minimum FFTs averaged per output frame")
+        ("frame-rate", po::value<double>(&frame_rate)->default_value(0), "Max output frames per second (0 = unlimited)")
         ("gpsdo", po::value<bool>(&use_gpsdo)->default_value(true), "Use GPSDO if available")
+        ("ring-blocks", po::value<size_t>(&ring_blocks)->default_value(512), "Receive ring capacity in FFT-sized blocks")
+        ("output-format", po::value<std::string>(&output_format_name)->default_value("json"), "Stdout format (json/binary)")
+        ("payload", po::value<std::string>(&payload_name)->default_value("float32"), "Binary bin payload (float32/int16)")
+        ("settle-ms", po::value<double>(&settle_ms)->default_value(5), "Samples discarded after a live retune (ms)")
+        ("plan-effort", po::value<std::string>(&plan_effort_name)->default_value("measure"), "FFTW planner effort (estimate/measure/patient/exhaustive)")
+        ("wisdom-file", po::value<std::string>(&wisdom_file)->default_value(""), "FFTW wisdom cache (default: per-CPU file under ~/.cache/sdr)")
+        ("perf-interval", po::value<double>(&perf_interval)->default_value(10), "Seconds between {\"type\":\"perf\"} stage latency records (0 = off)")
     ;
 
     po::variables_map vm;
@@ -101,6 +332,30 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
         return EXIT_SUCCESS;
     }
 
+    OutputFormat output_format;
+    BinPayload bin_payload;
+    if (!parse_output_format(output_format_name, output_format)) {
+        std::cerr << "Error: Unknown output format '" << output_format_name << "' (json/binary)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!parse_bin_payload(payload_name, bin_payload)) {
+        std::cerr << "Error: Unknown payload '" << payload_name << "' (float32/int16)" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    PlanEffort plan_effort;
+    if (!parse_plan_effort(plan_effort_name, plan_effort)) {
+        std::cerr << "Error: Unknown plan effort '" << plan_effort_name
+                  << "' (estimate/measure/patient/exhaustive)" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (overlap_pct < 0.0 || overlap_pct > 95.0) {
+        std::cerr << "Error: Overlap " << overlap_pct << "% out of range [0-95%]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (avg_count < 1) avg_count = 1;
+
     // Validate B210 hardware limits
     if (freq < B210_MIN_FREQ || freq > B210_MAX_FREQ) {
         std::cerr << "Error: Frequency " << freq/1e6 << " MHz out of range ["
@@ -120,10 +375,16 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
 
     // Create USRP device
     std::cerr << "Creating B210 USRP device with args: " << device_args << std::endl;
-    uhd::usrp::multi_usrp::sptr usrp = uhd::usrp::multi_usrp::make(device_args);
+    RxFrontend::sptr frontend = RxFrontend::make(device_args);
+    uhd::usrp::multi_usrp::sptr usrp = frontend->usrp();
 
     // Detect GPSDO and configure clock/time source
-    if (use_gpsdo) {
+    if (!usrp) {
+        const ReplaySource& replay = *frontend->replay();
+        std::cerr << "Replaying " << replay.path() << " (" << sample_format_name(replay.format()) << ", "
+                  << replay.samples() << " samples, " << (replay.paced() ? "paced" : "fast")
+                  << (replay.loop() ? ", looped" : "") << ")" << std::endl;
+    } else if (use_gpsdo) {
         try {
             auto sensors = usrp->get_mboard_sensor_names(0);
             bool has_gpsdo = std::find(sensors.begin(), sensors.end(), "gps_locked") != sensors.end();
@@ -167,150 +428,224 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     }
 
     // Configure RX
-    usrp->set_rx_subdev_spec(subdev);
-    usrp->set_rx_rate(rate);
-    usrp->set_rx_freq(freq);
-    usrp->set_rx_gain(gain);
-    usrp->set_rx_bandwidth(bw);
-    usrp->set_rx_antenna(ant);
-
-    std::this_thread::sleep_for(std::chrono::seconds(1)); // Allow hardware to settle
+    if (usrp) usrp->set_rx_subdev_spec(subdev);
+    frontend->set_rx_rate(rate);
+    frontend->set_rx_freq(freq);
+    frontend->set_rx_gain(gain);
+    frontend->set_rx_bandwidth(bw);
+    frontend->set_rx_antenna(ant);
+
+    if (usrp) {
+        std::this_thread::sleep_for(std::chrono::seconds(1)); // Allow hardware to settle
+    } else {
+        rate = frontend->get_rx_rate();  // A recording plays at its own rate
+    }
 
     // Print actual settings
-    std::cerr << boost::format("Actual RX Rate: %f Msps") % (usrp->get_rx_rate()/1e6) << std::endl;
-    std::cerr << boost::format("Actual RX Freq: %f MHz") % (usrp->get_rx_freq()/1e6) << std::endl;
-    std::cerr << boost::format("Actual RX Gain: %f dB") % usrp->get_rx_gain() << std::endl;
-    std::cerr << boost::format("Actual RX BW: %f MHz") % (usrp->get_rx_bandwidth()/1e6) << std::endl;
+    std::cerr << boost::format("Actual RX Rate: %f Msps") % (frontend->get_rx_rate()/1e6) << std::endl;
+    std::cerr << boost::format("Actual RX Freq: %f MHz") % (frontend->get_rx_freq()/1e6) << std::endl;
+    std::cerr << boost::format("Actual RX Gain: %f dB") % frontend->get_rx_gain() << std::endl;
+    std::cerr << boost::format("Actual RX BW: %f MHz") % (frontend->get_rx_bandwidth()/1e6) << std::endl;
 
     // Setup streaming
     uhd::stream_args_t stream_args("fc32", "sc16");
-    uhd::rx_streamer::sptr rx_stream = usrp->get_rx_stream(stream_args);
+    frontend->setup_stream(stream_args);
+
+    // Preallocate the receive ring (blocks are sized by the startup FFT size;
+    // the DSP thread reassembles them, so live fft-size changes are fine)
+    const size_t block_size = fft_size;
+    SampleBlock prototype;
+    prototype.samples.resize(block_size);
+    SampleRing ring(ring_blocks, prototype);
+
+    const dsp::Kernels& kernels = dsp::kernels();
+    std::cerr << "DSP kernels: " << kernels.name << std::endl;
+
+    WisdomStore wisdom(wisdom_file.empty() ? default_wisdom_path() : wisdom_file);
+    std::cerr << "FFTW wisdom " << (wisdom.load() ? "loaded from " : "will be saved to ")
+              << wisdom.path() << std::endl;
+
+    // Window, FFT, power and averaging (streamer_pipeline.hpp)
+    StreamerPipelineConfig pipeline_config;
+    pipeline_config.rate = rate;
+    pipeline_config.overlap_pct = overlap_pct;
+    pipeline_config.avg_count = avg_count;
+    pipeline_config.frame_rate = frame_rate;
+    pipeline_config.max_block = block_size;
+    pipeline_config.plan_flags = plan_effort_flags(plan_effort);
+    StreamerPipeline pipeline(pipeline_config);
+    uint64_t expected_seq = 0;
+
+    // Stage latencies (stage_latency.hpp), reported every --perf-interval
+    StageTimes perf;
+    StageTimes* perf_times = perf_interval > 0 ? &perf : nullptr;
+    pipeline.set_stage_times(perf_times);
+    std::chrono::steady_clock::time_point block_received;
+
+    auto configure_fft = [&](size_t n) {
+        fft_size = n;
+        const double plan_ms = pipeline.configure(fft_size);
+        if (!wisdom.save()) {
+            std::cerr << "Warning: could not write FFTW wisdom to " << wisdom.path() << std::endl;
+        }
+        std::cerr << "FFT size: " << fft_size << ", hop: " << pipeline.hop() << " samples, averaging >= "
+                  << avg_count << " FFTs per frame, " << plan_effort_name << " plan in "
+                  << static_cast<long>(plan_ms) << " ms" << std::endl;
+    };
+    configure_fft(fft_size);
 
-    uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
-    stream_cmd.stream_now = true;
-    rx_stream->issue_stream_cmd(stream_cmd);
-
-    // Allocate buffers
-    std::vector<std::complex<float>> buffer(fft_size);
-    std::vector<std::complex<float>*> buffs{buffer.data()};
-    
-    // FFTW setup
-    fftwf_complex* fft_in = fftwf_alloc_complex(fft_size);
-    fftwf_complex* fft_out = fftwf_alloc_complex(fft_size);
-    fftwf_plan plan = fftwf_plan_dft_1d(fft_size, fft_in, fft_out, FFTW_FORWARD, FFTW_MEASURE);
-
-    // Hann window
-    std::vector<float> window(fft_size);
-    for (size_t i = 0; i < fft_size; i++) {
-        window[i] = 0.5 * (1.0 - std::cos(2.0 * M_PI * i / (fft_size - 1)));
-    }
+    // int16 payloads carry dB values in 0.01 dB steps
+    BinaryFrameWriter frame_writer(std::cout, bin_payload, 0.01f);
 
     // Signal handler
     std::signal(SIGINT, &sig_int_handler);
     std::signal(SIGTERM, &sig_int_handler);
 
-    uhd::rx_metadata_t md;
+    // Live control: commands are read here and applied on the receive thread
+    ControlChannel control;
+    RecordQueue records;
+    ReceiveContext rx_ctx;
+    rx_ctx.frontend = frontend;
+    rx_ctx.ring = &ring;
+    rx_ctx.control = &control;
+    rx_ctx.records = &records;
+    rx_ctx.block_size = block_size;
+    rx_ctx.settle_secs = settle_ms / 1000.0;
+    rx_ctx.lossless = !usrp && !frontend->replay()->paced();
+    rx_ctx.settings.center_freq = frontend->get_rx_freq();
+    rx_ctx.settings.fft_size = fft_size;
+    LiveSettings current = rx_ctx.settings;
+
+    // Start streaming only once buffers and the FFT plan are ready
+    uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+    stream_cmd.stream_now = true;
+    frontend->issue_stream_cmd(stream_cmd);
+
+    control.start();
+    std::thread rx_thread(receive_loop, std::ref(rx_ctx));
+
     size_t frame_count = 0;
     auto last_status_time = std::chrono::steady_clock::now();
+    auto last_perf_time = last_status_time;
 
-    while (!stop_signal_called) {
-        // Receive samples
-        size_t num_rx_samps = rx_stream->recv(buffs, fft_size, md, 3.0);
-
-        // Handle errors
-        if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
-            std::cerr << "Timeout while streaming" << std::endl;
-            continue;
+    auto emit_record = [&](const std::string& record) {
+        if (output_format == OutputFormat::Binary) {
+            frame_writer.write_record(record);
+        } else {
+            std::cout << record << std::endl;
         }
-        if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
-            std::cerr << "Receiver error: " << md.strerror() << std::endl;
-            continue;
+    };
+
+    auto emit_frame = [&](const StreamerFrame& frame) {
+        const auto serialize_start = stage_clock(perf_times);
+        if (output_format == OutputFormat::Binary) {
+            encode_streamer_binary(frame_writer, frame, current.center_freq, rate, current.generation);
+        } else {
+            write_streamer_json(std::cout, frame, current.center_freq, rate, current.generation);
         }
+        const auto write_start = stage_clock(perf_times);
+        if (output_format == OutputFormat::Binary) {
+            frame_writer.write_frame();
+        } else {
+            std::cout.flush();
+        }
+        if (perf_times) {
+            const auto written = std::chrono::steady_clock::now();
+            perf.record(STAGE_SERIALIZE, serialize_start, write_start);
+            perf.record(STAGE_WRITE, write_start, written);
+            perf.record(STAGE_FRAME, block_received, written);
+        }
+        frame_count++;
+    };
 
-        // Bounds check
-        if (num_rx_samps < fft_size) {
-            std::cerr << "Warning: Incomplete sample buffer (" << num_rx_samps 
-                      << "/" << fft_size << "), skipping FFT" << std::endl;
-            continue;
+    while (!stop_signal_called) {
+        // Control acks go out before any frame of the new generation
+        std::string record;
+        while (records.pop(record)) {
+            emit_record(record);
         }
 
-        // Apply window and copy to FFT input
-        for (size_t i = 0; i < fft_size; i++) {
-            fft_in[i][0] = buffer[i].real() * window[i];
-            fft_in[i][1] = buffer[i].imag() * window[i];
+        SampleBlock* block = ring.acquire_read();
+        if (!block) {
+            if (rx_ctx.done.load(std::memory_order_acquire) && ring.depth() == 0) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
         }
 
-        // Compute FFT
-        fftwf_execute(plan);
-
-        // Compute power spectrum (dBFS) and find peak
-        std::vector<float> power_db(fft_size);
-        float peak_power = -200.0f;
-        size_t peak_bin = 0;
-        
-        for (size_t i = 0; i < fft_size; i++) {
-            // FFT shift
-            size_t j = (i + fft_size/2) % fft_size;
-            float real = fft_out[j][0];
-            float imag = fft_out[j][1];
-            float power = (real*real + imag*imag) / (fft_size * fft_size);
-            power_db[i] = 10.0f * std::log10(power + 1e-20f);  // Avoid log(0)
-            
-            if (power_db[i] > peak_power) {
-                peak_power = power_db[i];
-                peak_bin = i;
+        // New configuration: never average across it
+        if (block->settings.generation != current.generation) {
+            if (block->settings.fft_size != fft_size) {
+                configure_fft(block->settings.fft_size);
             }
+            current = block->settings;
+            pipeline.reset();
         }
 
-        // Output JSON FFT data
-        std::cout << "{\"type\":\"fft\",\"timestamp\":" << md.time_spec.get_real_secs()
-                  << ",\"centerFreq\":" << freq
-                  << ",\"sampleRate\":" << rate
-                  << ",\"fftSize\":" << fft_size
-                  << ",\"peakPower\":" << peak_power
-                  << ",\"peakBin\":" << peak_bin
-                  << ",\"data\":[";
-        
-        for (size_t i = 0; i < fft_size; i++) {
-            std::cout << power_db[i];
-            if (i < fft_size - 1) std::cout << ",";
+        // A sequence gap means the ring dropped blocks or the device
+        // overflowed: restart the overlap window so that no FFT straddles the discontinuity
+        if (block->seq != expected_seq) {
+            pipeline.restart_overlap();
         }
-        std::cout << "]}" << std::endl;
+        expected_seq = block->seq + 1;
 
-        frame_count++;
+        block_received = block->received;
+        if (perf_times) perf.record(STAGE_QUEUE, block_received, std::chrono::steady_clock::now());
+        pipeline.append(block->samples.data(), block->num_samps, block->timestamp);
+
+        // Samples are copied out, return the slot to the receive thread
+        ring.release_read();
+
+        pipeline.run(emit_frame);
 
-        // Periodic status update with GPSDO info (every 10 seconds)
         auto now = std::chrono::steady_clock::now();
+        const double perf_secs = std::chrono::duration<double>(now - last_perf_time).count();
+        if (perf_times && perf_secs >= perf_interval) {
+            emit_record(perf.perf_record(perf_secs));
+            perf.reset();
+            last_perf_time = now;
+        }
+
+        // Periodic status update with GPSDO info (every 10 seconds)
         if (std::chrono::duration_cast<std::chrono::seconds>(now - last_status_time).count() >= 10) {
-            GPSDOStatus gps = get_gpsdo_status(usrp);
-            
-            // Get temperature sensors
+            GPSDOStatus gps{false, "replay", "", "", 0.0};
             float rx_temp = 0.0f, tx_temp = 0.0f;
-            try {
-                rx_temp = std::stof(usrp->get_rx_sensor("temp").value);
-                tx_temp = std::stof(usrp->get_tx_sensor("temp").value);
-            } catch (...) {}
-
-            std::cout << "{\"type\":\"status\""
-                      << ",\"frames\":" << frame_count
-                      << ",\"gpsLocked\":" << (gps.locked ? "true" : "false")
-                      << ",\"gpsTime\":\"" << gps.time << "\""
-                      << ",\"gpsServo\":" << gps.servo
-                      << ",\"rxTemp\":" << rx_temp
-                      << ",\"txTemp\":" << tx_temp
-                      << "}" << std::endl;
+            if (usrp) {
+                gps = get_gpsdo_status(usrp);
+
+                // Get temperature sensors
+                try {
+                    rx_temp = std::stof(usrp->get_rx_sensor("temp").value);
+                    tx_temp = std::stof(usrp->get_tx_sensor("temp").value);
+                } catch (...) {}
+            }
+
+            std::ostringstream status;
+            status << "{\"type\":\"status\""
+                   << ",\"frames\":" << frame_count
+                   << ",\"gpsLocked\":" << (gps.locked ? "true" : "false")
+                   << ",\"gpsTime\":\"" << gps.time << "\""
+                   << ",\"gpsServo\":" << gps.servo
+                   << ",\"rxTemp\":" << rx_temp
+                   << ",\"txTemp\":" << tx_temp
+                   << ",\"ringDepth\":" << ring.depth()
+                   << ",\"ringHighWater\":" << ring.high_water()
+                   << ",\"ringCapacity\":" << ring.capacity()
+                   << ",\"droppedBlocks\":" << ring.dropped()
+                   << ",\"overflows\":" << rx_ctx.overflow_count.load(std::memory_order_relaxed)
+                   << ",\"configGen\":" << current.generation
+                   << "}";
+            emit_record(status.str());
             
             last_status_time = now;
         }
     }
 
+    rx_thread.join();
+    control.stop();
+
     // Cleanup
     stream_cmd.stream_mode = uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS;
-    rx_stream->issue_stream_cmd(stream_cmd);
-
-    fftwf_destroy_plan(plan);
-    fftwf_free(fft_in);
-    fftwf_free(fft_out);
+    frontend->issue_stream_cmd(stream_cmd);
 
     std::cerr << "Streaming stopped cleanly" << std::endl;
     return EXIT_SUCCESS;
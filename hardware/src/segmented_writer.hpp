@@ -0,0 +1,516 @@
+/**
+ * segmented_writer.hpp - Rotating, gap-free SigMF segments for the recorders
+ *
+ * Multi-hour captures are split into segments of a fixed number of samples
+ * (--segment-secs / --segment-mb) so they can be uploaded and analysed while
+ * recording continues: recording.sigmf-data becomes recording_00000.sigmf-data,
+ * recording_00001.sigmf-data, ... each with its own .sigmf-meta whose
+ * capture carries core:global_index (the segment's first sample in the
+ * whole stream) and the matching core:datetime.
+ *
+ * Stream positions count every sample the device produced, including ones
+ * lost to an overflow (mark_overflow()) or a full write queue
+ * (mark_dropped()). The next sample written after a loss starts a new
+ * capture with its own global_index and datetime, plus an "overflow" or
+ * "dropped" annotation. Each capture is contiguous, so readers can trust
+ * sample_start -> time without scanning the data. Datetimes are
+ * set_stream_start() + global_index / rate. Pass the hardware time of
+ * the first sample there.
+ *
+ * Every segment is an AsyncFileWriter. A rotator thread keeps the next one
+ * open, preallocated and with its buffers faulted in, so the receive
+ * thread's switch is a pointer swap at an exact sample boundary: acquire()
+ * never hands out space past the end of a segment. The finished segment is
+ * then drained, truncated and described on the rotator thread. If the next
+ * segment is not ready yet the current one simply grows until it is; no
+ * samples are lost to a rotation. This costs a second write-buffer pool
+ * while rotating.
+ *
+ * With a retention budget (--retain-mb) the oldest complete segments are
+ * deleted once the total exceeds it. Completed segments are reported
+ * through poll().
+ *
+ * With segment_samples = 0 it is a single AsyncFileWriter on the output
+ * path plus its .sigmf-meta, so the recorders have one write path.
+ *
+ * With compression on, each segment puts an IqCompressor in front of its
+ * writer: the data file becomes <base>.iqz (see iq_compress.hpp), the
+ * .sigmf-meta keeps its name and describes the decompressed samples, and
+ * segment boundaries still fall on exact raw sample counts.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_writer.hpp"
+#include "control_channel.hpp"
+#include "iq_compress.hpp"
+#include "latency_histogram.hpp"
+#include "sigmf.hpp"
+
+struct SegmentOptions {
+    uint64_t segment_samples = 0;   // Samples per segment, 0 = one file
+    uint64_t total_samples = 0;     // Capture length if known, for preallocation
+    uint64_t retain_bytes = 0;      // Keep at most this much of complete segments (0 = all)
+    size_t sample_bytes = 8;
+    double sample_rate = 0.0;
+    bool compress = false;          // Write .iqz through an IqCompressor
+    IqCompressOptions compression;
+    SampleFormat format = SampleFormat::Cf32;   // For the compressor's transform
+};
+
+struct SegmentEvent {
+    unsigned index = 0;
+    std::string file;
+    std::string meta_file;
+    uint64_t global_index = 0;      // First sample's position in the stream
+    uint64_t samples = 0;
+    uint64_t stored_bytes = 0;      // On disk (less than samples' worth if compressed)
+    unsigned gaps = 0;              // Captures started by a loss
+    uint64_t lost_samples = 0;
+    bool ok = true;
+    std::string error;
+    std::vector<std::string> deleted;   // Dropped by the retention budget
+};
+
+// {"type":"segment"} record for the parent process
+inline std::string segment_event_json(const SegmentEvent& event) {
+    std::ostringstream record;
+    record << "{\"type\":\"segment\""
+           << ",\"ok\":" << (event.ok ? "true" : "false")
+           << ",\"index\":" << event.index
+           << ",\"file\":\"" << json_escape(event.file) << "\""
+           << ",\"metaFile\":\"" << json_escape(event.meta_file) << "\""
+           << ",\"globalIndex\":" << event.global_index
+           << ",\"samples\":" << event.samples
+           << ",\"bytes\":" << event.stored_bytes;
+    if (event.gaps > 0) {
+        record << ",\"gaps\":" << event.gaps << ",\"lostSamples\":" << event.lost_samples;
+    }
+    if (!event.deleted.empty()) {
+        record << ",\"deleted\":[";
+        for (size_t i = 0; i < event.deleted.size(); i++) {
+            record << (i ? "," : "") << "\"" << json_escape(event.deleted[i]) << "\"";
+        }
+        record << "]";
+    }
+    if (!event.error.empty()) {
+        record << ",\"error\":\"" << json_escape(event.error) << "\"";
+    }
+    record << "}";
+    return record.str();
+}
+
+class SegmentedWriter {
+public:
+    // `meta` is the SigMF template (datatype, rate, hw, frequency in the
+    // first capture); each segment fills in its own capture
+    SegmentedWriter(const std::string& output, const AsyncWriterOptions& writer_options,
+                    const SegmentOptions& options, SigmfMeta meta)
+        : output_(output), writer_options_(writer_options), options_(options), meta_(std::move(meta)),
+          stream_start_(std::chrono::system_clock::now()) {
+        frequency_ = meta_.captures.empty() ? 0.0 : meta_.captures[0].frequency;
+        segment_bytes_ = options_.segment_samples * options_.sample_bytes;
+
+        current_ = open_segment(segmented() ? 0 : NOT_NUMBERED);
+        if (!current_) return;
+        if (segmented()) {
+            next_index_ = 1;
+            rotator_ = std::thread(&SegmentedWriter::rotator_loop, this);
+        }
+    }
+
+    ~SegmentedWriter() { close(); }
+
+    SegmentedWriter(const SegmentedWriter&) = delete;
+    SegmentedWriter& operator=(const SegmentedWriter&) = delete;
+
+    bool is_open() const { return current_ != nullptr; }
+    bool segmented() const { return options_.segment_samples > 0; }
+    // The segment being written (backend, queue depth)
+    const AsyncFileWriter& current() const { return *current_->writer; }
+    const std::string& current_path() const { return current_->path; }
+
+    // Time of the first sample (hardware time where the device has it),
+    // for core:datetime; call before the first commit()
+    void set_stream_start(std::chrono::system_clock::time_point when) { stream_start_ = when; }
+
+    // Producer: as AsyncFileWriter::acquire(), but never past a segment end
+    void* acquire(size_t& bytes_available) {
+        if (segmented() && current_->bytes >= segment_bytes_) rotate();
+        void* space = current_->compressor ? current_->compressor->acquire(bytes_available)
+                                           : current_->writer->acquire(bytes_available);
+        if (space && segmented() && current_->bytes < segment_bytes_) {
+            bytes_available = static_cast<size_t>(std::min<uint64_t>(bytes_available, segment_bytes_ - current_->bytes));
+        }
+        return space;
+    }
+
+    void commit(size_t bytes) {
+        if (current_->breaks.empty() || pending_overflow_ + pending_dropped_ > 0) start_capture();
+        if (current_->compressor) current_->compressor->commit(bytes);
+        else current_->writer->commit(bytes);
+        current_->bytes += bytes;
+        stream_bytes_ += bytes;
+    }
+
+    // Producer: copies in samples that were not received in place (the
+    // DDC's output), across segment ends; whatever finds every buffer
+    // queued is dropped
+    void write(const void* data, size_t bytes) {
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        while (bytes > 0) {
+            size_t available = 0;
+            void* space = acquire(available);
+            if (!space) {
+                mark_dropped(bytes);
+                return;
+            }
+            const size_t chunk = std::min(bytes, available);
+            std::memcpy(space, src, chunk);
+            commit(chunk);
+            src += chunk;
+            bytes -= chunk;
+        }
+    }
+
+    // Dropped samples still advance the stream position of later segments
+    void mark_dropped(size_t bytes) {
+        current_->writer->mark_dropped(bytes);
+        stream_bytes_ += bytes;
+        pending_dropped_ += bytes / options_.sample_bytes;
+    }
+
+    // Producer: the device skipped `samples` before the next commit();
+    // `estimated` if the count came from the host clock
+    void mark_overflow(uint64_t samples, bool estimated) {
+        if (samples == 0) return;
+        stream_bytes_ += samples * options_.sample_bytes;
+        pending_overflow_ += samples;
+        pending_estimated_ = pending_estimated_ || estimated;
+    }
+
+    // Producer: closes the current segment (and discards the pre-opened
+    // next one). Returns false if any segment failed to write.
+    bool close() {
+        if (closed_ || !current_) return !failed_;
+        closed_ = true;
+        if (segmented()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closing_.push_back(std::move(current_));
+                stopping_ = true;
+            }
+            cv_.notify_all();
+            if (rotator_.joinable()) rotator_.join();
+        } else {
+            std::unique_ptr<Segment> last = std::move(current_);
+            finish_segment(*last);
+        }
+        return !failed_;
+    }
+
+    // Main loop: oldest completed-segment event, false if none
+    bool poll(SegmentEvent& event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (events_.empty()) return false;
+        event = std::move(events_.front());
+        events_.pop_front();
+        return true;
+    }
+
+    bool compressed() const { return options_.compress; }
+    // Compression worker threads per segment
+    unsigned compress_threads() const { return current_ && current_->compressor ? current_->compressor->threads() : 0; }
+
+    // Statistics over all segments; call from the producer thread
+    unsigned segments() const { return segments_done_.load() + (current_ ? 1 : 0); }
+    // Captures started by an overflow or drop, and the samples they skipped
+    unsigned gaps() const { return gaps_; }
+    uint64_t lost_samples() const { return lost_samples_; }
+    // Samples' worth of bytes accepted, before compression
+    uint64_t raw_bytes() const { return done_raw_.load() + (current_ ? current_->bytes : 0); }
+    double compress_seconds() const {
+        return done_compress_ns_.load() / 1e9
+            + (current_ && current_->compressor ? current_->compressor->compress_seconds() : 0.0);
+    }
+    uint64_t bytes_written() const {
+        return done_bytes_.load() + (current_ ? current_->writer->bytes_written() : 0);
+    }
+    uint64_t dropped_bytes() const {
+        return done_dropped_.load() + (current_ ? current_->writer->dropped_bytes() : 0);
+    }
+    double busy_seconds() const {
+        return done_busy_ns_.load() / 1e9 + (current_ ? current_->writer->busy_seconds() : 0.0);
+    }
+    size_t buffers_peak() const { return std::max(done_peak_.load(), current_ ? current_->writer->buffers_peak() : 0); }
+    int error() const { return error_.load(); }
+    // Per-write latency across every segment; read after close()
+    const LatencyHistogram& write_latency() const { return latency_; }
+
+private:
+    static constexpr unsigned NOT_NUMBERED = ~0u;
+
+    // Start of a contiguous run of samples within a segment
+    struct Break {
+        uint64_t sample_start;      // In the segment
+        uint64_t global_index;      // In the stream
+        uint64_t overflow;          // Samples lost just before it
+        uint64_t dropped;
+        bool estimated;
+    };
+
+    struct Segment {
+        unsigned index = 0;
+        std::string path;
+        std::string meta_path;
+        std::unique_ptr<AsyncFileWriter> writer;
+        std::unique_ptr<IqCompressor> compressor;   // Feeds writer when compressing
+        uint64_t global_bytes = 0;  // Stream position of the first byte
+        uint64_t bytes = 0;         // Committed so far
+        std::vector<Break> breaks;  // One capture starts at each
+    };
+
+    std::unique_ptr<Segment> open_segment(unsigned index) {
+        auto segment = std::make_unique<Segment>();
+        segment->index = index;
+        const std::string data_path = index == NOT_NUMBERED ? output_ : sigmf_numbered_path(output_, index, 5);
+        segment->path = options_.compress ? iqz_path(data_path) : data_path;
+        segment->meta_path = sigmf_meta_path(data_path);
+        AsyncWriterOptions options = writer_options_;
+        options.expected_bytes = segmented() ? segment_bytes_ : options_.total_samples * options_.sample_bytes;
+        segment->writer = std::make_unique<AsyncFileWriter>(segment->path, options);
+        if (!segment->writer->is_open()) {
+            error_ = errno;
+            return nullptr;
+        }
+        if (options_.compress) {
+            segment->compressor = std::make_unique<IqCompressor>(*segment->writer, options_.format,
+                                                                 options_.sample_rate, options_.compression);
+        }
+        return segment;
+    }
+
+    struct RetainedSegment {
+        std::string path;
+        std::string meta_path;
+        uint64_t bytes;
+    };
+
+    // Producer: the next committed sample begins a capture
+    void start_capture() {
+        Segment& segment = *current_;
+        const uint64_t sample = segment.bytes / options_.sample_bytes;
+        if (segment.bytes == 0) segment.global_bytes = stream_bytes_;
+        if (pending_overflow_ + pending_dropped_ > 0) {
+            gaps_++;
+            lost_samples_ += pending_overflow_ + pending_dropped_;
+        }
+        segment.breaks.push_back(Break{sample, stream_bytes_ / options_.sample_bytes,
+                                       pending_overflow_, pending_dropped_, pending_estimated_});
+        pending_overflow_ = 0;
+        pending_dropped_ = 0;
+        pending_estimated_ = false;
+    }
+
+    // Producer: swap in the pre-opened segment if the rotator has it ready
+    void rotate() {
+        std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+        if (!lock.owns_lock() || !next_) return;  // Keep growing this one
+        closing_.push_back(std::move(current_));
+        current_ = std::move(next_);
+        current_->global_bytes = stream_bytes_;
+        lock.unlock();
+        cv_.notify_all();
+    }
+
+    void rotator_loop() {
+        while (true) {
+            std::unique_ptr<Segment> done;
+            bool want_next;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return !closing_.empty() || stopping_ || (!next_ && !open_failed_); });
+                if (!closing_.empty()) {
+                    done = std::move(closing_.front());
+                    closing_.pop_front();
+                } else if (stopping_) {
+                    break;
+                }
+                want_next = !next_ && !open_failed_ && !stopping_;
+            }
+
+            // Pre-open first so the producer can rotate again as soon as possible
+            if (want_next) {
+                std::unique_ptr<Segment> next = open_segment(next_index_);
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (next) {
+                    next_index_++;
+                    next_ = std::move(next);
+                } else {
+                    open_failed_ = true;
+                    SegmentEvent event;
+                    event.ok = false;
+                    event.file = sigmf_numbered_path(output_, next_index_, 5);
+                    event.meta_file = sigmf_meta_path(event.file);
+                    if (options_.compress) event.file = iqz_path(event.file);
+                    event.error = std::string("could not open next segment: ") + std::strerror(error_.load());
+                    events_.push_back(event);
+                }
+            }
+            if (done) finish_segment(*done);
+        }
+
+        // Never used: remove the pre-opened file
+        if (next_) {
+            next_->compressor.reset();
+            next_->writer->close();
+            std::remove(next_->path.c_str());
+            next_.reset();
+        }
+    }
+
+    // Drains and closes a segment, writes its meta and applies retention
+    void finish_segment(Segment& segment) {
+        bool ok = true;
+        if (segment.compressor) {
+            // Index and trailer go through the writer, so it closes after
+            ok = segment.compressor->finish();
+            done_compress_ns_ += static_cast<int64_t>(segment.compressor->compress_seconds() * 1e9);
+        }
+        ok = segment.writer->close() && ok;
+        AsyncFileWriter& writer = *segment.writer;
+        done_raw_ += segment.bytes;
+        done_bytes_ += writer.bytes_written();
+        done_dropped_ += writer.dropped_bytes();
+        done_busy_ns_ += static_cast<int64_t>(writer.busy_seconds() * 1e9);
+        done_peak_ = std::max(done_peak_.load(), writer.buffers_peak());
+        latency_.merge(writer.write_latency());
+        segments_done_++;
+
+        SegmentEvent event;
+        event.index = segment.index;
+        event.file = segment.path;
+        event.meta_file = segment.meta_path;
+        event.global_index = segment.global_bytes / options_.sample_bytes;
+        for (const Break& b : segment.breaks) {
+            if (b.overflow + b.dropped == 0) continue;
+            event.gaps++;
+            event.lost_samples += b.overflow + b.dropped;
+        }
+        event.samples = segment.compressor ? segment.compressor->raw_bytes() / options_.sample_bytes
+                                           : writer.bytes_written() / options_.sample_bytes;
+        event.stored_bytes = writer.bytes_written();
+        if (!ok) {
+            failed_ = true;
+            error_ = writer.error();
+            event.ok = false;
+            event.error = std::strerror(writer.error());
+        }
+
+        SigmfMeta meta = meta_;
+        meta.captures.clear();
+        if (segment.breaks.empty()) segment.breaks.push_back(Break{0, event.global_index, 0, 0, false});
+        for (const Break& b : segment.breaks) {
+            SigmfCapture capture;
+            capture.sample_start = b.sample_start;
+            capture.frequency = frequency_;
+            capture.datetime = iso8601_utc(stream_start_
+                + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::nanoseconds(std::llround(b.global_index * 1e9 / options_.sample_rate))));
+            if (segmented() || segment.breaks.size() > 1) capture.global_index = static_cast<int64_t>(b.global_index);
+            meta.captures.push_back(capture);
+            if (b.overflow + b.dropped == 0) continue;
+
+            std::ostringstream comment;
+            if (b.overflow > 0) {
+                comment << b.overflow << " samples lost to a device overflow"
+                        << (b.estimated ? " (estimated from the host clock)" : "");
+            }
+            if (b.dropped > 0) {
+                comment << (b.overflow ? "; " : "") << b.dropped << " samples dropped, write queue full";
+            }
+            meta.annotations.push_back(SigmfAnnotation{b.sample_start, 0, b.overflow ? "overflow" : "dropped",
+                                                       comment.str()});
+        }
+        if (!write_sigmf_meta(segment.meta_path, meta) && event.ok) {
+            event.ok = false;
+            event.error = "failed to write " + segment.meta_path;
+        }
+
+        // The budget counts bytes on disk, so compression stretches it
+        if (segmented() && options_.retain_bytes > 0) {
+            retained_.push_back({segment.path, segment.meta_path, writer.bytes_written()});
+            retained_bytes_ += writer.bytes_written();
+            while (retained_bytes_ > options_.retain_bytes && retained_.size() > 1) {
+                const RetainedSegment& oldest = retained_.front();
+                std::remove(oldest.path.c_str());
+                std::remove(oldest.meta_path.c_str());
+                event.deleted.push_back(oldest.path);
+                retained_bytes_ -= oldest.bytes;
+                retained_.pop_front();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.push_back(std::move(event));
+    }
+
+    std::string output_;
+    AsyncWriterOptions writer_options_;
+    SegmentOptions options_;
+    SigmfMeta meta_;
+    double frequency_ = 0.0;
+    std::chrono::system_clock::time_point stream_start_;
+    uint64_t segment_bytes_ = 0;
+
+    // Producer side
+    std::unique_ptr<Segment> current_;
+    uint64_t stream_bytes_ = 0;
+    uint64_t pending_overflow_ = 0;     // Lost since the last commit()
+    uint64_t pending_dropped_ = 0;
+    bool pending_estimated_ = false;
+    unsigned gaps_ = 0;
+    uint64_t lost_samples_ = 0;
+    bool closed_ = false;
+
+    // Shared with the rotator under mutex_
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unique_ptr<Segment> next_;
+    std::deque<std::unique_ptr<Segment>> closing_;
+    std::deque<SegmentEvent> events_;
+    unsigned next_index_ = 0;
+    bool open_failed_ = false;
+    bool stopping_ = false;
+    std::thread rotator_;
+
+    // Rotator side (and close() for a single file)
+    std::deque<RetainedSegment> retained_;
+    uint64_t retained_bytes_ = 0;
+    LatencyHistogram latency_;
+    std::atomic<uint64_t> done_bytes_{0};
+    std::atomic<uint64_t> done_raw_{0};
+    std::atomic<int64_t> done_compress_ns_{0};
+    std::atomic<uint64_t> done_dropped_{0};
+    std::atomic<int64_t> done_busy_ns_{0};
+    std::atomic<size_t> done_peak_{0};
+    std::atomic<unsigned> segments_done_{0};
+    std::atomic<bool> failed_{false};
+    std::atomic<int> error_{0};
+};
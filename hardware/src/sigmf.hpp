@@ -0,0 +1,203 @@
+/**
+ * sigmf.hpp - SigMF metadata (.sigmf-meta) writer shared by the recorders
+ *
+ * Writes the JSON metadata that accompanies a recording: global fields
+ * (datatype, rate, hardware), one `captures` entry per contiguous run
+ * of samples and optional `annotations` over sample ranges. The file is written next to the data file following the
+ * SigMF naming rule (x.sigmf-data -> x.sigmf-meta) and swapped in with
+ * rename(), so readers never see a half-written meta file.
+ *
+ * read_sigmf_core() pulls the few fields the offline tools need back out
+ * of a meta file. It is a key search, not a JSON parser: enough for what
+ * write_sigmf_meta() and other SigMF writers emit.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct SigmfCapture {
+    uint64_t sample_start = 0;
+    double frequency = 0.0;
+    std::string datetime;       // ISO 8601 UTC, empty to omit
+    int64_t global_index = -1;  // Position in the original stream, -1 to omit
+};
+
+struct SigmfAnnotation {
+    uint64_t sample_start = 0;
+    uint64_t sample_count = 0;  // 0 to omit (a point, e.g. a gap)
+    std::string label;
+    std::string comment;        // Empty to omit
+};
+
+struct SigmfMeta {
+    std::string datatype = "cf32_le";
+    double sample_rate = 0.0;
+    std::string description;
+    std::string recorder;
+    std::string hw;
+    std::vector<SigmfCapture> captures;
+    std::vector<SigmfAnnotation> annotations;
+};
+
+// x.sigmf-data -> x.sigmf-meta; any other name gets the extension appended
+inline std::string sigmf_meta_path(const std::string& data_path) {
+    static const std::string data_ext = ".sigmf-data";
+    if (data_path.size() > data_ext.size()
+        && data_path.compare(data_path.size() - data_ext.size(), data_ext.size(), data_ext) == 0) {
+        return data_path.substr(0, data_path.size() - data_ext.size()) + ".sigmf-meta";
+    }
+    return data_path + ".sigmf-meta";
+}
+
+// recording.sigmf-data -> recording_007.sigmf-data for numbered files
+// (triggered dumps, segments); other names get the index and extension
+inline std::string sigmf_numbered_path(const std::string& output, unsigned index, int digits) {
+    static const std::string data_ext = ".sigmf-data";
+    std::string base = output;
+    if (base.size() > data_ext.size()
+        && base.compare(base.size() - data_ext.size(), data_ext.size(), data_ext) == 0) {
+        base.resize(base.size() - data_ext.size());
+    }
+    char suffix[24];
+    std::snprintf(suffix, sizeof(suffix), "_%0*u", digits, index);
+    return base + suffix + data_ext;
+}
+
+inline std::string iso8601_utc(std::time_t when) {
+    std::tm tm = *std::gmtime(&when);
+    std::ostringstream oss;
+    oss << std::put_time(&tm, "%Y-%m-%dT%H:%M:%SZ");
+    return oss.str();
+}
+
+// Nanosecond resolution, so hardware timestamps survive sample-accurate
+inline std::string iso8601_utc(std::chrono::system_clock::time_point when) {
+    const auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(when.time_since_epoch());
+    const std::time_t secs = static_cast<std::time_t>(since_epoch.count() / 1000000000);
+    std::tm tm = *std::gmtime(&secs);
+    char frac[16];
+    std::snprintf(frac, sizeof(frac), ".%09lldZ", static_cast<long long>(since_epoch.count() % 1000000000));
+    std::ostringstream oss;
+    oss << std::put_time(&tm, "%Y-%m-%dT%H:%M:%S") << frac;
+    return oss.str();
+}
+
+inline std::string sigmf_json_string(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+inline bool write_sigmf_meta(const std::string& meta_path, const SigmfMeta& meta) {
+    const std::string tmp_path = meta_path + ".tmp";
+    {
+        std::ofstream out(tmp_path);
+        if (!out.is_open()) return false;
+        out << std::setprecision(15);
+
+        out << "{\n";
+        out << "  \"global\": {\n";
+        out << "    \"core:datatype\": " << sigmf_json_string(meta.datatype) << ",\n";
+        out << "    \"core:sample_rate\": " << meta.sample_rate << ",\n";
+        out << "    \"core:version\": \"1.0.0\",\n";
+        if (!meta.description.empty()) {
+            out << "    \"core:description\": " << sigmf_json_string(meta.description) << ",\n";
+        }
+        out << "    \"core:author\": \"Ettus SDR Web App\",\n";
+        out << "    \"core:recorder\": " << sigmf_json_string(meta.recorder) << ",\n";
+        out << "    \"core:hw\": " << sigmf_json_string(meta.hw) << "\n";
+        out << "  },\n";
+        out << "  \"captures\": [";
+        for (size_t i = 0; i < meta.captures.size(); i++) {
+            const SigmfCapture& capture = meta.captures[i];
+            out << (i ? ",\n" : "\n") << "    {\n";
+            out << "      \"core:sample_start\": " << capture.sample_start << ",\n";
+            out << "      \"core:frequency\": " << capture.frequency;
+            if (capture.global_index >= 0) {
+                out << ",\n      \"core:global_index\": " << capture.global_index;
+            }
+            if (!capture.datetime.empty()) {
+                out << ",\n      \"core:datetime\": " << sigmf_json_string(capture.datetime);
+            }
+            out << "\n    }";
+        }
+        out << "\n  ],\n";
+        out << "  \"annotations\": [";
+        for (size_t i = 0; i < meta.annotations.size(); i++) {
+            const SigmfAnnotation& annotation = meta.annotations[i];
+            out << (i ? ",\n" : "\n") << "    {\n";
+            out << "      \"core:sample_start\": " << annotation.sample_start << ",\n";
+            if (annotation.sample_count > 0) {
+                out << "      \"core:sample_count\": " << annotation.sample_count << ",\n";
+            }
+            out << "      \"core:label\": " << sigmf_json_string(annotation.label);
+            if (!annotation.comment.empty()) {
+                out << ",\n      \"core:comment\": " << sigmf_json_string(annotation.comment);
+            }
+            out << "\n    }";
+        }
+        out << (meta.annotations.empty() ? "]\n" : "\n  ]\n");
+        out << "}\n";
+        if (!out.good()) {
+            out.close();
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+    return std::rename(tmp_path.c_str(), meta_path.c_str()) == 0;
+}
+
+// Global datatype and sample rate, and the first capture's frequency, of
+// a .sigmf-meta; fields not found are left unchanged
+inline bool read_sigmf_core(const std::string& meta_path, std::string& datatype, double& sample_rate,
+                            double& frequency) {
+    std::ifstream in(meta_path);
+    if (!in.is_open()) return false;
+    std::stringstream text;
+    text << in.rdbuf();
+    const std::string json = text.str();
+
+    // Position just past `"key":` and any whitespace, npos if absent
+    auto value_of = [&json](const std::string& key) {
+        size_t pos = json.find("\"" + key + "\"");
+        if (pos == std::string::npos) return pos;
+        pos = json.find(':', pos + key.size() + 2);
+        if (pos == std::string::npos) return pos;
+        return json.find_first_not_of(" \t\r\n", pos + 1);
+    };
+    size_t pos = value_of("core:datatype");
+    if (pos != std::string::npos && json[pos] == '"') {
+        const size_t end = json.find('"', pos + 1);
+        if (end != std::string::npos) datatype = json.substr(pos + 1, end - pos - 1);
+    }
+    pos = value_of("core:sample_rate");
+    if (pos != std::string::npos) sample_rate = std::strtod(json.c_str() + pos, nullptr);
+    pos = value_of("core:frequency");
+    if (pos != std::string::npos) frequency = std::strtod(json.c_str() + pos, nullptr);
+    return true;
+}
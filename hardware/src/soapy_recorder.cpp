@@ -2,19 +2,68 @@
  * SoapySDR IQ Recorder
  * 
  * Records IQ samples from SoapySDR-compatible devices to binary file with SigMF metadata
+ *
+ * readStream() fills large page-aligned buffers directly and a writer
+ * thread flushes them (async_writer.hpp), so the receive loop never
+ * touches the filesystem. Pool size: --write-buffer-mb x --write-buffers.
+ * --io-backend direct|uring bypasses the page cache with O_DIRECT (uring:
+ * io_uring, several writes in flight) into a file preallocated for
+ * --samples.
+ * --format ci16|ci8 records the device's CS16/CS8 samples as-is (no float
+ * conversion, 2-4x less disk bandwidth); see sample_format.hpp.
+ * --pretrigger SECS runs as a daemon holding the last SECS of samples in
+ * memory (pretrigger.hpp); each `trigger [post_secs]` line on stdin dumps
+ * that history plus --post-trigger seconds to <output>_NNN.sigmf-data and
+ * {"type":"trigger"} records report progress on stdout. `stop` exits.
+ * --segment-secs/--segment-mb rotate into numbered, gap-free SigMF
+ * segments (segmented_writer.hpp) reported as {"type":"segment"} records,
+ * --retain-mb deletes the oldest beyond a budget, and --samples 0 records
+ * until SIGINT/SIGTERM.
+ * --burst-threshold DB keeps only energy bursts out of --samples, padded
+ * by --burst-pre-ms/--burst-post-ms, each as a SigMF capture and "burst"
+ * annotation in one file (burst_capture.hpp).
+ * Where the driver keeps hardware time it is set to UTC and readStream's
+ * timeNs dates the first sample in the .sigmf-meta. After an overflow a
+ * new SigMF capture starts, stamped and annotated with the samples lost,
+ * so every capture is contiguous (sample_timeline.hpp). Drivers without
+ * timestamps fall back to the host clock.
+ * --compress zstd[:level]|lz4[:accel] writes lossless, seekable .iqz
+ * blocks compressed on a worker pool (iq_compress.hpp) in place of
+ * .sigmf-data; --compress-transform, --compress-threads and
+ * --compress-block-kb tune it.
+ * --ddc-offset HZ --ddc-bw HZ keeps only one narrowband channel: the
+ * down-converter (ddc.hpp) shifts it to 0 Hz and decimates in the read
+ * loop, and the file is cf32 at the output rate, described in the
+ * .sigmf-meta by the channel's frequency and that rate.
+ * --pyramid writes <base>.pyramid alongside, a multi-resolution
+ * spectrogram of what was recorded (spectrogram_pyramid.hpp), tuned by
+ * --pyramid-fft, --pyramid-row-ms and --pyramid-ffts.
  * 
  * Compile: g++ -o soapy_recorder soapy_recorder.cpp -lSoapySDR -std=c++17
  */
 
 #include <SoapySDR/Device.hpp>
 #include <SoapySDR/Formats.hpp>
+#include <SoapySDR/Errors.hpp>
 #include <iostream>
-#include <fstream>
 #include <vector>
-#include <complex>
+#include <algorithm>
 #include <ctime>
 #include <iomanip>
-#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <csignal>
+#include <memory>
+
+#include "async_writer.hpp"
+#include "burst_capture.hpp"
+#include "ddc.hpp"
+#include "pretrigger.hpp"
+#include "sample_format.hpp"
+#include "sample_timeline.hpp"
+#include "segmented_writer.hpp"
+#include "spectrogram_pyramid.hpp"
+#include "sigmf.hpp"
 
 struct RecordConfig {
     std::string device_args;
@@ -24,50 +73,253 @@ struct RecordConfig {
     size_t num_samples;
     std::string output_file;
     int channel;
+    size_t write_buffer_mb;
+    size_t write_buffers;
+    WriteBackend io_backend;
+    SampleFormat format;
+    double pretrigger;
+    double post_trigger;
+    double burst_threshold;
+    double burst_pre_ms;
+    double burst_post_ms;
+    size_t burst_window;
+    double burst_floor_secs;
+    double segment_secs;
+    double segment_mb;
+    double retain_mb;
+    IqCompressOptions compression;
+    double ddc_offset;
+    double ddc_bw;
+    bool pyramid;
+    PyramidOptions pyramid_options;
 };
 
-std::string get_iso8601_timestamp() {
-    auto now = std::time(nullptr);
-    auto tm = *std::gmtime(&now);
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "%Y-%m-%dT%H:%M:%SZ");
-    return oss.str();
+volatile bool running = true;
+
+void signal_handler(int signum) {
+    std::cerr << "[SOAPY-RECORDER] Received signal " << signum << ", shutting down..." << std::endl;
+    running = false;
 }
 
-void write_sigmf_metadata(const std::string& filename, const RecordConfig& config, 
-                           const std::string& hw_info) {
-    std::string meta_filename = filename + ".sigmf-meta";
-    std::ofstream meta_file(meta_filename);
-    
-    if (!meta_file.is_open()) {
-        std::cerr << "[SOAPY-RECORDER] Failed to create metadata file" << std::endl;
-        return;
+// Streams into the pre-trigger history until stopped, dumping on triggers
+static void run_pretrigger_daemon(SoapySDR::Device* device, SoapySDR::Stream* stream,
+                                  const RecordConfig& config, const std::string& hw_info) {
+    const size_t sample_bytes = sample_format_bytes(config.format);
+    const double sample_rate = device->getSampleRate(SOAPY_SDR_RX, config.channel);
+
+    // The whole history is mapped and faulted in before streaming starts
+    const size_t chunk_size = 16384;
+    SampleHistory history(static_cast<size_t>(config.pretrigger * sample_rate) * sample_bytes,
+                          chunk_size * sample_bytes);
+    std::cerr << "[SOAPY-RECORDER] Pre-trigger history: " << config.pretrigger << " s, "
+              << (history.capacity() >> 20) << " MB (" << history.page_kind() << ")" << std::endl;
+
+    SigmfMeta meta;
+    meta.datatype = sigmf_datatype(config.format);
+    meta.sample_rate = sample_rate;
+    meta.description = "Triggered IQ recording from SoapySDR device";
+    meta.recorder = "soapy_recorder";
+    meta.hw = hw_info;
+    SigmfCapture capture;
+    capture.frequency = device->getFrequency(SOAPY_SDR_RX, config.channel);
+    meta.captures.push_back(capture);
+    PretriggerDumper dumper(history, sample_bytes, sample_rate, meta);
+
+    ControlChannel control;
+    control.start();
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+    std::cerr << "[SOAPY-RECORDER] Waiting for triggers (trigger [post_secs] / stop on stdin)" << std::endl;
+
+    ControlCommand cmd;
+    TriggerEvent event;
+    unsigned triggers = 0;
+    size_t overflows = 0;
+    // Dates the dumps and logs overflow gaps in the history
+    SampleTimeline timeline(sample_rate);
+    bool overflowed = false;
+
+    device->activateStream(stream);
+    while (running) {
+        size_t bytes_available = 0;
+        void *buffs[] = {history.acquire(bytes_available)};
+        int flags = 0;
+        long long time_ns = 0;
+
+        int ret = device->readStream(stream, buffs, bytes_available / sample_bytes, flags, time_ns, 1000000);
+        if (ret == SOAPY_SDR_OVERFLOW) {
+            overflows++;
+            overflowed = true;
+        } else if (ret < 0 && ret != SOAPY_SDR_TIMEOUT) {
+            std::cerr << "[SOAPY-RECORDER] Stream error: " << ret << std::endl;
+        } else if (ret > 0) {
+            const bool has_time = (flags & SOAPY_SDR_HAS_TIME) != 0;
+            const bool first = !timeline.started();
+            const uint64_t lost = timeline.observe(has_time, time_ns, ret, overflowed);
+            overflowed = false;
+            if (first) dumper.set_stream_start(time_point_from_ns(timeline.first_ns()));
+            history.mark_gap(lost, !has_time);
+            history.commit(ret * sample_bytes);
+        }
+
+        while (control.poll(cmd)) {
+            if (cmd.key == "stop") {
+                running = false;
+            } else if (cmd.key == "trigger") {
+                double post = config.post_trigger;
+                try {
+                    if (!cmd.value.empty()) post = std::stod(cmd.value);
+                } catch (const std::exception&) {
+                    event = TriggerEvent();
+                    event.status = "error";
+                    event.error = "invalid post-trigger duration '" + cmd.value + "'";
+                    std::cout << trigger_event_json(event) << std::endl;
+                    continue;
+                }
+                dumper.trigger(trigger_file_path(config.output_file, ++triggers), config.pretrigger, post);
+            } else {
+                event = TriggerEvent();
+                event.status = "error";
+                event.error = "unknown command '" + cmd.key + "'";
+                std::cout << trigger_event_json(event) << std::endl;
+            }
+        }
+        while (dumper.poll(event)) {
+            std::cout << trigger_event_json(event) << std::endl;
+        }
+    }
+
+    control.stop();
+    // A capture in progress ends with what has been received
+    dumper.finish();
+    while (dumper.poll(event)) {
+        std::cout << trigger_event_json(event) << std::endl;
+    }
+    std::cerr << "[SOAPY-RECORDER] Daemon stopped after " << triggers << " triggers";
+    if (overflows > 0) std::cerr << ", " << overflows << " overflows";
+    std::cerr << std::endl;
+}
+
+// Keeps only the bursts the energy detector finds in --samples
+static void run_burst_capture(SoapySDR::Device* device, SoapySDR::Stream* stream,
+                              const RecordConfig& config, const std::string& hw_info) {
+    const size_t sample_bytes = sample_format_bytes(config.format);
+    const double sample_rate = device->getSampleRate(SOAPY_SDR_RX, config.channel);
+    const uint64_t pre_samples = static_cast<uint64_t>(config.burst_pre_ms / 1e3 * sample_rate);
+    const uint64_t post_samples = static_cast<uint64_t>(config.burst_post_ms / 1e3 * sample_rate);
+
+    BurstDetectorConfig detector_config;
+    detector_config.window = config.burst_window;
+    detector_config.threshold_db = config.burst_threshold;
+    detector_config.floor_secs = config.burst_floor_secs;
+    detector_config.post_secs = config.burst_post_ms / 1e3;
+    EnergyDetector detector(detector_config, config.format, sample_rate);
+
+    // Pre-burst padding plus the write pool's worth of slack for the disk
+    const size_t chunk_size = 16384;
+    SampleHistory history((config.write_buffer_mb << 20) * config.write_buffers + pre_samples * sample_bytes,
+                          chunk_size * sample_bytes);
+    std::cerr << "[SOAPY-RECORDER] Burst capture: threshold " << config.burst_threshold << " dB, history "
+              << (history.capacity() >> 20) << " MB (" << history.page_kind() << ")" << std::endl;
+
+    SigmfMeta meta;
+    meta.datatype = sigmf_datatype(config.format);
+    meta.sample_rate = sample_rate;
+    meta.description = "Energy-triggered burst recording from SoapySDR device";
+    meta.recorder = "soapy_recorder";
+    meta.hw = hw_info;
+    SigmfCapture capture;
+    capture.frequency = device->getFrequency(SOAPY_SDR_RX, config.channel);
+    meta.captures.push_back(capture);
+    BurstWriter writer(history, config.output_file, sample_bytes, sample_rate, meta);
+    if (!writer.is_open()) {
+        throw std::runtime_error("failed to open " + config.output_file);
     }
 
-    std::string timestamp = get_iso8601_timestamp();
-
-    meta_file << "{\n";
-    meta_file << "  \"global\": {\n";
-    meta_file << "    \"core:datatype\": \"cf32_le\",\n";
-    meta_file << "    \"core:sample_rate\": " << config.sample_rate << ",\n";
-    meta_file << "    \"core:version\": \"1.0.0\",\n";
-    meta_file << "    \"core:description\": \"IQ recording from SoapySDR device\",\n";
-    meta_file << "    \"core:author\": \"Ettus SDR Web App\",\n";
-    meta_file << "    \"core:recorder\": \"soapy_recorder\",\n";
-    meta_file << "    \"core:hw\": \"" << hw_info << "\"\n";
-    meta_file << "  },\n";
-    meta_file << "  \"captures\": [\n";
-    meta_file << "    {\n";
-    meta_file << "      \"core:sample_start\": 0,\n";
-    meta_file << "      \"core:frequency\": " << config.center_freq << ",\n";
-    meta_file << "      \"core:datetime\": \"" << timestamp << "\"\n";
-    meta_file << "    }\n";
-    meta_file << "  ],\n";
-    meta_file << "  \"annotations\": []\n";
-    meta_file << "}\n";
-
-    meta_file.close();
-    std::cerr << "[SOAPY-RECORDER] Metadata written to " << meta_filename << std::endl;
+    auto on_burst = [&](const EnergyDetector::Event& event) {
+        if (event.start) {
+            writer.begin(event.sample, pre_samples);
+        } else {
+            writer.end(event.sample, post_samples, event.peak_dbfs, event.floor_dbfs);
+        }
+    };
+
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+    uint64_t samples_received = 0;
+    size_t overflows = 0;
+    size_t next_progress = 1000000;
+    // Dates the bursts and logs overflow gaps in the history
+    SampleTimeline timeline(sample_rate);
+    bool overflowed = false;
+    uint64_t overflow_lost = 0;
+
+    device->activateStream(stream);
+    while (running && (config.num_samples == 0 || samples_received < config.num_samples)) {
+        size_t bytes_available = 0;
+        void *buffs[] = {history.acquire(bytes_available)};
+        size_t samples_to_read = bytes_available / sample_bytes;
+        if (config.num_samples > 0) {
+            samples_to_read = static_cast<size_t>(std::min<uint64_t>(samples_to_read, config.num_samples - samples_received));
+        }
+        int flags = 0;
+        long long time_ns = 0;
+
+        int ret = device->readStream(stream, buffs, samples_to_read, flags, time_ns, 1000000);
+        if (ret == SOAPY_SDR_TIMEOUT) continue;
+        if (ret == SOAPY_SDR_OVERFLOW) {
+            overflows++;
+            overflowed = true;
+            continue;
+        }
+        if (ret < 0) {
+            std::cerr << "[SOAPY-RECORDER] Stream error: " << ret << std::endl;
+            break;
+        }
+
+        const bool has_time = (flags & SOAPY_SDR_HAS_TIME) != 0;
+        const bool first = !timeline.started();
+        const uint64_t lost = timeline.observe(has_time, time_ns, ret, overflowed);
+        overflowed = false;
+        if (first) writer.set_stream_start(time_point_from_ns(timeline.first_ns()));
+        overflow_lost += lost;
+        history.mark_gap(lost, !has_time);
+        history.commit(ret * sample_bytes);
+        detector.process(buffs[0], ret, on_burst);
+        samples_received += ret;
+
+        if (samples_received >= next_progress) {
+            next_progress += 1000000;
+            std::cerr << "[SOAPY-RECORDER] Progress: " << samples_received << " / " << config.num_samples
+                      << " samples, " << writer.bursts() << " bursts, floor "
+                      << std::fixed << std::setprecision(1) << detector.floor_dbfs() << " dBFS"
+                      << std::defaultfloat << std::endl;
+        }
+    }
+
+    detector.flush(on_burst);
+    const bool write_ok = writer.finish();
+    if (overflows > 0) {
+        std::cerr << "[SOAPY-RECORDER] " << overflows << " overflows, " << overflow_lost << " samples lost"
+                  << (timeline.host_timed() ? " (host clock estimate)" : "") << std::endl;
+    }
+    if (writer.lost_samples() > 0) {
+        std::cerr << "[SOAPY-RECORDER] Disk fell behind, lost " << writer.lost_samples()
+                  << " burst samples" << std::endl;
+    }
+    if (!write_ok) {
+        throw std::runtime_error(std::string("writing ") + config.output_file + " failed: "
+                                 + std::strerror(writer.error()));
+    }
+
+    std::cout << "{\"success\":true,\"samplesRecorded\":" << writer.samples_written()
+              << ",\"samplesReceived\":" << samples_received
+              << ",\"bursts\":" << writer.bursts()
+              << ",\"dataFile\":\"" << config.output_file
+              << "\",\"metaFile\":\"" << sigmf_meta_path(config.output_file)
+              << "\",\"format\":\"" << sample_format_name(config.format) << "\"}" << std::endl;
+    std::cerr << "[SOAPY-RECORDER] Burst capture complete: " << writer.bursts() << " bursts, "
+              << writer.samples_written() << " of " << samples_received << " samples kept" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
@@ -79,6 +331,24 @@ int main(int argc, char* argv[]) {
     config.num_samples = 10000000;  // 10M samples default (5 seconds at 2 MSPS)
     config.output_file = "/tmp/recording.sigmf-data";
     config.channel = 0;
+    config.write_buffer_mb = 32;
+    config.write_buffers = 8;
+    config.io_backend = WriteBackend::Buffered;
+    config.format = SampleFormat::Cf32;
+    config.pretrigger = 0.0;
+    config.post_trigger = 5.0;
+    config.burst_threshold = 0.0;
+    config.burst_pre_ms = 1.0;
+    config.burst_post_ms = 1.0;
+    config.burst_window = 1024;
+    config.burst_floor_secs = 10.0;
+    config.segment_secs = 0.0;
+    config.segment_mb = 0.0;
+    config.retain_mb = 0.0;
+    config.compression.codec = IqCodec::None;
+    config.ddc_offset = 0.0;
+    config.ddc_bw = 0.0;
+    config.pyramid = false;
 
     // Parse arguments
     for (int i = 1; i < argc; i++) {
@@ -95,6 +365,71 @@ int main(int argc, char* argv[]) {
             config.output_file = argv[++i];
         } else if (arg == "--device" && i + 1 < argc) {
             config.device_args = argv[++i];
+        } else if (arg == "--pretrigger" && i + 1 < argc) {
+            config.pretrigger = std::stod(argv[++i]);
+        } else if (arg == "--post-trigger" && i + 1 < argc) {
+            config.post_trigger = std::stod(argv[++i]);
+        } else if (arg == "--segment-secs" && i + 1 < argc) {
+            config.segment_secs = std::stod(argv[++i]);
+        } else if (arg == "--segment-mb" && i + 1 < argc) {
+            config.segment_mb = std::stod(argv[++i]);
+        } else if (arg == "--retain-mb" && i + 1 < argc) {
+            config.retain_mb = std::stod(argv[++i]);
+        } else if (arg == "--compress" && i + 1 < argc) {
+            if (!parse_iq_codec(argv[++i], config.compression.codec, config.compression.level)
+                || !iq_codec_available(config.compression.codec)) {
+                std::cerr << "[SOAPY-RECORDER] Unknown or unavailable compression: " << argv[i]
+                          << " (zstd[:level]/lz4[:accel]/none)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--compress-transform" && i + 1 < argc) {
+            if (!parse_iq_transform(argv[++i], config.compression.transform)) {
+                std::cerr << "[SOAPY-RECORDER] Unknown compression transform: " << argv[i]
+                          << " (shuffle/delta/none)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--compress-threads" && i + 1 < argc) {
+            config.compression.threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--compress-block-kb" && i + 1 < argc) {
+            config.compression.block_bytes = std::max<size_t>(1, std::stoul(argv[++i])) << 10;
+        } else if (arg == "--ddc-offset" && i + 1 < argc) {
+            config.ddc_offset = std::stod(argv[++i]);
+        } else if (arg == "--ddc-bw" && i + 1 < argc) {
+            config.ddc_bw = std::stod(argv[++i]);
+        } else if (arg == "--pyramid") {
+            config.pyramid = true;
+        } else if (arg == "--pyramid-fft" && i + 1 < argc) {
+            config.pyramid_options.fft_size = std::stoul(argv[++i]);
+        } else if (arg == "--pyramid-row-ms" && i + 1 < argc) {
+            config.pyramid_options.row_secs = std::stod(argv[++i]) / 1e3;
+        } else if (arg == "--pyramid-ffts" && i + 1 < argc) {
+            config.pyramid_options.ffts_per_row = std::stoul(argv[++i]);
+        } else if (arg == "--burst-threshold" && i + 1 < argc) {
+            config.burst_threshold = std::stod(argv[++i]);
+        } else if (arg == "--burst-pre-ms" && i + 1 < argc) {
+            config.burst_pre_ms = std::stod(argv[++i]);
+        } else if (arg == "--burst-post-ms" && i + 1 < argc) {
+            config.burst_post_ms = std::stod(argv[++i]);
+        } else if (arg == "--burst-window" && i + 1 < argc) {
+            config.burst_window = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--burst-floor-secs" && i + 1 < argc) {
+            config.burst_floor_secs = std::stod(argv[++i]);
+        } else if (arg == "--write-buffer-mb" && i + 1 < argc) {
+            config.write_buffer_mb = std::stoul(argv[++i]);
+        } else if (arg == "--write-buffers" && i + 1 < argc) {
+            config.write_buffers = std::stoul(argv[++i]);
+        } else if (arg == "--format" && i + 1 < argc) {
+            if (!parse_sample_format(argv[++i], config.format)) {
+                std::cerr << "[SOAPY-RECORDER] Unknown sample format: " << argv[i]
+                          << " (cf32/ci16/ci8)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--io-backend" && i + 1 < argc) {
+            if (!parse_write_backend(argv[++i], config.io_backend)) {
+                std::cerr << "[SOAPY-RECORDER] Unknown I/O backend: " << argv[i]
+                          << " (buffered/direct/uring)" << std::endl;
+                return 1;
+            }
         }
     }
 
@@ -115,68 +450,300 @@ int main(int argc, char* argv[]) {
         device->setFrequency(SOAPY_SDR_RX, config.channel, config.center_freq);
         device->setGain(SOAPY_SDR_RX, config.channel, config.gain);
 
+        // Drivers round the rate; mixing, metadata and timestamps use what it set
+        const double sample_rate = device->getSampleRate(SOAPY_SDR_RX, config.channel);
+        if (sample_rate != config.sample_rate) {
+            std::cerr << "[SOAPY-RECORDER] Sample rate: " << sample_rate << " S/s (requested "
+                      << config.sample_rate << ")" << std::endl;
+        }
+
         // Setup stream
         std::vector<size_t> channels = {(size_t)config.channel};
-        SoapySDR::Stream *stream = device->setupStream(SOAPY_SDR_RX, SOAPY_SDR_CF32, channels);
-        device->activateStream(stream);
+        const std::string stream_format = soapy_stream_format(config.format);
+        const size_t sample_bytes = sample_format_bytes(config.format);
+        auto formats = device->getStreamFormats(SOAPY_SDR_RX, config.channel);
+        if (std::find(formats.begin(), formats.end(), stream_format) == formats.end()) {
+            std::string supported;
+            for (const auto& f : formats) supported += (supported.empty() ? "" : ", ") + f;
+            throw std::runtime_error("device does not stream " + stream_format + " (supports " + supported + ")");
+        }
+        SoapySDR::Stream *stream = device->setupStream(SOAPY_SDR_RX, stream_format, channels);
+        if (device->hasHardwareTime()) {
+            device->setHardwareTime(host_time_ns());
+        } else {
+            std::cerr << "[SOAPY-RECORDER] No hardware time, timestamps from the host clock" << std::endl;
+        }
+        // Each mode activates the stream once its buffers, files and plans
+        // are ready, so the device does not overflow during setup
 
-        // Open output file
-        std::ofstream data_file(config.output_file, std::ios::binary);
+        if (config.pretrigger > 0 || config.burst_threshold > 0) {
+            if (config.compression.codec != IqCodec::None) {
+                std::cerr << "[SOAPY-RECORDER] --compress applies to continuous recordings only; ignored" << std::endl;
+            }
+            if (config.ddc_bw > 0) {
+                std::cerr << "[SOAPY-RECORDER] --ddc-bw applies to continuous recordings only; ignored" << std::endl;
+            }
+            if (config.pyramid) {
+                std::cerr << "[SOAPY-RECORDER] --pyramid applies to continuous recordings only; ignored" << std::endl;
+            }
+            if (config.pretrigger > 0) {
+                run_pretrigger_daemon(device, stream, config, hw_info);
+            } else {
+                run_burst_capture(device, stream, config, hw_info);
+            }
+            device->deactivateStream(stream);
+            device->closeStream(stream);
+            SoapySDR::Device::unmake(device);
+            return 0;
+        }
+
+        // Open output file (or first segment, with the next one pre-opened),
+        // preallocated; write buffers are allocated before the stream starts
+        AsyncWriterOptions write_options;
+        write_options.buffer_bytes = config.write_buffer_mb << 20;
+        write_options.num_buffers = config.write_buffers;
+        write_options.backend = config.io_backend;
+        // With --ddc-bw the writer side is all at the DDC's cf32 output rate
+        std::unique_ptr<Ddc> ddc;
+        std::vector<float> narrowband;
+        if (config.ddc_bw > 0) {
+            ddc = std::make_unique<Ddc>(sample_rate, config.ddc_offset, config.ddc_bw);
+            if (!ddc->valid()) throw std::runtime_error(ddc->error());
+            std::cerr << "[SOAPY-RECORDER] DDC: " << (config.center_freq + ddc->offset()) / 1e6 << " MHz, "
+                      << config.ddc_bw / 1e3 << " kHz wide -> " << ddc->output_rate() / 1e3 << " kS/s (/"
+                      << ddc->decimation() << ": " << ddc->describe() << ")" << std::endl;
+        }
+        const SampleFormat file_format = ddc ? SampleFormat::Cf32 : config.format;
+        const size_t file_sample_bytes = sample_format_bytes(file_format);
+        const double file_rate = ddc ? ddc->output_rate() : sample_rate;
+
+        SegmentOptions segment_options;
+        segment_options.sample_bytes = file_sample_bytes;
+        segment_options.sample_rate = file_rate;
+        segment_options.total_samples = ddc ? config.num_samples / ddc->decimation() : config.num_samples;
+        if (config.segment_secs > 0) {
+            segment_options.segment_samples = static_cast<uint64_t>(config.segment_secs * file_rate);
+        } else if (config.segment_mb > 0) {
+            segment_options.segment_samples = static_cast<uint64_t>(config.segment_mb * (1 << 20)) / file_sample_bytes;
+        }
+        segment_options.retain_bytes = static_cast<uint64_t>(config.retain_mb * (1 << 20));
+        segment_options.compress = config.compression.codec != IqCodec::None;
+        segment_options.compression = config.compression;
+        segment_options.format = file_format;
+
+        SigmfMeta meta;
+        meta.datatype = sigmf_datatype(file_format);
+        meta.sample_rate = file_rate;
+        meta.description = ddc ? "Down-converted IQ recording from SoapySDR device" : "IQ recording from SoapySDR device";
+        meta.recorder = "soapy_recorder";
+        meta.hw = hw_info;
+        SigmfCapture capture;
+        capture.frequency = ddc ? config.center_freq + ddc->offset() : config.center_freq;
+        meta.captures.push_back(capture);
+
+        SegmentedWriter data_file(config.output_file, write_options, segment_options, meta);
         if (!data_file.is_open()) {
             std::cerr << "[SOAPY-RECORDER] Failed to open output file" << std::endl;
             SoapySDR::Device::unmake(device);
             return 1;
         }
+        std::cerr << "[SOAPY-RECORDER] Disk writes: " << write_backend_name(data_file.current().backend());
+        if (!data_file.current().backend_note().empty()) std::cerr << " (" << data_file.current().backend_note() << ")";
+        std::cerr << std::endl;
+
+        std::cerr << "[SOAPY-RECORDER] Recording ";
+        if (config.num_samples > 0) std::cerr << config.num_samples << " samples";
+        else std::cerr << "until stopped";
+        std::cerr << " to " << data_file.current_path();
+        if (data_file.segmented()) std::cerr << " (segments of " << segment_options.segment_samples << " samples)";
+        if (data_file.compressed()) {
+            std::cerr << ", " << iq_codec_name(config.compression.codec) << " level " << config.compression.level
+                      << " + " << iq_transform_name(config.compression.transform) << " on "
+                      << data_file.compress_threads() << " threads";
+        }
+        std::cerr << std::endl;
 
-        std::cerr << "[SOAPY-RECORDER] Recording " << config.num_samples << " samples to " 
-                  << config.output_file << std::endl;
+        // The pyramid indexes what goes into the file, by its global index
+        std::unique_ptr<PyramidWriter> overview;
+        if (config.pyramid) {
+            overview = std::make_unique<PyramidWriter>(pyramid_path(config.output_file), file_rate,
+                                                       capture.frequency, config.pyramid_options);
+            if (!overview->is_open()) {
+                throw std::runtime_error("cannot open " + overview->path() + ": " + std::strerror(overview->error()));
+            }
+            std::cerr << "[SOAPY-RECORDER] Pyramid: " << config.pyramid_options.fft_size << " bins, "
+                      << overview->ffts_per_row() << " FFTs per " << overview->row_samples() * 1e3 / file_rate
+                      << " ms row -> " << overview->path() << std::endl;
+        }
 
-        // Allocate buffer (read in chunks)
+        // Read in chunks; the scratch buffer is only used while every write buffer is queued
         const size_t chunk_size = 16384;
-        std::vector<std::complex<float>> buffer(chunk_size);
-        size_t samples_recorded = 0;
+        std::vector<uint8_t> buffer(chunk_size * sample_bytes);
+        uint64_t samples_recorded = 0;
+        uint64_t next_progress = 1000000;
+        std::signal(SIGINT, signal_handler);
+        std::signal(SIGTERM, signal_handler);
+        auto report_segments = [&data_file]() {
+            SegmentEvent event;
+            while (data_file.poll(event)) {
+                if (data_file.segmented()) {
+                    std::cout << segment_event_json(event) << std::endl;
+                } else if (!event.ok) {
+                    std::cerr << "[SOAPY-RECORDER] " << event.error << std::endl;
+                }
+            }
+        };
+        SampleTimeline timeline(sample_rate);
+        size_t overflows = 0;
+        bool overflowed = false;
+
+        device->activateStream(stream);
+        auto start_time = std::chrono::steady_clock::now();
 
         // Recording loop
-        while (samples_recorded < config.num_samples) {
-            size_t samples_to_read = std::min(chunk_size, config.num_samples - samples_recorded);
-            
-            void *buffs[] = {buffer.data()};
+        while (running && (config.num_samples == 0 || samples_recorded < config.num_samples)) {
+            size_t samples_to_read = config.num_samples == 0
+                ? chunk_size
+                : static_cast<size_t>(std::min<uint64_t>(chunk_size, config.num_samples - samples_recorded));
+            // The DDC reads from the scratch buffer and hands its output to
+            // SegmentedWriter::write()
+            size_t bytes_available = 0;
+            void *dest = ddc ? nullptr : data_file.acquire(bytes_available);
+            if (dest) {
+                samples_to_read = std::min(samples_to_read, bytes_available / sample_bytes);
+            }
+
+            void *buffs[] = {dest ? dest : buffer.data()};
             int flags = 0;
             long long time_ns = 0;
             
             int ret = device->readStream(stream, buffs, samples_to_read, flags, time_ns, 1000000);
-            
+            if (ret == SOAPY_SDR_TIMEOUT) continue;
+            if (ret == SOAPY_SDR_OVERFLOW) {
+                overflows++;
+                overflowed = true;
+                continue;
+            }
             if (ret < 0) {
                 std::cerr << "[SOAPY-RECORDER] Stream error: " << ret << std::endl;
                 break;
             }
 
             if (ret > 0) {
-                data_file.write(reinterpret_cast<const char*>(buffer.data()), 
-                                ret * sizeof(std::complex<float>));
+                // First sample dates the recording; after an overflow the
+                // timestamp says how many samples the device skipped
+                const bool has_time = (flags & SOAPY_SDR_HAS_TIME) != 0;
+                const bool first = !timeline.started();
+                const uint64_t lost = timeline.observe(has_time, time_ns, ret, overflowed);
+                overflowed = false;
+                if (first) {
+                    // The DDC's first output is centred delay() input samples in
+                    const int64_t offset_ns = ddc ? ddc->delay_ns() : 0;
+                    data_file.set_stream_start(time_point_from_ns(timeline.first_ns() + offset_ns));
+                }
+                if (lost > 0) {
+                    std::cerr << "[SOAPY-RECORDER] Overflow: " << lost << " samples lost"
+                              << (has_time ? "" : " (host clock estimate)") << ", starting a new capture" << std::endl;
+                    const uint64_t file_lost = ddc ? ddc->skip(lost) : lost;
+                    data_file.mark_overflow(file_lost, !has_time);
+                    if (overview) overview->skip(file_lost);
+                }
+                // The pyramid copies what it needs before a buffer is committed
+                if (ddc) {
+                    const size_t produced = ddc->process(buffer.data(), ret, config.format, narrowband);
+                    if (overview) overview->feed(narrowband.data(), produced, file_format);
+                    data_file.write(narrowband.data(), produced * file_sample_bytes);
+                } else {
+                    if (overview) overview->feed(buffs[0], ret, config.format);
+                    if (dest) {
+                        data_file.commit(ret * sample_bytes);
+                    } else {
+                        data_file.mark_dropped(ret * sample_bytes);
+                    }
+                }
                 samples_recorded += ret;
+                report_segments();
 
                 // Progress update every 1M samples
-                if (samples_recorded % 1000000 == 0) {
+                if (samples_recorded >= next_progress) {
+                    next_progress += 1000000;
+                    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
                     std::cerr << "[SOAPY-RECORDER] Progress: " << samples_recorded << " / " 
-                              << config.num_samples << " samples" << std::endl;
+                              << config.num_samples << " samples, segment " << data_file.segments() << ", write queue "
+                              << data_file.current().buffers_queued() << "/" << data_file.current().buffers() << ", "
+                              << std::fixed << std::setprecision(0) << data_file.bytes_written() / 1e6 / elapsed
+                              << " MB/s" << std::defaultfloat << std::endl;
                 }
             }
         }
 
-        // Cleanup
-        data_file.close();
+        // Cleanup; the stream stops before the write queue is drained and
+        // the SigMF metadata is written
         device->deactivateStream(stream);
         device->closeStream(stream);
         SoapySDR::Device::unmake(device);
+        const size_t buffers = data_file.current().buffers();
+        const bool write_ok = data_file.close();
+        report_segments();
+        const bool pyramid_ok = !overview || overview->close();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
 
-        // Write SigMF metadata
-        write_sigmf_metadata(config.output_file, config, hw_info);
+        std::cerr << "[SOAPY-RECORDER] Disk: " << std::fixed << std::setprecision(1)
+                  << data_file.bytes_written() / 1e6 / elapsed << " MB/s sustained, "
+                  << (data_file.busy_seconds() > 0 ? data_file.bytes_written() / 1e6 / data_file.busy_seconds() : 0.0)
+                  << " MB/s while writing, peak queue " << data_file.buffers_peak() << "/" << buffers
+                  << ", write latency p99 " << data_file.write_latency().percentile(99) / 1e6
+                  << " ms, max " << data_file.write_latency().max() / 1e6 << " ms"
+                  << std::defaultfloat << std::endl;
+        if (data_file.compressed() && data_file.raw_bytes() > 0) {
+            std::cerr << "[SOAPY-RECORDER] Compressed " << data_file.raw_bytes() / 1e6 << " MB to "
+                      << data_file.bytes_written() / 1e6 << " MB ("
+                      << std::fixed << std::setprecision(1) << 100.0 * data_file.bytes_written() / data_file.raw_bytes()
+                      << "%)" << std::defaultfloat << std::endl;
+        }
+        if (overflows > 0 || data_file.gaps() > 0) {
+            std::cerr << "[SOAPY-RECORDER] " << overflows << " overflows, " << data_file.gaps()
+                      << " SigMF captures started after " << data_file.lost_samples() << " lost samples" << std::endl;
+        }
+        if (data_file.dropped_bytes() > 0) {
+            std::cerr << "[SOAPY-RECORDER] Write queue full, dropped "
+                      << data_file.dropped_bytes() / file_sample_bytes << " samples" << std::endl;
+        }
+        if (overview && overview->rows_skipped() > 0) {
+            std::cerr << "[SOAPY-RECORDER] Pyramid fell behind, " << overview->rows_skipped()
+                      << " rows left empty" << std::endl;
+        }
+        if (!pyramid_ok) {
+            std::cerr << "[SOAPY-RECORDER] Writing " << overview->path() << " failed: "
+                      << std::strerror(overview->error()) << std::endl;
+        }
+        if (!write_ok) {
+            throw std::runtime_error(std::string("writing ") + config.output_file + " failed: "
+                                     + std::strerror(data_file.error()));
+        }
+        const std::string meta_file = sigmf_meta_path(config.output_file);
 
         // Output JSON result
         std::cout << "{\"success\":true,\"samplesRecorded\":" << samples_recorded 
-                  << ",\"dataFile\":\"" << config.output_file 
-                  << "\",\"metaFile\":\"" << config.output_file << ".sigmf-meta\"}" << std::endl;
+                  << ",\"dataFile\":\"" << (data_file.compressed() ? iqz_path(config.output_file) : config.output_file)
+                  << "\",\"metaFile\":\"" << meta_file
+                  << "\",\"segments\":" << (data_file.segmented() ? data_file.segments() : 0)
+                  << ",\"firstSampleTime\":\"" << iso8601_utc(time_point_from_ns(timeline.first_ns()))
+                  << "\",\"hardwareTime\":" << (timeline.host_timed() ? "false" : "true")
+                  << ",\"gaps\":" << data_file.gaps()
+                  << ",\"lostSamples\":" << data_file.lost_samples()
+                  << ",\"compression\":\"" << iq_codec_name(config.compression.codec)
+                  << "\",\"bytesWritten\":" << data_file.bytes_written()
+                  << ",\"format\":\"" << sample_format_name(file_format) << "\"";
+        if (ddc) {
+            std::cout << ",\"frequency\":" << capture.frequency
+                      << ",\"sampleRate\":" << file_rate
+                      << ",\"decimation\":" << ddc->decimation();
+        }
+        if (overview) {
+            std::cout << ",\"pyramidFile\":\"" << overview->path() << "\",\"pyramidRows\":" << overview->rows();
+        }
+        std::cout << "}" << std::endl;
 
         std::cerr << "[SOAPY-RECORDER] Recording complete: " << samples_recorded << " samples" << std::endl;
 
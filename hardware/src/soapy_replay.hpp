@@ -0,0 +1,183 @@
+/**
+ * soapy_replay.hpp - SoapySDR device that plays back a recording
+ *
+ * The Soapy daemons open their device through open_soapy_device(), which
+ * returns a SoapyReplayDevice for --device replay:path=... (see
+ * replay_source.hpp) and SoapySDR::Device::make() for anything else.
+ * Close it with close_soapy_device(): Device::unmake() only knows devices
+ * its factory made.
+ *
+ * The replay serves one RX channel in CF32, CS16 or CS8. Settings are
+ * kept and read back without touching the samples; hardware time is the
+ * replay clock in nanoseconds.
+ */
+
+#pragma once
+
+#include <SoapySDR/Device.hpp>
+#include <SoapySDR/Errors.hpp>
+#include <SoapySDR/Formats.hpp>
+
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "replay_source.hpp"
+
+class SoapyReplayDevice : public SoapySDR::Device {
+public:
+    explicit SoapyReplayDevice(const ReplayOptions& options) {
+        if (!replay_.open(options)) throw std::runtime_error(replay_.error());
+    }
+
+    const ReplaySource& replay() const { return replay_; }
+
+    std::string getDriverKey() const override { return "replay"; }
+    std::string getHardwareKey() const override { return "replay:" + replay_.path(); }
+
+    std::vector<std::string> getStreamFormats(const int, const size_t) const override {
+        return {SOAPY_SDR_CF32, SOAPY_SDR_CS16, SOAPY_SDR_CS8};
+    }
+    std::string getNativeStreamFormat(const int, const size_t, double& full_scale) const override {
+        switch (replay_.format()) {
+        case SampleFormat::Ci16: full_scale = 32767.0; return SOAPY_SDR_CS16;
+        case SampleFormat::Ci8: full_scale = 127.0; return SOAPY_SDR_CS8;
+        case SampleFormat::Cf32: break;
+        }
+        full_scale = 1.0;
+        return SOAPY_SDR_CF32;
+    }
+
+    void setSampleRate(const int, const size_t, const double rate) override { replay_.set_sample_rate(rate); }
+    double getSampleRate(const int, const size_t) const override { return replay_.sample_rate(); }
+
+    void setFrequency(const int, const size_t, const double frequency, const SoapySDR::Kwargs&) override {
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        freq_ = frequency;
+    }
+    double getFrequency(const int, const size_t) const override {
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        return freq_;
+    }
+
+    bool hasGainMode(const int, const size_t) const override { return false; }
+    void setGain(const int, const size_t, const double value) override {
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        gain_ = value;
+    }
+    double getGain(const int, const size_t) const override {
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        return gain_;
+    }
+
+    void setBandwidth(const int, const size_t, const double bw) override {
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        bandwidth_ = bw;
+    }
+    double getBandwidth(const int, const size_t) const override {
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        return bandwidth_ > 0.0 ? bandwidth_ : replay_.sample_rate();
+    }
+
+    std::vector<std::string> listAntennas(const int, const size_t) const override { return {"REPLAY"}; }
+    void setAntenna(const int, const size_t, const std::string& name) override {
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        antenna_ = name;
+    }
+    std::string getAntenna(const int, const size_t) const override {
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        return antenna_;
+    }
+
+    bool hasHardwareTime(const std::string&) const override { return true; }
+    long long getHardwareTime(const std::string&) const override {
+        return std::llround(replay_.time_now() * 1e9);
+    }
+    // The replay clock is the stream position and cannot be set
+    void setHardwareTime(const long long, const std::string&) override {}
+
+    SoapySDR::Stream* setupStream(const int direction, const std::string& format,
+                                  const std::vector<size_t>& channels, const SoapySDR::Kwargs&) override {
+        if (direction != SOAPY_SDR_RX) throw std::runtime_error("replay device is receive-only");
+        if (channels.size() > 1 || (channels.size() == 1 && channels[0] != 0)) {
+            throw std::runtime_error("replay device has a single channel");
+        }
+        if (format == SOAPY_SDR_CF32) {
+            stream_format_ = SampleFormat::Cf32;
+        } else if (format == SOAPY_SDR_CS16) {
+            stream_format_ = SampleFormat::Ci16;
+        } else if (format == SOAPY_SDR_CS8) {
+            stream_format_ = SampleFormat::Ci8;
+        } else {
+            throw std::runtime_error("replay device does not stream " + format);
+        }
+        return reinterpret_cast<SoapySDR::Stream*>(this);
+    }
+    void closeStream(SoapySDR::Stream*) override { replay_.stop(); }
+    size_t getStreamMTU(SoapySDR::Stream*) const override { return 16384; }
+
+    int activateStream(SoapySDR::Stream*, const int, const long long, const size_t) override {
+        replay_.start();
+        return 0;
+    }
+    int deactivateStream(SoapySDR::Stream*, const int, const long long) override {
+        replay_.stop();
+        return 0;
+    }
+
+    int readStream(SoapySDR::Stream*, void* const* buffs, const size_t num_elems, int& flags,
+                   long long& time_ns, const long timeout_us) override {
+        const ReplayRead read = replay_.read(buffs[0], stream_format_, num_elems, timeout_us / 1e6);
+        flags = 0;
+        switch (read.status) {
+        case ReplayStatus::Ok:
+            flags |= SOAPY_SDR_HAS_TIME;
+            time_ns = std::llround(read.first / replay_.sample_rate() * 1e9);
+            return static_cast<int>(read.samples);
+        case ReplayStatus::Overflow:
+            return SOAPY_SDR_OVERFLOW;
+        case ReplayStatus::End:
+            flags |= SOAPY_SDR_END_BURST;
+            return SOAPY_SDR_TIMEOUT;
+        case ReplayStatus::Timeout:
+            break;
+        }
+        return SOAPY_SDR_TIMEOUT;
+    }
+
+private:
+    ReplaySource replay_;
+    SampleFormat stream_format_ = SampleFormat::Cf32;
+
+    mutable std::mutex settings_mutex_;
+    double freq_ = 0.0;
+    double gain_ = 0.0;
+    double bandwidth_ = 0.0;
+    std::string antenna_ = "REPLAY";
+};
+
+// Device::make() for device args, a SoapyReplayDevice for "replay:..."
+inline SoapySDR::Device* open_soapy_device(const std::string& args) {
+    if (!is_replay_args(args)) return SoapySDR::Device::make(args);
+    ReplayOptions options;
+    const std::string error = parse_replay_args(args, options);
+    if (!error.empty()) throw std::invalid_argument(error);
+    return new SoapyReplayDevice(options);
+}
+
+inline void close_soapy_device(SoapySDR::Device* device) {
+    if (dynamic_cast<SoapyReplayDevice*>(device)) {
+        delete device;
+    } else {
+        SoapySDR::Device::unmake(device);
+    }
+}
+
+// True once a replay without loop=1 has played its whole file
+inline bool soapy_replay_finished(const SoapySDR::Device* device) {
+    const SoapyReplayDevice* replay = dynamic_cast<const SoapyReplayDevice*>(device);
+    return replay && replay->replay().finished();
+}
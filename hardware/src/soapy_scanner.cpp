@@ -3,6 +3,14 @@
  * 
  * Scans frequency ranges using SoapySDR-compatible devices
  * Outputs JSON results to stdout
+ *
+ * --panorama stitches the steps into one spectrum on a fixed bin grid
+ * (panorama.hpp) instead of listing peaks; --overlap, --edge-trim and
+ * --dc-blank replace --step. --output-format binary writes it as a single
+ * float32 spectrum frame (spectrum_frame.hpp) flagged SPECTRUM_FLAG_PANORAMA.
+ *
+ * --device replay:path=<file> scans a recording instead of a radio
+ * (soapy_replay.hpp); every step reads the next samples of the file.
  * 
  * Compile: g++ -o soapy_scanner soapy_scanner.cpp -lSoapySDR -lfftw3f -std=c++17
  */
@@ -16,6 +24,16 @@
 #include <cmath>
 #include <algorithm>
 #include <iomanip>
+#include <thread>
+#include <chrono>
+#include <cstring>
+
+#include "dsp_kernels.hpp"
+#include "fftw_wisdom.hpp"
+#include "soapy_replay.hpp"
+#include "panorama.hpp"
+#include "scanner_peaks.hpp"
+#include "spectrum_frame.hpp"
 
 struct ScanConfig {
     std::string device_args;
@@ -27,54 +45,15 @@ struct ScanConfig {
     size_t fft_size;
     int channel;
     double dwell_time_ms;
+    PlanEffort plan_effort;
+    std::string wisdom_file;
+    bool panorama;
+    double overlap;
+    double edge_trim;
+    size_t dc_blank_bins;
+    OutputFormat output_format;
 };
 
-struct Peak {
-    double frequency;
-    float power_db;
-    float bandwidth;
-};
-
-std::vector<Peak> find_peaks(const std::vector<float>& fft_data, double center_freq, 
-                              double sample_rate, float threshold_db = -80.0) {
-    std::vector<Peak> peaks;
-    const size_t fft_size = fft_data.size();
-    const double freq_resolution = sample_rate / fft_size;
-
-    for (size_t i = 5; i < fft_size - 5; ++i) {
-        float power_db = 20.0f * std::log10(fft_data[i] + 1e-10f);
-        
-        if (power_db < threshold_db) continue;
-
-        // Check if local maximum
-        bool is_peak = true;
-        for (int j = -2; j <= 2; ++j) {
-            if (j == 0) continue;
-            if (fft_data[i] < fft_data[i + j]) {
-                is_peak = false;
-                break;
-            }
-        }
-
-        if (is_peak) {
-            double freq = center_freq - sample_rate / 2.0 + i * freq_resolution;
-            
-            // Estimate bandwidth (3dB down)
-            float threshold_3db = fft_data[i] * 0.707f;
-            size_t bw_left = i, bw_right = i;
-            
-            while (bw_left > 0 && fft_data[bw_left] > threshold_3db) bw_left--;
-            while (bw_right < fft_size - 1 && fft_data[bw_right] > threshold_3db) bw_right++;
-            
-            float bandwidth = (bw_right - bw_left) * freq_resolution;
-
-            peaks.push_back({freq, power_db, bandwidth});
-        }
-    }
-
-    return peaks;
-}
-
 int main(int argc, char* argv[]) {
     ScanConfig config;
     config.device_args = "";
@@ -86,6 +65,13 @@ int main(int argc, char* argv[]) {
     config.fft_size = 2048;
     config.channel = 0;
     config.dwell_time_ms = 100;
+    config.plan_effort = PlanEffort::Measure;
+    config.wisdom_file = "";
+    config.panorama = false;
+    config.overlap = 0.25;
+    config.edge_trim = 0.1;
+    config.dc_blank_bins = 2;
+    config.output_format = OutputFormat::Json;
 
     // Parse arguments
     for (int i = 1; i < argc; i++) {
@@ -104,13 +90,38 @@ int main(int argc, char* argv[]) {
             config.device_args = argv[++i];
         } else if (arg == "--dwell" && i + 1 < argc) {
             config.dwell_time_ms = std::stod(argv[++i]);
+        } else if (arg == "--plan-effort" && i + 1 < argc) {
+            if (!parse_plan_effort(argv[++i], config.plan_effort)) {
+                std::cerr << "[SOAPY-SCANNER] Unknown plan effort: " << argv[i]
+                          << " (estimate/measure/patient/exhaustive)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--wisdom-file" && i + 1 < argc) {
+            config.wisdom_file = argv[++i];
+        } else if (arg == "--panorama") {
+            config.panorama = true;
+        } else if (arg == "--overlap" && i + 1 < argc) {
+            config.overlap = std::stod(argv[++i]);
+        } else if (arg == "--edge-trim" && i + 1 < argc) {
+            config.edge_trim = std::stod(argv[++i]);
+        } else if (arg == "--dc-blank" && i + 1 < argc) {
+            config.dc_blank_bins = std::stoul(argv[++i]);
+        } else if (arg == "--output-format" && i + 1 < argc) {
+            if (!parse_output_format(argv[++i], config.output_format)) {
+                std::cerr << "[SOAPY-SCANNER] Unknown output format: " << argv[i] << " (json/binary)" << std::endl;
+                return 1;
+            }
         }
     }
+    if (config.output_format == OutputFormat::Binary && !config.panorama) {
+        std::cerr << "[SOAPY-SCANNER] --output-format binary requires --panorama" << std::endl;
+        return 1;
+    }
 
     try {
         // Open device
         std::cerr << "[SOAPY-SCANNER] Opening device: " << config.device_args << std::endl;
-        SoapySDR::Device *device = SoapySDR::Device::make(config.device_args);
+        SoapySDR::Device *device = open_soapy_device(config.device_args);
         if (!device) {
             std::cerr << "[SOAPY-SCANNER] Failed to open device" << std::endl;
             return 1;
@@ -118,6 +129,9 @@ int main(int argc, char* argv[]) {
 
         // Configure device
         device->setSampleRate(SOAPY_SDR_RX, config.channel, config.sample_rate);
+        if (is_replay_args(config.device_args)) {
+            config.sample_rate = device->getSampleRate(SOAPY_SDR_RX, config.channel);  // The recording's own
+        }
         device->setGain(SOAPY_SDR_RX, config.channel, config.gain);
 
         // Setup stream
@@ -127,22 +141,51 @@ int main(int argc, char* argv[]) {
 
         // Allocate buffers
         std::vector<std::complex<float>> samples(config.fft_size);
+        std::vector<float> fft_power(config.fft_size);
         std::vector<float> fft_magnitude(config.fft_size);
+        std::vector<float> fft_db(config.fft_size);
+        const dsp::Kernels& kernels = dsp::kernels();
+        const float power_scale = 1.0f / (static_cast<float>(config.fft_size) * config.fft_size);
 
-        // Setup FFTW
+        // Setup FFTW, reusing cached wisdom for this CPU
+        WisdomStore wisdom(config.wisdom_file.empty() ? default_wisdom_path() : config.wisdom_file);
+        wisdom.load();
         fftwf_complex *fft_in = fftwf_alloc_complex(config.fft_size);
         fftwf_complex *fft_out = fftwf_alloc_complex(config.fft_size);
-        fftwf_plan plan = fftwf_plan_dft_1d(config.fft_size, fft_in, fft_out, 
-                                            FFTW_FORWARD, FFTW_ESTIMATE);
+        fftwf_plan plan = fftwf_plan_dft_1d(config.fft_size, fft_in, fft_out,
+                                            FFTW_FORWARD, plan_effort_flags(config.plan_effort));
+        if (!wisdom.save()) {
+            std::cerr << "[SOAPY-SCANNER] Could not write FFTW wisdom to " << wisdom.path() << std::endl;
+        }
 
         std::vector<Peak> all_peaks;
-        double current_freq = config.start_freq;
+
+        // Panorama steps are planned on the grid of the rate the device actually runs at
+        PanoramaConfig pano_config;
+        pano_config.start_freq = config.start_freq;
+        pano_config.stop_freq = config.stop_freq;
+        pano_config.sample_rate = device->getSampleRate(SOAPY_SDR_RX, config.channel);
+        pano_config.fft_size = config.fft_size;
+        pano_config.overlap = config.overlap;
+        pano_config.edge_trim = config.edge_trim;
+        pano_config.dc_blank_bins = config.dc_blank_bins;
+        PanoramaStitcher stitcher(pano_config);
+
+        std::vector<double> scan_freqs;
+        if (config.panorama) {
+            scan_freqs = stitcher.plan_steps();
+        } else {
+            for (double freq = config.start_freq; freq <= config.stop_freq; freq += config.step_size) {
+                scan_freqs.push_back(freq);
+            }
+        }
 
         std::cerr << "[SOAPY-SCANNER] Scanning " << config.start_freq / 1e6 << " MHz to " 
-                  << config.stop_freq / 1e6 << " MHz" << std::endl;
+                  << config.stop_freq / 1e6 << " MHz in " << scan_freqs.size() << " steps" << std::endl;
 
         // Scan loop
-        while (current_freq <= config.stop_freq) {
+        for (double current_freq : scan_freqs) {
+            if (soapy_replay_finished(device)) break;
             device->setFrequency(SOAPY_SDR_RX, config.channel, current_freq);
             
             // Allow settling time
@@ -157,27 +200,24 @@ int main(int argc, char* argv[]) {
             
             if (ret == (int)config.fft_size) {
                 // Compute FFT
-                for (size_t i = 0; i < config.fft_size; ++i) {
-                    fft_in[i][0] = samples[i].real();
-                    fft_in[i][1] = samples[i].imag();
-                }
+                std::memcpy(fft_in, samples.data(), config.fft_size * sizeof(fftwf_complex));
 
                 fftwf_execute(plan);
 
-                // Calculate magnitude with FFT shift
-                for (size_t i = 0; i < config.fft_size; ++i) {
-                    size_t shifted_idx = (i + config.fft_size / 2) % config.fft_size;
-                    float real = fft_out[shifted_idx][0];
-                    float imag = fft_out[shifted_idx][1];
-                    fft_magnitude[i] = std::sqrt(real * real + imag * imag) / config.fft_size;
-                }
+                // Power with FFT shift, then magnitude and dB views of it
+                dsp::shifted_power(kernels, reinterpret_cast<const float*>(fft_out), fft_power.data(),
+                                   config.fft_size, power_scale);
+                kernels.magnitude(fft_power.data(), fft_magnitude.data(), config.fft_size);
+                kernels.power_to_db(fft_power.data(), fft_db.data(), config.fft_size, 0.0f);
 
-                // Find peaks
-                auto peaks = find_peaks(fft_magnitude, current_freq, config.sample_rate);
-                all_peaks.insert(all_peaks.end(), peaks.begin(), peaks.end());
+                if (config.panorama) {
+                    stitcher.add(device->getFrequency(SOAPY_SDR_RX, config.channel), fft_power.data());
+                } else {
+                    // Find peaks
+                    auto peaks = find_peaks(fft_magnitude, fft_db, current_freq, config.sample_rate);
+                    all_peaks.insert(all_peaks.end(), peaks.begin(), peaks.end());
+                }
             }
-
-            current_freq += config.step_size;
         }
 
         // Cleanup
@@ -186,7 +226,42 @@ int main(int argc, char* argv[]) {
         fftwf_destroy_plan(plan);
         fftwf_free(fft_in);
         fftwf_free(fft_out);
-        SoapySDR::Device::unmake(device);
+        close_soapy_device(device);
+
+        if (config.panorama) {
+            std::vector<float> pano_db;
+            const size_t filled = stitcher.finish(pano_db);
+            const size_t peak_bin = std::max_element(pano_db.begin(), pano_db.end()) - pano_db.begin();
+
+            if (config.output_format == OutputFormat::Binary) {
+                SpectrumFrameInfo info;
+                info.timestamp = std::chrono::duration<double>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+                info.center_freq = stitcher.center_freq();
+                info.sample_rate = stitcher.span();
+                info.peak_bin = static_cast<uint32_t>(peak_bin);
+                info.peak_power = pano_db[peak_bin];
+                info.flags = SPECTRUM_FLAG_PANORAMA;
+                info.fft_count = static_cast<uint32_t>(stitcher.fft_count());
+                BinaryFrameWriter writer(std::cout, BinPayload::Float32, 0.01f);
+                writer.write_spectrum(info, pano_db.data(), pano_db.size());
+            } else {
+                std::cout << "{\"panorama\":{\"startFreq\":" << std::fixed << std::setprecision(0) << stitcher.start_freq()
+                          << ",\"binHz\":" << std::setprecision(3) << stitcher.bin_hz()
+                          << ",\"peakFrequency\":" << std::setprecision(0) << stitcher.start_freq() + peak_bin * stitcher.bin_hz()
+                          << ",\"bins\":[" << std::setprecision(2);
+                for (size_t i = 0; i < pano_db.size(); ++i) {
+                    if (i > 0) std::cout << ",";
+                    std::cout << pano_db[i];
+                }
+                std::cout << "]},\"scanRange\":{\"start\":" << std::setprecision(0) << config.start_freq
+                          << ",\"stop\":" << config.stop_freq << "}}" << std::endl;
+            }
+
+            std::cerr << "[SOAPY-SCANNER] Panorama: " << pano_db.size() << " bins, "
+                      << filled << " interpolated" << std::endl;
+            return 0;
+        }
 
         // Sort peaks by power
         std::sort(all_peaks.begin(), all_peaks.end(), 
@@ -2,7 +2,29 @@
  * SoapySDR FFT Streamer
  * 
  * Streams real-time FFT data from SoapySDR-compatible devices (RTL-SDR, HackRF, LimeSDR, etc.)
- * Outputs JSON to stdout for consumption by Node.js WebSocket server.
+ * Outputs JSON to stdout for consumption by Node.js WebSocket server, or
+ * binary length-prefixed frames with --output-format binary (see spectrum_frame.hpp).
+ *
+ * The device is read continuously; every FFT is folded into the current
+ * display frame (--reduce mean|max|min) and frames are emitted at
+ * --frame-rate, counted in samples so the output rate tracks the stream.
+ *
+ * Line-delimited commands on stdin (freq, gain, bw, antenna, fft-size; see
+ * control_channel.hpp) retune the running stream. Each one bumps the config
+ * generation carried by every following frame.
+ *
+ * FFT plans use --plan-effort (default measure) backed by the shared
+ * per-CPU wisdom cache (fftw_wisdom.hpp, --wisdom-file to override). The
+ * startup plan is made before the stream is activated; a live fft-size
+ * change plans from wisdom only, falling back to FFTW_ESTIMATE.
+ *
+ * --device replay:path=<file>[,mode=fast] streams a recording instead of
+ * a radio (soapy_replay.hpp) and exits at its end unless it loops.
+ *
+ * Every --perf-interval seconds (default 10, 0 = off) a {"type":"perf"}
+ * record gives per-stage latency histograms (FFT, power, reduce,
+ * serialize, write) and readStream-to-written frame latency
+ * (stage_latency.hpp).
  * 
  * Compile: g++ -o soapy_streamer soapy_streamer.cpp -lSoapySDR -lfftw3f -std=c++17
  */
@@ -10,6 +32,7 @@
 #include <SoapySDR/Device.hpp>
 #include <SoapySDR/Formats.hpp>
 #include <SoapySDR/Types.hpp>
+#include <SoapySDR/Errors.hpp>
 #include <fftw3.h>
 #include <iostream>
 #include <vector>
@@ -19,6 +42,17 @@
 #include <chrono>
 #include <thread>
 #include <iomanip>
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+
+#include "spectrum_frame.hpp"
+#include "spectrum_accumulator.hpp"
+#include "control_channel.hpp"
+#include "dsp_kernels.hpp"
+#include "fftw_wisdom.hpp"
+#include "soapy_replay.hpp"
+#include "stage_latency.hpp"
 
 // Global flag for graceful shutdown
 volatile bool running = true;
@@ -36,9 +70,19 @@ struct Config {
     size_t fft_size;
     int channel;
     std::string antenna;
+    OutputFormat output_format;
+    BinPayload bin_payload;
+    double frame_rate;
+    ReduceMode reduce_mode;
+    double settle_ms;
+    PlanEffort plan_effort;
+    std::string wisdom_file;
+    double perf_interval;
 };
 
-void print_json_fft(const std::vector<float>& fft_data, double center_freq, double sample_rate) {
+// One {"type":"fft"} line; the caller flushes
+void print_json_fft(const std::vector<float>& fft_data, double center_freq, double sample_rate,
+                    size_t fft_count, uint32_t config_gen) {
     std::cout << "{\"type\":\"fft\",\"data\":[";
     for (size_t i = 0; i < fft_data.size(); ++i) {
         if (i > 0) std::cout << ",";
@@ -46,9 +90,40 @@ void print_json_fft(const std::vector<float>& fft_data, double center_freq, doub
     }
     std::cout << "],\"centerFreq\":" << std::fixed << std::setprecision(0) << center_freq
               << ",\"sampleRate\":" << std::fixed << std::setprecision(0) << sample_rate
+              << ",\"fftCount\":" << fft_count
+              << ",\"configGen\":" << config_gen
               << ",\"timestamp\":" << std::chrono::duration_cast<std::chrono::milliseconds>(
                      std::chrono::system_clock::now().time_since_epoch()).count()
-              << "}" << std::endl;
+              << "}\n";
+}
+
+// Applies one live control command. Returns an error, empty on success.
+std::string apply_control_command(SoapySDR::Device* device, Config& config, const ControlCommand& cmd) {
+    try {
+        // The device first: config only takes a setting once it is applied
+        if (cmd.key == "freq") {
+            device->setFrequency(SOAPY_SDR_RX, config.channel, std::stod(cmd.value));
+            config.center_freq = device->getFrequency(SOAPY_SDR_RX, config.channel);
+        } else if (cmd.key == "gain") {
+            const double gain = std::stod(cmd.value);
+            device->setGain(SOAPY_SDR_RX, config.channel, gain);
+            config.gain = gain;
+        } else if (cmd.key == "bw") {
+            device->setBandwidth(SOAPY_SDR_RX, config.channel, std::stod(cmd.value));
+        } else if (cmd.key == "antenna") {
+            device->setAntenna(SOAPY_SDR_RX, config.channel, cmd.value);
+            config.antenna = cmd.value;
+        } else if (cmd.key == "fft-size") {
+            size_t fft_size = std::stoul(cmd.value);
+            if (fft_size < 16 || fft_size > 65536) return "fft-size out of range [16-65536]";
+            config.fft_size = fft_size;
+        } else {
+            return "unknown command '" + cmd.key + "'";
+        }
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+    return "";
 }
 
 int main(int argc, char* argv[]) {
@@ -61,6 +136,14 @@ int main(int argc, char* argv[]) {
     config.fft_size = 2048;      // 2048 bins default
     config.channel = 0;
     config.antenna = "RX";
+    config.output_format = OutputFormat::Json;
+    config.bin_payload = BinPayload::Float32;
+    config.frame_rate = 30.0;    // 30 FPS default
+    config.reduce_mode = ReduceMode::Mean;
+    config.settle_ms = 5.0;      // Samples discarded after a live retune
+    config.plan_effort = PlanEffort::Measure;
+    config.wisdom_file = "";     // Per-CPU default cache
+    config.perf_interval = 10.0; // Seconds between perf records, 0 = off
 
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -76,6 +159,35 @@ int main(int argc, char* argv[]) {
             config.device_args = argv[++i];
         } else if (arg == "--antenna" && i + 1 < argc) {
             config.antenna = argv[++i];
+        } else if (arg == "--output-format" && i + 1 < argc) {
+            if (!parse_output_format(argv[++i], config.output_format)) {
+                std::cerr << "[SOAPY-STREAMER] Unknown output format: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--frame-rate" && i + 1 < argc) {
+            config.frame_rate = std::stod(argv[++i]);
+        } else if (arg == "--reduce" && i + 1 < argc) {
+            if (!parse_reduce_mode(argv[++i], config.reduce_mode)) {
+                std::cerr << "[SOAPY-STREAMER] Unknown reduce mode: " << argv[i] << " (mean/max/min)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--settle-ms" && i + 1 < argc) {
+            config.settle_ms = std::stod(argv[++i]);
+        } else if (arg == "--payload" && i + 1 < argc) {
+            if (!parse_bin_payload(argv[++i], config.bin_payload)) {
+                std::cerr << "[SOAPY-STREAMER] Unknown payload: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--plan-effort" && i + 1 < argc) {
+            if (!parse_plan_effort(argv[++i], config.plan_effort)) {
+                std::cerr << "[SOAPY-STREAMER] Unknown plan effort: " << argv[i]
+                          << " (estimate/measure/patient/exhaustive)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--wisdom-file" && i + 1 < argc) {
+            config.wisdom_file = argv[++i];
+        } else if (arg == "--perf-interval" && i + 1 < argc) {
+            config.perf_interval = std::stod(argv[++i]);
         }
     }
 
@@ -86,7 +198,7 @@ int main(int argc, char* argv[]) {
     try {
         // Create device
         std::cerr << "[SOAPY-STREAMER] Opening device: " << config.device_args << std::endl;
-        SoapySDR::Device *device = SoapySDR::Device::make(config.device_args);
+        SoapySDR::Device *device = open_soapy_device(config.device_args);
         if (!device) {
             std::cerr << "[SOAPY-STREAMER] Failed to open device" << std::endl;
             return 1;
@@ -98,6 +210,9 @@ int main(int argc, char* argv[]) {
 
         // Configure device
         device->setSampleRate(SOAPY_SDR_RX, config.channel, config.sample_rate);
+        if (is_replay_args(config.device_args)) {
+            config.sample_rate = device->getSampleRate(SOAPY_SDR_RX, config.channel);  // The recording's own
+        }
         device->setFrequency(SOAPY_SDR_RX, config.channel, config.center_freq);
         
         // Set gain (try automatic first, then manual)
@@ -117,74 +232,241 @@ int main(int argc, char* argv[]) {
         SoapySDR::Stream *stream = device->setupStream(SOAPY_SDR_RX, SOAPY_SDR_CF32, channels);
         if (!stream) {
             std::cerr << "[SOAPY-STREAMER] Failed to setup stream" << std::endl;
-            SoapySDR::Device::unmake(device);
+            close_soapy_device(device);
             return 1;
         }
 
-        device->activateStream(stream);
+        // Buffers and FFTW state, rebuilt when fft-size changes live
+        std::vector<std::complex<float>> samples;
+        std::vector<float> fft_power;
+        std::vector<float> fft_magnitude;
+        float power_scale = 1.0f;
+        fftwf_complex *fft_in = nullptr;
+        fftwf_complex *fft_out = nullptr;
+        fftwf_plan plan = nullptr;
+        const dsp::Kernels& kernels = dsp::kernels();
+        std::cerr << "[SOAPY-STREAMER] DSP kernels: " << kernels.name << std::endl;
+        WisdomStore wisdom(config.wisdom_file.empty() ? default_wisdom_path() : config.wisdom_file);
+        wisdom.load();
+
+        // Bins are linear magnitude; int16 payloads use full scale = 1.0
+        BinaryFrameWriter frame_writer(std::cout, config.bin_payload, 1.0f / 32767.0f);
 
-        // Allocate buffers
-        std::vector<std::complex<float>> samples(config.fft_size);
-        std::vector<float> fft_magnitude(config.fft_size);
+        // Frame pacing is counted in samples, not wall-clock sleeps
+        SpectrumAccumulator accumulator(0, config.reduce_mode);
+        const size_t samples_per_frame = config.frame_rate > 0.0
+            ? static_cast<size_t>(config.sample_rate / config.frame_rate) : 0;
+        size_t samples_since_frame = 0;
+        size_t filled = 0;
+        size_t overflow_count = 0;
 
-        // Setup FFTW
-        fftwf_complex *fft_in = fftwf_alloc_complex(config.fft_size);
-        fftwf_complex *fft_out = fftwf_alloc_complex(config.fft_size);
-        fftwf_plan plan = fftwf_plan_dft_1d(config.fft_size, fft_in, fft_out, 
-                                            FFTW_FORWARD, FFTW_ESTIMATE);
+        // The startup plan runs at --plan-effort before the stream is
+        // activated. A live resize replans on the readStream thread, so it
+        // only uses wisdom and otherwise settles for an estimated plan
+        // rather than measuring while the device overflows
+        auto configure_fft = [&](bool live) {
+            if (plan) {
+                fftwf_destroy_plan(plan);
+                fftwf_free(fft_in);
+                fftwf_free(fft_out);
+            }
+            samples.resize(config.fft_size);
+            fft_power.resize(config.fft_size);
+            fft_magnitude.resize(config.fft_size);
+            power_scale = 1.0f / (static_cast<float>(config.fft_size) * config.fft_size);
+
+            // Setup FFTW
+            fft_in = fftwf_alloc_complex(config.fft_size);
+            fft_out = fftwf_alloc_complex(config.fft_size);
+            const unsigned effort = plan_effort_flags(config.plan_effort);
+            plan = fftwf_plan_dft_1d(config.fft_size, fft_in, fft_out,
+                                     FFTW_FORWARD, live ? effort | FFTW_WISDOM_ONLY : effort);
+            if (!plan) {
+                std::cerr << "[SOAPY-STREAMER] No FFTW wisdom for size " << config.fft_size
+                          << ", using an estimated plan" << std::endl;
+                plan = fftwf_plan_dft_1d(config.fft_size, fft_in, fft_out, FFTW_FORWARD, FFTW_ESTIMATE);
+            } else if (!live && !wisdom.save()) {
+                std::cerr << "[SOAPY-STREAMER] Could not write FFTW wisdom to " << wisdom.path() << std::endl;
+            }
+            accumulator.resize(config.fft_size);
+        };
+        configure_fft(false);
 
+        // Live control
+        ControlChannel control;
+        ControlCommand cmd;
+        uint32_t config_gen = 0;
+        size_t discard_samples = 0;
+
+        // Stage latencies (stage_latency.hpp), reported every --perf-interval
+        StageTimes perf;
+        StageTimes* perf_times = config.perf_interval > 0 ? &perf : nullptr;
+        auto last_perf_time = std::chrono::steady_clock::now();
+
+        auto emit_record = [&](const std::string& record) {
+            if (config.output_format == OutputFormat::Binary) {
+                frame_writer.write_record(record);
+            } else {
+                std::cout << record << std::endl;
+            }
+        };
+
+        device->activateStream(stream);
+        control.start();
         std::cerr << "[SOAPY-STREAMER] Streaming started (Ctrl+C to stop)" << std::endl;
 
         // Main streaming loop
         while (running) {
-            // Read samples
-            void *buffs[] = {samples.data()};
+            while (control.poll(cmd)) {
+                const size_t old_fft_size = config.fft_size;
+                std::string error = apply_control_command(device, config, cmd);
+                config_gen++;
+                if (config.fft_size != old_fft_size) {
+                    configure_fft(true);
+                }
+
+                // Drop the partial frame and let the front end settle
+                filled = 0;
+                samples_since_frame = 0;
+                accumulator.reset();
+                if (error.empty() && cmd.key != "fft-size") {
+                    discard_samples = static_cast<size_t>(config.settle_ms / 1000.0 * config.sample_rate);
+                }
+
+                std::ostringstream record;
+                record << "{\"type\":\"config\""
+                       << ",\"generation\":" << config_gen
+                       << ",\"command\":\"" << json_escape(cmd.key) << "\""
+                       << ",\"ok\":" << (error.empty() ? "true" : "false")
+                       << ",\"centerFreq\":" << std::fixed << std::setprecision(0) << config.center_freq
+                       << ",\"gain\":" << std::setprecision(1) << config.gain
+                       << ",\"antenna\":\"" << json_escape(config.antenna) << "\""
+                       << ",\"fftSize\":" << config.fft_size;
+                if (!error.empty()) {
+                    record << ",\"error\":\"" << json_escape(error) << "\"";
+                }
+                record << "}";
+                emit_record(record.str());
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            const double perf_secs = std::chrono::duration<double>(now - last_perf_time).count();
+            if (perf_times && perf_secs >= config.perf_interval) {
+                emit_record(perf.perf_record(perf_secs));
+                perf.reset();
+                last_perf_time = now;
+            }
+
+            // Read samples, completing partial reads rather than discarding them
+            void *buffs[] = {samples.data() + filled};
             int flags = 0;
             long long time_ns = 0;
             
-            int ret = device->readStream(stream, buffs, config.fft_size, flags, time_ns, 1000000);
+            int ret = device->readStream(stream, buffs, config.fft_size - filled, flags, time_ns, 1000000);
             
+            if (ret == SOAPY_SDR_TIMEOUT) {
+                if (soapy_replay_finished(device)) break;
+                continue;
+            }
+            if (ret == SOAPY_SDR_OVERFLOW) {
+                // Samples were lost; don't run an FFT across the gap
+                overflow_count++;
+                filled = 0;
+                continue;
+            }
             if (ret < 0) {
                 std::cerr << "[SOAPY-STREAMER] Stream error: " << ret << std::endl;
                 continue;
             }
 
-            if (ret != (int)config.fft_size) {
-                continue; // Incomplete read, skip FFT
+            if (discard_samples > 0) {
+                discard_samples -= std::min(discard_samples, static_cast<size_t>(ret));
+                continue;
             }
 
-            // Copy samples to FFT input
-            for (size_t i = 0; i < config.fft_size; ++i) {
-                fft_in[i][0] = samples[i].real();
-                fft_in[i][1] = samples[i].imag();
+            filled += ret;
+            if (filled < config.fft_size) {
+                continue;
             }
+            filled = 0;
+            const auto received = stage_clock(perf_times);   // readStream() completed this FFT
+
+            // Copy samples to FFT input (std::complex<float> matches fftwf_complex)
+            std::memcpy(fft_in, samples.data(), config.fft_size * sizeof(fftwf_complex));
+            const auto fft_start = stage_clock(perf_times);
 
             // Compute FFT
             fftwf_execute(plan);
+            const auto power_start = stage_clock(perf_times);
 
-            // Calculate magnitude and FFT shift
-            for (size_t i = 0; i < config.fft_size; ++i) {
-                size_t shifted_idx = (i + config.fft_size / 2) % config.fft_size;
-                float real = fft_out[shifted_idx][0];
-                float imag = fft_out[shifted_idx][1];
-                float magnitude = std::sqrt(real * real + imag * imag) / config.fft_size;
-                fft_magnitude[i] = magnitude;
+            // Calculate power with FFT shift and fold it into the current frame
+            dsp::shifted_power(kernels, reinterpret_cast<const float*>(fft_out), fft_power.data(),
+                               config.fft_size, power_scale);
+            accumulator.add(fft_power.data());
+            if (perf_times) {
+                perf.record(STAGE_FFT, fft_start, power_start);
+                perf.record(STAGE_POWER, power_start, std::chrono::steady_clock::now());
+            }
+
+            samples_since_frame += config.fft_size;
+            if (samples_since_frame < samples_per_frame) {
+                continue;
             }
+            samples_since_frame = 0;
 
-            // Output JSON
-            print_json_fft(fft_magnitude, config.center_freq, config.sample_rate);
+            // Reduced power back to linear magnitude for output
+            const auto reduce_start = stage_clock(perf_times);
+            const size_t fft_count = accumulator.count();
+            accumulator.result(fft_power.data());
+            accumulator.reset();
+            kernels.magnitude(fft_power.data(), fft_magnitude.data(), config.fft_size);
+            const size_t peak_bin = config.output_format == OutputFormat::Binary
+                ? kernels.argmax(fft_magnitude.data(), config.fft_size) : 0;
+            const auto serialize_start = stage_clock(perf_times);
+
+            if (config.output_format == OutputFormat::Binary) {
+                SpectrumFrameInfo info;
+                info.timestamp = std::chrono::duration<double>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+                info.center_freq = config.center_freq;
+                info.sample_rate = config.sample_rate;
+                info.peak_bin = static_cast<uint32_t>(peak_bin);
+                info.peak_power = fft_magnitude[peak_bin];
+                info.flags = SPECTRUM_FLAG_LINEAR;
+                info.fft_count = static_cast<uint32_t>(fft_count);
+                info.config_gen = config_gen;
+                frame_writer.encode_spectrum(info, fft_magnitude.data(), fft_magnitude.size());
+            } else {
+                // Output JSON
+                print_json_fft(fft_magnitude, config.center_freq, config.sample_rate, fft_count, config_gen);
+            }
+            const auto write_start = stage_clock(perf_times);
+            if (config.output_format == OutputFormat::Binary) {
+                frame_writer.write_frame();
+            } else {
+                std::cout.flush();
+            }
+            if (perf_times) {
+                const auto written = std::chrono::steady_clock::now();
+                perf.record(STAGE_REDUCE, reduce_start, serialize_start);
+                perf.record(STAGE_SERIALIZE, serialize_start, write_start);
+                perf.record(STAGE_WRITE, write_start, written);
+                perf.record(STAGE_FRAME, received, written);
+            }
+        }
 
-            // Throttle to ~30 FPS
-            std::this_thread::sleep_for(std::chrono::milliseconds(33));
+        if (overflow_count > 0) {
+            std::cerr << "[SOAPY-STREAMER] Overflows during session: " << overflow_count << std::endl;
         }
 
         // Cleanup
+        control.stop();
         device->deactivateStream(stream);
         device->closeStream(stream);
         fftwf_destroy_plan(plan);
         fftwf_free(fft_in);
         fftwf_free(fft_out);
-        SoapySDR::Device::unmake(device);
+        close_soapy_device(device);
 
         std::cerr << "[SOAPY-STREAMER] Shutdown complete" << std::endl;
 
@@ -0,0 +1,157 @@
+/**
+ * spectral_engine.hpp - Reusable batched spectrum measurement for the scanners
+ *
+ * Owns FFTW-aligned buffers and one fftwf_plan_many_dft plan for `batch`
+ * contiguous blocks of `fft_size` samples, created once per FFT size
+ * instead of once per measurement. Callers write raw samples into
+ * block(i), then measure() windows them, runs every block through the
+ * single batched plan and averages the shifted power spectra in the linear
+ * domain before any dB conversion (averaging dB values, or averaging
+ * per-block peaks, biases the result low). The per-bin maximum over the
+ * same blocks is kept alongside for peak-hold displays.
+ *
+ * Spectra use a Hann window scaled by its coherent gain, so a bin-centred
+ * tone reads the same power as it would unwindowed while leakage no longer
+ * props up the noise floor estimate. iq_analyze asks for sdr_streamer's
+ * window and scaling instead (spectrum_window.hpp).
+ */
+
+#pragma once
+
+#include <fftw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "dsp_kernels.hpp"
+#include "spectrum_accumulator.hpp"
+#include "spectrum_window.hpp"
+
+struct SpectralMeasurement {
+    size_t blocks = 0;              // Blocks averaged into this result
+    size_t peak_bin = 0;            // Index into the shifted spectrum (0 = -fs/2)
+    double peak_power_db = -200.0;  // Strongest bin of the averaged spectrum
+    double avg_power_db = -200.0;   // Mean over all bins (linear mean)
+    double noise_floor_db = -200.0; // Median bin, robust against narrow signals
+};
+
+class SpectralEngine {
+public:
+    SpectralEngine(size_t fft_size, size_t batch, unsigned plan_flags,
+                   SpectrumWindow window = SpectrumWindow::Scanner)
+        : fft_size_(fft_size), batch_(std::max<size_t>(1, batch)),
+          kernels_(dsp::kernels()), window_(hann_window(fft_size, window)), power_(fft_size),
+          averaged_(fft_size), held_(fft_size), scratch_(fft_size), accumulator_(fft_size),
+          max_hold_(fft_size, ReduceMode::MaxHold) {
+        in_ = fftwf_alloc_complex(fft_size_ * batch_);
+        out_ = fftwf_alloc_complex(fft_size_ * batch_);
+        const int n = static_cast<int>(fft_size_);
+        plan_ = fftwf_plan_many_dft(1, &n, static_cast<int>(batch_),
+                                    in_, nullptr, 1, n,
+                                    out_, nullptr, 1, n,
+                                    FFTW_FORWARD, plan_flags);
+        if (!plan_) {
+            fftwf_free(in_);
+            fftwf_free(out_);
+            throw std::runtime_error("FFTW could not plan the batched transform");
+        }
+
+        power_scale_ = spectrum_power_scale(window_, window);
+        band_divisor_ = spectrum_band_divisor(window_, power_scale_);
+    }
+
+    ~SpectralEngine() {
+        fftwf_destroy_plan(plan_);
+        fftwf_free(in_);
+        fftwf_free(out_);
+    }
+
+    SpectralEngine(const SpectralEngine&) = delete;
+    SpectralEngine& operator=(const SpectralEngine&) = delete;
+
+    size_t fft_size() const { return fft_size_; }
+    size_t batch() const { return batch_; }
+
+    // Destination for the raw samples of block i (fft_size samples)
+    std::complex<float>* block(size_t i) {
+        return reinterpret_cast<std::complex<float>*>(in_ + i * fft_size_);
+    }
+
+    // Transforms all blocks in one plan execution and averages the first
+    // `valid_blocks` of them. `offset_db` is added to every reported level.
+    SpectralMeasurement measure(size_t valid_blocks, double offset_db = 0.0) {
+        SpectralMeasurement result;
+        valid_blocks = std::min(valid_blocks, batch_);
+        accumulator_.reset();
+        max_hold_.reset();
+        if (valid_blocks == 0) {
+            std::fill(averaged_.begin(), averaged_.end(), 0.0f);
+            std::fill(held_.begin(), held_.end(), 0.0f);
+            return result;
+        }
+
+        for (size_t b = 0; b < valid_blocks; b++) {
+            float* iq = reinterpret_cast<float*>(in_ + b * fft_size_);
+            kernels_.apply_window(iq, window_.data(), iq, fft_size_);
+        }
+        fftwf_execute(plan_);
+
+        for (size_t b = 0; b < valid_blocks; b++) {
+            dsp::shifted_power(kernels_, reinterpret_cast<const float*>(out_ + b * fft_size_),
+                               power_.data(), fft_size_, power_scale_);
+            accumulator_.add(power_.data());
+            max_hold_.add(power_.data());
+        }
+        accumulator_.result(averaged_.data());
+        max_hold_.result(held_.data());
+
+        double total = 0.0;
+        for (float p : averaged_) total += p;
+        scratch_ = averaged_;
+        auto median = scratch_.begin() + scratch_.size() / 2;
+        std::nth_element(scratch_.begin(), median, scratch_.end());
+
+        result.blocks = valid_blocks;
+        result.peak_bin = kernels_.argmax(averaged_.data(), fft_size_);
+        result.peak_power_db = to_db(averaged_[result.peak_bin]) + offset_db;
+        result.avg_power_db = to_db(total / fft_size_) + offset_db;
+        result.noise_floor_db = to_db(*median) + offset_db;
+        return result;
+    }
+
+    // Linear power per shifted bin from the last measure()
+    const std::vector<float>& averaged_power() const { return averaged_; }
+
+    // Per-bin maximum over the blocks of the last measure(), same units
+    const std::vector<float>& max_power() const { return held_; }
+
+    // Summed bin powers over a band divided by this give the band's power
+    // (the window's equivalent noise bandwidth in bins, 1.5 for Hann, under
+    // Scanner scaling)
+    double band_divisor() const { return band_divisor_; }
+
+private:
+    static double to_db(double power) {
+        return 10.0 * std::log10(power + 1e-20);
+    }
+
+    size_t fft_size_;
+    size_t batch_;
+    const dsp::Kernels& kernels_;
+    fftwf_complex* in_ = nullptr;
+    fftwf_complex* out_ = nullptr;
+    fftwf_plan plan_ = nullptr;
+    std::vector<float> window_;
+    std::vector<float> power_;
+    std::vector<float> averaged_;
+    std::vector<float> held_;
+    std::vector<float> scratch_;
+    SpectrumAccumulator accumulator_;
+    SpectrumAccumulator max_hold_;
+    float power_scale_ = 1.0f;
+    double band_divisor_ = 1.0;
+};
@@ -0,0 +1,522 @@
+/**
+ * spectrogram_pyramid.hpp - Sidecar spectrogram overview for recordings
+ *
+ * Browsing a recording should not mean reading and transforming all of
+ * it. With --pyramid the recorders (and iq_pyramid for existing files)
+ * write <base>.pyramid next to the data: spectrogram rows at a base time
+ * resolution plus 2x/4x/8x... coarser levels, each row as per-bin mean
+ * and max, quantised to one byte per bin. An hour at 56 Msps is ~270 MB
+ * of pyramid at the defaults against ~800 GB of ci16 IQ.
+ *
+ * Base row r covers stream samples [r * row_samples, (r + 1) * row_samples)
+ * of the recording (SigMF global index, gaps included). Its levels are
+ * the linear-power mean and per-bin max of `ffts_per_row` Hann-windowed
+ * FFTs spaced evenly across the row (all of them when ffts_per_row *
+ * fft_size = row_samples), FFT-shifted so bin 0 is -fs/2. Level l row j
+ * folds level l-1 rows 2j and 2j+1 (mean of means, max of maxes).
+ *
+ * File layout, little-endian, made for mmap:
+ *
+ *   PyramidHeader (64 bytes)
+ *   tile 0, tile 1, ...  each 2^(levels-1) base rows and the rows above:
+ *     level 0 rows, level 1 rows, ...  (2^(levels-1-l) rows for level l)
+ *       row = mean[fft_size] bytes, then max[fft_size] bytes
+ *
+ * so any row of any level is at a computed offset. A byte v > 0 is
+ * db_min + v * db_step dBFS (full-scale tone = 0 dBFS); 0 means no data
+ * (rows lost to an overflow, or past the end). Tiles are written whole and
+ * the header's `rows` is updated after each, so a pyramid can be read
+ * while its recording is still running.
+ *
+ * The FFTs run on a worker thread; the recorder only copies the samples
+ * each FFT needs into a free row buffer. If none is free the row is left
+ * empty rather than stalling the receive loop.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <complex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fftw_wisdom.hpp"
+#include "sample_format.hpp"
+#include "spectral_engine.hpp"
+
+constexpr char PYRAMID_MAGIC[8] = {'S', 'D', 'R', 'P', 'Y', 'R', '0', '1'};
+constexpr float PYRAMID_DB_MIN = -150.0f;
+constexpr float PYRAMID_DB_STEP = 0.625f;    // Byte 255 = +9.4 dBFS
+
+struct PyramidHeader {
+    char magic[8];
+    double sample_rate;
+    double center_freq;
+    uint64_t row_samples;     // Stream samples per base row
+    uint64_t rows;            // Base rows written so far
+    uint32_t fft_size;        // Bins per row
+    uint32_t ffts_per_row;
+    uint32_t levels;          // Base level included
+    float db_min;
+    float db_step;
+    uint32_t reserved;
+};
+static_assert(sizeof(PyramidHeader) == 64, "PyramidHeader is an on-disk format");
+
+// x.sigmf-data -> x.pyramid; any other name gets the extension appended
+inline std::string pyramid_path(const std::string& data_path) {
+    static const std::string data_ext = ".sigmf-data";
+    if (data_path.size() > data_ext.size()
+        && data_path.compare(data_path.size() - data_ext.size(), data_ext.size(), data_ext) == 0) {
+        return data_path.substr(0, data_path.size() - data_ext.size()) + ".pyramid";
+    }
+    return data_path + ".pyramid";
+}
+
+inline float pyramid_db(uint8_t level) {
+    return PYRAMID_DB_MIN + level * PYRAMID_DB_STEP;
+}
+
+// Base rows per tile and bytes per tile for a pyramid shape
+inline uint64_t pyramid_tile_rows(uint32_t levels) { return uint64_t(1) << (levels - 1); }
+inline uint64_t pyramid_tile_bytes(uint32_t levels, uint32_t fft_size) {
+    return (2 * pyramid_tile_rows(levels) - 1) * 2 * uint64_t(fft_size);
+}
+
+struct PyramidOptions {
+    size_t fft_size = 1024;
+    double row_secs = 0.05;        // Base time resolution
+    size_t ffts_per_row = 32;      // 0 = every sample of the row
+    unsigned levels = 4;           // 1x, 2x, 4x, 8x
+    size_t queue_rows = 16;        // Row buffers between recorder and worker
+    bool wait_for_worker = false;  // Offline indexing: block instead of skipping rows
+};
+
+class PyramidWriter {
+public:
+    PyramidWriter(const std::string& path, double sample_rate, double center_freq, const PyramidOptions& options)
+        : path_(path), kernels_(dsp::kernels()) {
+        fft_size_ = std::max<size_t>(16, options.fft_size);
+        row_samples_ = std::max<uint64_t>(fft_size_, static_cast<uint64_t>(options.row_secs * sample_rate));
+        const size_t fit = static_cast<size_t>(row_samples_ / fft_size_);
+        ffts_ = options.ffts_per_row == 0 ? fit : std::min(options.ffts_per_row, fit);
+        levels_ = std::max(1u, std::min(options.levels, 12u));
+        tile_rows_ = pyramid_tile_rows(levels_);
+        wait_ = options.wait_for_worker;
+
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            error_ = errno;
+            return;
+        }
+
+        std::memset(&header_, 0, sizeof(header_));
+        std::memcpy(header_.magic, PYRAMID_MAGIC, sizeof(header_.magic));
+        header_.sample_rate = sample_rate;
+        header_.center_freq = center_freq;
+        header_.row_samples = row_samples_;
+        header_.fft_size = static_cast<uint32_t>(fft_size_);
+        header_.ffts_per_row = static_cast<uint32_t>(ffts_);
+        header_.levels = levels_;
+        header_.db_min = PYRAMID_DB_MIN;
+        header_.db_step = PYRAMID_DB_STEP;
+        write_at(&header_, sizeof(header_), 0);
+
+        // Planned here, on the caller's thread: FFTW's planner is not thread-safe
+        WisdomStore wisdom;
+        wisdom.load();
+        engine_ = std::make_unique<SpectralEngine>(fft_size_, ffts_, FFTW_MEASURE);
+        wisdom.save();
+
+        for (size_t i = 0; i < std::max<size_t>(2, options.queue_rows); i++) {
+            rows_.emplace_back(new Row);
+            rows_.back()->samples.resize(ffts_ * fft_size_);
+            free_.push_back(rows_.back().get());
+        }
+        const size_t level_values = tile_rows_ * 2 * fft_size_;
+        mean_.assign(levels_, std::vector<float>(level_values, 0.0f));
+        max_.assign(levels_, std::vector<float>(level_values, 0.0f));
+        present_.assign(levels_, std::vector<bool>(tile_rows_, false));
+        tile_.resize(pyramid_tile_bytes(levels_, header_.fft_size));
+        db_.resize(fft_size_);
+        begin_slot();
+        worker_ = std::thread(&PyramidWriter::run, this);
+    }
+
+    ~PyramidWriter() { close(); }
+
+    PyramidWriter(const PyramidWriter&) = delete;
+    PyramidWriter& operator=(const PyramidWriter&) = delete;
+
+    bool is_open() const { return fd_ >= 0; }
+    int error() const { return error_; }
+    const std::string& path() const { return path_; }
+    uint64_t row_samples() const { return row_samples_; }
+    size_t ffts_per_row() const { return ffts_; }
+    // Base rows the worker has finished / rows left empty because every
+    // row buffer was still queued
+    uint64_t rows() const { std::lock_guard<std::mutex> lock(mutex_); return header_.rows; }
+    uint64_t rows_skipped() const { return rows_skipped_; }
+
+    // Producer: the next n stream samples, in `format`
+    void feed(const void* samples, size_t n, SampleFormat format) {
+        if (fd_ < 0) return;
+        const uint64_t end = position_ + n;
+        while (slot_start_ + filled_ < end) {
+            const uint64_t from = slot_start_ + filled_;
+            const size_t count = static_cast<size_t>(std::min<uint64_t>(fft_size_ - filled_, end - from));
+            if (filling_) {
+                samples_to_cf32(samples, static_cast<size_t>(from - position_), count, format,
+                                reinterpret_cast<float*>(filling_->samples.data() + blocks_ * fft_size_ + filled_));
+            }
+            filled_ += count;
+            if (filled_ == fft_size_) {
+                if (filling_) blocks_++;
+                next_slot();
+            }
+        }
+        position_ = end;
+    }
+
+    // Producer: `samples` stream samples are missing (overflow); FFTs that
+    // would straddle the gap are left out
+    void skip(uint64_t samples) {
+        if (fd_ < 0 || samples == 0) return;
+        position_ += samples;
+        while (slot_start_ < position_) next_slot();
+    }
+
+    // Producer: hands over the last row, writes the final partial tile and
+    // header. Returns false if any write failed.
+    bool close() {
+        if (fd_ < 0) return error_ == 0;
+        if (filling_ && blocks_ > 0) submit();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        if (worker_.joinable()) worker_.join();
+        if (next_row_ % tile_rows_ != 0) flush_tile();
+        ::close(fd_);
+        fd_ = -1;
+        return error_ == 0;
+    }
+
+private:
+    struct Row {
+        uint64_t index = 0;
+        size_t blocks = 0;
+        std::vector<std::complex<float>> samples;
+    };
+
+    // Producer side: FFT slots are evenly spaced within each row
+    uint64_t slot_position(uint64_t row, size_t slot) const {
+        return row * row_samples_ + slot * (row_samples_ / ffts_);
+    }
+
+    void begin_slot() {
+        slot_start_ = slot_position(row_, slot_);
+        filled_ = 0;
+        if (slot_ == 0) {
+            blocks_ = 0;
+            filling_ = take_row();
+        }
+    }
+
+    void next_slot() {
+        if (++slot_ == ffts_) {
+            if (filling_ && blocks_ > 0) submit();
+            else if (filling_) release(filling_);
+            filling_ = nullptr;
+            row_++;
+            slot_ = 0;
+        }
+        begin_slot();
+    }
+
+    Row* take_row() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (wait_) free_cv_.wait(lock, [this] { return !free_.empty(); });
+        if (free_.empty()) {
+            rows_skipped_++;
+            return nullptr;
+        }
+        Row* row = free_.back();
+        free_.pop_back();
+        return row;
+    }
+
+    void release(Row* row) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(row);
+        }
+        free_cv_.notify_one();
+    }
+
+    void submit() {
+        filling_->index = row_;
+        filling_->blocks = blocks_;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_.push_back(filling_);
+        }
+        filling_ = nullptr;
+        cv_.notify_one();
+    }
+
+    // Worker: transforms queued rows in order and writes whole tiles
+    void run() {
+        while (true) {
+            Row* row = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || !ready_.empty(); });
+                if (ready_.empty()) return;
+                row = ready_.front();
+                ready_.pop_front();
+            }
+            for (size_t b = 0; b < row->blocks; b++) {
+                std::copy(row->samples.begin() + b * fft_size_, row->samples.begin() + (b + 1) * fft_size_,
+                          engine_->block(b));
+            }
+            const uint64_t index = row->index;
+            const size_t blocks = row->blocks;
+            release(row);
+            engine_->measure(blocks);
+
+            // Rows nobody submitted (gaps, skipped) stay empty
+            while (next_row_ < index) add_row(nullptr, nullptr);
+            add_row(engine_->averaged_power().data(), engine_->max_power().data());
+        }
+    }
+
+    void add_row(const float* mean, const float* max) {
+        const size_t i = static_cast<size_t>(next_row_ % tile_rows_);
+        if (mean) {
+            std::copy(mean, mean + fft_size_, mean_[0].begin() + i * fft_size_);
+            std::copy(max, max + fft_size_, max_[0].begin() + i * fft_size_);
+        }
+        present_[0][i] = mean != nullptr;
+        next_row_++;
+        if (i + 1 == tile_rows_) flush_tile();
+    }
+
+    // Folds the base rows of the current tile up the levels, quantises and
+    // writes the tile, then the row count
+    void flush_tile() {
+        const uint64_t tile = (next_row_ - 1) / tile_rows_;
+        size_t count = static_cast<size_t>((next_row_ - 1) % tile_rows_) + 1;
+        for (unsigned l = 1; l < levels_; l++) {
+            const size_t parents = (count + 1) / 2;
+            for (size_t j = 0; j < parents; j++) {
+                float* mean = mean_[l].data() + j * fft_size_;
+                float* max = max_[l].data() + j * fft_size_;
+                size_t children = 0;
+                std::fill(mean, mean + fft_size_, 0.0f);
+                std::fill(max, max + fft_size_, 0.0f);
+                for (size_t c = 2 * j; c < std::min(2 * j + 2, count); c++) {
+                    if (!present_[l - 1][c]) continue;
+                    const float* child_mean = mean_[l - 1].data() + c * fft_size_;
+                    const float* child_max = max_[l - 1].data() + c * fft_size_;
+                    for (size_t k = 0; k < fft_size_; k++) {
+                        mean[k] += child_mean[k];
+                        max[k] = std::max(max[k], child_max[k]);
+                    }
+                    children++;
+                }
+                if (children > 1) {
+                    for (size_t k = 0; k < fft_size_; k++) mean[k] *= 0.5f;
+                }
+                present_[l][j] = children > 0;
+            }
+            count = parents;
+        }
+
+        uint8_t* out = tile_.data();
+        for (unsigned l = 0; l < levels_; l++) {
+            const size_t level_rows = static_cast<size_t>(tile_rows_ >> l);
+            const size_t valid = static_cast<size_t>(((next_row_ - 1) % tile_rows_) >> l) + 1;
+            for (size_t j = 0; j < level_rows; j++) {
+                const bool have = j < valid && present_[l][j];
+                quantize(have ? mean_[l].data() + j * fft_size_ : nullptr, out);
+                quantize(have ? max_[l].data() + j * fft_size_ : nullptr, out + fft_size_);
+                out += 2 * fft_size_;
+            }
+        }
+        std::fill(present_[0].begin(), present_[0].end(), false);
+
+        write_at(tile_.data(), tile_.size(), sizeof(PyramidHeader) + tile * tile_.size());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            header_.rows = next_row_;
+        }
+        write_at(&header_.rows, sizeof(header_.rows), offsetof(PyramidHeader, rows));
+    }
+
+    void quantize(const float* power, uint8_t* out) {
+        if (!power) {
+            std::fill(out, out + fft_size_, 0);
+            return;
+        }
+        kernels_.power_to_db(power, db_.data(), fft_size_, 0.0f);
+        for (size_t k = 0; k < fft_size_; k++) {
+            const float level = std::round((db_[k] - PYRAMID_DB_MIN) / PYRAMID_DB_STEP);
+            out[k] = static_cast<uint8_t>(std::min(255.0f, std::max(1.0f, level)));
+        }
+    }
+
+    void write_at(const void* data, size_t bytes, uint64_t offset) {
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        while (bytes > 0) {
+            const ssize_t written = ::pwrite(fd_, src, bytes, static_cast<off_t>(offset));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                error_ = errno;
+                return;
+            }
+            src += written;
+            offset += written;
+            bytes -= written;
+        }
+    }
+
+    std::string path_;
+    const dsp::Kernels& kernels_;
+    int fd_ = -1;
+    int error_ = 0;
+    PyramidHeader header_;
+    size_t fft_size_ = 0;
+    uint64_t row_samples_ = 0;
+    size_t ffts_ = 1;
+    unsigned levels_ = 1;
+    uint64_t tile_rows_ = 1;
+    bool wait_ = false;
+
+    // Producer
+    uint64_t position_ = 0;      // Stream position of the next fed sample
+    uint64_t row_ = 0;
+    size_t slot_ = 0;
+    uint64_t slot_start_ = 0;
+    size_t filled_ = 0;
+    size_t blocks_ = 0;
+    Row* filling_ = nullptr;
+    uint64_t rows_skipped_ = 0;
+
+    // Shared
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable free_cv_;
+    std::vector<std::unique_ptr<Row>> rows_;
+    std::vector<Row*> free_;
+    std::deque<Row*> ready_;
+    bool stopping_ = false;
+    std::thread worker_;
+
+    // Worker
+    std::unique_ptr<SpectralEngine> engine_;
+    uint64_t next_row_ = 0;
+    std::vector<std::vector<float>> mean_;   // Per level, tile rows x bins, linear
+    std::vector<std::vector<float>> max_;
+    std::vector<std::vector<bool>> present_;
+    std::vector<uint8_t> tile_;
+    std::vector<float> db_;
+};
+
+// Read-only mmap of a .pyramid, usable while it is still being written
+class PyramidReader {
+public:
+    PyramidReader() = default;
+    ~PyramidReader() { close(); }
+
+    PyramidReader(const PyramidReader&) = delete;
+    PyramidReader& operator=(const PyramidReader&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return fail(path + ": " + std::strerror(errno));
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(PyramidHeader)) {
+            ::close(fd);
+            return fail(path + ": not a pyramid file");
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* map = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) return fail(path + ": " + std::strerror(errno));
+        base_ = static_cast<const uint8_t*>(map);
+
+        const PyramidHeader& h = header();
+        if (std::memcmp(h.magic, PYRAMID_MAGIC, sizeof(h.magic)) != 0 || h.levels == 0 || h.levels > 12
+            || h.fft_size == 0) {
+            close();
+            return fail(path + ": not a pyramid file");
+        }
+        return true;
+    }
+
+    void close() {
+        if (base_) ::munmap(const_cast<uint8_t*>(base_), size_);
+        base_ = nullptr;
+        size_ = 0;
+    }
+
+    const std::string& error() const { return error_; }
+    const PyramidHeader& header() const { return *reinterpret_cast<const PyramidHeader*>(base_); }
+    unsigned levels() const { return header().levels; }
+    size_t bins() const { return header().fft_size; }
+
+    // Rows available at `level`: those the header counts, limited to the
+    // tiles mapped when the file was opened
+    uint64_t rows(unsigned level) const {
+        const PyramidHeader& h = header();
+        const uint64_t tiles = (size_ - sizeof(PyramidHeader)) / pyramid_tile_bytes(h.levels, h.fft_size);
+        const uint64_t base_rows = std::min(h.rows, tiles * pyramid_tile_rows(h.levels));
+        return (base_rows + (uint64_t(1) << level) - 1) >> level;
+    }
+
+    // Stream samples one row of `level` covers
+    uint64_t row_samples(unsigned level) const { return header().row_samples << level; }
+
+    // bins() bytes each, see pyramid_db(); level < levels(), row < rows(level)
+    const uint8_t* mean(unsigned level, uint64_t row) const { return row_data(level, row); }
+    const uint8_t* max(unsigned level, uint64_t row) const { return row_data(level, row) + bins(); }
+
+private:
+    const uint8_t* row_data(unsigned level, uint64_t row) const {
+        const PyramidHeader& h = header();
+        const uint64_t per_tile = pyramid_tile_rows(h.levels) >> level;
+        uint64_t before = 0;
+        for (unsigned l = 0; l < level; l++) before += pyramid_tile_rows(h.levels) >> l;
+        const uint64_t offset = sizeof(PyramidHeader)
+            + (row / per_tile) * pyramid_tile_bytes(h.levels, h.fft_size)
+            + (before + row % per_tile) * 2 * h.fft_size;
+        return base_ + offset;
+    }
+
+    bool fail(const std::string& message) {
+        error_ = message;
+        return false;
+    }
+
+    const uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    std::string error_;
+};
@@ -0,0 +1,90 @@
+/**
+ * spectrum_accumulator.hpp - Reduction of many power spectra into one frame
+ *
+ * Folds per-FFT power spectra into a single display frame so the FFT
+ * rate can run far above the output rate. Mean mode sums linear power,
+ * which is the Welch estimate (averaging in dB, or averaging only peaks,
+ * biases the noise floor low); max/min-hold keep the per-bin extreme
+ * across the interval. The log10 pass happens once per frame, after
+ * the reduction.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+enum class ReduceMode { Mean, MaxHold, MinHold };
+
+inline bool parse_reduce_mode(const std::string& name, ReduceMode& mode) {
+    if (name == "mean") { mode = ReduceMode::Mean; return true; }
+    if (name == "max") { mode = ReduceMode::MaxHold; return true; }
+    if (name == "min") { mode = ReduceMode::MinHold; return true; }
+    return false;
+}
+
+class SpectrumAccumulator {
+public:
+    explicit SpectrumAccumulator(size_t num_bins = 0, ReduceMode mode = ReduceMode::Mean)
+        : mode_(mode) {
+        resize(num_bins);
+    }
+
+    void resize(size_t num_bins) {
+        acc_.resize(num_bins);
+        reset();
+    }
+
+    void reset() {
+        std::fill(acc_.begin(), acc_.end(), initial_value());
+        count_ = 0;
+    }
+
+    // Folds one linear power spectrum (num_bins() values) into the frame
+    void add(const float* power) {
+        switch (mode_) {
+        case ReduceMode::Mean:
+            for (size_t i = 0; i < acc_.size(); i++) acc_[i] += power[i];
+            break;
+        case ReduceMode::MaxHold:
+            for (size_t i = 0; i < acc_.size(); i++) acc_[i] = std::max(acc_[i], power[i]);
+            break;
+        case ReduceMode::MinHold:
+            for (size_t i = 0; i < acc_.size(); i++) acc_[i] = std::min(acc_[i], power[i]);
+            break;
+        }
+        count_++;
+    }
+
+    // Writes the reduced linear power per bin; leaves the accumulator untouched
+    void result(float* out) const {
+        if (count_ == 0) {
+            std::fill(out, out + acc_.size(), 0.0f);
+            return;
+        }
+        if (mode_ != ReduceMode::Mean) {
+            std::copy(acc_.begin(), acc_.end(), out);
+            return;
+        }
+        const float inv = 1.0f / static_cast<float>(count_);
+        for (size_t i = 0; i < acc_.size(); i++) {
+            out[i] = acc_[i] * inv;
+        }
+    }
+
+    size_t count() const { return count_; }
+    size_t num_bins() const { return acc_.size(); }
+    ReduceMode mode() const { return mode_; }
+
+private:
+    float initial_value() const {
+        return mode_ == ReduceMode::MinHold ? std::numeric_limits<float>::max() : 0.0f;
+    }
+
+    ReduceMode mode_;
+    std::vector<float> acc_;
+    size_t count_ = 0;
+};
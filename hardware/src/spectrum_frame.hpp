@@ -0,0 +1,194 @@
+/**
+ * spectrum_frame.hpp - Binary framed output protocol for the streamer daemons
+ *
+ * Alternative to the line-delimited JSON stdout protocol. Every frame is a
+ * fixed 72-byte little-endian header followed by `frame_bytes - header_bytes`
+ * bytes of payload, so the consumer can split the byte stream without
+ * scanning for delimiters and copy bins straight into a typed array.
+ *
+ *   offset  type     field
+ *   0       u32      magic          "SPFR" (0x52465053)
+ *   4       u32      frame_bytes    header + payload, i.e. the length prefix
+ *   8       u8       version        SPECTRUM_FRAME_VERSION
+ *   9       u8       frame_type     SpectrumFrameType
+ *   10      u16      header_bytes   sizeof(SpectrumFrameHeader)
+ *   12      u32      flags          SPECTRUM_FLAG_*
+ *   16      f64      timestamp      seconds (hardware time or Unix time)
+ *   24      f64      center_freq    Hz
+ *   32      f64      sample_rate    Hz
+ *   40      u32      fft_size       number of bins in the payload
+ *   44      u32      peak_bin
+ *   48      f32      peak_power
+ *   52      f32      payload_scale  int16 payloads: value = raw * scale
+ *   56      u32      sequence       frame counter, wraps
+ *   60      u32      fft_count      FFTs reduced into this frame (0 = unknown)
+ *   64      u32      config_gen     bumped on every live control command (v2+)
+ *   68      u32      reserved
+ *
+ * Version 1 headers were 64 bytes (no config_gen); readers must honour
+ * header_bytes rather than assume a size.
+ *
+ * Non-spectrum records (status, errors) are sent as FRAME_TYPE_RECORD with
+ * the usual JSON object as UTF-8 payload, so binary mode stays a single
+ * self-delimiting stream.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "spectrum_frame.hpp writes native structs and requires a little-endian target"
+#endif
+
+constexpr uint32_t SPECTRUM_FRAME_MAGIC = 0x52465053;  // "SPFR" on the wire
+constexpr uint8_t SPECTRUM_FRAME_VERSION = 2;
+
+enum SpectrumFrameType : uint8_t {
+    FRAME_TYPE_SPECTRUM = 1,
+    FRAME_TYPE_RECORD = 2,
+};
+
+// Header flags
+constexpr uint32_t SPECTRUM_FLAG_INT16 = 1u << 0;    // Payload is int16 (else float32)
+constexpr uint32_t SPECTRUM_FLAG_LINEAR = 1u << 1;   // Bins are linear magnitude (else dB)
+constexpr uint32_t SPECTRUM_FLAG_PANORAMA = 1u << 2; // Stitched scan: center_freq/sample_rate span the whole grid
+constexpr uint32_t SPECTRUM_FLAG_AVERAGE = 1u << 3;  // iq_analyze: mean over the whole analysed range
+constexpr uint32_t SPECTRUM_FLAG_MAX_HOLD = 1u << 4; // Per-bin maximum instead of a mean
+
+#pragma pack(push, 1)
+struct SpectrumFrameHeader {
+    uint32_t magic;
+    uint32_t frame_bytes;
+    uint8_t version;
+    uint8_t frame_type;
+    uint16_t header_bytes;
+    uint32_t flags;
+    double timestamp;
+    double center_freq;
+    double sample_rate;
+    uint32_t fft_size;
+    uint32_t peak_bin;
+    float peak_power;
+    float payload_scale;
+    uint32_t sequence;
+    uint32_t fft_count;
+    uint32_t config_gen;
+    uint32_t reserved;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(SpectrumFrameHeader) == 72, "SpectrumFrameHeader must be 72 bytes");
+
+enum class OutputFormat { Json, Binary };
+enum class BinPayload { Float32, Int16 };
+
+inline bool parse_output_format(const std::string& name, OutputFormat& format) {
+    if (name == "json") { format = OutputFormat::Json; return true; }
+    if (name == "binary") { format = OutputFormat::Binary; return true; }
+    return false;
+}
+
+inline bool parse_bin_payload(const std::string& name, BinPayload& payload) {
+    if (name == "float32") { payload = BinPayload::Float32; return true; }
+    if (name == "int16") { payload = BinPayload::Int16; return true; }
+    return false;
+}
+
+// Per-frame metadata, everything in the header except the framing fields
+struct SpectrumFrameInfo {
+    double timestamp = 0.0;
+    double center_freq = 0.0;
+    double sample_rate = 0.0;
+    uint32_t peak_bin = 0;
+    float peak_power = 0.0f;
+    uint32_t flags = 0;
+    uint32_t fft_count = 0;
+    uint32_t config_gen = 0;
+};
+
+class BinaryFrameWriter {
+public:
+    // `int16_scale` is the value of one int16 LSB: 0.01 gives centi-dB for
+    // dB spectra, 1/32767 gives full-scale for linear magnitudes.
+    BinaryFrameWriter(std::ostream& out, BinPayload payload, float int16_scale)
+        : out_(out), payload_(payload), int16_scale_(int16_scale) {}
+
+    void write_spectrum(const SpectrumFrameInfo& info, const float* bins, size_t num_bins) {
+        encode_spectrum(info, bins, num_bins);
+        write_frame();
+    }
+
+    // write_spectrum() in two steps, for callers that time them separately:
+    // build the frame in the writer's buffer, then write and flush it
+    void encode_spectrum(const SpectrumFrameInfo& info, const float* bins, size_t num_bins) {
+        const bool as_int16 = payload_ == BinPayload::Int16;
+        const size_t payload_bytes = num_bins * (as_int16 ? sizeof(int16_t) : sizeof(float));
+
+        SpectrumFrameHeader* header = begin_frame(FRAME_TYPE_SPECTRUM, payload_bytes);
+        header->flags = info.flags | (as_int16 ? SPECTRUM_FLAG_INT16 : 0u);
+        header->timestamp = info.timestamp;
+        header->center_freq = info.center_freq;
+        header->sample_rate = info.sample_rate;
+        header->fft_size = static_cast<uint32_t>(num_bins);
+        header->peak_bin = info.peak_bin;
+        header->peak_power = info.peak_power;
+        header->payload_scale = as_int16 ? int16_scale_ : 1.0f;
+        header->fft_count = info.fft_count;
+        header->config_gen = info.config_gen;
+
+        uint8_t* payload = buffer_.data() + sizeof(SpectrumFrameHeader);
+        if (as_int16) {
+            const float inv_scale = 1.0f / int16_scale_;
+            int16_t* out = reinterpret_cast<int16_t*>(payload);
+            for (size_t i = 0; i < num_bins; i++) {
+                float v = std::nearbyint(bins[i] * inv_scale);
+                out[i] = static_cast<int16_t>(std::min(32767.0f, std::max(-32768.0f, v)));
+            }
+        } else {
+            std::memcpy(payload, bins, payload_bytes);
+        }
+    }
+
+    void write_frame() {
+        out_.write(reinterpret_cast<const char*>(buffer_.data()), frame_bytes_);
+        out_.flush();
+    }
+
+    void write_record(const std::string& json) {
+        begin_frame(FRAME_TYPE_RECORD, json.size());
+        std::memcpy(buffer_.data() + sizeof(SpectrumFrameHeader), json.data(), json.size());
+        write_frame();
+    }
+
+private:
+    SpectrumFrameHeader* begin_frame(uint8_t frame_type, size_t payload_bytes) {
+        // Buffer only grows, so steady-state frames never allocate
+        const size_t frame_bytes = sizeof(SpectrumFrameHeader) + payload_bytes;
+        if (buffer_.size() < frame_bytes) buffer_.resize(frame_bytes);
+        frame_bytes_ = frame_bytes;
+
+        SpectrumFrameHeader* header = reinterpret_cast<SpectrumFrameHeader*>(buffer_.data());
+        std::memset(header, 0, sizeof(SpectrumFrameHeader));
+        header->magic = SPECTRUM_FRAME_MAGIC;
+        header->frame_bytes = static_cast<uint32_t>(frame_bytes);
+        header->version = SPECTRUM_FRAME_VERSION;
+        header->frame_type = frame_type;
+        header->header_bytes = sizeof(SpectrumFrameHeader);
+        header->sequence = sequence_++;
+        return header;
+    }
+
+    std::ostream& out_;
+    BinPayload payload_;
+    float int16_scale_;
+    std::vector<uint8_t> buffer_;
+    size_t frame_bytes_ = 0;
+    uint32_t sequence_ = 0;
+};
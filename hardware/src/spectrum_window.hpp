@@ -0,0 +1,51 @@
+/**
+ * spectrum_window.hpp - The Hann windows and power scalings of the spectrum paths
+ *
+ * Two conventions are in use, and levels only compare within one:
+ *
+ *   Streamer  sdr_streamer (streamer_pipeline.hpp) and iq_analyze, so
+ *             offline rows line up with live ones: symmetric Hann
+ *             (2*pi*i/(N-1)), power scaled by 1/N^2. A bin-centred tone
+ *             reads the window's coherent gain squared below its power,
+ *             about -6 dB.
+ *   Scanner   the scanners (spectral_engine.hpp): periodic Hann
+ *             (2*pi*i/N), power scaled by 1/sum(w)^2, so a bin-centred
+ *             tone reads its true power.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+enum class SpectrumWindow { Streamer, Scanner };
+
+inline std::vector<float> hann_window(size_t n, SpectrumWindow kind) {
+    const double period = kind == SpectrumWindow::Streamer ? n - 1.0 : static_cast<double>(n);
+    std::vector<float> window(n);
+    for (size_t i = 0; i < n; i++) {
+        window[i] = static_cast<float>(0.5 * (1.0 - std::cos(2.0 * M_PI * i / period)));
+    }
+    return window;
+}
+
+// Factor applied to |X|^2 of a transform windowed by `window`
+inline float spectrum_power_scale(const std::vector<float>& window, SpectrumWindow kind) {
+    const size_t n = window.size();
+    if (kind == SpectrumWindow::Streamer) {
+        return 1.0f / (static_cast<float>(n) * n);
+    }
+    double window_sum = 0.0;
+    for (float w : window) window_sum += w;
+    return static_cast<float>(1.0 / (window_sum * window_sum));
+}
+
+// Summed scaled bin powers over a band divided by this give the band's
+// power: the window's equivalent noise bandwidth in bins (1.5 for Hann)
+// under Scanner scaling
+inline double spectrum_band_divisor(const std::vector<float>& window, float power_scale) {
+    double window_energy = 0.0;
+    for (float w : window) window_energy += static_cast<double>(w) * w;
+    return window.size() * static_cast<double>(power_scale) * window_energy;
+}
@@ -0,0 +1,111 @@
+/**
+ * spsc_ring.hpp - Lock-free single-producer/single-consumer block ring
+ *
+ * Fixed-capacity ring of preallocated blocks shared between exactly one
+ * producer thread (typically the hardware receive loop) and one consumer
+ * thread (DSP/output). Neither side ever allocates or blocks: the producer
+ * asks for a free slot, fills it in place and commits it; the consumer
+ * peeks the oldest filled slot, processes it in place and releases it.
+ *
+ * When the ring is full the producer is expected to keep draining the
+ * hardware into a scratch buffer and call mark_dropped(), so a slow
+ * consumer costs blocks instead of causing device overflows.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+template <typename Block>
+class SpscRing {
+public:
+    // Capacity is rounded up to the next power of two so that slot indices
+    // can be computed with a mask. Every slot is copy-constructed from
+    // `prototype` up front, which is where block storage gets allocated.
+    SpscRing(size_t capacity, const Block& prototype)
+        : slots_(round_up_pow2(capacity), prototype),
+          mask_(slots_.size() - 1) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer: returns the next free slot, or nullptr if the ring is full.
+    Block* acquire_write() {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        if (head - tail >= slots_.size()) {
+            return nullptr;
+        }
+        return &slots_[head & mask_];
+    }
+
+    // Producer: publishes the slot returned by acquire_write().
+    void commit_write() {
+        const size_t head = head_.load(std::memory_order_relaxed) + 1;
+        head_.store(head, std::memory_order_release);
+
+        const size_t depth = head - tail_.load(std::memory_order_relaxed);
+        if (depth > high_water_.load(std::memory_order_relaxed)) {
+            high_water_.store(depth, std::memory_order_relaxed);
+        }
+    }
+
+    // Producer: records a block that was received but could not be queued.
+    void mark_dropped() {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Consumer: returns the oldest filled slot, or nullptr if the ring is empty.
+    Block* acquire_read() {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        if (tail == head) {
+            return nullptr;
+        }
+        return &slots_[tail & mask_];
+    }
+
+    // Consumer: the filled slot `ahead` places behind the oldest one
+    // (0 = acquire_read()), or nullptr if fewer slots are filled. Lets a
+    // consumer keep several slots in flight; they are still released in order.
+    Block* peek_read(size_t ahead) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        if (head - tail <= ahead) {
+            return nullptr;
+        }
+        return &slots_[(tail + ahead) & mask_];
+    }
+
+    // Consumer: hands the slot returned by acquire_read() back to the producer.
+    void release_read() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Statistics (safe to read from any thread, values are approximate)
+    size_t capacity() const { return slots_.size(); }
+    size_t depth() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+    size_t high_water() const { return high_water_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    std::vector<Block> slots_;
+    const size_t mask_;
+
+    // Producer- and consumer-owned indices live on separate cache lines
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<size_t> high_water_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
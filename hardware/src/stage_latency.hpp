@@ -0,0 +1,121 @@
+/**
+ * stage_latency.hpp - Per-stage timings of the spectrum streamers
+ *
+ * The streamers stamp steady_clock at the edges of each stage of a frame's
+ * life and record the intervals here:
+ *
+ *   queue      recv() returned -> DSP thread picks the block up (sdr_streamer)
+ *   window     Hann window into the FFT input              (per FFT)
+ *   fft        fftwf_execute                               (per FFT)
+ *   power      FFT shift, |X|^2, accumulation              (per FFT)
+ *   reduce     average, dB or magnitude, peak              (per frame)
+ *   serialize  JSON text / binary frame into the stdout stream (per frame)
+ *   write      flush to the pipe until it returns          (per frame)
+ *   frame      recv() of the block that completed the frame -> written
+ *
+ * window to write are work on the DSP thread and add up to its busy time;
+ * queue and frame are latencies spanning threads. Antenna to recv() is the
+ * device's buffering and not seen here: it is the gap between a frame's
+ * hardware timestamp and the device clock.
+ *
+ * Each stage keeps a running total and a LatencyHistogram; perf_record()
+ * turns an interval's worth into a {"type":"perf"} record (in binary
+ * output, a record frame) and the owner resets them. Recording is a
+ * few ns on top of one clock read per stage edge, so it stays on.
+ *
+ * Single-threaded, like LatencyHistogram: intervals measured elsewhere
+ * (queue) are handed to the thread that owns the StageTimes.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "latency_histogram.hpp"
+
+enum PipelineStage : size_t {
+    STAGE_WINDOW,
+    STAGE_FFT,
+    STAGE_POWER,
+    STAGE_REDUCE,
+    STAGE_SERIALIZE,
+    STAGE_WRITE,
+    STAGE_QUEUE,
+    STAGE_FRAME,
+    STAGE_COUNT
+};
+
+// Stages before this one are DSP-thread work and add up
+constexpr size_t STAGE_WORK_END = STAGE_WRITE + 1;
+
+inline const char* pipeline_stage_name(size_t stage) {
+    static const char* const names[STAGE_COUNT] = {
+        "window", "fft", "power", "reduce", "serialize", "write", "queue", "frame"};
+    return stage < STAGE_COUNT ? names[stage] : "unknown";
+}
+
+class StageTimes {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void record(size_t stage, uint64_t ns) {
+        ns_[stage] += ns;
+        histograms_[stage].record(ns);
+    }
+
+    void record(size_t stage, Clock::time_point from, Clock::time_point to) {
+        record(stage, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count()));
+    }
+
+    uint64_t total_ns(size_t stage) const { return ns_[stage]; }
+    const LatencyHistogram& histogram(size_t stage) const { return histograms_[stage]; }
+
+    void reset() {
+        for (size_t s = 0; s < STAGE_COUNT; s++) {
+            ns_[s] = 0;
+            histograms_[s].reset();
+        }
+    }
+
+    // {"type":"perf"} for the `seconds` since the last reset: per stage the
+    // count and mean/percentiles/max in microseconds, plus the DSP thread's
+    // busy fraction. Stages nothing was recorded for are left out.
+    std::string perf_record(double seconds) const {
+        uint64_t work_ns = 0;
+        for (size_t s = 0; s < STAGE_WORK_END; s++) work_ns += ns_[s];
+
+        std::ostringstream out;
+        out << "{\"type\":\"perf\",\"seconds\":" << seconds
+            << ",\"dspLoad\":" << (seconds > 0.0 ? work_ns / (seconds * 1e9) : 0.0)
+            << ",\"stagesUs\":{";
+        bool first = true;
+        for (size_t s = 0; s < STAGE_COUNT; s++) {
+            const LatencyHistogram& h = histograms_[s];
+            if (h.count() == 0) continue;
+            if (!first) out << ",";
+            first = false;
+            out << "\"" << pipeline_stage_name(s) << "\":{\"count\":" << h.count()
+                << ",\"mean\":" << h.mean() / 1e3
+                << ",\"p50\":" << h.percentile(50) / 1e3
+                << ",\"p90\":" << h.percentile(90) / 1e3
+                << ",\"p99\":" << h.percentile(99) / 1e3
+                << ",\"p999\":" << h.percentile(99.9) / 1e3
+                << ",\"max\":" << h.max() / 1e3 << "}";
+        }
+        out << "}}";
+        return out.str();
+    }
+
+private:
+    uint64_t ns_[STAGE_COUNT] = {};
+    LatencyHistogram histograms_[STAGE_COUNT];
+};
+
+// Clock read only when timing is on, so untimed paths cost a branch
+inline StageTimes::Clock::time_point stage_clock(const StageTimes* times) {
+    return times ? StageTimes::Clock::now() : StageTimes::Clock::time_point();
+}
@@ -0,0 +1,255 @@
+/**
+ * streamer_pipeline.hpp - sdr_streamer's spectrum path, from samples to output
+ *
+ * Received blocks are appended to an overlap history; every fft_size
+ * window at the configured hop is Hann-windowed, transformed, turned into
+ * an FFT-shifted linear power spectrum and folded into a SpectrumAccumulator.
+ * Once at least avg_count FFTs and samples_per_frame samples have gone in,
+ * the frame is reduced (one log10 pass, peak search) and handed to the
+ * caller's emit function, which serialises it (write_streamer_json() or
+ * encode_streamer_binary()) and writes it out.
+ *
+ * Kept out of sdr_streamer.cpp so bench_pipeline drives exactly the code
+ * the daemon runs. Given a StageTimes (stage_latency.hpp), run() records
+ * the window, FFT, power and reduce stages; serialising and writing are
+ * the caller's to time. Without one it never reads the clock.
+ */
+
+#pragma once
+
+#include <fftw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "dsp_kernels.hpp"
+#include "spectrum_accumulator.hpp"
+#include "spectrum_frame.hpp"
+#include "spectrum_window.hpp"
+#include "stage_latency.hpp"
+
+// One output frame, valid during the emit call
+struct StreamerFrame {
+    const float* power_db;
+    size_t bins;
+    size_t peak_bin;
+    float peak_power;
+    size_t fft_count;
+    double timestamp;       // Time of the frame's first sample
+};
+
+struct StreamerPipelineConfig {
+    double rate = 0.0;
+    double overlap_pct = 0.0;       // 0-95
+    size_t avg_count = 1;           // Minimum FFTs per frame
+    double frame_rate = 0.0;        // Max frames per second of samples, 0 = unlimited
+    size_t max_block = 0;           // Largest block passed to process()
+    unsigned plan_flags = FFTW_MEASURE;
+};
+
+class StreamerPipeline {
+public:
+    explicit StreamerPipeline(const StreamerPipelineConfig& config)
+        : config_(config),
+          kernels_(dsp::kernels()),
+          samples_per_frame_(config.frame_rate > 0.0 ? static_cast<size_t>(config.rate / config.frame_rate) : 0) {}
+
+    StreamerPipeline(const StreamerPipeline&) = delete;
+    StreamerPipeline& operator=(const StreamerPipeline&) = delete;
+
+    ~StreamerPipeline() { release(); }
+
+    // (Re)plans for `fft_size` and resets the spectrum. FFTW's planner is
+    // not thread-safe: call this from one thread at a time. Returns the
+    // time spent planning in ms.
+    double configure(size_t fft_size) {
+        release();
+        fft_size_ = fft_size;
+        fft_in_ = fftwf_alloc_complex(fft_size);
+        fft_out_ = fftwf_alloc_complex(fft_size);
+        const auto plan_start = std::chrono::steady_clock::now();
+        plan_ = fftwf_plan_dft_1d(static_cast<int>(fft_size), fft_in_, fft_out_, FFTW_FORWARD, config_.plan_flags);
+        const double plan_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - plan_start).count();
+
+        window_ = hann_window(fft_size, SpectrumWindow::Streamer);
+        power_lin_.assign(fft_size, 0.0f);
+        power_db_.assign(fft_size, 0.0f);
+        power_scale_ = spectrum_power_scale(window_, SpectrumWindow::Streamer);
+
+        hop_ = std::max<size_t>(1, std::lround(fft_size * (1.0 - config_.overlap_pct / 100.0)));
+        history_.resize(fft_size + config_.max_block);
+        accumulator_.resize(fft_size);
+        reset();
+        return plan_ms;
+    }
+
+    size_t fft_size() const { return fft_size_; }
+    size_t hop() const { return hop_; }
+
+    // New configuration: drop the history and the partial frame
+    void reset() {
+        history_len_ = 0;
+        accumulator_.reset();
+        samples_since_frame_ = 0;
+    }
+
+    // Discontinuity (dropped blocks): restart the overlap window so that
+    // no FFT straddles the gap; the partial frame is kept
+    void restart_overlap() { history_len_ = 0; }
+
+    void set_stage_times(StageTimes* times) { times_ = times; }
+
+    // append() then run(): the daemon hands its ring slot back in between
+    template <typename Emit>
+    void process(const std::complex<float>* samples, size_t count, double timestamp, Emit&& emit) {
+        append(samples, count, timestamp);
+        run(emit);
+    }
+
+    // Copies in `count` samples (at most max_block) taken at `timestamp`
+    void append(const std::complex<float>* samples, size_t count, double timestamp) {
+        if (history_len_ == 0) {
+            history_time_ = timestamp;
+        }
+        std::copy(samples, samples + count, history_.begin() + history_len_);
+        history_len_ += count;
+    }
+
+    // Runs every complete window, calling emit(const StreamerFrame&) for
+    // each finished frame
+    template <typename Emit>
+    void run(Emit&& emit) {
+        // Overlapped FFTs over every available window
+        size_t pos = 0;
+        while (history_len_ - pos >= fft_size_) {
+            if (accumulator_.count() == 0) {
+                frame_time_ = history_time_ + pos / config_.rate;
+            }
+            StageTimes::Clock::time_point t0 = stage_clock(times_);
+
+            // Apply window and copy to FFT input
+            kernels_.apply_window(reinterpret_cast<const float*>(history_.data() + pos),
+                                  window_.data(), reinterpret_cast<float*>(fft_in_), fft_size_);
+            StageTimes::Clock::time_point t1 = stage_clock(times_);
+
+            // Compute FFT
+            fftwf_execute(plan_);
+            StageTimes::Clock::time_point t2 = stage_clock(times_);
+
+            // Linear power spectrum with FFT shift
+            dsp::shifted_power(kernels_, reinterpret_cast<const float*>(fft_out_), power_lin_.data(),
+                               fft_size_, power_scale_);
+            accumulator_.add(power_lin_.data());
+            if (times_) {
+                const StageTimes::Clock::time_point t3 = StageTimes::Clock::now();
+                times_->record(STAGE_WINDOW, t0, t1);
+                times_->record(STAGE_FFT, t1, t2);
+                times_->record(STAGE_POWER, t2, t3);
+            }
+
+            pos += hop_;
+            samples_since_frame_ += hop_;
+
+            if (accumulator_.count() >= config_.avg_count && samples_since_frame_ >= samples_per_frame_) {
+                emit_frame(emit);
+            }
+        }
+
+        // Carry the unconsumed tail over to the next block
+        std::copy(history_.begin() + pos, history_.begin() + history_len_, history_.begin());
+        history_len_ -= pos;
+        history_time_ += pos / config_.rate;
+    }
+
+private:
+    // Single log10 pass over the averaged linear spectrum, then output
+    template <typename Emit>
+    void emit_frame(Emit& emit) {
+        const StageTimes::Clock::time_point t0 = stage_clock(times_);
+        StreamerFrame frame;
+        frame.fft_count = accumulator_.count();
+        accumulator_.result(power_lin_.data());
+        accumulator_.reset();
+        samples_since_frame_ = 0;
+
+        kernels_.power_to_db(power_lin_.data(), power_db_.data(), fft_size_, 0.0f);
+        frame.power_db = power_db_.data();
+        frame.bins = fft_size_;
+        frame.peak_bin = kernels_.argmax(power_db_.data(), fft_size_);
+        frame.peak_power = power_db_[frame.peak_bin];
+        frame.timestamp = frame_time_;
+        if (times_) times_->record(STAGE_REDUCE, t0, StageTimes::Clock::now());
+
+        emit(static_cast<const StreamerFrame&>(frame));
+    }
+
+    void release() {
+        if (!plan_) return;
+        fftwf_destroy_plan(plan_);
+        fftwf_free(fft_in_);
+        fftwf_free(fft_out_);
+        plan_ = nullptr;
+    }
+
+    StreamerPipelineConfig config_;
+    const dsp::Kernels& kernels_;
+    const size_t samples_per_frame_;
+    StageTimes* times_ = nullptr;
+
+    size_t fft_size_ = 0;
+    size_t hop_ = 1;
+    fftwf_complex* fft_in_ = nullptr;
+    fftwf_complex* fft_out_ = nullptr;
+    fftwf_plan plan_ = nullptr;
+    std::vector<float> window_, power_lin_, power_db_;
+    float power_scale_ = 1.0f;
+
+    // Welch state: samples carried between blocks and the running average
+    std::vector<std::complex<float>> history_;
+    size_t history_len_ = 0;
+    double history_time_ = 0.0;     // Time of history_[0]
+    SpectrumAccumulator accumulator_;
+    size_t samples_since_frame_ = 0;
+    double frame_time_ = 0.0;
+};
+
+// sdr_streamer's {"type":"fft"} line; the caller flushes
+inline void write_streamer_json(std::ostream& out, const StreamerFrame& frame, double center_freq, double rate,
+                                uint32_t config_gen) {
+    out << "{\"type\":\"fft\",\"timestamp\":" << frame.timestamp
+        << ",\"centerFreq\":" << center_freq
+        << ",\"sampleRate\":" << rate
+        << ",\"fftSize\":" << frame.bins
+        << ",\"peakPower\":" << frame.peak_power
+        << ",\"peakBin\":" << frame.peak_bin
+        << ",\"fftCount\":" << frame.fft_count
+        << ",\"configGen\":" << config_gen
+        << ",\"data\":[";
+
+    for (size_t i = 0; i < frame.bins; i++) {
+        out << frame.power_db[i];
+        if (i < frame.bins - 1) out << ",";
+    }
+    out << "]}\n";
+}
+
+// The same frame as a binary spectrum frame (dB bins); writer.write_frame()
+// sends it
+inline void encode_streamer_binary(BinaryFrameWriter& writer, const StreamerFrame& frame, double center_freq,
+                                   double rate, uint32_t config_gen) {
+    SpectrumFrameInfo info;
+    info.timestamp = frame.timestamp;
+    info.center_freq = center_freq;
+    info.sample_rate = rate;
+    info.peak_bin = static_cast<uint32_t>(frame.peak_bin);
+    info.peak_power = frame.peak_power;
+    info.fft_count = static_cast<uint32_t>(frame.fft_count);
+    info.config_gen = config_gen;
+    writer.encode_spectrum(info, frame.power_db, frame.bins);
+}
@@ -0,0 +1,159 @@
+/**
+ * synthetic_source.hpp - Generated IQ for benchmarks, at the cost of a memcpy
+ *
+ * A signal is a '+'-separated list of components (levels in dBFS, where
+ * full scale is amplitude 1.0):
+ *
+ *   tone:OFFSET_HZ:DBFS                     CW carrier
+ *   noise:DBFS                              complex Gaussian noise (total power)
+ *   burst:OFFSET_HZ:DBFS:ON_MS:PERIOD_MS    carrier keyed on for ON_MS every PERIOD_MS
+ *   fm:OFFSET_HZ:DBFS:DEV_HZ:MOD_HZ         carrier FM-modulated by a sine
+ *
+ * e.g. "tone:1e5:-20+burst:-2e6:-30:5:50+fm:3e6:-25:75e3:1e3+noise:-60".
+ *
+ * The sum is computed once into a table (2^20 samples by default) that
+ * read() then plays in a loop, so producing samples costs no more than
+ * the copy and never perturbs what is being measured. Frequencies and
+ * burst periods are snapped to whole cycles per table so the loop has no
+ * seam; with a 1M-sample table at 10 Msps that is a 9.5 Hz grid.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+struct SyntheticComponent {
+    enum Kind { Tone, Noise, Burst, Fm };
+    Kind kind = Tone;
+    double offset_hz = 0.0;
+    double dbfs = 0.0;
+    double on_ms = 0.0;         // Burst
+    double period_ms = 0.0;     // Burst
+    double dev_hz = 0.0;        // FM
+    double mod_hz = 0.0;        // FM
+};
+
+// "tone:...+noise:..." -> components. Returns an error, empty on success.
+inline std::string parse_synthetic_spec(const std::string& spec, std::vector<SyntheticComponent>& components) {
+    components.clear();
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t end = spec.find('+', pos);
+        if (end == std::string::npos) end = spec.size();
+        const std::string item = spec.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.empty()) continue;
+
+        std::vector<double> values;
+        size_t field = item.find(':');
+        const std::string kind = item.substr(0, field);
+        while (field != std::string::npos) {
+            const size_t next = item.find(':', field + 1);
+            const std::string text = item.substr(field + 1, next == std::string::npos ? std::string::npos
+                                                                                      : next - field - 1);
+            char* rest = nullptr;
+            const double value = std::strtod(text.c_str(), &rest);
+            if (text.empty() || *rest != '\0') return "bad number '" + text + "' in '" + item + "'";
+            values.push_back(value);
+            field = next;
+        }
+
+        SyntheticComponent c;
+        if (kind == "tone" && values.size() == 2) {
+            c.kind = SyntheticComponent::Tone;
+            c.offset_hz = values[0];
+            c.dbfs = values[1];
+        } else if (kind == "noise" && values.size() == 1) {
+            c.kind = SyntheticComponent::Noise;
+            c.dbfs = values[0];
+        } else if (kind == "burst" && values.size() == 4) {
+            c.kind = SyntheticComponent::Burst;
+            c.offset_hz = values[0];
+            c.dbfs = values[1];
+            c.on_ms = values[2];
+            c.period_ms = values[3];
+            if (c.period_ms <= 0.0 || c.on_ms < 0.0) return "burst needs 0 <= ON_MS and PERIOD_MS > 0";
+        } else if (kind == "fm" && values.size() == 4) {
+            c.kind = SyntheticComponent::Fm;
+            c.offset_hz = values[0];
+            c.dbfs = values[1];
+            c.dev_hz = values[2];
+            c.mod_hz = values[3];
+        } else {
+            return "bad signal component '" + item + "' (tone:OFFSET:DBFS, noise:DBFS, "
+                   "burst:OFFSET:DBFS:ON_MS:PERIOD_MS, fm:OFFSET:DBFS:DEV:MOD)";
+        }
+        components.push_back(c);
+    }
+    if (components.empty()) return "empty signal";
+    return "";
+}
+
+class SyntheticSource {
+public:
+    SyntheticSource(const std::vector<SyntheticComponent>& components, double rate,
+                    size_t table_len = size_t(1) << 20, uint32_t seed = 1)
+        : table_(table_len) {
+        const double n = static_cast<double>(table_len);
+        // Whole cycles per table: offsets may be negative, rates at least one cycle
+        auto cycles = [&](double hz) { return std::round(hz * n / rate); };
+        std::mt19937 rng(seed);
+
+        for (const SyntheticComponent& c : components) {
+            const double amplitude = std::pow(10.0, c.dbfs / 20.0);
+            const double carrier = cycles(c.offset_hz);
+            if (c.kind == SyntheticComponent::Noise) {
+                std::normal_distribution<float> gauss(0.0f, static_cast<float>(amplitude / std::sqrt(2.0)));
+                for (auto& s : table_) s += std::complex<float>(gauss(rng), gauss(rng));
+                continue;
+            }
+
+            size_t period = table_len, on = table_len;
+            double mod = 0.0, index = 0.0;
+            if (c.kind == SyntheticComponent::Burst) {
+                const double bursts = std::max(1.0, std::round(n / (c.period_ms * 1e-3 * rate)));
+                period = static_cast<size_t>(n / bursts);
+                on = std::min(period, static_cast<size_t>(c.on_ms * 1e-3 * rate));
+            } else if (c.kind == SyntheticComponent::Fm && c.mod_hz > 0.0) {
+                mod = std::max(1.0, cycles(c.mod_hz));
+                index = c.dev_hz / (mod * rate / n);
+            }
+
+            for (size_t i = 0; i < table_len; i++) {
+                if (i % period >= on) continue;
+                const double t = i / n;     // Fraction of the table, exact cycles per loop
+                const double phase = 2.0 * M_PI * carrier * t + index * std::sin(2.0 * M_PI * mod * t);
+                table_[i] += std::complex<float>(static_cast<float>(amplitude * std::cos(phase)),
+                                                 static_cast<float>(amplitude * std::sin(phase)));
+            }
+        }
+    }
+
+    // Next `count` samples of the looped table
+    void read(std::complex<float>* out, size_t count) {
+        size_t done = 0;
+        while (done < count) {
+            const size_t n = std::min(count - done, table_.size() - offset_);
+            std::memcpy(out + done, table_.data() + offset_, n * sizeof(std::complex<float>));
+            done += n;
+            offset_ = (offset_ + n) % table_.size();
+        }
+        position_ += count;
+    }
+
+    // Samples produced so far
+    uint64_t position() const { return position_; }
+
+private:
+    std::vector<std::complex<float>> table_;
+    size_t offset_ = 0;
+    uint64_t position_ = 0;
+};
@@ -1,6 +1,7 @@
 import { EventEmitter } from "events";
 import { spawn, ChildProcess } from "child_process";
 import path from "path";
+import { SpectrumFrameDecoder, type DecodedFrame } from "./spectrum-frame";
 
 export interface HardwareConfig {
   frequency: number;
@@ -46,6 +47,18 @@ export class ProductionHardwareManager extends EventEmitter {
   private sdrProcess: ChildProcess | null = null;
   private isStreaming = false;
 
+  // SDR_OUTPUT_FORMAT=binary switches sdr_streamer to framed binary output;
+  // JSON stays the default so both can be compared on the same hardware.
+  private readonly outputFormat: "json" | "binary" =
+    process.env.SDR_OUTPUT_FORMAT === "binary" ? "binary" : "json";
+  private frameDecoder = new SpectrumFrameDecoder();
+  private lineBuffer = "";
+
+  // Number of live control commands sent to the current sdr_streamer.
+  // The daemon bumps its config generation once per command, so frames
+  // stamped with an older generation predate the latest change.
+  private configGeneration = 0;
+
   constructor() {
     super();
     console.log("[ProductionHW] Initialized for B210 hardware");
@@ -87,14 +100,25 @@ export class ProductionHardwareManager extends EventEmitter {
       gain: this.config.gain
     });
 
+    this.frameDecoder = new SpectrumFrameDecoder();
+    this.lineBuffer = "";
+    this.configGeneration = 0;
+
     this.sdrProcess = spawn(binPath, [
       "--freq", this.config.frequency.toString(),
       "--rate", this.config.sampleRate.toString(),
       "--gain", this.config.gain.toString(),
+      "--output-format", this.outputFormat,
     ]);
 
     this.sdrProcess.stdout?.on("data", (data: Buffer) => {
-      this.parseSDROutput(data.toString());
+      if (this.outputFormat === "binary") {
+        for (const frame of this.frameDecoder.push(data)) {
+          this.handleBinaryFrame(frame);
+        }
+      } else {
+        this.parseSDROutput(data.toString());
+      }
     });
 
     this.sdrProcess.stderr?.on("data", (data: Buffer) => {
@@ -117,8 +141,51 @@ export class ProductionHardwareManager extends EventEmitter {
     this.isStreaming = true;
   }
 
+  private handleBinaryFrame(frame: DecodedFrame): void {
+    if (frame.kind === "record") {
+      this.handleStatusRecord(frame.record as Record<string, unknown>);
+      return;
+    }
+
+    if (frame.configGen < this.configGeneration) return; // Stale, pre-retune
+
+    const fftData: FFTData = {
+      timestamp: frame.timestamp,
+      centerFreq: frame.centerFreq,
+      sampleRate: frame.sampleRate,
+      fftSize: frame.fftSize,
+      fftData: Array.from(frame.bins),
+    };
+    this.emit("fft", fftData);
+  }
+
+  private handleStatusRecord(data: Record<string, any>): void {
+    if (data.type === "config") {
+      if (!data.ok) {
+        console.warn(`[ProductionHW] sdr_streamer rejected "${data.command}": ${data.error}`);
+      }
+      return;
+    }
+    if (data.type !== "status") return;
+
+    // Update hardware status from sdr_streamer
+    const temperature = data.rxTemp ?? data.temperature;
+    if (temperature !== undefined) {
+      this.status.temperature = temperature;
+    }
+    const gpsLock = data.gpsLocked ?? data.gps_lock;
+    if (gpsLock !== undefined) {
+      this.status.gpsLock = gpsLock;
+    }
+    if (data.pll_lock !== undefined) {
+      this.status.pllLock = data.pll_lock;
+    }
+  }
+
   private parseSDROutput(output: string): void {
-    const lines = output.split("\n");
+    // stdout chunks can split a line; keep the trailing fragment for next time
+    const lines = (this.lineBuffer + output).split("\n");
+    this.lineBuffer = lines.pop() ?? "";
     
     for (const line of lines) {
       if (!line.trim()) continue;
@@ -127,26 +194,19 @@ export class ProductionHardwareManager extends EventEmitter {
         const data = JSON.parse(line);
         
         if (data.type === "fft") {
+          if ((data.configGen ?? 0) < this.configGeneration) continue; // Stale, pre-retune
+
           // Emit FFT data event for WebSocket broadcasting
           const fftData: FFTData = {
             timestamp: data.timestamp || Date.now(),
-            centerFreq: data.center_freq || this.config.frequency,
-            sampleRate: data.sample_rate || this.config.sampleRate,
-            fftSize: data.fft_size || 2048,
-            fftData: data.fft_data || []
+            centerFreq: data.centerFreq || this.config.frequency,
+            sampleRate: data.sampleRate || this.config.sampleRate,
+            fftSize: data.fftSize || 2048,
+            fftData: data.data || []
           };
           this.emit("fft", fftData);
-        } else if (data.type === "status") {
-          // Update hardware status from sdr_streamer
-          if (data.temperature !== undefined) {
-            this.status.temperature = data.temperature;
-          }
-          if (data.gps_lock !== undefined) {
-            this.status.gpsLock = data.gps_lock;
-          }
-          if (data.pll_lock !== undefined) {
-            this.status.pllLock = data.pll_lock;
-          }
+        } else if (data.type === "status" || data.type === "config") {
+          this.handleStatusRecord(data);
         }
       } catch (error) {
         // Not JSON, might be informational message
@@ -165,20 +225,30 @@ export class ProductionHardwareManager extends EventEmitter {
     return { ...this.status };
   }
 
+  /**
+   * Send a live control command (see hardware/src/control_channel.hpp).
+   * Returns false when no streamer is running to receive it.
+   */
+  private sendCommand(command: string): boolean {
+    const stdin = this.sdrProcess?.stdin;
+    if (!this.isStreaming || !stdin || !stdin.writable) return false;
+
+    stdin.write(`${command}\n`);
+    this.configGeneration++;
+    return true;
+  }
+
   async setFrequency(frequency: number): Promise<void> {
     this.config.frequency = frequency;
     
-    // Restart sdr_streamer with new frequency
-    if (this.isStreaming) {
-      await this.stop();
-      await this.start();
-    }
+    // Retune the running sdr_streamer in place
+    this.sendCommand(`freq ${frequency}`);
   }
 
   async setSampleRate(sampleRate: number): Promise<void> {
     this.config.sampleRate = sampleRate;
     
-    // Restart sdr_streamer with new sample rate
+    // Sample rate is not a live setting: restart sdr_streamer with the new rate
     if (this.isStreaming) {
       await this.stop();
       await this.start();
@@ -188,10 +258,7 @@ export class ProductionHardwareManager extends EventEmitter {
   async setGain(gain: number): Promise<void> {
     this.config.gain = gain;
     
-    // Restart sdr_streamer with new gain
-    if (this.isStreaming) {
-      await this.stop();
-      await this.start();
-    }
+    // Apply gain to the running sdr_streamer in place
+    this.sendCommand(`gain ${gain}`);
   }
 }
@@ -0,0 +1,181 @@
+import { describe, expect, it } from "vitest";
+import {
+  FRAME_TYPE_RECORD,
+  FRAME_TYPE_SPECTRUM,
+  SPECTRUM_FLAG_INT16,
+  SPECTRUM_FLAG_PANORAMA,
+  SPECTRUM_FRAME_HEADER_BYTES,
+  SPECTRUM_FRAME_MAGIC,
+  SpectrumFrameDecoder,
+  binFrequency,
+} from "./spectrum-frame";
+
+function buildFrame(
+  frameType: number,
+  payload: Buffer,
+  fields: {
+    flags?: number;
+    fftSize?: number;
+    scale?: number;
+    sequence?: number;
+    configGen?: number;
+  } = {}
+): Buffer {
+  // Version 2 headers append configGen + reserved to the 64-byte v1 header
+  const version = fields.configGen === undefined ? 1 : 2;
+  const headerBytes = version === 1 ? SPECTRUM_FRAME_HEADER_BYTES : SPECTRUM_FRAME_HEADER_BYTES + 8;
+  const header = Buffer.alloc(headerBytes);
+  header.writeUInt32LE(SPECTRUM_FRAME_MAGIC, 0);
+  header.writeUInt32LE(headerBytes + payload.length, 4);
+  header.writeUInt8(version, 8);
+  header.writeUInt8(frameType, 9);
+  header.writeUInt16LE(headerBytes, 10);
+  header.writeUInt32LE(fields.flags ?? 0, 12);
+  header.writeDoubleLE(1.5, 16);
+  header.writeDoubleLE(915e6, 24);
+  header.writeDoubleLE(10e6, 32);
+  header.writeUInt32LE(fields.fftSize ?? 0, 40);
+  header.writeUInt32LE(2, 44);
+  header.writeFloatLE(-20, 48);
+  header.writeFloatLE(fields.scale ?? 1, 52);
+  header.writeUInt32LE(fields.sequence ?? 0, 56);
+  if (version === 2) header.writeUInt32LE(fields.configGen ?? 0, 64);
+  return Buffer.concat([header, payload]);
+}
+
+function float32Payload(values: number[]): Buffer {
+  const payload = Buffer.alloc(values.length * 4);
+  values.forEach((v, i) => payload.writeFloatLE(v, i * 4));
+  return payload;
+}
+
+describe("SpectrumFrameDecoder", () => {
+  it("decodes a float32 spectrum frame", () => {
+    const decoder = new SpectrumFrameDecoder();
+    const frame = buildFrame(FRAME_TYPE_SPECTRUM, float32Payload([-100, -50.5, -20, -90]), {
+      fftSize: 4,
+      sequence: 7,
+    });
+
+    const frames = decoder.push(frame);
+
+    expect(frames).toHaveLength(1);
+    const decoded = frames[0];
+    expect(decoded.kind).toBe("spectrum");
+    if (decoded.kind !== "spectrum") return;
+    expect(decoded.centerFreq).toBe(915e6);
+    expect(decoded.sampleRate).toBe(10e6);
+    expect(decoded.fftSize).toBe(4);
+    expect(decoded.peakBin).toBe(2);
+    expect(decoded.sequence).toBe(7);
+    expect(Array.from(decoded.bins)).toEqual([-100, -50.5, -20, -90]);
+  });
+
+  it("scales int16 payloads", () => {
+    const decoder = new SpectrumFrameDecoder();
+    const payload = Buffer.alloc(4);
+    payload.writeInt16LE(-10000, 0);
+    payload.writeInt16LE(-2050, 2);
+    const frame = buildFrame(FRAME_TYPE_SPECTRUM, payload, {
+      flags: SPECTRUM_FLAG_INT16,
+      fftSize: 2,
+      scale: 0.01,
+    });
+
+    const [decoded] = decoder.push(frame);
+
+    expect(decoded.kind).toBe("spectrum");
+    if (decoded.kind !== "spectrum") return;
+    expect(decoded.bins[0]).toBeCloseTo(-100, 3);
+    expect(decoded.bins[1]).toBeCloseTo(-20.5, 3);
+  });
+
+  it("reads the config generation from version 2 headers", () => {
+    const decoder = new SpectrumFrameDecoder();
+    const frame = buildFrame(FRAME_TYPE_SPECTRUM, float32Payload([-30, -40]), {
+      fftSize: 2,
+      configGen: 5,
+    });
+
+    const [decoded] = decoder.push(frame);
+
+    expect(decoded.kind).toBe("spectrum");
+    if (decoded.kind !== "spectrum") return;
+    expect(decoded.version).toBe(2);
+    expect(decoded.configGen).toBe(5);
+    expect(Array.from(decoded.bins)).toEqual([-30, -40]);
+  });
+
+  it("maps bins to frequencies for panorama frames", () => {
+    const decoder = new SpectrumFrameDecoder();
+    // buildFrame describes a 10 MHz span centred on 915 MHz
+    const frame = buildFrame(FRAME_TYPE_SPECTRUM, float32Payload([-90, -80, -70, -60]), {
+      flags: SPECTRUM_FLAG_PANORAMA,
+      fftSize: 4,
+      configGen: 0,
+    });
+
+    const [decoded] = decoder.push(frame);
+
+    expect(decoded.kind).toBe("spectrum");
+    if (decoded.kind !== "spectrum") return;
+    expect(decoded.flags & SPECTRUM_FLAG_PANORAMA).toBeTruthy();
+    expect(binFrequency(decoded, 0)).toBe(910e6);
+    expect(binFrequency(decoded, 2)).toBe(915e6);
+    expect(binFrequency(decoded, 3)).toBe(917.5e6);
+  });
+
+  it("reassembles frames split across chunks", () => {
+    const decoder = new SpectrumFrameDecoder();
+    const frame = buildFrame(FRAME_TYPE_SPECTRUM, float32Payload([1, 2, 3]), { fftSize: 3 });
+
+    expect(decoder.push(frame.subarray(0, 10))).toHaveLength(0);
+    expect(decoder.push(frame.subarray(10, 70))).toHaveLength(0);
+    expect(decoder.push(frame.subarray(70))).toHaveLength(1);
+  });
+
+  it("decodes JSON record frames and skips leading garbage", () => {
+    const decoder = new SpectrumFrameDecoder();
+    const record = buildFrame(FRAME_TYPE_RECORD, Buffer.from('{"type":"status","frames":3}'));
+
+    const frames = decoder.push(Buffer.concat([Buffer.from("noise"), record]));
+
+    expect(frames).toHaveLength(1);
+    expect(frames[0]).toMatchObject({ kind: "record", record: { type: "status", frames: 3 } });
+  });
+
+  it("resyncs past a false magic whose fftSize does not match the payload", () => {
+    const decoder = new SpectrumFrameDecoder();
+    // Claims a million bins in a 3-bin frame; must not be read or waited on
+    const bogus = buildFrame(FRAME_TYPE_SPECTRUM, float32Payload([1, 2, 3]), { fftSize: 1 << 20 });
+    const frame = buildFrame(FRAME_TYPE_SPECTRUM, float32Payload([4, 5]), { fftSize: 2 });
+
+    const frames = decoder.push(Buffer.concat([bogus, frame]));
+
+    expect(frames).toHaveLength(1);
+    const decoded = frames[0];
+    expect(decoded.kind).toBe("spectrum");
+    if (decoded.kind !== "spectrum") return;
+    expect(Array.from(decoded.bins)).toEqual([4, 5]);
+  });
+
+  it("resyncs past a false magic claiming an oversized record frame", () => {
+    const decoder = new SpectrumFrameDecoder();
+    // A 4 GiB record header would otherwise stall the stream waiting for its body
+    const bogus = buildFrame(FRAME_TYPE_RECORD, Buffer.from("{}"));
+    bogus.writeUInt32LE(0xffffffff, 4);
+    const record = buildFrame(FRAME_TYPE_RECORD, Buffer.from('{"type":"status"}'));
+
+    const frames = decoder.push(Buffer.concat([bogus, record]));
+
+    expect(frames).toHaveLength(1);
+    expect(frames[0]).toMatchObject({ kind: "record", record: { type: "status" } });
+  });
+
+  it("rejects int16 frames whose payload is short of fftSize bins", () => {
+    const decoder = new SpectrumFrameDecoder();
+    const frame = buildFrame(FRAME_TYPE_SPECTRUM, Buffer.alloc(4), { fftSize: 3, flags: SPECTRUM_FLAG_INT16 });
+
+    expect(decoder.push(frame)).toHaveLength(0);
+  });
+});
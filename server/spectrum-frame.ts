@@ -0,0 +1,160 @@
+/**
+ * Decoder for the binary spectrum frame protocol written by the hardware
+ * daemons with `--output-format binary` (see hardware/src/spectrum_frame.hpp).
+ *
+ * Frames are a 72-byte little-endian header (64 bytes in version 1) followed by a float32 or int16
+ * bin payload. Stdout chunks can split frames anywhere, so the decoder
+ * buffers partial input and yields only complete frames.
+ */
+
+export const SPECTRUM_FRAME_MAGIC = 0x52465053; // "SPFR"
+/** Smallest valid header (version 1); version 2 adds configGen at offset 64. */
+export const SPECTRUM_FRAME_HEADER_BYTES = 64;
+
+export const FRAME_TYPE_SPECTRUM = 1;
+export const FRAME_TYPE_RECORD = 2;
+/** Longest record (or unknown-type) frame accepted; longer is a false magic match. */
+export const MAX_RECORD_FRAME_BYTES = 1 << 20;
+
+export const SPECTRUM_FLAG_INT16 = 1 << 0;
+export const SPECTRUM_FLAG_LINEAR = 1 << 1;
+/** Stitched scanner panorama: centerFreq/sampleRate describe the whole grid. */
+export const SPECTRUM_FLAG_PANORAMA = 1 << 2;
+/** iq_analyze: mean over the whole analysed range rather than one time slice. */
+export const SPECTRUM_FLAG_AVERAGE = 1 << 3;
+/** Per-bin maximum (peak hold) instead of a mean. */
+export const SPECTRUM_FLAG_MAX_HOLD = 1 << 4;
+
+export interface SpectrumFrame {
+  kind: "spectrum";
+  version: number;
+  flags: number;
+  timestamp: number;
+  centerFreq: number;
+  sampleRate: number;
+  fftSize: number;
+  peakBin: number;
+  peakPower: number;
+  sequence: number;
+  fftCount: number;
+  configGen: number;
+  bins: Float32Array;
+}
+
+export interface RecordFrame {
+  kind: "record";
+  sequence: number;
+  record: unknown;
+}
+
+export type DecodedFrame = SpectrumFrame | RecordFrame;
+
+export class SpectrumFrameDecoder {
+  private pending: Buffer = Buffer.alloc(0);
+
+  /**
+   * Append a stdout chunk and return every frame it completes.
+   * Bytes that do not start with the frame magic are skipped so the
+   * decoder resynchronises after stray output.
+   */
+  push(chunk: Buffer): DecodedFrame[] {
+    this.pending = this.pending.length === 0 ? chunk : Buffer.concat([this.pending, chunk]);
+    const frames: DecodedFrame[] = [];
+    let offset = 0;
+
+    while (this.pending.length - offset >= SPECTRUM_FRAME_HEADER_BYTES) {
+      if (this.pending.readUInt32LE(offset) !== SPECTRUM_FRAME_MAGIC) {
+        offset++;
+        continue;
+      }
+
+      const frameBytes = this.pending.readUInt32LE(offset + 4);
+      const headerBytes = this.pending.readUInt16LE(offset + 10);
+      if (headerBytes < SPECTRUM_FRAME_HEADER_BYTES || frameBytes < headerBytes) {
+        offset++;
+        continue;
+      }
+      // A spectrum payload is exactly fftSize bins and other frames are
+      // small; anything else is a false magic match in stray output, not a
+      // frame to wait for
+      const valid =
+        this.pending.readUInt8(offset + 9) === FRAME_TYPE_SPECTRUM
+          ? frameBytes - headerBytes ===
+            spectrumPayloadBytes(this.pending.readUInt32LE(offset + 12), this.pending.readUInt32LE(offset + 40))
+          : frameBytes <= MAX_RECORD_FRAME_BYTES;
+      if (!valid) {
+        offset++;
+        continue;
+      }
+      if (this.pending.length - offset < frameBytes) break;
+
+      const frame = decodeFrame(this.pending.subarray(offset, offset + frameBytes), headerBytes);
+      if (frame) frames.push(frame);
+      offset += frameBytes;
+    }
+
+    this.pending = this.pending.subarray(offset);
+    return frames;
+  }
+}
+
+function spectrumPayloadBytes(flags: number, fftSize: number): number {
+  return fftSize * (flags & SPECTRUM_FLAG_INT16 ? 2 : 4);
+}
+
+function decodeFrame(frame: Buffer, headerBytes: number): DecodedFrame | null {
+  const frameType = frame.readUInt8(9);
+  const sequence = frame.readUInt32LE(56);
+  const payload = frame.subarray(headerBytes);
+
+  if (frameType === FRAME_TYPE_RECORD) {
+    try {
+      return { kind: "record", sequence, record: JSON.parse(payload.toString("utf8")) };
+    } catch {
+      return null;
+    }
+  }
+  if (frameType !== FRAME_TYPE_SPECTRUM) return null;
+
+  const flags = frame.readUInt32LE(12);
+  const fftSize = frame.readUInt32LE(40);
+  const scale = frame.readFloatLE(52);
+  if (payload.length !== spectrumPayloadBytes(flags, fftSize)) return null;
+  let bins: Float32Array;
+
+  if (flags & SPECTRUM_FLAG_INT16) {
+    bins = new Float32Array(fftSize);
+    for (let i = 0; i < fftSize; i++) {
+      bins[i] = payload.readInt16LE(i * 2) * scale;
+    }
+  } else {
+    // Copy into a fresh ArrayBuffer: the payload may sit at any offset of a
+    // shared pool buffer, not necessarily 4-byte aligned
+    const start = payload.byteOffset;
+    bins = new Float32Array(payload.buffer.slice(start, start + payload.length));
+  }
+
+  return {
+    kind: "spectrum",
+    version: frame.readUInt8(8),
+    flags,
+    timestamp: frame.readDoubleLE(16),
+    centerFreq: frame.readDoubleLE(24),
+    sampleRate: frame.readDoubleLE(32),
+    fftSize,
+    peakBin: frame.readUInt32LE(44),
+    peakPower: frame.readFloatLE(48),
+    sequence,
+    fftCount: frame.readUInt32LE(60),
+    configGen: headerBytes >= 68 ? frame.readUInt32LE(64) : 0,
+    bins,
+  };
+}
+
+/**
+ * Frequency of bin `index`. Bins are FFT-shifted, so the same mapping holds
+ * for single spectra and for stitched panoramas.
+ */
+export function binFrequency(frame: SpectrumFrame, index: number): number {
+  return frame.centerFreq + (index - Math.floor(frame.fftSize / 2)) * (frame.sampleRate / frame.fftSize);
+}